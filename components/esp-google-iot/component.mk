@@ -60,6 +60,8 @@ CFLAGS += -DIOTC_FS_MEMORY \
           -DIOTC_MEMORY_LIMITER_SYSTEM_MEMORY_LIMIT=2024 \
           -DIOTC_MEMORY_LIMITER_ENABLED \
           -DIOTC_TLS_LIB_MBEDTLS \
+          -DIOTC_BSP_TLS_SESSION_CACHE \
+          -DIOTC_EVTD_SUBMISSION_RING_SIZE=32 \
 
 ifdef CONFIG_GIOT_DEBUG_OUTPUT
 CFLAGS += -DIOTC_DEBUG_OUTPUT=1
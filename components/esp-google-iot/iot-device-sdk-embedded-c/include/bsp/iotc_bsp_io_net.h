@@ -86,6 +86,7 @@
  * iotc_bsp_io_net_connection_check() | Checks a {@link iotc_bsp_io_net_socket_connect() socket} connection status |
  * iotc_bsp_io_net_read() | Reads from a {@link iotc_bsp_io_net_socket_connect() socket}. |
  * iotc_bsp_io_net_select() | Checks a {@link iotc_bsp_io_net_socket_connect() socket} for scheduled read or write operations. |
+ * iotc_bsp_io_net_select_wakeup() | Makes a {@link iotc_bsp_io_net_select() select} in progress return early. |
  * iotc_bsp_io_net_write() | Writes to a {@link iotc_bsp_io_net_socket_connect() socket}. |
  * iotc_bsp_io_net_close_socket() | Closes a {@link iotc_bsp_io_net_socket_connect() socket}. | 
  *
@@ -255,6 +256,20 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
     iotc_bsp_socket_events_t* socket_events_array,
     size_t socket_events_array_size, long timeout_sec);
 
+/**
+ * @brief Makes a {@link iotc_bsp_io_net_select() select} in progress, or the
+ * next one, return early.
+ *
+ * Called from threads other than the one running the event loop after they
+ * handed it work. A select which returns because of a wakeup reports no socket
+ * events. A BSP which cannot wake up its select may return
+ * IOTC_BSP_IO_NET_STATE_OK without doing anything, the work is then picked up
+ * when the select returns by itself.
+ *
+ * @returns A {@link #iotc_bsp_socket_events_s networking function state}.
+ */
+iotc_bsp_io_net_state_t iotc_bsp_io_net_select_wakeup(void);
+
 /**
  * @details Checks a {@link iotc_bsp_io_net_socket_connect() socket} connection
  * status.
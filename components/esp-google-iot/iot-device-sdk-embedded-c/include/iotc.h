@@ -94,13 +94,22 @@ extern "C" {
  * | iotc_connect_to() | Connects to a custom MQTT broker endpoint. |
  * | iotc_create_iotcore_jwt() | Creates a JSON Web Token for authenticating to Cloud IoT Core. | 
  * | iotc_shutdown_connection() | Disconnects asynchronously from an MQTT broker. |
+ * | iotc_set_session_type() | Asks the MQTT broker to keep the session between connections. |
  *
  * ## Sending and receiving messages
  * | Function | Description |
  * | --- | --- | 
  * | iotc_publish() | Publishes a message to an MQTT topic. |
  * | iotc_publish_data() | Publishes binary data to an MQTT topic. | 
+ * | iotc_publish_data_with_priority() | Publishes binary data in a priority class. |
+ * | iotc_submit_publish_data() | Publishes binary data from a thread other than the event loop's. |
+ * | iotc_set_submit_writable_callback() | Tells when iotc_submit_publish_data() takes publishes again. |
  * | iotc_subscribe() | Subscribes to an MQTT topic. |
+ * | iotc_subscribe_multiple() | Subscribes to several MQTT topics with one SUBSCRIBE. |
+ * | iotc_subscribe_streaming() | Subscribes to an MQTT topic and receives its payloads in chunks. |
+ * | iotc_set_callback_executor() | Invokes user callbacks on a worker instead of the event loop thread. |
+ * | iotc_run_callback_job() | Invokes a user callback handed to the callback executor. |
+ * | iotc_set_publish_window() | Limits the QoS 1 publishes in flight and queued. |
  *
  * ## Scheduling functions
  * | Function | Description |
@@ -327,6 +336,97 @@ extern iotc_state_t iotc_publish_data(iotc_context_handle_t iotc_h,
                                       iotc_user_callback_t* callback,
                                       void* user_data);
 
+/**
+ * @brief Publishes binary data to an MQTT topic in a priority class.
+ *
+ * @details Performs the same operations as iotc_publish_data(), which
+ * publishes with IOTC_MQTT_PRIORITY_NORMAL. Publishes queued in the SDK are
+ * sent in priority order, so an urgent publish overtakes a backlog of
+ * normal and bulk publishes. See ::iotc_mqtt_priority_t for how long the
+ * lower classes wait at most.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [in] topic The MQTT topic.
+ * @param [in] data A pointer to a buffer with the message payload.
+ * @param [in] data_len The size, in bytes, of the message.
+ * @param [in] qos The Quality of Service (QoS) level. Can be <code>0</code> or
+ *     <code>1</code>. QoS level <code>2</code> isn't supported.
+ * @param [in] priority The priority class of the publish.
+ * @param [in] callback (Optional) The callback function. Invoked after a
+ *     message is successfully or unsuccessfully delivered.
+ * @param [in] user_data (Optional) Abstract data passed to the callback
+ *     function.
+ *
+ * @retval IOTC_INVALID_PARAMETER The priority is not a valid class.
+ */
+extern iotc_state_t iotc_publish_data_with_priority(
+    iotc_context_handle_t iotc_h, const char* topic, const uint8_t* data,
+    size_t data_len, const iotc_mqtt_qos_t qos,
+    const iotc_mqtt_priority_t priority, iotc_user_callback_t* callback,
+    void* user_data);
+
+/**
+ * @brief Publishes binary data to an MQTT topic from any thread.
+ *
+ * @details All the other functions must be called from the thread which runs
+ * iotc_events_process_blocking(). This one copies topic and payload, hands
+ * them to the event loop through a lock-free queue and wakes the loop up; it
+ * never waits for the loop or for other submitting threads. The loop then
+ * publishes as iotc_publish_data_with_priority() would. Publishes submitted
+ * from one thread are made in submission order.
+ *
+ * If the publish is not accepted once it reaches the loop, for instance with
+ * IOTC_PUBLISH_WINDOW_FULL, the callback is invoked with that state.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [in] topic The MQTT topic.
+ * @param [in] data A pointer to a buffer with the message payload.
+ * @param [in] data_len The size, in bytes, of the message.
+ * @param [in] qos The Quality of Service (QoS) level. Can be <code>0</code> or
+ *     <code>1</code>. QoS level <code>2</code> isn't supported.
+ * @param [in] priority The priority class of the publish.
+ * @param [in] callback (Optional) The callback function. Invoked on the event
+ *     loop thread after a message is successfully or unsuccessfully delivered.
+ * @param [in] user_data (Optional) Abstract data passed to the callback
+ *     function.
+ *
+ * @retval IOTC_STATE_OK The publish was handed to the event loop.
+ * @retval IOTC_SUBMIT_QUEUE_FULL IOTC_EVTD_SUBMISSION_RING_SIZE submitted
+ *     publishes are waiting for the event loop already. Retry from the
+ *     {@link iotc_set_submit_writable_callback() submit writable callback}.
+ * @retval IOTC_INVALID_PARAMETER A parameter is missing or invalid.
+ * @retval IOTC_NOT_INITIALIZED No context was created yet.
+ * @retval IOTC_OUT_OF_MEMORY The copy could not be allocated.
+ */
+extern iotc_state_t iotc_submit_publish_data(
+    iotc_context_handle_t iotc_h, const char* topic, const uint8_t* data,
+    size_t data_len, const iotc_mqtt_qos_t qos,
+    const iotc_mqtt_priority_t priority, iotc_user_callback_t* callback,
+    void* user_data);
+
+/**
+ * @brief Sets the callback invoked once iotc_submit_publish_data() takes
+ * publishes again.
+ *
+ * @details After iotc_submit_publish_data() refused a publish with
+ * IOTC_SUBMIT_QUEUE_FULL, the callback is invoked on the event loop thread
+ * with IOTC_STATE_OK as soon as the loop has taken one of the waiting
+ * publishes. The submitted publishes of all contexts share one queue, so
+ * there is one such callback.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}, passed
+ *     to the callback.
+ * @param [in] writable_callback (Optional) The callback, NULL removes it.
+ * @param [in] user_data (Optional) Abstract data passed to the callback
+ *     function.
+ *
+ * @retval IOTC_STATE_OK The callback was set.
+ * @retval IOTC_INVALID_PARAMETER The context is invalid.
+ */
+extern iotc_state_t iotc_set_submit_writable_callback(
+    iotc_context_handle_t iotc_h, iotc_user_callback_t* writable_callback,
+    void* user_data);
+
 /**
  * @brief Subscribes to an MQTT topic.
  *
@@ -344,6 +444,89 @@ extern iotc_state_t iotc_subscribe(iotc_context_handle_t iotc_h,
                                    iotc_user_subscription_callback_t* callback,
                                    void* user_data);
 
+/**
+ * @brief Subscribes to several MQTT topics with one SUBSCRIBE.
+ *
+ * @details Performs the same operations as iotc_subscribe() for each topic,
+ * but the topics travel in a single SUBSCRIBE and are acknowledged by a
+ * single SUBACK, so subscribing costs one round trip instead of one per
+ * topic. The callback is invoked with IOTC_SUB_CALL_SUBACK once for each
+ * topic, params->suback.topic tells them apart.
+ *
+ * A message is handed to the callback with the user_data of the subscription
+ * it matched, so the callback can tell the topics apart without comparing
+ * topic names. Where the topic filters overlap, the most specific one wins.
+ * The messages of a topic with its stream flag set reach the callback in
+ * chunks, as with iotc_subscribe_streaming().
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [in] topics The MQTT topics.
+ * @param [in] qos The Quality of Service (QoS) level of each topic.
+ * @param [in] count The number of topics.
+ * @param [in] callback The {@link ::iotc_user_subscription_callback_t callback}
+ *     invoked after a message is published to any of the MQTT topics.
+ * @param [in] user_data (Optional) The callback function's user_data
+ *     parameter for each topic.
+ * @param [in] stream (Optional) For each topic, non-zero to receive its
+ *     payloads in chunks. NULL if none of them is streamed.
+ *
+ * @retval IOTC_INVALID_PARAMETER No topics were given or one of them is NULL.
+ */
+extern iotc_state_t iotc_subscribe_multiple(
+    iotc_context_handle_t iotc_h, const char* const* topics,
+    const iotc_mqtt_qos_t* qos, size_t count,
+    iotc_user_subscription_callback_t* callback, void* const* user_data,
+    const uint8_t* stream);
+
+/**
+ * @brief Subscribes to an MQTT topic and receives its payloads in chunks.
+ *
+ * @details Performs the same operations as iotc_subscribe(), but a message is
+ * not assembled before the callback is invoked. The callback is invoked with
+ * IOTC_SUB_CALL_MESSAGE_BEGIN once the topic has arrived, with
+ * IOTC_SUB_CALL_MESSAGE_CHUNK for each part of the payload as it is read
+ * from the connection and with IOTC_SUB_CALL_MESSAGE_END after the last one.
+ * params->stream carries the offset of the chunk and the length of the whole
+ * payload, so a device can write a payload far larger than its free memory
+ * straight to flash. A chunk is only valid until the callback returns.
+ *
+ * If the connection is lost before the last chunk IOTC_SUB_CALL_MESSAGE_END
+ * comes with a state other than IOTC_STATE_OK and the payload is incomplete.
+ * The callbacks of a streamed message run on the event loop thread even with
+ * a {@link iotc_set_callback_executor() callback executor} set.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [in] topic The MQTT topic.
+ * @param [in] qos The Quality of Service (QoS) level.
+ * @param [in] callback The {@link ::iotc_user_subscription_callback_t callback}
+ *     invoked with the SUBACK and with each message in parts.
+ * @param [in] user_data (Optional) The callback function's user_data
+ *     parameter.
+ */
+extern iotc_state_t iotc_subscribe_streaming(
+    iotc_context_handle_t iotc_h, const char* topic, const iotc_mqtt_qos_t qos,
+    iotc_user_subscription_callback_t* callback, void* user_data);
+
+/**
+ * @brief Sets the MQTT session type of the next connections of a context.
+ *
+ * @details With IOTC_SESSION_CONTINUE the client connects with the clean
+ * session flag cleared, the broker keeps the subscriptions and the
+ * unacknowledged QoS 1 messages of the client between connections and the
+ * SDK keeps the subscription callbacks. The session_present member of the
+ * connection data passed to the iotc_connect() callback tells whether the
+ * broker had a session, only then the topics need not be subscribed again.
+ * The default is IOTC_SESSION_CLEAN.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [in] session_type The session type.
+ *
+ * @retval IOTC_STATE_OK The session type was set.
+ * @retval IOTC_INVALID_PARAMETER The context is invalid.
+ */
+extern iotc_state_t iotc_set_session_type(iotc_context_handle_t iotc_h,
+                                          iotc_session_type_t session_type);
+
 /**
  * @brief Disconnects asynchronously from an MQTT broker.
  *
@@ -355,6 +538,89 @@ extern iotc_state_t iotc_subscribe(iotc_context_handle_t iotc_h,
  */
 extern iotc_state_t iotc_shutdown_connection(iotc_context_handle_t iotc_h);
 
+/**
+ * @brief Gets the QoS 1 publish statistics of a context.
+ *
+ * @details The smoothed PUBACK round trip time sets the retransmission timeout
+ * of QoS 1 publishes. A publish without a PUBACK is resent with the timeout
+ * doubled each time, up to IOTC_MQTT_PUBACK_RTO_MAX_MS.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [out] stats The statistics.
+ *
+ * @retval IOTC_STATE_OK The statistics were copied.
+ * @retval IOTC_INVALID_PARAMETER The context or the stats pointer is invalid.
+ */
+extern iotc_state_t iotc_get_mqtt_publish_stats(
+    iotc_context_handle_t iotc_h, iotc_mqtt_publish_stats_t* stats);
+
+/**
+ * @brief Limits the QoS 1 publishes in flight and queued on a context.
+ *
+ * @details At most max_in_flight QoS 1 publishes wait for their PUBACK at a
+ * time. Further publishes are queued in the SDK and started as PUBACKs come
+ * in. Once max_in_flight plus max_queued publishes are in flight or queued
+ * iotc_publish() and iotc_publish_data() refuse QoS 1 publishes with
+ * IOTC_PUBLISH_WINDOW_FULL and the writable callback is invoked with
+ * IOTC_STATE_OK when the queue has drained to half of max_queued. The limits apply to publishes made
+ * after the call.
+ *
+ * @param [in] iotc_h A {@link iotc_create_context() context handle}.
+ * @param [in] max_in_flight The publish window, <code>0</code> removes the
+ *     limit, which is the default.
+ * @param [in] max_queued The publishes queued behind the window at most.
+ * @param [in] writable_callback (Optional) Invoked when publishes are
+ *     accepted again after one was refused.
+ * @param [in] user_data (Optional) Abstract data passed to the callback
+ *     function.
+ *
+ * @retval IOTC_STATE_OK The limits were set.
+ * @retval IOTC_INVALID_PARAMETER The context is invalid.
+ */
+extern iotc_state_t iotc_set_publish_window(
+    iotc_context_handle_t iotc_h, uint16_t max_in_flight, uint16_t max_queued,
+    iotc_user_callback_t* writable_callback, void* user_data);
+
+/**
+ * @brief Invokes user callbacks on a worker instead of the event loop thread.
+ *
+ * @details A callback which takes long, for instance because it writes to
+ * flash, stalls keepalives, acknowledgements and socket reads while it runs
+ * on the event loop thread. With an executor set each user callback is handed
+ * to it as a {@link ::iotc_callback_job_t job} instead. The payload of a
+ * message is not copied: the job owns the received message until the
+ * callback has returned, and the memory goes back to the event loop thread,
+ * which frees it.
+ *
+ * The SDK functions other than iotc_submit_publish_data() must only be called
+ * from the event loop thread, so the executor should only hand over the
+ * callbacks which don't call them. The call types it does not hand over are
+ * best refused by takes, which spares them the job; a job the executor got
+ * anyway it runs with iotc_run_callback_job() right away. Jobs must have been
+ * run before iotc_shutdown() is called.
+ *
+ * @param [in] executor The executor, NULL to invoke callbacks on the event
+ *     loop thread again, which is the default.
+ * @param [in] takes (Optional) Tells which call types the executor takes,
+ *     NULL if it takes all of them.
+ * @param [in] executor_data (Optional) Abstract data passed to the executor
+ *     and to takes.
+ */
+extern void iotc_set_callback_executor(iotc_callback_executor_t* executor,
+                                       iotc_callback_executor_takes_t* takes,
+                                       void* executor_data);
+
+/**
+ * @brief Invokes the user callback of a job handed to the
+ * {@link iotc_set_callback_executor() callback executor}.
+ *
+ * @details Can be called from any thread, once per job. The job must not be
+ * used afterwards.
+ *
+ * @param [in] job The job.
+ */
+extern void iotc_run_callback_job(iotc_callback_job_t* job);
+
 /**
  * @brief Returns a unique ID for the scheduled task and invokes a callback
  *     after an interval.
@@ -90,6 +90,9 @@ typedef struct iotc_connection_data_s {
   iotc_connection_state_t connection_state;
   /** The MQTT client session. */
   iotc_session_type_t session_type;
+  /** The CONNACK said the broker kept the session of an earlier connection,
+   * only ever set with IOTC_SESSION_CONTINUE. */
+  uint8_t session_present;
   /** Unused. */
   char* will_topic;
   /** Unused. */
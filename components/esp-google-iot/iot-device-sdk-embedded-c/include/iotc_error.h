@@ -107,6 +107,8 @@ typedef enum {
   /** The buffer is too small for the data. @internal Numeric code: 74 @endinternal */ IOTC_BUFFER_TOO_SMALL_ERROR,
   /** The buffer for storing formatted and signed JWTs is null. @internal Numeric code: 75 @endinternal */ IOTC_NULL_KEY_DATA_ERROR,
   /** @cond Numeric code: 76 */ IOTC_NULL_CLIENT_ID_ERROR, /** @endcond */
+  /** The QoS 1 publish window and its queue are full, the publish was not accepted. Retry from the {@link iotc_set_publish_window() writable callback}. @internal Numeric code: 77 @endinternal */ IOTC_PUBLISH_WINDOW_FULL,
+  /** Too many publishes submitted from other threads are waiting for the event loop, the publish was not accepted. Retry from the {@link iotc_set_submit_writable_callback() submit writable callback}. @internal Numeric code: 78 @endinternal */ IOTC_SUBMIT_QUEUE_FULL,
 
   /** @cond */ IOTC_ERROR_COUNT /** @endcond */ /* Add errors above this line; this should always be last line. */
 } iotc_state_t;
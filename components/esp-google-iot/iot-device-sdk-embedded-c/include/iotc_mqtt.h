@@ -17,6 +17,8 @@
 #ifndef __IOTC_MQTT_H__
 #define __IOTC_MQTT_H__
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -89,6 +91,81 @@ typedef enum iotc_mqtt_dup_e {
   IOTC_MQTT_DUP_TRUE = 1,
 } iotc_mqtt_dup_t;
 
+/**
+ * @typedef iotc_mqtt_priority_t
+ * @brief The scheduling class of an outbound publish.
+ *
+ * Queued publishes leave in strict priority order, first in first out within
+ * a class. A normal or bulk publish which has waited longer than
+ * IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS or IOTC_MQTT_PUBLISH_MAX_WAIT_BULK_MS
+ * is let through ahead of the higher classes, every other publish at most.
+ *
+ * @see iotc_mqtt_priority_e
+ */
+typedef enum iotc_mqtt_priority_e {
+  /** Alarms, ahead of everything else. */
+  IOTC_MQTT_PRIORITY_URGENT = 0,
+  /** State updates and events, the default. */
+  IOTC_MQTT_PRIORITY_NORMAL = 1,
+  /** Telemetry and heartbeats which can wait. */
+  IOTC_MQTT_PRIORITY_BULK = 2,
+} iotc_mqtt_priority_t;
+
+/** The number of publish priority classes. */
+#define IOTC_MQTT_PRIORITY_COUNT 3
+
+/** The buckets of the publish queue delay histograms. Bucket <code>i</code>
+ * counts delays below <code>16 << (2 * i)</code> milliseconds, the last one
+ * all longer delays. */
+#define IOTC_MQTT_QUEUE_DELAY_BUCKETS 8
+
+/**
+ * @typedef iotc_mqtt_publish_stats_t
+ * @brief QoS 1 publish round trip and retransmission statistics.
+ * @see iotc_mqtt_publish_stats_s
+ *
+ * @struct iotc_mqtt_publish_stats_s
+ * @brief QoS 1 publish round trip and retransmission statistics.
+ *
+ * The round trip time is measured from writing a PUBLISH to receiving its
+ * PUBACK and is estimated anew for each connection. The counters cover the
+ * lifetime of the context.
+ */
+typedef struct iotc_mqtt_publish_stats_s {
+  /** Smoothed round trip time in milliseconds, 0 until the first sample. */
+  uint32_t srtt_ms;
+  /** Round trip time variation in milliseconds. */
+  uint32_t rttvar_ms;
+  /** The current PUBACK timeout in milliseconds, before any backoff. */
+  uint32_t rto_ms;
+  /** The last round trip time sample in milliseconds. */
+  uint32_t last_rtt_ms;
+  /** The shortest round trip time sample in milliseconds. */
+  uint32_t min_rtt_ms;
+  /** The longest round trip time sample in milliseconds. */
+  uint32_t max_rtt_ms;
+  /** Round trip time samples taken, resent publishes give none. */
+  uint32_t rtt_samples;
+  /** QoS 1 publishes acknowledged with a PUBACK. */
+  uint32_t acked;
+  /** PUBACK timeouts. */
+  uint32_t timeouts;
+  /** PUBLISH retransmissions, after a timeout or a reconnect. */
+  uint32_t resent;
+  /** QoS 1 publishes refused with IOTC_PUBLISH_WINDOW_FULL. */
+  uint32_t refused;
+  /** QoS 1 publishes sent and waiting for their PUBACK. */
+  uint16_t in_flight;
+  /** Publishes queued in the SDK, waiting for the publish window or for
+   * the previous PUBLISH to be written. */
+  uint16_t queued;
+  /** Time from iotc_publish() until the PUBLISH was written, per
+   * iotc_mqtt_priority_t, see IOTC_MQTT_QUEUE_DELAY_BUCKETS. */
+  uint32_t queue_delay[IOTC_MQTT_PRIORITY_COUNT][IOTC_MQTT_QUEUE_DELAY_BUCKETS];
+  /** The longest queue delay in milliseconds, per iotc_mqtt_priority_t. */
+  uint32_t max_queue_delay_ms[IOTC_MQTT_PRIORITY_COUNT];
+} iotc_mqtt_publish_stats_t;
+
 #ifdef __cplusplus
 }
 #endif
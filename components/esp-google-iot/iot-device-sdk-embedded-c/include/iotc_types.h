@@ -90,7 +90,15 @@ typedef enum iotc_subscription_data_type_e {
   /** @brief The callback is a SUBACK notification. */
   IOTC_SUB_CALL_SUBACK,
   /** @brief The callback is a MESSAGE notification. */
-  IOTC_SUB_CALL_MESSAGE
+  IOTC_SUB_CALL_MESSAGE,
+  /** @brief A message for an {@link iotc_subscribe_streaming() streaming
+   * subscription} arrived, its payload follows in chunks. */
+  IOTC_SUB_CALL_MESSAGE_BEGIN,
+  /** @brief A chunk of the payload of a streamed message. */
+  IOTC_SUB_CALL_MESSAGE_CHUNK,
+  /** @brief The streamed message is complete if the state is IOTC_STATE_OK,
+   * otherwise the connection was lost before its last chunk. */
+  IOTC_SUB_CALL_MESSAGE_END
 } iotc_sub_call_type_t;
 
 /**
@@ -157,6 +165,32 @@ typedef union iotc_sub_call_params_u {
      */
     iotc_mqtt_dup_t dup_flag;
   } message;
+
+  /** A PUBLISH packet delivered to a
+   * {@link iotc_subscribe_streaming() streaming subscription}, the same for
+   * IOTC_SUB_CALL_MESSAGE_BEGIN, IOTC_SUB_CALL_MESSAGE_CHUNK and
+   * IOTC_SUB_CALL_MESSAGE_END apart from the chunk.
+   */
+  struct {
+    const char* topic;
+    /** @details A part of the PUBLISH payload, straight from the buffer the
+     * SDK reads into and valid only until the callback returns. NULL but for
+     * IOTC_SUB_CALL_MESSAGE_CHUNK. */
+    const uint8_t* temporary_chunk_data;
+    /** The length, in bytes, of the chunk. */
+    size_t temporary_chunk_data_length;
+    /** The position of the chunk in the payload. With
+     * IOTC_SUB_CALL_MESSAGE_END the number of bytes delivered. */
+    size_t offset;
+    /** The length, in bytes, of the whole payload. */
+    size_t total_length;
+    /** The MQTT retain flag. */
+    iotc_mqtt_retain_t retain;
+    /** The MQTT Quality of Service level. */
+    iotc_mqtt_qos_t qos;
+    /** The MQTT DUP flag. */
+    iotc_mqtt_dup_t dup_flag;
+  } stream;
 } iotc_sub_call_params_t;
 
 /** @brief The internal representations of empty
@@ -189,6 +223,50 @@ typedef void(iotc_user_subscription_callback_t)(
     const iotc_sub_call_params_t* const params, iotc_state_t state,
     void* user_data);
 
+/**
+ * @typedef iotc_callback_job_t
+ * @brief A user callback, with its parameters, waiting to be invoked by
+ * iotc_run_callback_job().
+ */
+typedef struct iotc_callback_job_s iotc_callback_job_t;
+
+/**
+ * @typedef iotc_callback_executor_t
+ * @brief The {@link iotc_set_callback_executor() callback executor}.
+ *
+ * Invoked on the event loop thread instead of a user callback. The executor
+ * hands the job to a worker, which invokes iotc_run_callback_job(), or calls
+ * iotc_run_callback_job() itself to invoke the callback right away.
+ *
+ * @param [in] job The callback to invoke.
+ * @param [in] call_type IOTC_SUB_CALL_MESSAGE or IOTC_SUB_CALL_SUBACK for a
+ *     {@link ::iotc_user_subscription_callback_t subscription callback},
+ *     IOTC_SUB_CALL_UNKNOWN for the other callbacks.
+ * @param [in] executor_data The data provided to
+ *     iotc_set_callback_executor().
+ */
+typedef void(iotc_callback_executor_t)(iotc_callback_job_t* job,
+                                       iotc_sub_call_type_t call_type,
+                                       void* executor_data);
+
+/**
+ * @typedef iotc_callback_executor_takes_t
+ * @brief Tells whether the {@link iotc_set_callback_executor() callback
+ * executor} takes callbacks of a call type.
+ *
+ * Invoked on the event loop thread before a job is made for a user callback.
+ * The callbacks the executor does not take are invoked right away, without a
+ * job.
+ *
+ * @param [in] call_type As passed to ::iotc_callback_executor_t.
+ * @param [in] executor_data The data provided to
+ *     iotc_set_callback_executor().
+ * @retval 0 The callback is invoked on the event loop thread.
+ * @retval 1 The callback is handed to the executor.
+ */
+typedef uint8_t(iotc_callback_executor_takes_t)(iotc_sub_call_type_t call_type,
+                                                void* executor_data);
+
 /**
  * @typedef iotc_crypto_key_union_type_t
  * @brief The internal code that represents the data type of the public or
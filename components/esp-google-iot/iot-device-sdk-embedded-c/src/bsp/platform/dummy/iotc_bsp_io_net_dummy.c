@@ -81,6 +81,12 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
   return IOTC_BSP_IO_NET_STATE_OK;
 }
 
+/* nothing to wake up a select with, the event loop picks submitted handles up
+ * when select returns */
+iotc_bsp_io_net_state_t iotc_bsp_io_net_select_wakeup(void) {
+  return IOTC_BSP_IO_NET_STATE_OK;
+}
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
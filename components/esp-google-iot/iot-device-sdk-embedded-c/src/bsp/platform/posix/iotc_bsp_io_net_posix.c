@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -36,6 +37,21 @@ extern "C" {
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #endif
 
+/* a pipe whose read end is part of every select, writing a byte to it cuts the
+ * select short */
+static int wakeup_fds[2] = {-1, -1};
+static pthread_once_t wakeup_once = PTHREAD_ONCE_INIT;
+
+static void iotc_bsp_io_net_wakeup_init(void) {
+  if (0 != pipe(wakeup_fds)) {
+    wakeup_fds[0] = wakeup_fds[1] = -1;
+    return;
+  }
+
+  fcntl(wakeup_fds[0], F_SETFL, fcntl(wakeup_fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(wakeup_fds[1], F_SETFL, fcntl(wakeup_fds[1], F_GETFL) | O_NONBLOCK);
+}
+
 iotc_bsp_io_net_state_t iotc_bsp_io_net_socket_connect(
     iotc_bsp_socket_t* iotc_socket, const char* host, uint16_t port,
     iotc_bsp_socket_type_t socket_type) {
@@ -260,6 +276,13 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
     }
   }
 
+  pthread_once(&wakeup_once, iotc_bsp_io_net_wakeup_init);
+
+  if (-1 != wakeup_fds[0]) {
+    FD_SET(wakeup_fds[0], &rfds);
+    max_fd_read = MAX(max_fd_read, wakeup_fds[0]);
+  }
+
   /* calculate max fd */
   const int max_fd = MAX(max_fd_read, MAX(max_fd_write, max_fd_error));
 
@@ -268,6 +291,13 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
   /* call the actual posix select */
   const int result = select(max_fd + 1, &rfds, &wfds, &efds, &tv);
 
+  if (0 < result && -1 != wakeup_fds[0] && FD_ISSET(wakeup_fds[0], &rfds)) {
+    char drain[16];
+
+    while (0 < read(wakeup_fds[0], drain, sizeof(drain)))
+      ;
+  }
+
   if (0 < result) {
     /* translate the result back to the socket events structure */
     for (socket_id = 0; socket_id < socket_events_array_size; ++socket_id) {
@@ -300,6 +330,24 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
   return IOTC_BSP_IO_NET_STATE_ERROR;
 }
 
+iotc_bsp_io_net_state_t iotc_bsp_io_net_select_wakeup(void) {
+  pthread_once(&wakeup_once, iotc_bsp_io_net_wakeup_init);
+
+  if (-1 == wakeup_fds[1]) {
+    return IOTC_BSP_IO_NET_STATE_ERROR;
+  }
+
+  const char wakeup = 0;
+
+  /* a full pipe has wakeups enough pending */
+  if (-1 == write(wakeup_fds[1], &wakeup, 1) && EAGAIN != errno &&
+      EWOULDBLOCK != errno) {
+    return IOTC_BSP_IO_NET_STATE_ERROR;
+  }
+
+  return IOTC_BSP_IO_NET_STATE_OK;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -248,3 +248,9 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
   return IOTC_BSP_IO_NET_STATE_ERROR;
 }
 
+
+/* nothing to wake up a select with, the event loop picks submitted handles up
+ * when select returns */
+iotc_bsp_io_net_state_t iotc_bsp_io_net_select_wakeup(void) {
+  return IOTC_BSP_IO_NET_STATE_OK;
+}
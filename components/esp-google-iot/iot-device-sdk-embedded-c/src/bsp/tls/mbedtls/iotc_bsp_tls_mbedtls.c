@@ -29,6 +29,10 @@
 #include <mbedtls/platform.h>
 #include <mbedtls/ssl.h>
 
+#ifdef IOTC_BSP_TLS_SESSION_CACHE
+#include "iotc_bsp_tls_session.h"
+#endif
+
 /**
  * @brief If the libiotc's certificate buffer's last character is '\n' (common
  * after file reading, and replicated in iotc_RootCA_list for consistency),
@@ -222,6 +226,14 @@ iotc_bsp_tls_state_t iotc_bsp_tls_init(
     goto err_handling;
   }
 
+#ifdef IOTC_BSP_TLS_SESSION_CACHE
+  /* resume the last session, the server falls back to a full handshake if it
+   * does not know it anymore */
+  if (iotc_bsp_tls_session_load(&mbedtls_tls_context->ssl)) {
+    iotc_bsp_debug_logger("offering cached TLS session");
+  }
+#endif
+
   return IOTC_BSP_TLS_STATE_OK;
 
 err_handling:
@@ -258,6 +270,10 @@ iotc_bsp_tls_state_t iotc_bsp_tls_connect(iotc_bsp_tls_context_t* tls_context) {
       return IOTC_BSP_TLS_STATE_CONNECT_ERROR;
   }
 
+#ifdef IOTC_BSP_TLS_SESSION_CACHE
+  iotc_bsp_tls_session_save(&mbedtls_tls_context->ssl);
+#endif
+
   /* after succesfull connection unload the certificate */
   mbedtls_x509_crt_free(&mbedtls_tls_context->cacert);
 
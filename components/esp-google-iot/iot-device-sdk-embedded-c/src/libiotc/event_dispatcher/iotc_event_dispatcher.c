@@ -17,6 +17,7 @@
 #include <inttypes.h>
 
 #include "iotc_event_dispatcher_api.h"
+#include "iotc_bsp_io_net.h"
 #include "iotc_helpers.h"
 #include "iotc_list.h"
 
@@ -196,6 +197,49 @@ err_handling:
   return NULL;
 }
 
+/* One wakeup per step is enough, the step takes all handles submitted before
+ * it cleared the flag. Only the producer which sets it pays for the wakeup. */
+static void iotc_evtd_wake_up(iotc_evtd_instance_t* instance) {
+  if (0 == __atomic_exchange_n(&instance->wakeup_pending, 1,
+                               __ATOMIC_SEQ_CST)) {
+    iotc_bsp_io_net_select_wakeup();
+  }
+}
+
+iotc_state_t iotc_evtd_submit(iotc_evtd_instance_t* instance,
+                              iotc_event_handle_t handle) {
+  assert(NULL != instance);
+
+  const iotc_state_t state =
+      iotc_event_handle_ring_push(instance->submissions, &handle);
+
+  if (IOTC_STATE_OK != state) {
+    return state;
+  }
+
+  iotc_evtd_wake_up(instance);
+
+  return IOTC_STATE_OK;
+}
+
+void iotc_evtd_submit_queued(iotc_evtd_instance_t* instance,
+                             iotc_event_handle_queue_t* elem) {
+  assert(NULL != instance);
+  assert(NULL != elem);
+
+  /* pushed in front, the step takes the whole list at once so a popped
+   * element never comes back under the same address while it is looked at */
+  elem->__next =
+      __atomic_load_n(&instance->queued_submissions, __ATOMIC_RELAXED);
+
+  while (!__atomic_compare_exchange_n(&instance->queued_submissions,
+                                      &elem->__next, elem, 1,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+  }
+
+  iotc_evtd_wake_up(instance);
+}
+
 iotc_state_t iotc_evtd_execute_in(
     iotc_evtd_instance_t* instance, iotc_event_handle_t handle,
     iotc_time_t time_diff, iotc_time_event_handle_t* ret_time_event_handle) {
@@ -265,6 +309,10 @@ iotc_evtd_instance_t* iotc_evtd_create_instance(void) {
   evtd_instance->handles_and_file_fd = iotc_vector_create();
   IOTC_CHECK_MEMORY(evtd_instance->handles_and_file_fd, state);
 
+  evtd_instance->submissions =
+      iotc_event_handle_ring_create(IOTC_EVTD_SUBMISSION_RING_SIZE);
+  IOTC_CHECK_MEMORY(evtd_instance->submissions, state);
+
   IOTC_CHECK_STATE(iotc_init_critical_section(&evtd_instance->cs));
 
   return evtd_instance;
@@ -274,6 +322,9 @@ err_handling:
   return 0;
 }
 
+static void iotc_evtd_run_submissions(iotc_evtd_instance_t* instance);
+static void iotc_evtd_run_queued_submissions(iotc_evtd_instance_t* instance);
+
 void iotc_evtd_destroy_instance(iotc_evtd_instance_t* instance) {
   if (instance == NULL) return;
 
@@ -281,6 +332,11 @@ void iotc_evtd_destroy_instance(iotc_evtd_instance_t* instance) {
 
   IOTC_UNUSED(cs); /* yeah, I know */
 
+  /* the submitted handles own what was handed over with them */
+  iotc_evtd_run_submissions(instance);
+  iotc_evtd_run_queued_submissions(instance);
+  iotc_event_handle_ring_destroy(&instance->submissions);
+
   iotc_lock_critical_section(cs);
 
   iotc_vector_destroy(instance->handles_and_file_fd);
@@ -347,6 +403,49 @@ static uint8_t iotc_state_is_fatal(iotc_state_t e) {
   }
 }
 
+/* Runs at most one ring's worth, so that producers which keep submitting
+ * cannot hold the dispatcher in here. */
+static void iotc_evtd_run_submissions(iotc_evtd_instance_t* instance) {
+  iotc_event_handle_t handle;
+  size_t count = 0;
+
+  while (count++ < IOTC_EVTD_SUBMISSION_RING_SIZE &&
+         iotc_event_handle_ring_pop(instance->submissions, &handle)) {
+    const iotc_state_t result = iotc_evtd_execute_handle(&handle);
+
+    if (iotc_state_is_fatal(result) == 1) {
+      iotc_debug_logger("error while processing submitted events");
+    }
+  }
+}
+
+/* Takes the whole list, elements submitted meanwhile wait for the next step.
+ * The list is newest first, it is turned around to run them in order. */
+static void iotc_evtd_run_queued_submissions(iotc_evtd_instance_t* instance) {
+  iotc_event_handle_queue_t* elem = __atomic_exchange_n(
+      &instance->queued_submissions, NULL, __ATOMIC_ACQUIRE);
+  iotc_event_handle_queue_t* in_order = NULL;
+
+  while (NULL != elem) {
+    iotc_event_handle_queue_t* next = elem->__next;
+    elem->__next = in_order;
+    in_order = elem;
+    elem = next;
+  }
+
+  while (NULL != in_order) {
+    /* the handle may release the element it came in */
+    iotc_event_handle_t handle = in_order->handle;
+    in_order = in_order->__next;
+
+    const iotc_state_t result = iotc_evtd_execute_handle(&handle);
+
+    if (iotc_state_is_fatal(result) == 1) {
+      iotc_debug_logger("error while processing submitted events");
+    }
+  }
+}
+
 extern uint8_t iotc_evtd_single_step(iotc_evtd_instance_t* evtd_instance,
                                      iotc_time_t new_step) {
   if (evtd_instance == NULL) return 0;
@@ -381,6 +480,11 @@ void iotc_evtd_step(iotc_evtd_instance_t* evtd_instance, iotc_time_t new_step) {
   evtd_instance->current_step = new_step;
   iotc_time_event_t* tmp = NULL;
 
+  /* cleared first, a handle submitted from now on wakes the loop again */
+  __atomic_store_n(&evtd_instance->wakeup_pending, 0, __ATOMIC_SEQ_CST);
+  iotc_evtd_run_submissions(evtd_instance);
+  iotc_evtd_run_queued_submissions(evtd_instance);
+
 #ifdef IOTC_DEUBG_OUTPUT_EVENT_SYSTEM
   iotc_debug_format("[size of time event queue: %d]",
                     evtd_instance->call_heap->first_free);
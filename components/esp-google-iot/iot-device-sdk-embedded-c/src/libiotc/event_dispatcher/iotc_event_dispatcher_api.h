@@ -25,6 +25,7 @@
 #include "iotc_config.h"
 #include "iotc_event_handle.h"
 #include "iotc_event_handle_queue.h"
+#include "iotc_event_handle_ring.h"
 #include "iotc_macros.h"
 #include "iotc_time.h"
 #include "iotc_time_event.h"
@@ -59,6 +60,11 @@ typedef struct iotc_evtd_instance_s {
   iotc_vector_t* handles_and_socket_fd;
   iotc_vector_t* handles_and_file_fd;
   iotc_event_handle_t on_empty;
+  /* handles from other threads, see iotc_evtd_submit() */
+  iotc_event_handle_ring_t* submissions;
+  /* the same, without a bound, see iotc_evtd_submit_queued() */
+  iotc_event_handle_queue_t* queued_submissions;
+  uint8_t wakeup_pending;
   uint8_t stop;
 } iotc_evtd_instance_t;
 
@@ -87,6 +93,34 @@ extern void iotc_evtd_continue_when_empty(iotc_evtd_instance_t* instance,
 extern iotc_event_handle_queue_t* iotc_evtd_execute(
     iotc_evtd_instance_t* instance, iotc_event_handle_t handle);
 
+/**
+ * @brief Hands a handle to the dispatcher from any thread.
+ *
+ * All the other functions must only be called from the thread which runs the
+ * dispatcher. The handle is run at the next step, in submission order with
+ * the other handles submitted from the same thread. If the dispatcher may be
+ * blocked in the select of the event loop it is woken up.
+ *
+ * @retval IOTC_STATE_OK
+ * @retval IOTC_BUFFER_OVERFLOW if IOTC_EVTD_SUBMISSION_RING_SIZE handles are
+ *         waiting already
+ */
+extern iotc_state_t iotc_evtd_submit(iotc_evtd_instance_t* instance,
+                                     iotc_event_handle_t handle);
+
+/**
+ * @brief Hands a handle to the dispatcher from any thread, in memory the
+ * caller provides so that it cannot fail.
+ *
+ * For the hand-overs which must not be lost, such as giving back memory which
+ * only the dispatcher's thread may free. The element stays the caller's, the
+ * dispatcher copies the handle out of it before it runs it, so the handle may
+ * release the element. Runs at the next step like iotc_evtd_submit(), in
+ * submission order with the other elements submitted from the same thread.
+ */
+extern void iotc_evtd_submit_queued(iotc_evtd_instance_t* instance,
+                                    iotc_event_handle_queue_t* elem);
+
 extern iotc_state_t iotc_evtd_execute_in(
     iotc_evtd_instance_t* instance, iotc_event_handle_t handle,
     iotc_time_t time_diff, iotc_time_event_handle_t* ret_time_event_handle);
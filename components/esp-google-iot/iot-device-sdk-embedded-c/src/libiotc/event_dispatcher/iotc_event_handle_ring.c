@@ -0,0 +1,126 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_event_handle_ring.h"
+#include "iotc_allocator.h"
+#include "iotc_macros.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+iotc_event_handle_ring_t* iotc_event_handle_ring_create(size_t capacity) {
+  if (0 == capacity || 0 != (capacity & (capacity - 1))) {
+    return NULL;
+  }
+
+  iotc_state_t state = IOTC_STATE_OK;
+  IOTC_ALLOC(iotc_event_handle_ring_t, ring, state);
+  IOTC_ALLOC_BUFFER_AT(iotc_event_handle_ring_slot_t, ring->slots,
+                       capacity * sizeof(iotc_event_handle_ring_slot_t),
+                       state);
+
+  ring->mask = capacity - 1;
+
+  /* slot i is free for the push of position i */
+  size_t i = 0;
+  for (; i < capacity; ++i) {
+    ring->slots[i].sequence = i;
+  }
+
+  return ring;
+
+err_handling:
+  IOTC_SAFE_FREE(ring);
+  return NULL;
+}
+
+void iotc_event_handle_ring_destroy(iotc_event_handle_ring_t** ring) {
+  if (NULL == ring || NULL == *ring) {
+    return;
+  }
+
+  IOTC_SAFE_FREE((*ring)->slots);
+  IOTC_SAFE_FREE(*ring);
+}
+
+iotc_state_t iotc_event_handle_ring_push(iotc_event_handle_ring_t* ring,
+                                         const iotc_event_handle_t* handle) {
+  /* PRE-CONDITIONS */
+  assert(NULL != ring);
+  assert(NULL != handle);
+
+  iotc_event_handle_ring_slot_t* slot = NULL;
+  size_t position =
+      __atomic_load_n(&ring->enqueue_position, __ATOMIC_RELAXED);
+
+  for (;;) {
+    slot = &ring->slots[position & ring->mask];
+
+    const size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+    if (0 == difference) {
+      /* on failure position is reloaded with the one another producer left */
+      if (__atomic_compare_exchange_n(&ring->enqueue_position, &position,
+                                      position + 1, 1, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (0 > difference) {
+      /* the slot still holds the handle of the previous lap */
+      return IOTC_BUFFER_OVERFLOW;
+    } else {
+      position = __atomic_load_n(&ring->enqueue_position, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->handle = *handle;
+  __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+
+  return IOTC_STATE_OK;
+}
+
+uint8_t iotc_event_handle_ring_pop(iotc_event_handle_ring_t* ring,
+                                   iotc_event_handle_t* out_handle) {
+  /* PRE-CONDITIONS */
+  assert(NULL != ring);
+  assert(NULL != out_handle);
+
+  const size_t position = ring->dequeue_position;
+  iotc_event_handle_ring_slot_t* slot = &ring->slots[position & ring->mask];
+  const size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+  if (sequence != position + 1) {
+    return 0;
+  }
+
+  *out_handle = slot->handle;
+
+  /* free for the push one lap ahead */
+  __atomic_store_n(&slot->sequence, position + ring->mask + 1,
+                   __ATOMIC_RELEASE);
+  ring->dequeue_position = position + 1;
+
+  return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,85 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_EVENT_HANDLE_RING_H__
+#define __IOTC_EVENT_HANDLE_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "iotc_error.h"
+#include "iotc_event_handle.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A bounded ring of event handles which any number of threads push to and a
+ * single thread pops from, without locks. Each slot carries a sequence number
+ * which tells whether it is free for the push of a given position or holds
+ * the handle of that position. A producer claims a position with one compare
+ * and swap and never waits for another producer or for the consumer. */
+
+typedef struct iotc_event_handle_ring_slot_s {
+  size_t sequence;
+  iotc_event_handle_t handle;
+} iotc_event_handle_ring_slot_t;
+
+typedef struct iotc_event_handle_ring_s {
+  iotc_event_handle_ring_slot_t* slots;
+  size_t mask; /* capacity - 1, the capacity is a power of two */
+  size_t enqueue_position; /* shared by the producers */
+  size_t dequeue_position; /* owned by the consumer */
+} iotc_event_handle_ring_t;
+
+/**
+ * @brief Allocates an empty ring.
+ *
+ * @param capacity the number of handles the ring holds, a power of two
+ * @return the ring or NULL if out of memory or the capacity is not valid
+ */
+iotc_event_handle_ring_t* iotc_event_handle_ring_create(size_t capacity);
+
+/**
+ * @brief Releases the ring, handles still in it are dropped.
+ */
+void iotc_event_handle_ring_destroy(iotc_event_handle_ring_t** ring);
+
+/**
+ * @brief Appends a handle, safe to call from any thread.
+ *
+ * @retval IOTC_STATE_OK
+ * @retval IOTC_BUFFER_OVERFLOW if the ring is full
+ */
+iotc_state_t iotc_event_handle_ring_push(iotc_event_handle_ring_t* ring,
+                                         const iotc_event_handle_t* handle);
+
+/**
+ * @brief Takes the oldest handle, only ever called from the consumer thread.
+ *
+ * A handle whose producer is still copying it in stops the pop until the copy
+ * is done, so handles come out in the order their positions were claimed.
+ *
+ * @return 1 if a handle was taken, 0 if there is none
+ */
+uint8_t iotc_event_handle_ring_pop(iotc_event_handle_ring_t* ring,
+                                   iotc_event_handle_t* out_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_EVENT_HANDLE_RING_H__ */
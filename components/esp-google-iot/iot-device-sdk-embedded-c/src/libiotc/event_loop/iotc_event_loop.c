@@ -56,6 +56,7 @@ iotc_state_t iotc_bsp_event_loop_transform_to_bsp_select(
 
   size_t socket_id = 0;
   uint8_t was_file_updated = 0;
+  uint8_t was_handle_submitted = 0;
   uint8_t was_timeout_candidate_set = 0;
   iotc_time_t timeout_candidate = 0;
 
@@ -115,6 +116,11 @@ iotc_state_t iotc_bsp_event_loop_transform_to_bsp_select(
     }
 
     was_file_updated |= iotc_evtd_update_file_fd_events(event_dispatcher);
+
+    /* handles submitted since the last step don't wait for the timeout, on
+     * BSPs whose select cannot be woken up this is all they get */
+    was_handle_submitted |=
+        __atomic_load_n(&event_dispatcher->wakeup_pending, __ATOMIC_SEQ_CST);
   }
 
   /* store the current time */
@@ -136,7 +142,9 @@ iotc_state_t iotc_bsp_event_loop_transform_to_bsp_select(
   timeout_candidate = IOTC_MIN(timeout_candidate, IOTC_MAX_IDLE_TIMEOUT);
 
   /* update the return parameter */
-  *out_timeout = (was_file_updated != 0) ? (0) : (timeout_candidate);
+  *out_timeout = (was_file_updated != 0 || was_handle_submitted != 0)
+                     ? (0)
+                     : (timeout_candidate);
 
   return IOTC_STATE_OK;
 }
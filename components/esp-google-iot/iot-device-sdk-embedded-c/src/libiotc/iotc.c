@@ -22,6 +22,7 @@
 #include "iotc_allocator.h"
 #include "iotc_backoff_lut_config.h"
 #include "iotc_backoff_status_api.h"
+#include "iotc_callback_executor.h"
 #include "iotc_common.h"
 #include "iotc_connection_data_internal.h"
 #include "iotc_debug.h"
@@ -48,6 +49,7 @@
 
 #include "iotc_user_sub_call_wrapper.h"
 
+#include <iotc_bsp_mem.h>
 #include <iotc_bsp_rng.h>
 #include <iotc_bsp_time.h>
 
@@ -205,14 +207,9 @@ static void iotc_free_context_data(iotc_context_t* context) {
   iotc_vector_destroy(context_data->io_timeouts);
 
   /* See comment in iotc_types_internal.h. */
-  if (context_data->copy_of_handlers_for_topics) {
-    iotc_vector_for_each(context_data->copy_of_handlers_for_topics,
-                         &iotc_mqtt_task_spec_data_free_subscribe_data_vec,
-                         NULL, 0);
-
-    context_data->copy_of_handlers_for_topics =
-        iotc_vector_destroy(context_data->copy_of_handlers_for_topics);
-  }
+  iotc_mqtt_logic_topic_trie_destroy(
+      &context_data->copy_of_handlers_for_topics,
+      &iotc_mqtt_task_spec_data_free_subscribe_data_trie);
 
   if (context_data->copy_of_q12_unacked_messages_queue) {
     /* This pointer must be present otherwise we are not going to be able to
@@ -309,7 +306,8 @@ iotc_state_t iotc_user_callback_wrapper(void* context, void* data,
       state = iotc_find_handle_for_object(iotc_globals.context_handles_vector,
                                           context, &context_handle));
 
-  ((iotc_user_callback_t*)(client_callback))(context_handle, data, in_state);
+  iotc_callback_executor_run_user_callback(context_handle, client_callback,
+                                           data, in_state);
 
 err_handling:
   return state;
@@ -332,6 +330,63 @@ extern uint8_t iotc_is_context_connected(iotc_context_handle_t iotc_h) {
          IOTC_SHUTDOWN_UNINITIALISED == iotc->context_data.shutdown_state;
 }
 
+iotc_state_t iotc_get_mqtt_publish_stats(iotc_context_handle_t iotc_h,
+                                         iotc_mqtt_publish_stats_t* stats) {
+  if (IOTC_INVALID_CONTEXT_HANDLE == iotc_h || NULL == stats) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc_context_t* iotc = (iotc_context_t*)iotc_object_for_handle(
+      iotc_globals.context_handles_vector, iotc_h);
+
+  if (NULL == iotc) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  *stats = iotc->context_data.publish_stats;
+
+  const iotc_mqtt_logic_layer_data_t* layer_data =
+      (iotc_mqtt_logic_layer_data_t*)iotc->layer_chain.top->user_data;
+
+  if (NULL != layer_data) {
+    stats->in_flight = layer_data->q1_in_flight_count;
+    stats->queued = layer_data->publish_queue.count;
+  }
+
+  return IOTC_STATE_OK;
+}
+
+iotc_state_t iotc_set_publish_window(iotc_context_handle_t iotc_h,
+                                     uint16_t max_in_flight,
+                                     uint16_t max_queued,
+                                     iotc_user_callback_t* writable_callback,
+                                     void* user_data) {
+  if (IOTC_INVALID_CONTEXT_HANDLE == iotc_h) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc_context_t* iotc = (iotc_context_t*)iotc_object_for_handle(
+      iotc_globals.context_handles_vector, iotc_h);
+
+  if (NULL == iotc) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc->context_data.publish_window = max_in_flight;
+  iotc->context_data.publish_backlog_max = max_queued;
+  iotc->context_data.publish_refused = 0;
+
+  if (NULL == writable_callback) {
+    iotc->context_data.publish_writable_callback = iotc_make_empty_handle();
+  } else {
+    iotc->context_data.publish_writable_callback = iotc_make_threaded_handle(
+        IOTC_THREADID_THREAD_0, &iotc_user_callback_wrapper, iotc, user_data,
+        IOTC_STATE_OK, (void*)writable_callback);
+  }
+
+  return IOTC_STATE_OK;
+}
+
 void iotc_events_stop() { iotc_evtd_stop(iotc_globals.evtd_instance); }
 
 void iotc_events_process_blocking() {
@@ -432,13 +487,14 @@ iotc_state_t iotc_connect_to(iotc_context_handle_t iotc_h, const char* host,
   if (NULL != iotc->context_data.connection_data) {
     IOTC_CHECK_STATE(iotc_connection_data_update_lastwill(
         iotc->context_data.connection_data, host, port, username, password,
-        client_id, connection_timeout, keepalive_timeout, IOTC_SESSION_CLEAN,
-        NULL, NULL, (iotc_mqtt_qos_t)0, (iotc_mqtt_retain_t)0));
+        client_id, connection_timeout, keepalive_timeout,
+        iotc->context_data.session_type, NULL, NULL, (iotc_mqtt_qos_t)0,
+        (iotc_mqtt_retain_t)0));
   } else {
     iotc->context_data.connection_data = iotc_alloc_connection_data_lastwill(
         host, port, username, password, client_id, connection_timeout,
-        keepalive_timeout, IOTC_SESSION_CLEAN, NULL, NULL, (iotc_mqtt_qos_t)0,
-        (iotc_mqtt_retain_t)0);
+        keepalive_timeout, iotc->context_data.session_type, NULL, NULL,
+        (iotc_mqtt_qos_t)0, (iotc_mqtt_retain_t)0);
 
     IOTC_CHECK_MEMORY(iotc->context_data.connection_data, state);
   }
@@ -450,6 +506,7 @@ iotc_state_t iotc_connect_to(iotc_context_handle_t iotc_h, const char* host,
   /* Reset the connection state. */
   iotc->context_data.connection_data->connection_state =
       IOTC_CONNECTION_STATE_UNINITIALIZED;
+  iotc->context_data.connection_data->session_present = 0;
 
   /* Reset shutdown state. */
   iotc->context_data.shutdown_state = IOTC_SHUTDOWN_UNINITIALISED;
@@ -480,6 +537,7 @@ err_handling:
 iotc_state_t iotc_publish_data_impl(iotc_context_handle_t iotc_h,
                                     const char* topic, iotc_data_desc_t* data,
                                     const iotc_mqtt_qos_t qos,
+                                    const iotc_mqtt_priority_t priority,
                                     iotc_user_callback_t* callback,
                                     void* user_data) {
   /* PRE-CONDITIONS */
@@ -517,7 +575,8 @@ iotc_state_t iotc_publish_data_impl(iotc_context_handle_t iotc_h,
   IOTC_UNUSED(layer_data);
 
   task = iotc_mqtt_logic_make_publish_task(topic, data, effective_qos,
-                                           (iotc_mqtt_retain_t)0, event_handle);
+                                           (iotc_mqtt_retain_t)0, priority,
+                                           event_handle);
 
   IOTC_CHECK_MEMORY(task, state);
 
@@ -545,8 +604,8 @@ iotc_state_t iotc_publish(iotc_context_handle_t iotc_h, const char* topic,
 
   IOTC_CHECK_MEMORY(data_desc, state);
 
-  return iotc_publish_data_impl(iotc_h, topic, data_desc, qos, callback,
-                                user_data);
+  return iotc_publish_data_impl(iotc_h, topic, data_desc, qos,
+                                IOTC_MQTT_PRIORITY_NORMAL, callback, user_data);
 
 err_handling:
   return state;
@@ -568,17 +627,186 @@ iotc_state_t iotc_publish_data(iotc_context_handle_t iotc_h, const char* topic,
 
   IOTC_CHECK_MEMORY(data_desc, state);
 
-  return iotc_publish_data_impl(iotc_h, topic, data_desc, qos, callback,
-                                user_data);
+  return iotc_publish_data_impl(iotc_h, topic, data_desc, qos,
+                                IOTC_MQTT_PRIORITY_NORMAL, callback, user_data);
 
 err_handling:
   return state;
 }
 
-iotc_state_t iotc_subscribe(iotc_context_handle_t iotc_h, const char* topic,
-                            const iotc_mqtt_qos_t qos,
-                            iotc_user_subscription_callback_t* callback,
-                            void* user_data) {
+iotc_state_t iotc_publish_data_with_priority(
+    iotc_context_handle_t iotc_h, const char* topic, const uint8_t* data,
+    size_t data_len, const iotc_mqtt_qos_t qos,
+    const iotc_mqtt_priority_t priority, iotc_user_callback_t* callback,
+    void* user_data) {
+  /* PRE-CONDITIONS */
+  assert(NULL != topic);
+  assert(NULL != data);
+  assert(0 != data_len);
+
+  if ((size_t)priority >= IOTC_MQTT_PRIORITY_COUNT) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc_state_t state = IOTC_STATE_OK;
+
+  iotc_data_desc_t* data_desc = iotc_make_desc_from_buffer_copy(data, data_len);
+
+  IOTC_CHECK_MEMORY(data_desc, state);
+
+  return iotc_publish_data_impl(iotc_h, topic, data_desc, qos, priority,
+                                callback, user_data);
+
+err_handling:
+  return state;
+}
+
+/* A publish on its way from another thread to the event loop. It is allocated
+ * in one block with its topic and payload, from the BSP directly since the
+ * memory limiter may only be used on the event loop thread. */
+typedef struct iotc_submitted_publish_s {
+  iotc_context_handle_t iotc_h;
+  iotc_mqtt_qos_t qos;
+  iotc_mqtt_priority_t priority;
+  iotc_user_callback_t* callback;
+  void* user_data;
+  size_t data_len;
+  uint8_t* data;
+  char* topic;
+} iotc_submitted_publish_t;
+
+static iotc_state_t iotc_run_submitted_publish(void* data) {
+  iotc_submitted_publish_t* publish = (iotc_submitted_publish_t*)data;
+  iotc_state_t state = IOTC_INVALID_PARAMETER;
+
+  /* the context may have been deleted in the meantime */
+  if (NULL != iotc_object_for_handle(iotc_globals.context_handles_vector,
+                                     publish->iotc_h)) {
+    state = iotc_publish_data_with_priority(
+        publish->iotc_h, publish->topic, publish->data, publish->data_len,
+        publish->qos, publish->priority, publish->callback,
+        publish->user_data);
+  }
+
+  /* the submitter has returned long ago, the callback is its only way to
+   * learn that the publish was not accepted */
+  if (IOTC_STATE_OK != state && NULL != publish->callback) {
+    publish->callback(publish->iotc_h, publish->user_data, state);
+  }
+
+  /* its slot is free again for a submitter which was refused */
+  if (__atomic_exchange_n(&iotc_globals.submit_refused, 0, __ATOMIC_ACQ_REL) &&
+      0 == iotc_handle_disposed(&iotc_globals.submit_writable_callback)) {
+    iotc_evtd_execute(iotc_globals.evtd_instance,
+                      iotc_globals.submit_writable_callback);
+  }
+
+  iotc_bsp_mem_free(publish);
+
+  return IOTC_STATE_OK;
+}
+
+iotc_state_t iotc_submit_publish_data(
+    iotc_context_handle_t iotc_h, const char* topic, const uint8_t* data,
+    size_t data_len, const iotc_mqtt_qos_t qos,
+    const iotc_mqtt_priority_t priority, iotc_user_callback_t* callback,
+    void* user_data) {
+  if (IOTC_INVALID_CONTEXT_HANDLE >= iotc_h || NULL == topic ||
+      NULL == data || 0 == data_len ||
+      (size_t)priority >= IOTC_MQTT_PRIORITY_COUNT) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  if (NULL == iotc_globals.evtd_instance) {
+    return IOTC_NOT_INITIALIZED;
+  }
+
+  const size_t topic_size = strlen(topic) + 1;
+  iotc_submitted_publish_t* publish = (iotc_submitted_publish_t*)
+      iotc_bsp_mem_alloc(sizeof(iotc_submitted_publish_t) + data_len +
+                         topic_size);
+
+  if (NULL == publish) {
+    return IOTC_OUT_OF_MEMORY;
+  }
+
+  publish->iotc_h = iotc_h;
+  publish->qos = qos;
+  publish->priority = priority;
+  publish->callback = callback;
+  publish->user_data = user_data;
+  publish->data_len = data_len;
+  publish->data = (uint8_t*)(publish + 1);
+  publish->topic = (char*)publish->data + data_len;
+  memcpy(publish->data, data, data_len);
+  memcpy(publish->topic, topic, topic_size);
+
+  const iotc_event_handle_t handle =
+      iotc_make_handle(&iotc_run_submitted_publish, (void*)publish);
+
+  if (IOTC_STATE_OK != iotc_evtd_submit(iotc_globals.evtd_instance, handle)) {
+    /* flagged before the second try: if that fails too, the publishes which
+     * fill the ring are still to be run and one of them will see the flag */
+    __atomic_store_n(&iotc_globals.submit_refused, 1, __ATOMIC_SEQ_CST);
+
+    if (IOTC_STATE_OK != iotc_evtd_submit(iotc_globals.evtd_instance, handle)) {
+      iotc_bsp_mem_free(publish);
+      return IOTC_SUBMIT_QUEUE_FULL;
+    }
+  }
+
+  return IOTC_STATE_OK;
+}
+
+iotc_state_t iotc_set_submit_writable_callback(
+    iotc_context_handle_t iotc_h, iotc_user_callback_t* writable_callback,
+    void* user_data) {
+  if (IOTC_INVALID_CONTEXT_HANDLE == iotc_h) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc_context_t* iotc = (iotc_context_t*)iotc_object_for_handle(
+      iotc_globals.context_handles_vector, iotc_h);
+
+  if (NULL == iotc) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  if (NULL == writable_callback) {
+    iotc_globals.submit_writable_callback = iotc_make_empty_handle();
+  } else {
+    iotc_globals.submit_writable_callback = iotc_make_threaded_handle(
+        IOTC_THREADID_THREAD_0, &iotc_user_callback_wrapper, iotc, user_data,
+        IOTC_STATE_OK, (void*)writable_callback);
+  }
+
+  return IOTC_STATE_OK;
+}
+
+iotc_state_t iotc_set_session_type(iotc_context_handle_t iotc_h,
+                                   iotc_session_type_t session_type) {
+  if (IOTC_INVALID_CONTEXT_HANDLE == iotc_h ||
+      (IOTC_SESSION_CLEAN != session_type &&
+       IOTC_SESSION_CONTINUE != session_type)) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc_context_t* iotc = (iotc_context_t*)iotc_object_for_handle(
+      iotc_globals.context_handles_vector, iotc_h);
+
+  if (NULL == iotc) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  iotc->context_data.session_type = session_type;
+
+  return IOTC_STATE_OK;
+}
+
+static iotc_state_t iotc_subscribe_impl(
+    iotc_context_handle_t iotc_h, const char* topic, const iotc_mqtt_qos_t qos,
+    iotc_user_subscription_callback_t* callback, void* user_data,
+    uint8_t stream) {
   if ((IOTC_INVALID_CONTEXT_HANDLE == iotc_h) || (NULL == topic) ||
       (NULL == callback)) {
     return IOTC_INVALID_PARAMETER;
@@ -618,6 +846,104 @@ iotc_state_t iotc_subscribe(iotc_context_handle_t iotc_h, const char* topic,
   /* Pass the partial ownership of the task data to the handler (in case of
    * subscription failure it will release the memory.) */
   task->data.data_u->subscribe.handler.handlers.h6.a6 = task->data.data_u;
+  task->data.data_u->subscribe.stream = stream;
+
+  return IOTC_PROCESS_PUSH_ON_THIS_LAYER(&input_layer->layer_connection, task,
+                                         IOTC_STATE_OK);
+
+err_handling:
+  if (task) {
+    iotc_mqtt_logic_free_task(&task);
+  }
+
+  IOTC_SAFE_FREE(internal_topic);
+
+  return state;
+}
+
+iotc_state_t iotc_subscribe(iotc_context_handle_t iotc_h, const char* topic,
+                            const iotc_mqtt_qos_t qos,
+                            iotc_user_subscription_callback_t* callback,
+                            void* user_data) {
+  return iotc_subscribe_impl(iotc_h, topic, qos, callback, user_data, 0);
+}
+
+iotc_state_t iotc_subscribe_streaming(
+    iotc_context_handle_t iotc_h, const char* topic, const iotc_mqtt_qos_t qos,
+    iotc_user_subscription_callback_t* callback, void* user_data) {
+  return iotc_subscribe_impl(iotc_h, topic, qos, callback, user_data, 1);
+}
+
+iotc_state_t iotc_subscribe_multiple(
+    iotc_context_handle_t iotc_h, const char* const* topics,
+    const iotc_mqtt_qos_t* qos, size_t count,
+    iotc_user_subscription_callback_t* callback, void* const* user_data,
+    const uint8_t* stream) {
+  if ((IOTC_INVALID_CONTEXT_HANDLE == iotc_h) || (NULL == topics) ||
+      (NULL == qos) || (0 == count) || (NULL == callback)) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  size_t i = 0;
+  for (; i < count; ++i) {
+    if (NULL == topics[i]) {
+      return IOTC_INVALID_PARAMETER;
+    }
+  }
+
+  iotc_state_t state = IOTC_STATE_OK;
+  iotc_mqtt_logic_task_t* task = NULL;
+  char* internal_topic = NULL;
+  iotc_mqtt_task_specific_data_t** last = NULL;
+  iotc_layer_t* input_layer = NULL;
+  iotc_event_handle_t event_handle = iotc_make_empty_event_handle();
+
+  iotc_context_t* iotc = (iotc_context_t*)iotc_object_for_handle(
+      iotc_globals.context_handles_vector, iotc_h);
+
+  IOTC_CHECK_MEMORY(iotc, state);
+
+  if (IOTC_BACKOFF_CLASS_NONE != iotc_globals.backoff_status.backoff_class) {
+    return IOTC_BACKOFF_TERMINAL;
+  }
+
+  event_handle = iotc_make_threaded_handle(
+      IOTC_THREADID_THREAD_0, &iotc_user_sub_call_wrapper, iotc, NULL,
+      IOTC_STATE_OK, (void*)callback, (void*)NULL, (void*)NULL);
+
+  IOTC_CHECK_MEMORY(internal_topic = iotc_str_dup(topics[0]), state);
+
+  task = iotc_mqtt_logic_make_subscribe_task(internal_topic, qos[0],
+                                             event_handle);
+  IOTC_CHECK_MEMORY(task, state);
+
+  /* the task owns the topic from here on */
+  internal_topic = NULL;
+
+  /* each topic carries its own handler, the SUBACK hands them out one by one
+   * as iotc_subscribe() does with its only one */
+  task->data.data_u->subscribe.handler.handlers.h6.a5 =
+      NULL != user_data ? user_data[0] : NULL;
+  task->data.data_u->subscribe.handler.handlers.h6.a6 = task->data.data_u;
+  task->data.data_u->subscribe.stream = NULL != stream && 0 != stream[0];
+  last = &task->data.data_u->subscribe.next;
+
+  for (i = 1; i < count; ++i) {
+    IOTC_ALLOC_AT(iotc_mqtt_task_specific_data_t, *last, state);
+    IOTC_CHECK_MEMORY((*last)->subscribe.topic = iotc_str_dup(topics[i]),
+                      state);
+
+    (*last)->subscribe.qos = qos[i];
+    (*last)->subscribe.handler = event_handle;
+    (*last)->subscribe.handler.handlers.h6.a5 =
+        NULL != user_data ? user_data[i] : NULL;
+    (*last)->subscribe.handler.handlers.h6.a6 = *last;
+    (*last)->subscribe.stream = NULL != stream && 0 != stream[i];
+
+    last = &(*last)->subscribe.next;
+  }
+
+  input_layer = iotc->layer_chain.top;
 
   return IOTC_PROCESS_PUSH_ON_THIS_LAYER(&input_layer->layer_connection, task,
                                          IOTC_STATE_OK);
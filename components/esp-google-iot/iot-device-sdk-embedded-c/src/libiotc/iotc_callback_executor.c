@@ -0,0 +1,175 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_callback_executor.h"
+
+#include "iotc.h"
+#include "iotc_allocator.h"
+#include "iotc_event_dispatcher_api.h"
+#include "iotc_globals.h"
+#include "iotc_macros.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static iotc_state_t iotc_callback_job_release(void* job_arg) {
+  iotc_callback_job_t* job = (iotc_callback_job_t*)job_arg;
+
+  iotc_mqtt_message_free(&job->msg);
+  IOTC_SAFE_FREE(job);
+
+  return IOTC_STATE_OK;
+}
+
+static void iotc_callback_job_invoke(const iotc_callback_job_t* job) {
+  if (job->is_subscription) {
+    ((iotc_user_subscription_callback_t*)job->client_callback)(
+        job->context_handle, job->call_type,
+        IOTC_SUB_CALL_UNKNOWN != job->call_type ? &job->params : NULL,
+        job->state, job->data);
+  } else {
+    ((iotc_user_callback_t*)job->client_callback)(job->context_handle,
+                                                  job->data, job->state);
+  }
+}
+
+/* Allocates the job with room for a copy of the suback topic behind it. */
+static iotc_callback_job_t* iotc_callback_job_create(size_t topic_size) {
+  iotc_callback_job_t* job =
+      (iotc_callback_job_t*)iotc_alloc(sizeof(iotc_callback_job_t) + topic_size);
+
+  if (NULL != job) {
+    memset(job, 0, sizeof(iotc_callback_job_t));
+    job->release.handle = iotc_make_handle(&iotc_callback_job_release, job);
+  }
+
+  return job;
+}
+
+/* Callbacks the executor does not take run right away, without a job. */
+static uint8_t iotc_callback_executor_takes(iotc_sub_call_type_t call_type) {
+  if (NULL == iotc_globals.callback_executor) {
+    return 0;
+  }
+
+  return NULL == iotc_globals.callback_executor_takes ||
+         0 != iotc_globals.callback_executor_takes(
+                  call_type, iotc_globals.callback_executor_data);
+}
+
+void iotc_set_callback_executor(iotc_callback_executor_t* executor,
+                                iotc_callback_executor_takes_t* takes,
+                                void* executor_data) {
+  iotc_globals.callback_executor = executor;
+  iotc_globals.callback_executor_takes = takes;
+  iotc_globals.callback_executor_data = executor_data;
+}
+
+void iotc_run_callback_job(iotc_callback_job_t* job) {
+  if (NULL == job) {
+    return;
+  }
+
+  iotc_callback_job_invoke(job);
+
+  /* the loop frees the job and the message it owns */
+  iotc_evtd_submit_queued(iotc_globals.evtd_instance, &job->release);
+}
+
+void iotc_callback_executor_run_user_callback(
+    iotc_context_handle_t context_handle, void* client_callback, void* data,
+    iotc_state_t state) {
+  assert(NULL != client_callback);
+
+  iotc_callback_job_t* job = NULL;
+
+  if (iotc_callback_executor_takes(IOTC_SUB_CALL_UNKNOWN)) {
+    job = iotc_callback_job_create(0);
+  }
+
+  /* without a job the callback runs right here, as without an executor */
+  if (NULL == job) {
+    ((iotc_user_callback_t*)client_callback)(context_handle, data, state);
+    return;
+  }
+
+  job->context_handle = context_handle;
+  job->state = state;
+  job->client_callback = client_callback;
+  job->data = data;
+  job->call_type = IOTC_SUB_CALL_UNKNOWN;
+
+  iotc_globals.callback_executor(job, job->call_type,
+                                 iotc_globals.callback_executor_data);
+}
+
+void iotc_callback_executor_run_sub_callback(
+    iotc_context_handle_t context_handle, void* client_callback,
+    iotc_sub_call_type_t call_type, const iotc_sub_call_params_t* params,
+    iotc_state_t state, void* user_data, iotc_mqtt_message_t** msg) {
+  assert(NULL != client_callback);
+  assert(NULL != msg);
+
+  iotc_callback_job_t* job = NULL;
+  size_t topic_size = 0;
+
+  /* the subscription the topic belongs to may be gone by the time the
+   * callback runs, a message's topic is in the message the job takes */
+  if (IOTC_SUB_CALL_SUBACK == call_type && NULL != params->suback.topic) {
+    topic_size = strlen(params->suback.topic) + 1;
+  }
+
+  if (iotc_callback_executor_takes(call_type)) {
+    job = iotc_callback_job_create(topic_size);
+  }
+
+  if (NULL == job) {
+    ((iotc_user_subscription_callback_t*)client_callback)(
+        context_handle, call_type, params, state, user_data);
+    return;
+  }
+
+  job->context_handle = context_handle;
+  job->state = state;
+  job->client_callback = client_callback;
+  job->data = user_data;
+  job->is_subscription = 1;
+  job->call_type = call_type;
+
+  if (NULL != params) {
+    job->params = *params;
+  }
+
+  if (0 != topic_size) {
+    char* topic = (char*)(job + 1);
+    memcpy(topic, params->suback.topic, topic_size);
+    job->params.suback.topic = topic;
+  }
+
+  job->msg = *msg;
+  *msg = NULL;
+
+  iotc_globals.callback_executor(job, call_type,
+                                 iotc_globals.callback_executor_data);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_CALLBACK_EXECUTOR_H__
+#define __IOTC_CALLBACK_EXECUTOR_H__
+
+#include "iotc_event_handle_queue.h"
+#include "iotc_mqtt_message.h"
+#include "iotc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A user callback on its way to the worker of the executor set with
+ * iotc_set_callback_executor() and back. The job is allocated and freed on
+ * the event loop thread, the only one the memory limiter may be used from;
+ * after the callback the worker hands it back with iotc_evtd_submit_queued()
+ * through the element embedded in it. */
+struct iotc_callback_job_s {
+  iotc_event_handle_queue_t release;
+  iotc_context_handle_t context_handle;
+  iotc_state_t state;
+  void* client_callback;
+  /* the data of an iotc_user_callback_t, the user_data of a subscription */
+  void* data;
+  /* IOTC_SUB_CALL_UNKNOWN and no params for an iotc_user_callback_t */
+  uint8_t is_subscription;
+  iotc_sub_call_type_t call_type;
+  iotc_sub_call_params_t params;
+  /* the received message the params point into, freed with the job */
+  iotc_mqtt_message_t* msg;
+};
+
+/**
+ * @brief Invokes an iotc_user_callback_t, on the executor if one is set.
+ */
+void iotc_callback_executor_run_user_callback(
+    iotc_context_handle_t context_handle, void* client_callback, void* data,
+    iotc_state_t state);
+
+/**
+ * @brief Invokes an iotc_user_subscription_callback_t, on the executor if one
+ * is set.
+ *
+ * The params are copied, the suback topic as well. If the callback is handed
+ * over the job takes the message the params point into and msg is set to
+ * NULL.
+ */
+void iotc_callback_executor_run_sub_callback(
+    iotc_context_handle_t context_handle, void* client_callback,
+    iotc_sub_call_type_t call_type, const iotc_sub_call_params_t* params,
+    iotc_state_t state, void* user_data, iotc_mqtt_message_t** msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_CALLBACK_EXECUTOR_H__ */
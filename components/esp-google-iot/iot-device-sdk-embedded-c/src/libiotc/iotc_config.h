@@ -37,6 +37,36 @@
 #define IOTC_MAX_IDLE_TIMEOUT 5
 #endif
 
+/* PUBACK timeout of QoS 1 publishes before the first round trip sample, and
+ * the bounds of the estimated timeout including backoff, in milliseconds */
+#ifndef IOTC_MQTT_PUBACK_RTO_INITIAL_MS
+#define IOTC_MQTT_PUBACK_RTO_INITIAL_MS 3000
+#endif
+
+#ifndef IOTC_MQTT_PUBACK_RTO_MIN_MS
+#define IOTC_MQTT_PUBACK_RTO_MIN_MS 1000
+#endif
+
+#ifndef IOTC_MQTT_PUBACK_RTO_MAX_MS
+#define IOTC_MQTT_PUBACK_RTO_MAX_MS 60000
+#endif
+
+/* how long a queued normal or bulk publish waits behind higher classes at
+ * most before it is let through, in milliseconds */
+#ifndef IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS
+#define IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS 2000
+#endif
+
+#ifndef IOTC_MQTT_PUBLISH_MAX_WAIT_BULK_MS
+#define IOTC_MQTT_PUBLISH_MAX_WAIT_BULK_MS 10000
+#endif
+
+/* the handles other threads can have submitted to the event loop before it
+ * runs them, a power of two */
+#ifndef IOTC_EVTD_SUBMISSION_RING_SIZE
+#define IOTC_EVTD_SUBMISSION_RING_SIZE 16
+#endif
+
 #ifndef IOTC_MQTT_PORT
 #define IOTC_MQTT_PORT 8883
 /* note: usually port 1883 is used for insecure MQTT connections */
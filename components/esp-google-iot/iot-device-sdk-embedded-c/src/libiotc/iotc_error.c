@@ -122,6 +122,8 @@ const char* iotc_error_string[IOTC_ERROR_STRINGS_COUNT] = {
     "IOTC_BUFFER_TOO_SMALL_ERROR",       /* 74 IOTC_BUFFER_TOO_SMALL_ERROR */
     "IOTC_NULL_KEY_DATA_ERROR",          /* 75 IOTC_NULL_KEY_DATA_ERROR */
     "IOTC_NULL_CLIENT_ID_ERROR",         /* 76 IOTC_NULL_CLIENT_ID_ERROR */
+    "IOTC_PUBLISH_WINDOW_FULL",          /* 77 IOTC_PUBLISH_WINDOW_FULL */
+    "IOTC_SUBMIT_QUEUE_FULL",            /* 78 IOTC_SUBMIT_QUEUE_FULL */
 
     "IOTC_ERROR_UNDEFINED" /* The error code is not recognized */
 };
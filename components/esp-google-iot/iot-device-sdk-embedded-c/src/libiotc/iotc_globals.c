@@ -25,5 +25,11 @@ iotc_globals_t iotc_globals = {
     .context_handles_vector = NULL,
     .timed_tasks_container = NULL,
     .main_threadpool = NULL,
+    .callback_executor = NULL,
+    .callback_executor_takes = NULL,
+    .callback_executor_data = NULL,
+    .submit_refused = 0,
+    .submit_writable_callback =
+        iotc_make_empty_event_handle(IOTC_THREADID_MAINTHREAD),
     .backoff_status = {iotc_make_empty_time_event_handle(), 0, 0,
                        IOTC_BACKOFF_CLASS_NONE, 0}};
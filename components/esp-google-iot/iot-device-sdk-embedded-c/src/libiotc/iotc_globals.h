@@ -39,6 +39,13 @@ typedef struct {
   iotc_vector_t* context_handles_vector;
   iotc_timed_task_container_t* timed_tasks_container;
   struct iotc_threadpool_s* main_threadpool;
+  /* see iotc_set_callback_executor() */
+  iotc_callback_executor_t* callback_executor;
+  iotc_callback_executor_takes_t* callback_executor_takes;
+  void* callback_executor_data;
+  /* see iotc_set_submit_writable_callback() */
+  uint8_t submit_refused;
+  iotc_event_handle_t submit_writable_callback;
   iotc_backoff_status_t backoff_status;
 } iotc_globals_t;
 
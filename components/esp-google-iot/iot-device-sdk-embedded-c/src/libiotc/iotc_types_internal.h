@@ -52,7 +52,12 @@ typedef struct iotc_context_data_s {
  * enable/disable it via flags or defines. Bu for now,
  * let's use that simplified form. */
 #if 1 /* MQTT context part. */
-  iotc_vector_t* copy_of_handlers_for_topics;
+  struct iotc_mqtt_logic_topic_trie_s*
+      copy_of_handlers_for_topics; /* Subscriptions kept for the next
+                                      connection of a continued session. */
+  struct iotc_mqtt_logic_topic_trie_s*
+      handlers_for_topics; /* Subscriptions of the open connection, for the
+                              codec layer to find streaming ones. */
   void* copy_of_q12_unacked_messages_queue; /* We have to use void* because we
                                                don't want to create mqtt logic
                                                layer dependency. */
@@ -60,6 +65,15 @@ typedef struct iotc_context_data_s {
       void**); /* This is dstr for unacked messages. */
   uint16_t
       copy_of_last_msg_id; /* Value of the msg_id for continious session. */
+  iotc_mqtt_publish_stats_t
+      publish_stats; /* PUBACK round trip estimate and QoS 1 counters. */
+  /* QoS 1 flow control, see iotc_set_publish_window(). */
+  uint16_t publish_window;      /* In flight at most, 0 is no limit. */
+  uint16_t publish_backlog_max; /* Queued behind the window at most. */
+  uint8_t publish_refused;      /* Refused since the last writable callback. */
+  iotc_event_handle_t publish_writable_callback;
+  /* Session of the next connections, see iotc_set_session_type(). */
+  iotc_session_type_t session_type;
 #endif
   /* this is the common part */
   iotc_time_event_handle_t connect_handler;
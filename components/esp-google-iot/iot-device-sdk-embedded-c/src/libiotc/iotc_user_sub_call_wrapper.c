@@ -16,11 +16,15 @@
 
 #include "iotc_user_sub_call_wrapper.h"
 
+#include "iotc_callback_executor.h"
 #include "iotc_globals.h"
 #include "iotc_handle.h"
 #include "iotc_mqtt_logic_layer_data.h"
+#include "iotc_mqtt_logic_topic_trie.h"
 #include "iotc_types.h"
 
+#include <string.h>
+
 iotc_state_t iotc_user_sub_call_wrapper(void* context, void* data,
                                         iotc_state_t in_state,
                                         void* client_callback, void* user_data,
@@ -52,10 +56,12 @@ iotc_state_t iotc_user_sub_call_wrapper(void* context, void* data,
       params.suback.suback_status = status;
       params.suback.topic = (const char*)sub_data->subscribe.topic;
 
-      ((iotc_user_subscription_callback_t*)(client_callback))(
-          context_handle, IOTC_SUB_CALL_SUBACK, &params, in_state, user_data);
+      iotc_callback_executor_run_sub_callback(
+          context_handle, client_callback, IOTC_SUB_CALL_SUBACK, &params,
+          in_state, user_data, &msg);
 
-      /* Now it's ok to free the data as it's no longer needed.*/
+      /* Now it's ok to free the data as it's no longer needed, a callback
+       * which was handed over has its own copy of the topic. */
       iotc_mqtt_task_spec_data_free_subscribe_data(&sub_data);
     } break;
     case IOTC_MQTT_SUBSCRIPTION_SUCCESSFULL: {
@@ -63,8 +69,9 @@ iotc_state_t iotc_user_sub_call_wrapper(void* context, void* data,
       params.suback.suback_status = status;
       params.suback.topic = (const char*)sub_data->subscribe.topic;
 
-      ((iotc_user_subscription_callback_t*)(client_callback))(
-          context_handle, IOTC_SUB_CALL_SUBACK, &params, in_state, user_data);
+      iotc_callback_executor_run_sub_callback(
+          context_handle, client_callback, IOTC_SUB_CALL_SUBACK, &params,
+          in_state, user_data, &msg);
     } break;
     case IOTC_STATE_OK: {
       msg = (iotc_mqtt_message_t*)data;
@@ -87,12 +94,15 @@ iotc_state_t iotc_user_sub_call_wrapper(void* context, void* data,
           msg->common.common_u.common_bits.retain, &params.message.retain);
       IOTC_CHECK_STATE(in_state);
 
-      ((iotc_user_subscription_callback_t*)(client_callback))(
-          context_handle, IOTC_SUB_CALL_MESSAGE, &params, in_state, user_data);
+      /* a callback which is handed over takes the message with it */
+      iotc_callback_executor_run_sub_callback(
+          context_handle, client_callback, IOTC_SUB_CALL_MESSAGE, &params,
+          in_state, user_data, &msg);
     } break;
     default: {
-      ((iotc_user_subscription_callback_t*)(client_callback))(
-          context_handle, IOTC_SUB_CALL_UNKNOWN, NULL, in_state, user_data);
+      iotc_callback_executor_run_sub_callback(
+          context_handle, client_callback, IOTC_SUB_CALL_UNKNOWN, NULL,
+          in_state, user_data, &msg);
     } break;
   };
 
@@ -105,3 +115,101 @@ err_handling:
 
   return state;
 }
+
+static void iotc_user_sub_stream_invoke(const iotc_user_sub_stream_t* stream,
+                                        iotc_sub_call_type_t call_type,
+                                        iotc_state_t state) {
+  ((iotc_user_subscription_callback_t*)stream->client_callback)(
+      stream->context_handle, call_type, &stream->params, state,
+      stream->user_data);
+}
+
+uint8_t iotc_user_sub_stream_begin(
+    iotc_user_sub_stream_t* stream,
+    const iotc_mqtt_logic_topic_trie_t* handlers_for_topics,
+    const iotc_mqtt_message_t* msg, size_t total_length) {
+  assert(NULL != stream);
+  assert(NULL == stream->client_callback);
+  assert(NULL != msg);
+
+  const iotc_mqtt_task_specific_data_t* sub_data = NULL;
+
+  if (NULL != handlers_for_topics && NULL != msg->publish.topic_name) {
+    sub_data = (const iotc_mqtt_task_specific_data_t*)
+        iotc_mqtt_logic_topic_trie_match(
+            handlers_for_topics,
+            (const char*)msg->publish.topic_name->data_ptr,
+            msg->publish.topic_name->length);
+  }
+
+  if (NULL == sub_data || 0 == sub_data->subscribe.stream) {
+    return 0;
+  }
+
+  const iotc_event_handle_t* handler = &sub_data->subscribe.handler;
+
+  memset(stream, 0, sizeof(iotc_user_sub_stream_t));
+  stream->context_handle = IOTC_INVALID_CONTEXT_HANDLE;
+
+  if (NULL != handler->handlers.h6.a1 &&
+      IOTC_STATE_OK !=
+          iotc_find_handle_for_object(iotc_globals.context_handles_vector,
+                                      handler->handlers.h6.a1,
+                                      &stream->context_handle)) {
+    return 0;
+  }
+
+  stream->params.stream.topic = (const char*)msg->publish.topic_name->data_ptr;
+  stream->params.stream.total_length = total_length;
+
+  /* a flag out of range is left zero */
+  iotc_mqtt_convert_to_qos(msg->common.common_u.common_bits.qos,
+                           &stream->params.stream.qos);
+  iotc_mqtt_convert_to_dup(msg->common.common_u.common_bits.dup,
+                           &stream->params.stream.dup_flag);
+  iotc_mqtt_convert_to_retain(msg->common.common_u.common_bits.retain,
+                              &stream->params.stream.retain);
+
+  stream->client_callback = handler->handlers.h6.a4;
+  stream->user_data = handler->handlers.h6.a5;
+
+  iotc_user_sub_stream_invoke(stream, IOTC_SUB_CALL_MESSAGE_BEGIN,
+                              IOTC_STATE_OK);
+
+  return 1;
+}
+
+void iotc_user_sub_stream_chunk(iotc_user_sub_stream_t* stream,
+                                const uint8_t* chunk, size_t offset,
+                                size_t length) {
+  assert(NULL != stream);
+
+  if (NULL == stream->client_callback) {
+    return;
+  }
+
+  stream->params.stream.temporary_chunk_data = chunk;
+  stream->params.stream.temporary_chunk_data_length = length;
+  stream->params.stream.offset = offset;
+
+  iotc_user_sub_stream_invoke(stream, IOTC_SUB_CALL_MESSAGE_CHUNK,
+                              IOTC_STATE_OK);
+
+  /* the offset of the next chunk is what END reports as delivered */
+  stream->params.stream.temporary_chunk_data = NULL;
+  stream->params.stream.temporary_chunk_data_length = 0;
+  stream->params.stream.offset = offset + length;
+}
+
+void iotc_user_sub_stream_end(iotc_user_sub_stream_t* stream,
+                              iotc_state_t state) {
+  assert(NULL != stream);
+
+  if (NULL == stream->client_callback) {
+    return;
+  }
+
+  iotc_user_sub_stream_invoke(stream, IOTC_SUB_CALL_MESSAGE_END, state);
+
+  memset(stream, 0, sizeof(iotc_user_sub_stream_t));
+}
@@ -27,4 +27,38 @@ iotc_state_t iotc_user_sub_call_wrapper(void* context, void* data,
                                         void* client_callback, void* user_data,
                                         void* task_data);
 
+/* The streaming subscription the payload of the PUBLISH being parsed goes
+ * to, see iotc_subscribe_streaming(). The callback is copied as the
+ * subscription may be replaced before the last chunk arrives. Streamed
+ * callbacks run right away on the event loop, never on the callback
+ * executor, as the chunks are gone once they return. */
+typedef struct iotc_user_sub_stream_s {
+  void* client_callback; /* NULL if no payload is streamed */
+  void* user_data;
+  iotc_context_handle_t context_handle;
+  iotc_sub_call_params_t params;
+} iotc_user_sub_stream_t;
+
+/**
+ * @brief Looks up the subscription of the message's topic and if it is a
+ * streaming one invokes its callback with IOTC_SUB_CALL_MESSAGE_BEGIN.
+ *
+ * @return 1 if the payload is to be streamed, 0 if it is to be buffered
+ */
+uint8_t iotc_user_sub_stream_begin(
+    iotc_user_sub_stream_t* stream,
+    const iotc_mqtt_logic_topic_trie_t* handlers_for_topics,
+    const iotc_mqtt_message_t* msg, size_t total_length);
+
+void iotc_user_sub_stream_chunk(iotc_user_sub_stream_t* stream,
+                                const uint8_t* chunk, size_t offset,
+                                size_t length);
+
+/**
+ * @brief Invokes the callback with IOTC_SUB_CALL_MESSAGE_END if a payload is
+ * being streamed, with a state other than IOTC_STATE_OK if it is cut short.
+ */
+void iotc_user_sub_stream_end(iotc_user_sub_stream_t* stream,
+                              iotc_state_t state);
+
 #endif /* __IOTC_USER_SUB_CALL_WRAPPER_H__ */
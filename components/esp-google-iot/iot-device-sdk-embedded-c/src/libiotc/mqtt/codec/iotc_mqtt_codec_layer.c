@@ -57,6 +57,26 @@ static void clear_task_queue(void* context) {
   assert(layer_data->task_queue == 0);
 }
 
+static uint8_t payload_begin(void* context, const iotc_mqtt_message_t* msg,
+                             size_t total_length) {
+  iotc_mqtt_codec_layer_data_t* layer_data =
+      (iotc_mqtt_codec_layer_data_t*)IOTC_THIS_LAYER(context)->user_data;
+  const iotc_context_data_t* context_data = IOTC_CONTEXT_DATA(context);
+
+  return iotc_user_sub_stream_begin(
+      &layer_data->stream,
+      NULL != context_data ? context_data->handlers_for_topics : NULL, msg,
+      total_length);
+}
+
+static void payload_chunk(void* context, const uint8_t* chunk, size_t offset,
+                          size_t length) {
+  iotc_mqtt_codec_layer_data_t* layer_data =
+      (iotc_mqtt_codec_layer_data_t*)IOTC_THIS_LAYER(context)->user_data;
+
+  iotc_user_sub_stream_chunk(&layer_data->stream, chunk, offset, length);
+}
+
 iotc_state_t iotc_mqtt_codec_layer_push(void* context, void* data,
                                         iotc_state_t in_out_state) {
   IOTC_LAYER_FUNCTION_PRINT_FUNCTION_DIGEST();
@@ -281,6 +301,12 @@ iotc_state_t iotc_mqtt_codec_layer_pull(void* context, void* data,
 
   iotc_mqtt_parser_init(&layer_data->parser);
 
+  /* payloads of streaming subscriptions go to their callback straight from
+   * the buffers read, they are never assembled */
+  layer_data->parser.payload_begin = &payload_begin;
+  layer_data->parser.payload_chunk = &payload_chunk;
+  layer_data->parser.payload_data = context;
+
   do {
     layer_data->local_state = iotc_mqtt_parser_execute(
         &layer_data->parser, layer_data->msg, data_desc);
@@ -307,6 +333,9 @@ iotc_state_t iotc_mqtt_codec_layer_pull(void* context, void* data,
 
   iotc_debug_mqtt_message_dump(layer_data->msg);
 
+  /* the message is complete before it is handled and the next is read */
+  iotc_user_sub_stream_end(&layer_data->stream, IOTC_STATE_OK);
+
   iotc_mqtt_message_t* recvd = layer_data->msg;
   layer_data->msg = NULL;
 
@@ -338,6 +367,9 @@ err_handling:
   }
 
   if (layer_data) {
+    iotc_user_sub_stream_end(&layer_data->stream,
+                             IOTC_MAX(in_out_state, layer_data->local_state));
+
     /* Reset the coroutine state. */
     IOTC_CR_RESET(layer_data->pull_cs);
     clear_task_queue(context);
@@ -394,6 +426,12 @@ iotc_state_t iotc_mqtt_codec_layer_close_externally(void* context, void* data,
     clear_task_queue(context);
     IOTC_CR_RESET(layer_data->push_cs);
 
+    /* the connection is gone before the last chunk of a streamed payload */
+    iotc_user_sub_stream_end(&layer_data->stream,
+                             IOTC_STATE_OK != in_out_state
+                                 ? in_out_state
+                                 : IOTC_SOCKET_NO_ACTIVE_CONNECTION_ERROR);
+
     iotc_mqtt_message_free(&layer_data->msg);
 
     IOTC_SAFE_FREE(IOTC_THIS_LAYER(context)->user_data);
@@ -18,6 +18,7 @@
 #define __IOTC_MQTT_CODEC_LAYER_DATA_H__
 
 #include "iotc_mqtt_parser.h"
+#include "iotc_user_sub_call_wrapper.h"
 #include "iotc_vector.h"
 
 #ifdef __cplusplus
@@ -35,6 +36,8 @@ typedef struct iotc_mqtt_codec_layer_data_s {
   iotc_mqtt_message_t* msg;
   iotc_mqtt_codec_layer_task_t* task_queue;
   iotc_mqtt_parser_t parser;
+  /* the streaming subscription the payload being parsed goes to */
+  iotc_user_sub_stream_t stream;
   iotc_state_t local_state;
   uint16_t msg_id;
   iotc_mqtt_type_t msg_type;
@@ -28,6 +28,9 @@
 #include "iotc_mqtt_logic_layer_data.h"
 #include "iotc_mqtt_logic_layer_handlers.h"
 #include "iotc_mqtt_logic_layer_helpers.h"
+#include "iotc_mqtt_logic_publish_queue.h"
+#include "iotc_mqtt_logic_rtt.h"
+#include "iotc_mqtt_logic_task_queue.h"
 #include "iotc_mqtt_message.h"
 #include "iotc_mqtt_parser.h"
 #include "iotc_mqtt_serialiser.h"
@@ -67,6 +70,16 @@ static void iotc_mqtt_logic_layer_task_make_context_null(
   task->logic.handlers.h4.a1 = NULL;
 }
 
+static void iotc_mqtt_logic_layer_count_in_flight(
+    iotc_mqtt_logic_task_t* task, iotc_mqtt_logic_layer_data_t* layer_data) {
+  assert(NULL != task);
+  assert(NULL != layer_data);
+
+  if (is_q1_publish(task)) {
+    ++layer_data->q1_in_flight_count;
+  }
+}
+
 iotc_state_t iotc_mqtt_logic_layer_push(void* context, void* data,
                                         iotc_state_t in_out_state) {
   IOTC_LAYER_FUNCTION_PRINT_FUNCTION_DIGEST();
@@ -111,14 +124,14 @@ iotc_state_t iotc_mqtt_logic_layer_push(void* context, void* data,
       iotc_mqtt_message_class_t msg_class =
           iotc_mqtt_class_msg_type_sending(msg_type);
 
-      iotc_mqtt_logic_task_t* task_queue = NULL;
+      iotc_mqtt_logic_task_queue_t* task_queue = NULL;
 
       switch (msg_class) {
         case IOTC_MQTT_MESSAGE_CLASS_FROM_SERVER:
-          task_queue = layer_data->q12_recv_tasks_queue;
+          task_queue = &layer_data->q12_recv_tasks_queue;
           break;
         case IOTC_MQTT_MESSAGE_CLASS_TO_SERVER:
-          task_queue = layer_data->q12_tasks_queue;
+          task_queue = &layer_data->q12_tasks_queue;
           break;
         case IOTC_MQTT_MESSAGE_CLASS_UNKNOWN:
           in_out_state = IOTC_MQTT_MESSAGE_CLASS_UNKNOWN_ERROR;
@@ -129,8 +142,7 @@ iotc_state_t iotc_mqtt_logic_layer_push(void* context, void* data,
       }
 
       /* It is one of the qos12 tasks, find the proper task */
-      IOTC_LIST_FIND(iotc_mqtt_logic_task_t, task_queue, CMP_TASK_MSG_ID,
-                     msg_id, task_to_be_called);
+      task_to_be_called = iotc_mqtt_logic_task_queue_find(task_queue, msg_id);
     }
 
     /* restart the layer keepalive task timer after every every successful
@@ -220,9 +232,13 @@ iotc_state_t iotc_mqtt_logic_layer_push(void* context, void* data,
       return IOTC_MQTT_LOGIC_WRONG_SCENARIO_TYPE;
   }
 
-  run_task(context, task);
+  const iotc_mqtt_qos_t qos = task->data.mqtt_settings.qos;
+
+  in_out_state = run_task(context, task);
 
-  return IOTC_STATE_OK;
+  /* a QoS 1 publish refused by a full publish window has to be reported to
+   * the publisher, everything else reports through the task's callback */
+  return (IOTC_MQTT_QOS_AT_MOST_ONCE == qos) ? IOTC_STATE_OK : in_out_state;
 
 err_handling:
   if (in_out_state == IOTC_STATE_WRITTEN ||
@@ -279,7 +295,7 @@ iotc_state_t iotc_mqtt_logic_layer_pull(void* context, void* data,
      * otherway we are going to use the current qos_0 task */
     if (msg_id > 0) {
       iotc_mqtt_logic_task_t* task = 0;
-      iotc_mqtt_logic_task_t* task_queue = 0;
+      iotc_mqtt_logic_task_queue_t* task_queue = 0;
 
       /** store the msg class */
       iotc_mqtt_message_class_t msg_class = iotc_mqtt_class_msg_type_receiving(
@@ -288,10 +304,10 @@ iotc_state_t iotc_mqtt_logic_layer_pull(void* context, void* data,
       /** pick proper msg queue */
       switch (msg_class) {
         case IOTC_MQTT_MESSAGE_CLASS_FROM_SERVER:
-          task_queue = layer_data->q12_recv_tasks_queue;
+          task_queue = &layer_data->q12_recv_tasks_queue;
           break;
         case IOTC_MQTT_MESSAGE_CLASS_TO_SERVER:
-          task_queue = layer_data->q12_tasks_queue;
+          task_queue = &layer_data->q12_tasks_queue;
           break;
         case IOTC_MQTT_MESSAGE_CLASS_UNKNOWN:
         default:
@@ -299,8 +315,7 @@ iotc_state_t iotc_mqtt_logic_layer_pull(void* context, void* data,
           goto err_handling;
       }
 
-      IOTC_LIST_FIND(iotc_mqtt_logic_task_t, task_queue, CMP_TASK_MSG_ID,
-                     msg_id, task);
+      task = iotc_mqtt_logic_task_queue_find(task_queue, msg_id);
 
       if (task != 0) /* got the task let's call the proper handler */
       {
@@ -362,29 +377,43 @@ iotc_state_t iotc_mqtt_logic_layer_init(void* context, void* data,
 
   if (IOTC_SESSION_CONTINUE ==
       IOTC_CONTEXT_DATA(context)->connection_data->session_type) {
+    /* same story goes with the qos1&2 unacked messages what we have to do is to
+     * re-plug them into the queue and connect task will restart the tasks */
+    iotc_mqtt_logic_task_t* unacked_list =
+        (iotc_mqtt_logic_task_t*)
+            context_data->copy_of_q12_unacked_messages_queue;
+    context_data->copy_of_q12_unacked_messages_queue = NULL;
+
+    in_out_state = iotc_mqtt_logic_task_queue_append_list(
+        &layer_data->q12_tasks_queue, &unacked_list);
+
+    if (IOTC_STATE_OK != in_out_state) {
+      /* give the tasks back to the copy in their order, nothing is lost */
+      iotc_mqtt_logic_task_t* queued =
+          iotc_mqtt_logic_task_queue_detach(&layer_data->q12_tasks_queue);
+      IOTC_LIST_PUSH_BACK(iotc_mqtt_logic_task_t, queued, unacked_list);
+      context_data->copy_of_q12_unacked_messages_queue = queued;
+      goto err_handling;
+    }
+
+    /* the unacknowledged publishes take their place in the publish window */
+    IOTC_LIST_FOREACH_WITH_ARG(iotc_mqtt_logic_task_t,
+                               layer_data->q12_tasks_queue.head,
+                               iotc_mqtt_logic_layer_count_in_flight,
+                               layer_data);
+
     /* let's swap them with values so we are going to re-use the
      * handlers for topics from last session */
     layer_data->handlers_for_topics = context_data->copy_of_handlers_for_topics;
     context_data->copy_of_handlers_for_topics = NULL;
 
-    /* same story goes with the qos1&2 unacked messages what we have to do is to
-     * re-plug them into the queue and connect task will restart the tasks */
-    layer_data->q12_tasks_queue =
-        context_data->copy_of_q12_unacked_messages_queue;
-    context_data->copy_of_q12_unacked_messages_queue = NULL;
-
     /* restoring the last_msg_id */
     layer_data->last_msg_id = context_data->copy_of_last_msg_id;
     context_data->copy_of_last_msg_id = 0;
   } else {
-    if (NULL != context_data->copy_of_handlers_for_topics) {
-      iotc_vector_for_each(context_data->copy_of_handlers_for_topics,
-                           &iotc_mqtt_task_spec_data_free_subscribe_data_vec,
-                           NULL, 0);
-
-      context_data->copy_of_handlers_for_topics =
-          iotc_vector_destroy(context_data->copy_of_handlers_for_topics);
-    }
+    iotc_mqtt_logic_topic_trie_destroy(
+        &context_data->copy_of_handlers_for_topics,
+        &iotc_mqtt_task_spec_data_free_subscribe_data_trie);
 
     /* clean the unsent QoS12 unacked tasks */
     iotc_mqtt_logic_task_t* saved_unacked_qos_12_queue =
@@ -398,10 +427,15 @@ iotc_state_t iotc_mqtt_logic_layer_init(void* context, void* data,
   /* if there was no copy or this is the fresh (re)start */
   if (NULL == layer_data->handlers_for_topics) {
     /* let's create fresh one */
-    layer_data->handlers_for_topics = iotc_vector_create();
+    layer_data->handlers_for_topics = iotc_mqtt_logic_topic_trie_create();
     IOTC_CHECK_MEMORY(layer_data->handlers_for_topics, in_out_state);
   }
 
+  context_data->handlers_for_topics = layer_data->handlers_for_topics;
+
+  /* round trip times of an earlier connection say little about this one */
+  iotc_mqtt_logic_rtt_reset(&context_data->publish_stats);
+
   IOTC_CONTEXT_DATA(context)->connection_data->connection_state =
       IOTC_CONNECTION_STATE_OPENING;
 
@@ -446,11 +480,15 @@ iotc_state_t iotc_mqtt_logic_layer_post_connect(void* context, void* data,
   }
 
   /* set new context and send timeout which will make the qos12 tasks to
-   * continue they work just where they were stopped */
+   * continue they work just where they were stopped, in the order they were
+   * first sent (MQTT 3.1.1 section 4.6) whatever their class */
   IOTC_LIST_FOREACH_WITH_ARG(iotc_mqtt_logic_task_t,
-                             layer_data->q12_tasks_queue,
+                             layer_data->q12_tasks_queue.head,
                              set_new_context_and_call_resend, context);
 
+  /* publishes never sent, queued while disconnected, go by class */
+  iotc_mqtt_logic_layer_run_pending_publishes(context);
+
   return iotc_layer_default_post_connect(context, data, in_out_state);
 }
 
@@ -517,13 +555,29 @@ iotc_state_t iotc_mqtt_logic_layer_close_externally(void* context, void* data,
 
   /* disable timeouts of all tasks */
   IOTC_LIST_FOREACH_WITH_ARG(iotc_mqtt_logic_task_t,
-                             layer_data->q12_tasks_queue, cancel_task_timeout,
-                             context);
+                             layer_data->q12_tasks_queue.head,
+                             cancel_task_timeout, context);
 
   IOTC_LIST_FOREACH_WITH_ARG(iotc_mqtt_logic_task_t,
-                             layer_data->q12_recv_tasks_queue,
+                             layer_data->q12_recv_tasks_queue.head,
                              cancel_task_timeout, context);
 
+  /* from here on the tasks are only walked as plain lists */
+  iotc_mqtt_logic_task_t* q12_queue =
+      iotc_mqtt_logic_task_queue_detach(&layer_data->q12_tasks_queue);
+  iotc_mqtt_logic_task_t* q12_recv_queue =
+      iotc_mqtt_logic_task_queue_detach(&layer_data->q12_recv_tasks_queue);
+
+  /* publishes still waiting in the publish queue have not been started, they
+   * go the same way as the other unstarted tasks */
+  iotc_mqtt_logic_task_t* queued_publishes =
+      iotc_mqtt_logic_publish_queue_detach(&layer_data->publish_queue);
+  IOTC_LIST_PUSH_BACK(iotc_mqtt_logic_task_t, q12_queue, queued_publishes);
+  layer_data->publish_unwritten = NULL;
+
+  /* the codec layer is closed before, nothing looks the trie up anymore */
+  context_data->handlers_for_topics = NULL;
+
   /* if clean session not set check if we have anything to copy */
   if (IOTC_SESSION_CONTINUE == context_data->connection_data->session_type) {
     iotc_context_data_t* context_data = IOTC_THIS_LAYER(context)->context_data;
@@ -532,7 +586,7 @@ iotc_state_t iotc_mqtt_logic_layer_close_externally(void* context, void* data,
 
     /* this will copy the handlers for topics */
     if (layer_data->handlers_for_topics != NULL &&
-        layer_data->handlers_for_topics->elem_no > 0) {
+        layer_data->handlers_for_topics->count > 0) {
       /* sanity check, let's make sure that it is empty */
       assert(
           IOTC_THIS_LAYER(context)->context_data->copy_of_handlers_for_topics ==
@@ -550,7 +604,7 @@ iotc_state_t iotc_mqtt_logic_layer_close_externally(void* context, void* data,
     /* we will construct new list out of them */
     iotc_mqtt_logic_task_t* unacked_list = NULL;
 
-    IOTC_LIST_SPLIT_I(iotc_mqtt_logic_task_t, layer_data->q12_tasks_queue,
+    IOTC_LIST_SPLIT_I(iotc_mqtt_logic_task_t, q12_queue,
                       iotc_mqtt_logic_layer_task_should_be_stored_predicate,
                       context, unacked_list);
 
@@ -562,12 +616,9 @@ iotc_state_t iotc_mqtt_logic_layer_close_externally(void* context, void* data,
 
   /* if the handlers for topics are left alone than it means
    * that it has to be freed */
-  if (layer_data->handlers_for_topics != NULL) {
-    iotc_vector_for_each(layer_data->handlers_for_topics,
-                         &iotc_mqtt_task_spec_data_free_subscribe_data_vec,
-                         NULL, 0);
-    iotc_vector_destroy(layer_data->handlers_for_topics);
-  }
+  iotc_mqtt_logic_topic_trie_destroy(
+      &layer_data->handlers_for_topics,
+      &iotc_mqtt_task_spec_data_free_subscribe_data_trie);
 
   /* let's stop the current task */
   if (layer_data->current_q0_task != 0) {
@@ -590,8 +641,6 @@ iotc_state_t iotc_mqtt_logic_layer_close_externally(void* context, void* data,
 
   /* save queues */
   iotc_mqtt_logic_task_t* current_q0 = layer_data->current_q0_task;
-  iotc_mqtt_logic_task_t* q12_queue = layer_data->q12_tasks_queue;
-  iotc_mqtt_logic_task_t* q12_recv_queue = layer_data->q12_recv_tasks_queue;
   iotc_mqtt_logic_task_t* q0_queue = layer_data->q0_tasks_queue;
 
   /* destroy user's data */
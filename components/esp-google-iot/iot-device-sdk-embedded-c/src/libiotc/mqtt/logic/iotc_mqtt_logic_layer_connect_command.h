@@ -149,6 +149,14 @@ static inline iotc_state_t do_mqtt_connect(
     }
 
     if (msg_memory->connack.return_code == 0) {
+      /* bit 0 of the acknowledge flags is session present, a broker may only
+       * set it when the clean session flag was cleared */
+      IOTC_CONTEXT_DATA(context)->connection_data->session_present =
+          IOTC_SESSION_CONTINUE ==
+                  IOTC_CONTEXT_DATA(context)->connection_data->session_type
+              ? (msg_memory->connack._unused & 0x01)
+              : 0;
+
       iotc_mqtt_message_free(&msg_memory);
 
       if (IOTC_CONTEXT_DATA(context)->connection_data->keepalive_timeout > 0) {
@@ -24,7 +24,8 @@ extern "C" {
 
 iotc_mqtt_logic_task_t* iotc_mqtt_logic_make_publish_task(
     const char* topic, iotc_data_desc_t* data, const iotc_mqtt_qos_t qos,
-    const iotc_mqtt_retain_t retain, iotc_event_handle_t callback) {
+    const iotc_mqtt_retain_t retain, const iotc_mqtt_priority_t priority,
+    iotc_event_handle_t callback) {
   /* PRECONDITIONS */
   assert(NULL != topic);
   assert(NULL != data);
@@ -35,6 +36,7 @@ iotc_mqtt_logic_task_t* iotc_mqtt_logic_make_publish_task(
 
   task->data.mqtt_settings.scenario = IOTC_MQTT_PUBLISH;
   task->data.mqtt_settings.qos = qos;
+  task->publish_priority = priority;
 
   task->callback = callback;
 
@@ -114,16 +116,19 @@ void iotc_mqtt_task_spec_data_free_subscribe_data(
   assert(NULL != data);
   assert(NULL != *data);
 
-  IOTC_SAFE_FREE((*data)->subscribe.topic);
-  IOTC_SAFE_FREE((*data));
-}
+  while (NULL != *data) {
+    iotc_mqtt_task_specific_data_t* next = (*data)->subscribe.next;
+
+    IOTC_SAFE_FREE((*data)->subscribe.topic);
+    IOTC_SAFE_FREE((*data));
 
-void iotc_mqtt_task_spec_data_free_subscribe_data_vec(
-    union iotc_vector_selector_u* data, void* arg) {
-  IOTC_UNUSED(arg);
+    *data = next;
+  }
+}
 
+void iotc_mqtt_task_spec_data_free_subscribe_data_trie(void* data) {
   iotc_mqtt_task_spec_data_free_subscribe_data(
-      (iotc_mqtt_task_specific_data_t**)&data->ptr_value);
+      (iotc_mqtt_task_specific_data_t**)&data);
 }
 
 iotc_mqtt_logic_task_t* iotc_mqtt_logic_free_task_data(
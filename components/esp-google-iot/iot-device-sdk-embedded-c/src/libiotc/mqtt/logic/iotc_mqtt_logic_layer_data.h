@@ -20,6 +20,7 @@
 #include "iotc_connection_data.h"
 #include "iotc_data_desc.h"
 #include "iotc_event_dispatcher_api.h"
+#include "iotc_mqtt_logic_topic_trie.h"
 #include "iotc_mqtt_message.h"
 
 #ifdef __cplusplus
@@ -35,7 +36,7 @@ typedef enum iotc_scenario_e {
   IOTC_MQTT_SHUTDOWN
 } iotc_scenario_t;
 
-typedef union {
+typedef union iotc_mqtt_task_specific_data_u {
   struct data_t_publish_t {
     char* topic;
     iotc_data_desc_t* data;
@@ -47,6 +48,13 @@ typedef union {
     char* topic;
     iotc_event_handle_t handler;
     iotc_mqtt_qos_t qos;
+    /* set by iotc_subscribe_streaming(), the codec layer hands the payloads
+     * to the handler's callback in chunks and the message which reaches the
+     * logic layer has none */
+    uint8_t stream;
+    /* the further topics sent in the same SUBSCRIBE, each one is handed
+     * over to its handler on its own once the SUBACK arrives */
+    union iotc_mqtt_task_specific_data_u* next;
   } subscribe;
 
   struct data_t_shutdown_t {
@@ -78,6 +86,7 @@ typedef enum {
 
 typedef struct iotc_mqtt_logic_task_s {
   struct iotc_mqtt_logic_task_s* __next;
+  struct iotc_mqtt_logic_task_s* __prev; /* only while in a task queue */
   iotc_time_event_handle_t timeout;
   iotc_event_handle_t logic;
   iotc_event_handle_t callback;
@@ -86,8 +95,33 @@ typedef struct iotc_mqtt_logic_task_s {
   iotc_mqtt_logic_task_session_state_t session_state;
   uint16_t cs;
   uint16_t msg_id;
+  iotc_time_t sent_time_ms; /* when a QoS 1 PUBLISH was written first */
+  uint8_t resend_count;
+  iotc_mqtt_priority_t publish_priority; /* URGENT for all other tasks */
+  iotc_time_t queued_time_ms; /* when a publish entered the publish queue */
 } iotc_mqtt_logic_task_t;
 
+/* QoS 1 and 2 tasks in the order they were started, indexed by message id so
+ * that an acknowledgement finds its task in constant time. See
+ * iotc_mqtt_logic_task_queue.h. A zeroed queue is a valid empty queue. */
+typedef struct iotc_mqtt_logic_task_queue_s {
+  iotc_mqtt_logic_task_t* head;
+  iotc_mqtt_logic_task_t* tail;
+  iotc_mqtt_logic_task_t** index; /* open addressing, linear probing */
+  size_t index_size;              /* power of two, 0 until the first push */
+  size_t count;
+} iotc_mqtt_logic_task_queue_t;
+
+/* Publishes waiting to be started, one list per iotc_mqtt_priority_t linked
+ * through __next. See iotc_mqtt_logic_publish_queue.h. A zeroed queue is a
+ * valid empty queue. */
+typedef struct iotc_mqtt_logic_publish_queue_s {
+  iotc_mqtt_logic_task_t* head[IOTC_MQTT_PRIORITY_COUNT];
+  iotc_mqtt_logic_task_t* tail[IOTC_MQTT_PRIORITY_COUNT];
+  uint16_t count;
+  uint8_t last_pick_aged; /* the last publish was let through by its age */
+} iotc_mqtt_logic_publish_queue_t;
+
 typedef struct {
   /* Here we are going to store the mapping of the
    * handle functions versus the subscribed topics
@@ -95,11 +129,20 @@ typedef struct {
    * for each of the subscribed topics. */
 
   /* Handle to the user idle function that suppose to. */
-  iotc_mqtt_logic_task_t* q12_tasks_queue;
-  iotc_mqtt_logic_task_t* q12_recv_tasks_queue;
+  iotc_mqtt_logic_task_queue_t q12_tasks_queue;
+  iotc_mqtt_logic_task_queue_t q12_recv_tasks_queue;
   iotc_mqtt_logic_task_t* q0_tasks_queue;
   iotc_mqtt_logic_task_t* current_q0_task;
-  iotc_vector_t* handlers_for_topics;
+  /* QoS 0 and 1 publishes waiting for room in the publish window or for the
+   * previous publish to be written, QoS 1 publishes get their message id once
+   * they are started */
+  iotc_mqtt_logic_publish_queue_t publish_queue;
+  /* the started publish the codec has not written yet, the next one waits
+   * for it so that the codec's queue never holds a backlog of publishes */
+  iotc_mqtt_logic_task_t* publish_unwritten;
+  uint16_t q1_in_flight_count;
+  /* the subscribe data of the granted subscriptions by topic filter */
+  iotc_mqtt_logic_topic_trie_t* handlers_for_topics;
   iotc_time_event_handle_t keepalive_event;
   uint16_t last_msg_id;
 } iotc_mqtt_logic_layer_data_t;
@@ -107,7 +150,8 @@ typedef struct {
 /* Pseudo constructors. */
 extern iotc_mqtt_logic_task_t* iotc_mqtt_logic_make_publish_task(
     const char* topic, iotc_data_desc_t* data, const iotc_mqtt_qos_t qos,
-    const iotc_mqtt_retain_t retain, iotc_event_handle_t callback);
+    const iotc_mqtt_retain_t retain, const iotc_mqtt_priority_t priority,
+    iotc_event_handle_t callback);
 
 extern iotc_mqtt_logic_task_t* iotc_mqtt_logic_make_subscribe_task(
     char* topic, const iotc_mqtt_qos_t qos, iotc_event_handle_t handler);
@@ -118,8 +162,7 @@ extern void iotc_mqtt_task_spec_data_free_publish_data(
 extern void iotc_mqtt_task_spec_data_free_subscribe_data(
     iotc_mqtt_task_specific_data_t** data);
 
-extern void iotc_mqtt_task_spec_data_free_subscribe_data_vec(
-    union iotc_vector_selector_u* data, void* arg);
+extern void iotc_mqtt_task_spec_data_free_subscribe_data_trie(void* data);
 
 extern iotc_mqtt_logic_task_t* iotc_mqtt_logic_make_shutdown_task(void);
 
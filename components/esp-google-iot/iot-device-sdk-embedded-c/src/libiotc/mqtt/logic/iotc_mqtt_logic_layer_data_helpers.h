@@ -26,66 +26,6 @@
 extern "C" {
 #endif
 
-static inline int8_t match_topics(const union iotc_vector_selector_u* a,
-                                  const union iotc_vector_selector_u* b) {
-  if (NULL == a || NULL == b) {
-    return 1;
-  }
-
-  const iotc_mqtt_task_specific_data_t* ca =
-      (const iotc_mqtt_task_specific_data_t*)
-          a->ptr_value; /* This is supposed to be the one from the vector. */
-  const iotc_data_desc_t* cb =
-      (const iotc_data_desc_t*)b->ptr_value; /* This is supposed to be the one
-                                                from the msg. */
-
-  if (NULL == ca || NULL == cb || NULL == ca->subscribe.topic ||
-      NULL == cb->data_ptr) {
-    return 1;
-  }
-
-  // check if we have a wildcard in our subscription
-  const uint8_t subscription_length = strlen(ca->subscribe.topic);
-  if (subscription_length == 0) {
-    return 1;
-  }
-
-  const uint8_t published_topic_length = cb->length;
-  if (published_topic_length == 0) {
-    return 1;
-  }
-
-  const char last_sub_token = ca->subscribe.topic[subscription_length - 1];
-
-  // first deal with non-wildcard subscriptions. Must be exact
-  if ('#' != last_sub_token) {
-    // we can bail out if our topics aren't exactly the same length
-    if (published_topic_length != subscription_length) return 1;
-
-    return memcmp(ca->subscribe.topic, cb->data_ptr, published_topic_length)
-               ? 1
-               : 0;
-  } else {
-    // handle the wildcard subscriptions
-    if (subscription_length == 1) {
-      return 0;
-    }
-
-    if ((subscription_length - 1) <= published_topic_length) {
-      // if the published topic has something in the wildcard position
-      return memcmp(ca->subscribe.topic, cb->data_ptr, subscription_length - 1)
-                 ? 1
-                 : 0;
-    } else if ((subscription_length - 2) == published_topic_length) {
-      // match the parent topic, e.g. pear/banana/#, pear/banana
-      return memcmp(ca->subscribe.topic, cb->data_ptr, subscription_length - 2)
-                 ? 1
-                 : 0;
-    }
-  }
-  return 1;
-}
-
 static inline iotc_state_t fill_with_pingreq_data(iotc_mqtt_message_t* msg) {
   memset(msg, 0, sizeof(iotc_mqtt_message_t));
   msg->common.common_u.common_bits.type = IOTC_MQTT_TYPE_PINGREQ;
@@ -259,6 +199,29 @@ err_handling:
   return local_state;
 }
 
+/* Appends a topic to a SUBSCRIBE made by fill_with_subscribe_data(), the
+ * broker answers with one return code per topic in the same order. */
+static inline iotc_state_t add_subscribe_topic(iotc_mqtt_message_t* msg,
+                                               const char* topic,
+                                               const iotc_mqtt_qos_t qos) {
+  iotc_state_t local_state = IOTC_STATE_OK;
+  iotc_mqtt_topicpair_t** last = &msg->subscribe.topics;
+
+  while (NULL != *last) {
+    last = &(*last)->next;
+  }
+
+  IOTC_ALLOC_AT(iotc_mqtt_topicpair_t, *last, local_state);
+
+  IOTC_CHECK_MEMORY((*last)->name = iotc_make_desc_from_string_copy(topic),
+                    local_state);
+
+  (*last)->iotc_mqtt_topic_pair_payload_u.qos = qos;
+
+err_handling:
+  return local_state;
+}
+
 static inline iotc_state_t fill_with_disconnect_data(iotc_mqtt_message_t* msg) {
   memset(msg, 0, sizeof(iotc_mqtt_message_t));
 
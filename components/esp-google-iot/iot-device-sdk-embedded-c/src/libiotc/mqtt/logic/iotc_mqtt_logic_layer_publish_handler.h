@@ -42,22 +42,23 @@ static inline void call_topic_handler(
   /* Pre-conditions. */
   assert(NULL != msg_memory);
 
-  iotc_vector_index_type_t index = 0;
+  iotc_mqtt_task_specific_data_t* subscribe_data = NULL;
 
   iotc_debug_format("[m.id[%d]] looking for publish message handler",
                     iotc_mqtt_get_message_id(msg_memory));
 
-  index = iotc_vector_find(layer_data->handlers_for_topics,
-                           IOTC_VEC_CONST_VALUE_PARAM(IOTC_VEC_VALUE_PTR(
-                               msg_memory->publish.topic_name)),
-                           match_topics);
-
-  if (index != -1) {
-    iotc_mqtt_task_specific_data_t* subscribe_data =
-        (iotc_mqtt_task_specific_data_t*)layer_data->handlers_for_topics
-            ->array[index]
-            .selector_t.ptr_value;
+  if (NULL != msg_memory->publish.topic_name) {
+    subscribe_data =
+        (iotc_mqtt_task_specific_data_t*)iotc_mqtt_logic_topic_trie_match(
+            layer_data->handlers_for_topics,
+            (const char*)msg_memory->publish.topic_name->data_ptr,
+            msg_memory->publish.topic_name->length);
+  }
 
+  if (NULL != subscribe_data && subscribe_data->subscribe.stream) {
+    /* the codec layer has delivered the payload already */
+    iotc_mqtt_message_free(&msg_memory);
+  } else if (NULL != subscribe_data) {
     subscribe_data->subscribe.handler.handlers.h3.a2 = msg_memory;
     subscribe_data->subscribe.handler.handlers.h3.a3 = IOTC_STATE_OK;
 
@@ -129,21 +130,17 @@ static inline iotc_state_t on_publish_q1_recieved(
 
     task->msg_id = msg_id;
 
-/* @TODO: change this into debug only compilation. */
-#if 1
-    {
-      iotc_mqtt_logic_task_t* test_task = NULL;
+    // there must not be similar tasks
+    assert(NULL == iotc_mqtt_logic_task_queue_find(
+                       &layer_data->q12_recv_tasks_queue, task->msg_id));
 
-      IOTC_LIST_FIND(iotc_mqtt_logic_task_t, layer_data->q12_recv_tasks_queue,
-                     CMP_TASK_MSG_ID, task->msg_id, test_task);
+    state = iotc_mqtt_logic_task_queue_push_back(
+        &layer_data->q12_recv_tasks_queue, task);
 
-      // there must not be similar tasks
-      assert(NULL == test_task);
+    if (IOTC_STATE_OK != state) {
+      iotc_mqtt_logic_free_task(&task);
+      goto err_handling;
     }
-#endif
-
-    IOTC_LIST_PUSH_BACK(iotc_mqtt_logic_task_t,
-                        layer_data->q12_recv_tasks_queue, task);
   }
 
   IOTC_CR_START(task->cs);
@@ -170,8 +167,7 @@ static inline iotc_state_t on_publish_q1_recieved(
   /* Msg sent now proceed with cleaning. */
 
   /* Clean the created task data. */
-  IOTC_LIST_DROP(iotc_mqtt_logic_task_t, layer_data->q12_recv_tasks_queue,
-                 task);
+  iotc_mqtt_logic_task_queue_drop(&layer_data->q12_recv_tasks_queue, task);
 
   iotc_mqtt_logic_free_task(&task);
 
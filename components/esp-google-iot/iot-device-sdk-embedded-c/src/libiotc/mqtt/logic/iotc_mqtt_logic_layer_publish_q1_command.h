@@ -23,8 +23,11 @@
 #include "iotc_mqtt_logic_layer_data.h"
 #include "iotc_mqtt_logic_layer_data_helpers.h"
 #include "iotc_mqtt_logic_layer_task_helpers.h"
+#include "iotc_mqtt_logic_rtt.h"
 #include "iotc_mqtt_message.h"
 
+#include <iotc_bsp_time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -46,6 +49,8 @@ static iotc_state_t do_mqtt_publish_q1(
   iotc_evtd_instance_t* event_dispatcher =
       IOTC_CONTEXT_DATA(context)->evtd_instance;
   iotc_mqtt_message_t* msg_memory = (iotc_mqtt_message_t*)msg_data;
+  iotc_mqtt_publish_stats_t* stats =
+      &IOTC_CONTEXT_DATA(context)->publish_stats;
 
   if (IOTC_THIS_LAYER_NOT_OPERATIONAL(context) || NULL == layer_data) {
     cancel_task_timeout(task, context);
@@ -63,6 +68,16 @@ static iotc_state_t do_mqtt_publish_q1(
   do {
     iotc_debug_format("[m.id[%d]]publish q1 preparing message", task->msg_id);
 
+    if (IOTC_STATE_RESEND == state) {
+      ++stats->resent;
+
+      /* doubles the PUBACK timeout and rules out the round trip sample, the
+       * PUBACK could belong to any of the copies */
+      if (task->resend_count < UINT8_MAX) {
+        ++task->resend_count;
+      }
+    }
+
     IOTC_ALLOC_AT(iotc_mqtt_message_t, msg_memory, state);
 
     /* Note on memory - here the data ptr's are shared, so no data copy. */
@@ -80,8 +95,12 @@ static iotc_state_t do_mqtt_publish_q1(
     IOTC_CR_YIELD(task->cs, IOTC_PROCESS_PUSH_ON_PREV_LAYER(context, msg_memory,
                                                             IOTC_STATE_OK));
 
+    /* the codec is free for the next queued publish */
+    iotc_mqtt_logic_layer_publish_written(context, task);
+
     if (state == IOTC_STATE_WRITTEN) {
       iotc_debug_format("[m.id[%d]]publish q1 has been sent", task->msg_id);
+      task->sent_time_ms = iotc_bsp_time_getmonotonictime_milliseconds();
       task->session_state =
           task->session_state == IOTC_MQTT_LOGIC_TASK_SESSION_UNSET
               ? IOTC_MQTT_LOGIC_TASK_SESSION_STORE
@@ -95,22 +114,21 @@ static iotc_state_t do_mqtt_publish_q1(
     /* Add a timeout for waiting for the response. */
     assert(NULL == task->timeout.ptr_to_position);
 
-    /* @TODO change it to use the defined timeout. */
-    if (IOTC_CONTEXT_DATA(context)->connection_data->keepalive_timeout > 0) {
-      state = iotc_evtd_execute_in(
-          event_dispatcher,
-          iotc_make_handle(&do_mqtt_publish_q1, context, task,
-                           IOTC_STATE_TIMEOUT, NULL),
-          IOTC_CONTEXT_DATA(context)->connection_data->keepalive_timeout,
-          &task->timeout);
-      IOTC_CHECK_STATE(state);
-    }
+    /* The timeout follows the measured PUBACK round trip time and backs off
+     * exponentially while the publish stays unacknowledged. */
+    state = iotc_evtd_execute_in(
+        event_dispatcher,
+        iotc_make_handle(&do_mqtt_publish_q1, context, task,
+                         IOTC_STATE_TIMEOUT, NULL),
+        iotc_mqtt_logic_rtt_timeout(stats, task->resend_count), &task->timeout);
+    IOTC_CHECK_STATE(state);
 
     /* Wait for the puback. */
     IOTC_CR_YIELD(task->cs, IOTC_STATE_OK);
 
     if (IOTC_STATE_TIMEOUT == state) {
       iotc_debug_format("[m.id[%d]]publish q1 timeout occured", task->msg_id);
+      ++stats->timeouts;
 
       /* Clear if it was timeout. */
       assert(NULL == task->timeout.ptr_to_position);
@@ -154,6 +172,14 @@ static iotc_state_t do_mqtt_publish_q1(
   iotc_debug_format("[m.id[%d]]publish q1 publish puback received",
                     task->msg_id);
 
+  ++stats->acked;
+
+  if (0 == task->resend_count) {
+    iotc_mqtt_logic_rtt_sample(
+        stats,
+        iotc_bsp_time_getmonotonictime_milliseconds() - task->sent_time_ms);
+  }
+
   iotc_mqtt_logic_task_defer_users_callback(context, task, state);
 
   iotc_mqtt_message_free(&msg_memory);
@@ -29,6 +29,23 @@
 extern "C" {
 #endif
 
+/* Registers the handler of a granted subscription, passing the ownership of
+ * the data to the handlers trie. A handler for the same topic filter, kept
+ * from an earlier session or an earlier subscribe, is replaced so that a
+ * message is never handed out twice. */
+static inline iotc_state_t register_subscription_handler(
+    iotc_mqtt_logic_layer_data_t* layer_data,
+    iotc_mqtt_task_specific_data_t* data) {
+  void* replaced = NULL;
+  iotc_state_t state = iotc_mqtt_logic_topic_trie_insert(
+      layer_data->handlers_for_topics, data->subscribe.topic, data, &replaced);
+
+  iotc_mqtt_task_spec_data_free_subscribe_data(
+      (iotc_mqtt_task_specific_data_t**)&replaced);
+
+  return state;
+}
+
 static inline iotc_state_t do_mqtt_subscribe(void* ctx, void* data,
                                              iotc_state_t state, void* msg) {
   iotc_layer_connectivity_t* context = (iotc_layer_connectivity_t*)ctx;
@@ -66,6 +83,17 @@ static inline iotc_state_t do_mqtt_subscribe(void* ctx, void* data,
                          IOTC_STATE_RESEND == state ? IOTC_MQTT_DUP_TRUE
                                                     : IOTC_MQTT_DUP_FALSE));
 
+    {
+      iotc_mqtt_task_specific_data_t* further =
+          task->data.data_u->subscribe.next;
+
+      for (; NULL != further; further = further->subscribe.next) {
+        IOTC_CHECK_STATE(state = add_subscribe_topic(
+                             msg_memory, further->subscribe.topic,
+                             further->subscribe.qos));
+      }
+    }
+
     iotc_debug_format("[m.id[%d]]subscribe sending message", task->msg_id);
 
     IOTC_CR_YIELD(task->cs, IOTC_PROCESS_PUSH_ON_PREV_LAYER(context, msg_memory,
@@ -148,38 +176,49 @@ static inline iotc_state_t do_mqtt_subscribe(void* ctx, void* data,
 
     iotc_debug_format("[m.id[%d]]subscribe suback received", task->msg_id);
 
-    iotc_mqtt_suback_status_t suback_status =
-        msg_memory->suback.topics->iotc_mqtt_topic_pair_payload_u.status;
+    /* the return codes come in the order of the topics, a topic the broker
+     * left without one is taken as refused */
+    const iotc_mqtt_topicpair_t* suback_topic = msg_memory->suback.topics;
 
-    iotc_mqtt_message_free(&msg_memory);
+    while (NULL != task->data.data_u) {
+      iotc_mqtt_task_specific_data_t* data = task->data.data_u;
 
-    task->data.data_u->subscribe.handler.handlers.h6.a2 =
-        (void*)(intptr_t)suback_status;
+      iotc_mqtt_suback_status_t suback_status =
+          NULL != suback_topic
+              ? suback_topic->iotc_mqtt_topic_pair_payload_u.status
+              : IOTC_MQTT_SUBACK_FAILED;
 
-    task->data.data_u->subscribe.handler.handlers.h6.a3 =
-        suback_status == IOTC_MQTT_SUBACK_FAILED
-            ? IOTC_MQTT_SUBSCRIPTION_FAILED
-            : IOTC_MQTT_SUBSCRIPTION_SUCCESSFULL;
+      suback_topic = NULL != suback_topic ? suback_topic->next : NULL;
 
-    /* check if the suback registration was successfull */
-    if (IOTC_MQTT_SUBACK_FAILED != suback_status) {
-      /* now it can be registered - we are passing the ownership of the
-       * data.data_u to the vector */
+      /* each topic is handed over on its own from here on */
+      task->data.data_u = data->subscribe.next;
+      data->subscribe.next = NULL;
+
+      data->subscribe.handler.handlers.h6.a2 = (void*)(intptr_t)suback_status;
+
+      data->subscribe.handler.handlers.h6.a3 =
+          suback_status == IOTC_MQTT_SUBACK_FAILED
+              ? IOTC_MQTT_SUBSCRIPTION_FAILED
+              : IOTC_MQTT_SUBSCRIPTION_SUCCESSFULL;
+
+      /* check if the suback registration was successfull */
+      if (IOTC_MQTT_SUBACK_FAILED != suback_status) {
+        state = register_subscription_handler(layer_data, data);
+
+        if (IOTC_STATE_OK != state) {
+          iotc_mqtt_task_spec_data_free_subscribe_data(&data);
+          goto err_handling;
+        }
+      }
+
+      /* the ownership of this memory block is now passed either to the
+       * subscription callback or the handlers_for_topics trie if the
+       * subscription was succesfull */
       IOTC_CHECK_MEMORY(
-          iotc_vector_push(
-              layer_data->handlers_for_topics,
-              IOTC_VEC_VALUE_PARAM(IOTC_VEC_VALUE_PTR(task->data.data_u))),
-          state);
+          iotc_evtd_execute(event_dispatcher, data->subscribe.handler), state);
     }
 
-    IOTC_CHECK_MEMORY(iotc_evtd_execute(event_dispatcher,
-                                        task->data.data_u->subscribe.handler),
-                      state);
-
-    /* now it's safe to nullify this pointer because the ownership of this
-     * memory block is now passed either to a subscription callback or the
-     * handlers_for_topics vector if the subscription was succesfull */
-    task->data.data_u = NULL;
+    iotc_mqtt_message_free(&msg_memory);
 
     IOTC_CR_EXIT(task->cs, iotc_mqtt_logic_layer_finalize_task(context, task));
   }
@@ -19,6 +19,9 @@
 #include "iotc_layer_api.h"
 #include "iotc_list.h"
 #include "iotc_mqtt_logic_layer_data.h"
+#include "iotc_mqtt_logic_publish_queue.h"
+
+#include <iotc_bsp_time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +70,109 @@ iotc_state_t iotc_mqtt_logic_layer_run_next_q0_task(void* data) {
   return IOTC_STATE_OK;
 }
 
+iotc_state_t iotc_mqtt_logic_layer_schedule_publish(
+    iotc_layer_connectivity_t* context, iotc_mqtt_logic_task_t* task) {
+  /* PRECONDITION */
+  assert(NULL != context);
+  assert(NULL != task);
+
+  iotc_mqtt_logic_layer_data_t* layer_data =
+      (iotc_mqtt_logic_layer_data_t*)IOTC_THIS_LAYER(context)->user_data;
+  iotc_context_data_t* context_data = IOTC_CONTEXT_DATA(context);
+
+  assert(layer_data != 0);
+
+  /* beyond the publish window QoS 1 publishes wait for a PUBACK to make
+   * room, the wait is bounded so that the producer notices */
+  if (is_q1_publish(task) && 0 != context_data->publish_window &&
+      layer_data->q1_in_flight_count + layer_data->publish_queue.count >=
+          context_data->publish_window + context_data->publish_backlog_max) {
+    context_data->publish_refused = 1;
+    ++context_data->publish_stats.refused;
+    iotc_mqtt_logic_free_task(&task);
+    return IOTC_PUBLISH_WINDOW_FULL;
+  }
+
+  task->queued_time_ms = iotc_bsp_time_getmonotonictime_milliseconds();
+  iotc_mqtt_logic_publish_queue_push(&layer_data->publish_queue, task);
+
+  iotc_mqtt_logic_layer_run_pending_publishes(context);
+
+  return IOTC_STATE_OK;
+}
+
+void iotc_mqtt_logic_layer_run_pending_publishes(
+    iotc_layer_connectivity_t* context) {
+  iotc_mqtt_logic_layer_data_t* layer_data =
+      (iotc_mqtt_logic_layer_data_t*)IOTC_THIS_LAYER(context)->user_data;
+  iotc_context_data_t* context_data = IOTC_CONTEXT_DATA(context);
+
+  assert(layer_data != 0);
+
+  const iotc_time_t now_ms = iotc_bsp_time_getmonotonictime_milliseconds();
+
+  /* the codec writes one message at a time, by handing it one publish at a
+   * time the order of the publishes is decided here and not by its queue,
+   * while disconnected the publishes wait here too so that they are sent in
+   * order of priority once the connection is back */
+  while (NULL == layer_data->publish_unwritten &&
+         IOTC_CONNECTION_STATE_OPENED ==
+             context_data->connection_data->connection_state) {
+    const uint8_t q1_blocked =
+        0 != context_data->publish_window &&
+        layer_data->q1_in_flight_count >= context_data->publish_window;
+
+    iotc_mqtt_logic_task_t* task = iotc_mqtt_logic_publish_queue_pop(
+        &layer_data->publish_queue, now_ms, q1_blocked);
+
+    if (NULL == task) {
+      break;
+    }
+
+    iotc_mqtt_logic_publish_queue_record_delay(&context_data->publish_stats,
+                                               task->publish_priority,
+                                               now_ms - task->queued_time_ms);
+
+    /* the publisher got IOTC_STATE_OK long ago, a failure to start a QoS 1
+     * publish can only reach it through the callback */
+    const uint8_t q1_publish = is_q1_publish(task);
+    iotc_event_handle_t callback = task->callback;
+    iotc_state_t state = dispatch_task(context, task);
+
+    if (q1_publish && IOTC_STATE_OK != state &&
+        0 == iotc_handle_disposed(&callback)) {
+      callback.handlers.h3.a3 = state;
+      iotc_evttd_execute(context_data->evtd_instance, callback);
+    }
+  }
+
+  /* half the backlog is left to the producer before it is woken up again, so
+   * that it does not bounce off the limit with each publish */
+  if (context_data->publish_refused &&
+      layer_data->publish_queue.count <= context_data->publish_backlog_max / 2) {
+    context_data->publish_refused = 0;
+
+    if (0 == iotc_handle_disposed(&context_data->publish_writable_callback)) {
+      iotc_evttd_execute(context_data->evtd_instance,
+                         context_data->publish_writable_callback);
+    }
+  }
+}
+
+void iotc_mqtt_logic_layer_publish_written(iotc_layer_connectivity_t* context,
+                                           iotc_mqtt_logic_task_t* task) {
+  iotc_mqtt_logic_layer_data_t* layer_data =
+      (iotc_mqtt_logic_layer_data_t*)IOTC_THIS_LAYER(context)->user_data;
+
+  /* resends and publishes started before a reconnect are not waited for */
+  if (NULL == layer_data || task != layer_data->publish_unwritten) {
+    return;
+  }
+
+  layer_data->publish_unwritten = NULL;
+  iotc_mqtt_logic_layer_run_pending_publishes(context);
+}
+
 void iotc_mqtt_logic_task_defer_users_callback(void* context,
                                                iotc_mqtt_logic_task_t* task,
                                                iotc_state_t state) {
@@ -97,15 +203,39 @@ iotc_state_t iotc_mqtt_logic_layer_finalize_task(
   iotc_mqtt_logic_layer_data_t* layer_data =
       (iotc_mqtt_logic_layer_data_t*)IOTC_THIS_LAYER(context)->user_data;
 
+  /* a publish which failed before it was written */
+  if (task == layer_data->publish_unwritten) {
+    layer_data->publish_unwritten = NULL;
+  }
+
   if (task->data.mqtt_settings.qos == IOTC_MQTT_QOS_AT_MOST_ONCE) {
-    return iotc_mqtt_logic_layer_run_next_q0_task(context);
+    const uint8_t q0_publish =
+        IOTC_MQTT_PUBLISH == task->data.mqtt_settings.scenario;
+    iotc_state_t state = iotc_mqtt_logic_layer_run_next_q0_task(context);
+
+    /* a QoS 0 publish is done once it is written, the next one may go */
+    if (q0_publish) {
+      iotc_mqtt_logic_layer_run_pending_publishes(context);
+    }
+
+    return state;
   } else /* I left it for better code readability */
   {
+    const uint8_t q1_publish = is_q1_publish(task);
+
     /* detach the task from the qos 1 and 2 queue */
-    IOTC_LIST_DROP(iotc_mqtt_logic_task_t, layer_data->q12_tasks_queue, task);
+    iotc_mqtt_logic_task_queue_drop(&layer_data->q12_tasks_queue, task);
 
     /* release task's memory */
     iotc_mqtt_logic_free_task(&task);
+
+    /* its place in the publish window goes to the next queued publish */
+    if (q1_publish) {
+      assert(0 < layer_data->q1_in_flight_count);
+      --layer_data->q1_in_flight_count;
+
+      iotc_mqtt_logic_layer_run_pending_publishes(context);
+    }
   }
 
   return IOTC_STATE_OK;
@@ -23,6 +23,7 @@
 #include "iotc_layer_api.h"
 #include "iotc_list.h"
 #include "iotc_mqtt_logic_layer_data.h"
+#include "iotc_mqtt_logic_task_queue.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +34,15 @@ iotc_state_t iotc_mqtt_logic_layer_finalize_task(
 
 iotc_state_t iotc_mqtt_logic_layer_run_next_q0_task(void* data);
 
+iotc_state_t iotc_mqtt_logic_layer_schedule_publish(
+    iotc_layer_connectivity_t* context, iotc_mqtt_logic_task_t* task);
+
+void iotc_mqtt_logic_layer_run_pending_publishes(
+    iotc_layer_connectivity_t* context);
+
+void iotc_mqtt_logic_layer_publish_written(iotc_layer_connectivity_t* context,
+                                           iotc_mqtt_logic_task_t* task);
+
 void iotc_mqtt_logic_task_defer_users_callback(void* context,
                                                iotc_mqtt_logic_task_t* task,
                                                iotc_state_t state);
@@ -98,8 +108,18 @@ static inline void set_new_context_and_call_resend(iotc_mqtt_logic_task_t* task,
   }
 }
 
-static inline iotc_state_t run_task(iotc_layer_connectivity_t* context,
-                                    iotc_mqtt_logic_task_t* task) {
+/* QoS 1 publishes are the ones held back by the publish window */
+static inline uint8_t is_q1_publish(const iotc_mqtt_logic_task_t* task) {
+  return IOTC_MQTT_PUBLISH == task->data.mqtt_settings.scenario &&
+         IOTC_MQTT_QOS_AT_LEAST_ONCE == task->data.mqtt_settings.qos;
+}
+
+/* Starts a task, publishes come here once the publish queue lets them go.
+ * Returns IOTC_STATE_OK unless a QoS 1 or 2 task could not be accepted, in
+ * which case the task has been freed. IOTC_NO_MORE_RESOURCE_AVAILABLE means
+ * that all 65535 message ids are in flight. */
+static inline iotc_state_t dispatch_task(iotc_layer_connectivity_t* context,
+                                         iotc_mqtt_logic_task_t* task) {
   /* PRECONDITION */
   assert(context != 0);
   assert(task != 0);
@@ -111,6 +131,11 @@ static inline iotc_state_t run_task(iotc_layer_connectivity_t* context,
       IOTC_MQTT_QOS_AT_MOST_ONCE) /* qos zero tasks
                                    * must be enqued */
   {
+    /* a QoS 0 publish is finalized as soon as it is written */
+    if (IOTC_MQTT_PUBLISH == task->data.mqtt_settings.scenario) {
+      layer_data->publish_unwritten = task;
+    }
+
     /* task on qos0 can be prioritized */
     switch (task->priority) {
       case IOTC_MQTT_LOGIC_TASK_NORMAL:
@@ -127,38 +152,77 @@ static inline iotc_state_t run_task(iotc_layer_connectivity_t* context,
       return iotc_mqtt_logic_layer_run_next_q0_task(context);
     }
   } else {
+    iotc_context_data_t* context_data = IOTC_CONTEXT_DATA(context);
+
     /* generate the new id this id will be used to communicate with the server
-     * and to demultiplex msgs */
-    task->msg_id = ++layer_data->last_msg_id;
-
-#ifdef IOTC_DEBUG_EXTRA_INFO
-    iotc_mqtt_logic_task_t* needle = NULL;
-    IOTC_LIST_FIND(iotc_mqtt_logic_task_t, layer_data->q12_tasks_queue,
-                   CMP_TASK_MSG_ID,
-                   task->msg_id, /* this is linear search so we have O(n)
-                                    complexity it can be optimized but for the
-                                    small n it is acceptable complexity */
-                   needle);
-    assert(NULL == needle && "task with the same id already exist");
-#endif
+     * and to demultiplex msgs, 0 is not a valid id and after a wrap around an
+     * id may still be in flight */
+    uint16_t attempts = 0;
+    for (;;) {
+      task->msg_id = ++layer_data->last_msg_id;
+
+      if (0 == task->msg_id) {
+        continue;
+      }
+
+      if (NULL == iotc_mqtt_logic_task_queue_find(&layer_data->q12_tasks_queue,
+                                                  task->msg_id)) {
+        break;
+      }
+
+      /* every valid id is in flight */
+      if (UINT16_MAX == ++attempts) {
+        iotc_mqtt_logic_free_task(&task);
+        return IOTC_NO_MORE_RESOURCE_AVAILABLE;
+      }
+    }
 
     /* add it to the queue which is really a multiplexer of message id's */
-    IOTC_LIST_PUSH_BACK(iotc_mqtt_logic_task_t, layer_data->q12_tasks_queue,
-                        task);
+    iotc_state_t state = iotc_mqtt_logic_task_queue_push_back(
+        &layer_data->q12_tasks_queue, task);
 
-    /* execute it immediately
+    if (IOTC_STATE_OK != state) {
+      iotc_mqtt_logic_free_task(&task);
+      return state;
+    }
+
+    if (is_q1_publish(task)) {
+      ++layer_data->q1_in_flight_count;
+    }
+
+    /* execute it immediately, a failure reaches the task's callback
      * @TODO concider a different strategy of execution in order to minimize the
      * device overload we could execute only a certain amount per one loop
      *  but let's keep it simple for now */
-    if (IOTC_CONTEXT_DATA(context)->connection_data->connection_state ==
+    if (context_data->connection_data->connection_state ==
         IOTC_CONNECTION_STATE_OPENED) {
-      return iotc_evtd_execute_handle(&task->logic);
+      if (is_q1_publish(task)) {
+        layer_data->publish_unwritten = task;
+      }
+
+      iotc_evtd_execute_handle(&task->logic);
     }
   }
 
   return IOTC_STATE_OK;
 }
 
+/* QoS 0 and 1 publishes wait in the publish queue, see
+ * iotc_mqtt_logic_layer_schedule_publish(). */
+static inline iotc_state_t run_task(iotc_layer_connectivity_t* context,
+                                    iotc_mqtt_logic_task_t* task) {
+  /* PRECONDITION */
+  assert(context != 0);
+  assert(task != 0);
+
+  if (IOTC_MQTT_PUBLISH == task->data.mqtt_settings.scenario &&
+      IOTC_MQTT_QOS_EXACTLY_ONCE != task->data.mqtt_settings.qos) {
+    return iotc_mqtt_logic_layer_schedule_publish(context, task);
+  }
+
+  return dispatch_task(context, task);
+}
+
 #ifdef __cplusplus
 }
 #endif
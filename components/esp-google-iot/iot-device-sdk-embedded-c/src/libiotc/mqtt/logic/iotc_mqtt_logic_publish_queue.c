@@ -0,0 +1,189 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_mqtt_logic_publish_queue.h"
+#include "iotc_config.h"
+#include "iotc_macros.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* an unknown class is treated as the lowest */
+static size_t iotc_mqtt_logic_publish_queue_class(
+    const iotc_mqtt_logic_task_t* task) {
+  return ((size_t)task->publish_priority < IOTC_MQTT_PRIORITY_COUNT)
+             ? (size_t)task->publish_priority
+             : IOTC_MQTT_PRIORITY_COUNT - 1;
+}
+
+static iotc_time_t iotc_mqtt_logic_publish_queue_max_wait(size_t priority) {
+  switch (priority) {
+    case IOTC_MQTT_PRIORITY_NORMAL:
+      return IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS;
+    case IOTC_MQTT_PRIORITY_BULK:
+      return IOTC_MQTT_PUBLISH_MAX_WAIT_BULK_MS;
+    default:
+      return 0;
+  }
+}
+
+static uint8_t iotc_mqtt_logic_publish_queue_can_start(
+    const iotc_mqtt_logic_task_t* task, uint8_t q1_blocked) {
+  return NULL != task &&
+         (0 == q1_blocked ||
+          IOTC_MQTT_QOS_AT_LEAST_ONCE != task->data.mqtt_settings.qos);
+}
+
+void iotc_mqtt_logic_publish_queue_push(iotc_mqtt_logic_publish_queue_t* queue,
+                                        iotc_mqtt_logic_task_t* task) {
+  assert(NULL != queue);
+  assert(NULL != task);
+
+  const size_t priority = iotc_mqtt_logic_publish_queue_class(task);
+
+  if (IOTC_MQTT_LOGIC_TASK_IMMEDIATE == task->priority) {
+    task->__next = queue->head[priority];
+    queue->head[priority] = task;
+
+    if (NULL == queue->tail[priority]) {
+      queue->tail[priority] = task;
+    }
+  } else {
+    task->__next = NULL;
+
+    if (NULL != queue->tail[priority]) {
+      queue->tail[priority]->__next = task;
+    } else {
+      queue->head[priority] = task;
+    }
+
+    queue->tail[priority] = task;
+  }
+
+  ++queue->count;
+}
+
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_publish_queue_pop(
+    iotc_mqtt_logic_publish_queue_t* queue, iotc_time_t now_ms,
+    uint8_t q1_blocked) {
+  assert(NULL != queue);
+
+  size_t picked = IOTC_MQTT_PRIORITY_COUNT;
+  size_t priority = 0;
+
+  for (; priority < IOTC_MQTT_PRIORITY_COUNT; ++priority) {
+    if (iotc_mqtt_logic_publish_queue_can_start(queue->head[priority],
+                                                q1_blocked)) {
+      picked = priority;
+      break;
+    }
+  }
+
+  if (IOTC_MQTT_PRIORITY_COUNT == picked) {
+    return NULL;
+  }
+
+  uint8_t aged = 0;
+
+  /* a class below the picked one may have waited too long */
+  if (0 == queue->last_pick_aged) {
+    for (priority = picked + 1; priority < IOTC_MQTT_PRIORITY_COUNT;
+         ++priority) {
+      const iotc_mqtt_logic_task_t* head = queue->head[priority];
+
+      if (iotc_mqtt_logic_publish_queue_can_start(head, q1_blocked) &&
+          now_ms - head->queued_time_ms >=
+              iotc_mqtt_logic_publish_queue_max_wait(priority)) {
+        picked = priority;
+        aged = 1;
+        break;
+      }
+    }
+  }
+
+  queue->last_pick_aged = aged;
+
+  iotc_mqtt_logic_task_t* task = queue->head[picked];
+
+  queue->head[picked] = task->__next;
+
+  if (NULL == queue->head[picked]) {
+    queue->tail[picked] = NULL;
+  }
+
+  task->__next = NULL;
+  --queue->count;
+
+  return task;
+}
+
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_publish_queue_detach(
+    iotc_mqtt_logic_publish_queue_t* queue) {
+  assert(NULL != queue);
+
+  iotc_mqtt_logic_task_t* list = NULL;
+  iotc_mqtt_logic_task_t* list_tail = NULL;
+  size_t priority = 0;
+
+  for (; priority < IOTC_MQTT_PRIORITY_COUNT; ++priority) {
+    if (NULL == queue->head[priority]) {
+      continue;
+    }
+
+    if (NULL != list_tail) {
+      list_tail->__next = queue->head[priority];
+    } else {
+      list = queue->head[priority];
+    }
+
+    list_tail = queue->tail[priority];
+  }
+
+  memset(queue, 0, sizeof(*queue));
+
+  return list;
+}
+
+void iotc_mqtt_logic_publish_queue_record_delay(
+    iotc_mqtt_publish_stats_t* stats, iotc_mqtt_priority_t priority,
+    iotc_time_t delay_ms) {
+  assert(NULL != stats);
+
+  if ((size_t)priority >= IOTC_MQTT_PRIORITY_COUNT) {
+    priority = IOTC_MQTT_PRIORITY_BULK;
+  }
+
+  const uint32_t delay = (uint32_t)IOTC_MAX(delay_ms, 0);
+
+  /* bucket i holds the delays below 16 << (2 * i) ms */
+  size_t bucket = 0;
+  while (bucket < IOTC_MQTT_QUEUE_DELAY_BUCKETS - 1 &&
+         delay >= ((uint32_t)16 << (2 * bucket))) {
+    ++bucket;
+  }
+
+  ++stats->queue_delay[priority][bucket];
+  stats->max_queue_delay_ms[priority] =
+      IOTC_MAX(stats->max_queue_delay_ms[priority], delay);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_MQTT_LOGIC_PUBLISH_QUEUE_H__
+#define __IOTC_MQTT_LOGIC_PUBLISH_QUEUE_H__
+
+#include <stdint.h>
+
+#include <iotc_mqtt.h>
+#include <iotc_time.h>
+
+#include "iotc_mqtt_logic_layer_data.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Publishes leave the queue in strict priority order, first in first out
+ * within a class. A normal or bulk publish which has waited longer than
+ * IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS or IOTC_MQTT_PUBLISH_MAX_WAIT_BULK_MS
+ * is taken ahead of the higher classes, but never twice in a row, so urgent
+ * publishes keep at least every other turn. */
+
+/**
+ * @brief Adds a publish to the list of its class.
+ *
+ * IOTC_MQTT_LOGIC_TASK_IMMEDIATE tasks go to the front of their class.
+ */
+void iotc_mqtt_logic_publish_queue_push(iotc_mqtt_logic_publish_queue_t* queue,
+                                        iotc_mqtt_logic_task_t* task);
+
+/**
+ * @brief Takes the publish which is to be started next.
+ *
+ * @param now_ms the monotonic time in milliseconds, for the aging
+ * @param q1_blocked if set, a QoS 1 publish at the head of a class blocks
+ *        that class and the next class is tried
+ * @return the publish or NULL if none can be started
+ */
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_publish_queue_pop(
+    iotc_mqtt_logic_publish_queue_t* queue, iotc_time_t now_ms,
+    uint8_t q1_blocked);
+
+/**
+ * @brief Empties the queue.
+ *
+ * @return the publishes as a list linked through __next, urgent ones first
+ */
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_publish_queue_detach(
+    iotc_mqtt_logic_publish_queue_t* queue);
+
+/**
+ * @brief Adds the time a publish spent in the queue to the histogram and the
+ * maximum of its class.
+ */
+void iotc_mqtt_logic_publish_queue_record_delay(
+    iotc_mqtt_publish_stats_t* stats, iotc_mqtt_priority_t priority,
+    iotc_time_t delay_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_MQTT_LOGIC_PUBLISH_QUEUE_H__ */
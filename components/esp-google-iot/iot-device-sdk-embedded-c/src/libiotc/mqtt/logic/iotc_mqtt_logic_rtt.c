@@ -0,0 +1,99 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_mqtt_logic_rtt.h"
+#include "iotc_config.h"
+#include "iotc_macros.h"
+
+#include <assert.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The event dispatcher counts in seconds, a finer variation term would only
+ * fire the timeout before the PUBACK could have been seen. */
+#define IOTC_MQTT_LOGIC_RTT_CLOCK_GRANULARITY_MS 1000
+
+void iotc_mqtt_logic_rtt_reset(iotc_mqtt_publish_stats_t* stats) {
+  assert(NULL != stats);
+
+  stats->srtt_ms = 0;
+  stats->rttvar_ms = 0;
+  stats->rto_ms = IOTC_MQTT_PUBACK_RTO_INITIAL_MS;
+}
+
+void iotc_mqtt_logic_rtt_sample(iotc_mqtt_publish_stats_t* stats,
+                                iotc_time_t rtt_ms) {
+  assert(NULL != stats);
+
+  if (rtt_ms < 0) {
+    return;
+  }
+
+  const uint32_t rtt = (uint32_t)IOTC_MIN(rtt_ms, IOTC_MQTT_PUBACK_RTO_MAX_MS);
+
+  if (0 == stats->rtt_samples || rtt < stats->min_rtt_ms) {
+    stats->min_rtt_ms = rtt;
+  }
+
+  stats->max_rtt_ms = IOTC_MAX(stats->max_rtt_ms, rtt);
+  stats->last_rtt_ms = rtt;
+  ++stats->rtt_samples;
+
+  if (0 == stats->srtt_ms) {
+    /* first sample of the connection */
+    stats->srtt_ms = IOTC_MAX(rtt, 1);
+    stats->rttvar_ms = rtt / 2;
+  } else {
+    const uint32_t delta = stats->srtt_ms > rtt ? stats->srtt_ms - rtt
+                                                : rtt - stats->srtt_ms;
+
+    /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R */
+    stats->rttvar_ms = (3 * stats->rttvar_ms + delta) / 4;
+    stats->srtt_ms = IOTC_MAX((7 * stats->srtt_ms + rtt) / 8, 1);
+  }
+
+  const uint32_t rto =
+      stats->srtt_ms +
+      IOTC_MAX(IOTC_MQTT_LOGIC_RTT_CLOCK_GRANULARITY_MS, 4 * stats->rttvar_ms);
+
+  stats->rto_ms = IOTC_MIN(IOTC_MAX(rto, IOTC_MQTT_PUBACK_RTO_MIN_MS),
+                           IOTC_MQTT_PUBACK_RTO_MAX_MS);
+}
+
+iotc_time_t iotc_mqtt_logic_rtt_timeout(const iotc_mqtt_publish_stats_t* stats,
+                                        uint8_t resend_count) {
+  assert(NULL != stats);
+
+  iotc_time_t timeout_ms =
+      0 != stats->rto_ms ? stats->rto_ms : IOTC_MQTT_PUBACK_RTO_INITIAL_MS;
+
+  /* exponential backoff, stops doubling once the cap is reached */
+  for (; resend_count > 0 && timeout_ms < IOTC_MQTT_PUBACK_RTO_MAX_MS;
+       --resend_count) {
+    timeout_ms *= 2;
+  }
+
+  timeout_ms = IOTC_MIN(timeout_ms, IOTC_MQTT_PUBACK_RTO_MAX_MS);
+
+  /* rounded up, a timeout of 0 would fire right away */
+  return IOTC_MAX((timeout_ms + 999) / 1000, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
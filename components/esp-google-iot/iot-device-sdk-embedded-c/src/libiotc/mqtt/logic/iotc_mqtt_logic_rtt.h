@@ -0,0 +1,59 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_MQTT_LOGIC_RTT_H__
+#define __IOTC_MQTT_LOGIC_RTT_H__
+
+#include <stdint.h>
+
+#include <iotc_mqtt.h>
+#include <iotc_time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* PUBACK round trip estimation after RFC 6298. The estimator state is kept
+ * in the srtt_ms, rttvar_ms and rto_ms members of the publish stats. */
+
+/**
+ * @brief Forgets the round trip estimate, the counters are kept.
+ */
+void iotc_mqtt_logic_rtt_reset(iotc_mqtt_publish_stats_t* stats);
+
+/**
+ * @brief Adds a round trip sample and updates the timeout.
+ *
+ * Samples must only be taken from publishes which were sent once.
+ */
+void iotc_mqtt_logic_rtt_sample(iotc_mqtt_publish_stats_t* stats,
+                                iotc_time_t rtt_ms);
+
+/**
+ * @brief Gets the PUBACK timeout of a publish.
+ *
+ * @param resend_count how often the publish timed out so far, the timeout is
+ *        doubled for each
+ * @return the timeout in seconds, the unit of the event dispatcher
+ */
+iotc_time_t iotc_mqtt_logic_rtt_timeout(const iotc_mqtt_publish_stats_t* stats,
+                                        uint8_t resend_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_MQTT_LOGIC_RTT_H__ */
@@ -0,0 +1,238 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_mqtt_logic_task_queue.h"
+#include "iotc_allocator.h"
+#include "iotc_macros.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOTC_MQTT_LOGIC_TASK_QUEUE_MIN_INDEX_SIZE 16
+
+/* Message ids are handed out in sequence, so the id itself spreads the tasks
+ * evenly over the table. */
+static size_t iotc_mqtt_logic_task_queue_home(
+    const iotc_mqtt_logic_task_queue_t* queue, uint16_t msg_id) {
+  return msg_id & (queue->index_size - 1);
+}
+
+static void iotc_mqtt_logic_task_queue_index_insert(
+    iotc_mqtt_logic_task_queue_t* queue, iotc_mqtt_logic_task_t* task) {
+  size_t i = iotc_mqtt_logic_task_queue_home(queue, task->msg_id);
+
+  while (NULL != queue->index[i]) {
+    i = (i + 1) & (queue->index_size - 1);
+  }
+
+  queue->index[i] = task;
+}
+
+/* Keeps the table at most half full, so that probe sequences stay short. */
+static iotc_state_t iotc_mqtt_logic_task_queue_reserve(
+    iotc_mqtt_logic_task_queue_t* queue, size_t count) {
+  if (count * 2 <= queue->index_size) {
+    return IOTC_STATE_OK;
+  }
+
+  size_t new_size = queue->index_size ? queue->index_size * 2
+                                      : IOTC_MQTT_LOGIC_TASK_QUEUE_MIN_INDEX_SIZE;
+  while (count * 2 > new_size) {
+    new_size *= 2;
+  }
+
+  iotc_mqtt_logic_task_t** new_index = (iotc_mqtt_logic_task_t**)iotc_calloc(
+      new_size, sizeof(iotc_mqtt_logic_task_t*));
+
+  if (NULL == new_index) {
+    return IOTC_OUT_OF_MEMORY;
+  }
+
+  iotc_mqtt_logic_task_t** old_index = queue->index;
+  size_t old_size = queue->index_size;
+
+  queue->index = new_index;
+  queue->index_size = new_size;
+
+  size_t i = 0;
+  for (; i < old_size; ++i) {
+    if (NULL != old_index[i]) {
+      iotc_mqtt_logic_task_queue_index_insert(queue, old_index[i]);
+    }
+  }
+
+  IOTC_SAFE_FREE(old_index);
+
+  return IOTC_STATE_OK;
+}
+
+/* Backward shift deletion, entries behind the removed one are moved up unless
+ * that would put them in front of their home slot. No tombstones are left, so
+ * lookups never get slower. */
+static void iotc_mqtt_logic_task_queue_index_remove(
+    iotc_mqtt_logic_task_queue_t* queue, iotc_mqtt_logic_task_t* task) {
+  const size_t mask = queue->index_size - 1;
+  size_t i = iotc_mqtt_logic_task_queue_home(queue, task->msg_id);
+
+  while (queue->index[i] != task) {
+    if (NULL == queue->index[i]) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+
+    if (NULL == queue->index[j]) {
+      break;
+    }
+
+    const size_t home =
+        iotc_mqtt_logic_task_queue_home(queue, queue->index[j]->msg_id);
+
+    /* distance from the home slot is compared modulo the table size */
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      queue->index[i] = queue->index[j];
+      i = j;
+    }
+  }
+
+  queue->index[i] = NULL;
+}
+
+iotc_state_t iotc_mqtt_logic_task_queue_push_back(
+    iotc_mqtt_logic_task_queue_t* queue, iotc_mqtt_logic_task_t* task) {
+  /* PRE-CONDITIONS */
+  assert(NULL != queue);
+  assert(NULL != task);
+
+  iotc_state_t state = iotc_mqtt_logic_task_queue_reserve(queue, queue->count + 1);
+
+  if (IOTC_STATE_OK != state) {
+    return state;
+  }
+
+  iotc_mqtt_logic_task_queue_index_insert(queue, task);
+
+  task->__next = NULL;
+  task->__prev = queue->tail;
+
+  if (NULL != queue->tail) {
+    queue->tail->__next = task;
+  } else {
+    queue->head = task;
+  }
+
+  queue->tail = task;
+  ++queue->count;
+
+  return IOTC_STATE_OK;
+}
+
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_task_queue_find(
+    const iotc_mqtt_logic_task_queue_t* queue, uint16_t msg_id) {
+  assert(NULL != queue);
+
+  if (0 == queue->index_size) {
+    return NULL;
+  }
+
+  size_t i = iotc_mqtt_logic_task_queue_home(queue, msg_id);
+
+  while (NULL != queue->index[i]) {
+    if (queue->index[i]->msg_id == msg_id) {
+      return queue->index[i];
+    }
+    i = (i + 1) & (queue->index_size - 1);
+  }
+
+  return NULL;
+}
+
+void iotc_mqtt_logic_task_queue_drop(iotc_mqtt_logic_task_queue_t* queue,
+                                     iotc_mqtt_logic_task_t* task) {
+  assert(NULL != queue);
+  assert(NULL != task);
+
+  if (task != queue->head && NULL == task->__prev) {
+    return;
+  }
+
+  iotc_mqtt_logic_task_queue_index_remove(queue, task);
+
+  if (NULL != task->__prev) {
+    task->__prev->__next = task->__next;
+  } else {
+    queue->head = task->__next;
+  }
+
+  if (NULL != task->__next) {
+    task->__next->__prev = task->__prev;
+  } else {
+    queue->tail = task->__prev;
+  }
+
+  task->__next = NULL;
+  task->__prev = NULL;
+  --queue->count;
+}
+
+iotc_state_t iotc_mqtt_logic_task_queue_append_list(
+    iotc_mqtt_logic_task_queue_t* queue, iotc_mqtt_logic_task_t** list) {
+  assert(NULL != queue);
+  assert(NULL != list);
+
+  while (NULL != *list) {
+    iotc_mqtt_logic_task_t* task = *list;
+    iotc_mqtt_logic_task_t* next = task->__next;
+
+    iotc_state_t state = iotc_mqtt_logic_task_queue_push_back(queue, task);
+
+    if (IOTC_STATE_OK != state) {
+      return state;
+    }
+
+    *list = next;
+  }
+
+  return IOTC_STATE_OK;
+}
+
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_task_queue_detach(
+    iotc_mqtt_logic_task_queue_t* queue) {
+  assert(NULL != queue);
+
+  iotc_mqtt_logic_task_t* list = queue->head;
+  iotc_mqtt_logic_task_t* task = list;
+
+  for (; NULL != task; task = task->__next) {
+    task->__prev = NULL;
+  }
+
+  IOTC_SAFE_FREE(queue->index);
+  memset(queue, 0, sizeof(*queue));
+
+  return list;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,82 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_MQTT_LOGIC_TASK_QUEUE_H__
+#define __IOTC_MQTT_LOGIC_TASK_QUEUE_H__
+
+#include <stdint.h>
+
+#include "iotc_error.h"
+#include "iotc_mqtt_logic_layer_data.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The tasks are kept in a doubly linked list through their __next and __prev
+ * members, so the queue can be walked with the IOTC_LIST macros starting at
+ * head. The index is an open addressed table of task pointers keyed by
+ * msg_id. It grows with the queue and is released by
+ * iotc_mqtt_logic_task_queue_detach(). */
+
+/**
+ * @brief Appends a task to the queue.
+ *
+ * @retval IOTC_STATE_OK
+ * @retval IOTC_OUT_OF_MEMORY if the index could not grow, the task is not
+ *         queued
+ */
+iotc_state_t iotc_mqtt_logic_task_queue_push_back(
+    iotc_mqtt_logic_task_queue_t* queue, iotc_mqtt_logic_task_t* task);
+
+/**
+ * @brief Looks up the task with the given message id.
+ *
+ * @return the task or NULL if there is none
+ */
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_task_queue_find(
+    const iotc_mqtt_logic_task_queue_t* queue, uint16_t msg_id);
+
+/**
+ * @brief Removes a task from the queue, does nothing if it is not queued.
+ */
+void iotc_mqtt_logic_task_queue_drop(iotc_mqtt_logic_task_queue_t* queue,
+                                     iotc_mqtt_logic_task_t* task);
+
+/**
+ * @brief Appends a list of tasks linked through __next, keeping their order.
+ *
+ * On failure the tasks which could not be queued are left in the list.
+ *
+ * @retval IOTC_STATE_OK
+ * @retval IOTC_OUT_OF_MEMORY
+ */
+iotc_state_t iotc_mqtt_logic_task_queue_append_list(
+    iotc_mqtt_logic_task_queue_t* queue, iotc_mqtt_logic_task_t** list);
+
+/**
+ * @brief Empties the queue and releases the index.
+ *
+ * @return the tasks as a list linked through __next, in queue order
+ */
+iotc_mqtt_logic_task_t* iotc_mqtt_logic_task_queue_detach(
+    iotc_mqtt_logic_task_queue_t* queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_MQTT_LOGIC_TASK_QUEUE_H__ */
@@ -0,0 +1,338 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_mqtt_logic_topic_trie.h"
+#include "iotc_allocator.h"
+#include "iotc_macros.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOTC_MQTT_LOGIC_TOPIC_TRIE_MIN_INDEX_SIZE 16
+
+typedef iotc_mqtt_logic_topic_trie_node_t node_t;
+
+/* FNV-1a over the level, seeded with the parent so that equal levels under
+ * different parents land in different slots. */
+static uint32_t iotc_mqtt_logic_topic_trie_hash(const node_t* parent,
+                                                const char* level,
+                                                size_t length) {
+  uint32_t hash = 2166136261u ^ (uint32_t)(uintptr_t)parent;
+  size_t i = 0;
+
+  for (; i < length; ++i) {
+    hash ^= (uint8_t)level[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+static const char* iotc_mqtt_logic_topic_trie_level_end(const char* level,
+                                                        const char* end) {
+  const char* separator = (const char*)memchr(level, '/', end - level);
+
+  return NULL != separator ? separator : end;
+}
+
+static node_t* iotc_mqtt_logic_topic_trie_find(
+    const iotc_mqtt_logic_topic_trie_t* trie, const node_t* parent,
+    const char* level, size_t length) {
+  if (0 == trie->index_size) {
+    return NULL;
+  }
+
+  const uint32_t hash = iotc_mqtt_logic_topic_trie_hash(parent, level, length);
+  const size_t mask = trie->index_size - 1;
+  size_t i = hash & mask;
+
+  while (NULL != trie->index[i]) {
+    node_t* node = trie->index[i];
+
+    if (node->hash == hash && node->parent == parent &&
+        node->level_length == length &&
+        0 == memcmp(node->level, level, length)) {
+      return node;
+    }
+
+    i = (i + 1) & mask;
+  }
+
+  return NULL;
+}
+
+static void iotc_mqtt_logic_topic_trie_index_insert(
+    iotc_mqtt_logic_topic_trie_t* trie, node_t* node) {
+  size_t i = node->hash & (trie->index_size - 1);
+
+  while (NULL != trie->index[i]) {
+    i = (i + 1) & (trie->index_size - 1);
+  }
+
+  trie->index[i] = node;
+}
+
+/* Keeps the table at most half full, so that probe sequences stay short. */
+static iotc_state_t iotc_mqtt_logic_topic_trie_reserve(
+    iotc_mqtt_logic_topic_trie_t* trie, size_t count) {
+  if (count * 2 <= trie->index_size) {
+    return IOTC_STATE_OK;
+  }
+
+  size_t new_size = trie->index_size ? trie->index_size * 2
+                                     : IOTC_MQTT_LOGIC_TOPIC_TRIE_MIN_INDEX_SIZE;
+  while (count * 2 > new_size) {
+    new_size *= 2;
+  }
+
+  node_t** new_index = (node_t**)iotc_calloc(new_size, sizeof(node_t*));
+
+  if (NULL == new_index) {
+    return IOTC_OUT_OF_MEMORY;
+  }
+
+  node_t** old_index = trie->index;
+  size_t old_size = trie->index_size;
+
+  trie->index = new_index;
+  trie->index_size = new_size;
+
+  size_t i = 0;
+  for (; i < old_size; ++i) {
+    if (NULL != old_index[i]) {
+      iotc_mqtt_logic_topic_trie_index_insert(trie, old_index[i]);
+    }
+  }
+
+  IOTC_SAFE_FREE(old_index);
+
+  return IOTC_STATE_OK;
+}
+
+static node_t* iotc_mqtt_logic_topic_trie_add(
+    iotc_mqtt_logic_topic_trie_t* trie, const node_t* parent,
+    const char* level, size_t length) {
+  if (IOTC_STATE_OK !=
+      iotc_mqtt_logic_topic_trie_reserve(trie, trie->node_count + 1)) {
+    return NULL;
+  }
+
+  node_t* node = (node_t*)iotc_alloc(sizeof(node_t) + length);
+
+  if (NULL == node) {
+    return NULL;
+  }
+
+  node->parent = parent;
+  node->value = NULL;
+  node->hash = iotc_mqtt_logic_topic_trie_hash(parent, level, length);
+  node->level_length = (uint16_t)length;
+  node->level = (char*)(node + 1);
+  memcpy(node->level, level, length);
+
+  iotc_mqtt_logic_topic_trie_index_insert(trie, node);
+  ++trie->node_count;
+
+  return node;
+}
+
+static int iotc_mqtt_logic_topic_trie_valid_filter(const char* filter,
+                                                   const char* end) {
+  const char* level = filter;
+
+  for (;;) {
+    const char* stop = iotc_mqtt_logic_topic_trie_level_end(level, end);
+    const size_t length = stop - level;
+
+    if (UINT16_MAX < length) {
+      return 0;
+    }
+
+    if (NULL != memchr(level, '+', length) ||
+        NULL != memchr(level, '#', length)) {
+      if (1 != length || ('#' == *level && stop != end)) {
+        return 0;
+      }
+    }
+
+    if (stop == end) {
+      return 1;
+    }
+
+    level = stop + 1;
+  }
+}
+
+iotc_mqtt_logic_topic_trie_t* iotc_mqtt_logic_topic_trie_create(void) {
+  return (iotc_mqtt_logic_topic_trie_t*)iotc_calloc(
+      1, sizeof(iotc_mqtt_logic_topic_trie_t));
+}
+
+void iotc_mqtt_logic_topic_trie_destroy(iotc_mqtt_logic_topic_trie_t** trie,
+                                        void (*release)(void* value)) {
+  if (NULL == trie || NULL == *trie) {
+    return;
+  }
+
+  size_t i = 0;
+  for (; i < (*trie)->index_size; ++i) {
+    node_t* node = (*trie)->index[i];
+
+    if (NULL == node) {
+      continue;
+    }
+
+    if (NULL != node->value && NULL != release) {
+      release(node->value);
+    }
+
+    IOTC_SAFE_FREE(node);
+  }
+
+  IOTC_SAFE_FREE((*trie)->index);
+  IOTC_SAFE_FREE(*trie);
+}
+
+iotc_state_t iotc_mqtt_logic_topic_trie_insert(
+    iotc_mqtt_logic_topic_trie_t* trie, const char* filter, void* value,
+    void** replaced) {
+  /* PRE-CONDITIONS */
+  assert(NULL != trie);
+  assert(NULL != value);
+  assert(NULL != replaced);
+
+  *replaced = NULL;
+
+  if (NULL == filter || '\0' == *filter) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  const char* end = filter + strlen(filter);
+
+  /* checked up front, so that a filter which is refused adds no nodes */
+  if (!iotc_mqtt_logic_topic_trie_valid_filter(filter, end)) {
+    return IOTC_INVALID_PARAMETER;
+  }
+
+  const node_t* parent = NULL;
+  const char* level = filter;
+
+  for (;;) {
+    const char* stop = iotc_mqtt_logic_topic_trie_level_end(level, end);
+    node_t* node =
+        iotc_mqtt_logic_topic_trie_find(trie, parent, level, stop - level);
+
+    if (NULL == node) {
+      node = iotc_mqtt_logic_topic_trie_add(trie, parent, level, stop - level);
+
+      if (NULL == node) {
+        return IOTC_OUT_OF_MEMORY;
+      }
+    }
+
+    if (stop == end) {
+      *replaced = node->value;
+      node->value = value;
+
+      if (NULL == *replaced) {
+        ++trie->count;
+      }
+
+      return IOTC_STATE_OK;
+    }
+
+    parent = node;
+    level = stop + 1;
+  }
+}
+
+static void* iotc_mqtt_logic_topic_trie_match_level(
+    const iotc_mqtt_logic_topic_trie_t* trie, const node_t* parent,
+    const char* level, const char* end);
+
+/* Continues below a node which matched the level ending at stop. */
+static void* iotc_mqtt_logic_topic_trie_match_below(
+    const iotc_mqtt_logic_topic_trie_t* trie, const node_t* node,
+    const char* stop, const char* end) {
+  if (stop != end) {
+    return iotc_mqtt_logic_topic_trie_match_level(trie, node, stop + 1, end);
+  }
+
+  if (NULL != node->value) {
+    return node->value;
+  }
+
+  /* "a/#" matches "a" as well */
+  node = iotc_mqtt_logic_topic_trie_find(trie, node, "#", 1);
+
+  return NULL != node ? node->value : NULL;
+}
+
+/* Only a literal match which leads nowhere makes the search come back for
+ * '+', so for the usual sets of filters each level is looked at once. */
+static void* iotc_mqtt_logic_topic_trie_match_level(
+    const iotc_mqtt_logic_topic_trie_t* trie, const node_t* parent,
+    const char* level, const char* end) {
+  const char* stop = iotc_mqtt_logic_topic_trie_level_end(level, end);
+  const node_t* node =
+      iotc_mqtt_logic_topic_trie_find(trie, parent, level, stop - level);
+  void* value = NULL;
+
+  if (NULL != node) {
+    value = iotc_mqtt_logic_topic_trie_match_below(trie, node, stop, end);
+
+    if (NULL != value) {
+      return value;
+    }
+  }
+
+  if (NULL == parent && level < end && '$' == *level) {
+    return NULL;
+  }
+
+  node = iotc_mqtt_logic_topic_trie_find(trie, parent, "+", 1);
+
+  if (NULL != node) {
+    value = iotc_mqtt_logic_topic_trie_match_below(trie, node, stop, end);
+
+    if (NULL != value) {
+      return value;
+    }
+  }
+
+  node = iotc_mqtt_logic_topic_trie_find(trie, parent, "#", 1);
+
+  return NULL != node ? node->value : NULL;
+}
+
+void* iotc_mqtt_logic_topic_trie_match(const iotc_mqtt_logic_topic_trie_t* trie,
+                                       const char* topic, size_t topic_length) {
+  if (NULL == trie || NULL == topic || 0 == topic_length ||
+      0 == trie->count) {
+    return NULL;
+  }
+
+  return iotc_mqtt_logic_topic_trie_match_level(trie, NULL, topic,
+                                                topic + topic_length);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,98 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_MQTT_LOGIC_TOPIC_TRIE_H__
+#define __IOTC_MQTT_LOGIC_TOPIC_TRIE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "iotc_error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Subscription topic filters split at '/' into a tree of levels, with one
+ * value per filter. Every node is kept in a single open addressed table keyed
+ * by its parent and its level, so the child for a level of a topic is found
+ * with one hash of that level. Matching a topic hashes each of its levels
+ * once and allocates nothing. The '+' and '#' wildcards are ordinary levels of
+ * the tree which the matching looks up next to the literal one. */
+
+typedef struct iotc_mqtt_logic_topic_trie_node_s {
+  const struct iotc_mqtt_logic_topic_trie_node_s* parent; /* NULL at the top */
+  void* value; /* NULL if no filter ends here */
+  uint32_t hash;
+  uint16_t level_length;
+  char* level; /* allocated together with the node, not terminated */
+} iotc_mqtt_logic_topic_trie_node_t;
+
+typedef struct iotc_mqtt_logic_topic_trie_s {
+  iotc_mqtt_logic_topic_trie_node_t** index; /* linear probing */
+  size_t index_size; /* power of two, 0 until the first insert */
+  size_t node_count;
+  size_t count; /* values, i.e. distinct topic filters */
+} iotc_mqtt_logic_topic_trie_t;
+
+/**
+ * @brief Allocates an empty trie.
+ *
+ * @return the trie or NULL if out of memory
+ */
+iotc_mqtt_logic_topic_trie_t* iotc_mqtt_logic_topic_trie_create(void);
+
+/**
+ * @brief Releases the trie and passes each of its values to release.
+ *
+ * @param release may be NULL if the values are not owned by the trie
+ */
+void iotc_mqtt_logic_topic_trie_destroy(iotc_mqtt_logic_topic_trie_t** trie,
+                                        void (*release)(void* value));
+
+/**
+ * @brief Sets the value of a topic filter.
+ *
+ * The value an equal filter had before is handed back through replaced, the
+ * caller becomes its owner again.
+ *
+ * @retval IOTC_STATE_OK
+ * @retval IOTC_INVALID_PARAMETER if the filter is empty or has a wildcard
+ *         which is not a level of its own, or a '#' which is not the last level
+ * @retval IOTC_OUT_OF_MEMORY
+ */
+iotc_state_t iotc_mqtt_logic_topic_trie_insert(
+    iotc_mqtt_logic_topic_trie_t* trie, const char* filter, void* value,
+    void** replaced);
+
+/**
+ * @brief Finds the value of the filter matching a topic.
+ *
+ * If several filters match, the most specific one wins: at each level a
+ * literal match is preferred over '+' and '+' over '#'. Following the MQTT
+ * specification wildcards in the first level do not match topics starting
+ * with '$', and "a/#" matches "a" as well.
+ *
+ * @return the value or NULL if no filter matches
+ */
+void* iotc_mqtt_logic_topic_trie_match(const iotc_mqtt_logic_topic_trie_t* trie,
+                                       const char* topic, size_t topic_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_MQTT_LOGIC_TOPIC_TRIE_H__ */
@@ -106,12 +106,13 @@ IOTC_LAYER_TYPES_ADD(IOTC_LAYER_TYPE_IO, &iotc_io_dummy_layer_push,
         IOTC_DECLARE_LAYER_TYPES_END()
 
             static void iotc_inject_subscribe_handler(
-                iotc_vector_t** handler_vector,
+                iotc_mqtt_logic_topic_trie_t** handler_trie,
                 iotc_mqtt_task_specific_data_t* subs) {
   int i = 0;
+  void* replaced = NULL;
 
-  if (*handler_vector == NULL) {
-    *handler_vector = iotc_vector_create();
+  if (*handler_trie == NULL) {
+    *handler_trie = iotc_mqtt_logic_topic_trie_create();
   }
 
   while (subs[i].subscribe.topic != NULL) {
@@ -121,8 +122,8 @@ IOTC_LAYER_TYPES_ADD(IOTC_LAYER_TYPE_IO, &iotc_io_dummy_layer_push,
     memcpy(data, &subs[i], sizeof(subs[i]));
     data->subscribe.topic = iotc_str_dup(subs[i].subscribe.topic);
 
-    iotc_vector_push(*handler_vector,
-                     IOTC_VEC_VALUE_PARAM(IOTC_VEC_VALUE_PTR(data)));
+    iotc_mqtt_logic_topic_trie_insert(*handler_trie, data->subscribe.topic,
+                                      data, &replaced);
 
     i++;
   }
@@ -189,13 +190,13 @@ iotc_state_t iotc_mockfunction__layerfunction_init(void* context, void* data,
   if (mqtt_logic_layer_user_data != NULL) {
     /* printf("_init next layer handlers_for_topics = %p, size = %d\n",
         mqtt_logic_layer_user_data->handlers_for_topics,
-        mqtt_logic_layer_user_data->handlers_for_topics->elem_no); */
+        mqtt_logic_layer_user_data->handlers_for_topics->count); */
 
-    const iotc_vector_t* handlers_for_topics =
+    const iotc_mqtt_logic_topic_trie_t* handlers_for_topics =
         mqtt_logic_layer_user_data->handlers_for_topics;
 
     check_expected(handlers_for_topics);
-    check_expected(handlers_for_topics->elem_no);
+    check_expected(handlers_for_topics->count);
   }
 
   // extension related to the next phase of processing
@@ -224,13 +225,13 @@ iotc_state_t iotc_mockfunction__layerfunction_close(void* context, void* data,
   if (mqtt_logic_layer_user_data != NULL) {
     /* printf("_close next layer handlers_for_topics = %p, size = %d\n",
         mqtt_logic_layer_user_data->handlers_for_topics,
-        mqtt_logic_layer_user_data->handlers_for_topics->elem_no); */
+        mqtt_logic_layer_user_data->handlers_for_topics->count); */
 
-    const iotc_vector_t* handlers_for_topics =
+    const iotc_mqtt_logic_topic_trie_t* handlers_for_topics =
         mqtt_logic_layer_user_data->handlers_for_topics;
 
     check_expected(handlers_for_topics);
-    check_expected(handlers_for_topics->elem_no);
+    check_expected(handlers_for_topics->count);
   }
 
   return IOTC_PROCESS_CLOSE_EXTERNALLY_ON_THIS_LAYER(context, data,
@@ -287,7 +288,7 @@ void iotc_itest_test_valid_flow__handlers_vector_should_be_empty__init_with_clea
   expect_not_value(iotc_mockfunction__layerfunction_init, handlers_for_topics,
                    NULL);
   expect_value(iotc_mockfunction__layerfunction_init,
-               handlers_for_topics->elem_no, 0);
+               handlers_for_topics->count, 0);
   will_return(iotc_mockfunction__layerfunction_init, PROC_TYPE_DONT);
 
   iotc_itest_clean_session_act();
@@ -0,0 +1,354 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc.h"
+#include "iotc_event_dispatcher_api.h"
+#include "iotc_globals.h"
+#include "iotc_handle.h"
+#include "iotc_helpers.h"
+#include "iotc_mqtt_logic_layer_data_helpers.h"
+#include "iotc_user_sub_call_wrapper.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+
+#define IOTC_UTEST_QUEUED_PRODUCERS 8
+#define IOTC_UTEST_QUEUED_PER_PRODUCER 5000
+
+typedef struct iotc_utest_queued_producer_s {
+  pthread_t thread;
+  iotc_evtd_instance_t* evtd;
+  iotc_event_handle_queue_t* elems;
+  intptr_t next_expected; /* consumer side */
+  size_t executed;        /* consumer side */
+  size_t out_of_order;    /* consumer side */
+} iotc_utest_queued_producer_t;
+
+static iotc_state_t iotc_utest_queued_run(void* producer_arg,
+                                          void* sequence_arg) {
+  iotc_utest_queued_producer_t* producer =
+      (iotc_utest_queued_producer_t*)producer_arg;
+
+  if ((intptr_t)sequence_arg != producer->next_expected) {
+    ++producer->out_of_order;
+  }
+
+  producer->next_expected = (intptr_t)sequence_arg + 1;
+  ++producer->executed;
+
+  return IOTC_STATE_OK;
+}
+
+static void* iotc_utest_queued_producer(void* arg) {
+  iotc_utest_queued_producer_t* producer = (iotc_utest_queued_producer_t*)arg;
+  intptr_t sequence = 0;
+
+  for (; sequence < IOTC_UTEST_QUEUED_PER_PRODUCER; ++sequence) {
+    iotc_event_handle_queue_t* elem = &producer->elems[sequence];
+    elem->handle =
+        iotc_make_handle(&iotc_utest_queued_run, producer, (void*)sequence);
+
+    iotc_evtd_submit_queued(producer->evtd, elem);
+  }
+
+  return NULL;
+}
+
+/* The executor of the tests only keeps the job, the test decides where it
+ * runs. */
+static iotc_callback_job_t* iotc_utest_executor_job;
+static iotc_sub_call_type_t iotc_utest_executor_call_type;
+
+static void iotc_utest_executor(iotc_callback_job_t* job,
+                                iotc_sub_call_type_t call_type,
+                                void* executor_data) {
+  IOTC_UNUSED(executor_data);
+
+  iotc_utest_executor_job = job;
+  iotc_utest_executor_call_type = call_type;
+}
+
+static uint8_t iotc_utest_executor_takes_messages(
+    iotc_sub_call_type_t call_type, void* executor_data) {
+  IOTC_UNUSED(executor_data);
+
+  return IOTC_SUB_CALL_MESSAGE == call_type;
+}
+
+static void* iotc_utest_executor_worker(void* arg) {
+  IOTC_UNUSED(arg);
+
+  iotc_run_callback_job(iotc_utest_executor_job);
+
+  return NULL;
+}
+
+static int iotc_utest_executor_run_on_worker(void) {
+  pthread_t thread;
+
+  if (0 != pthread_create(&thread, NULL, &iotc_utest_executor_worker, NULL)) {
+    return 0;
+  }
+
+  pthread_join(thread, NULL);
+
+  return 1;
+}
+
+typedef struct iotc_utest_sub_call_s {
+  pthread_t thread;
+  iotc_sub_call_type_t call_type;
+  iotc_state_t state;
+  const uint8_t* payload;
+  size_t payload_length;
+  char topic[16];
+  void* user_data;
+  size_t calls;
+} iotc_utest_sub_call_t;
+
+static iotc_utest_sub_call_t iotc_utest_sub_call;
+
+static void iotc_utest_sub_callback(iotc_context_handle_t in_context_handle,
+                                    iotc_sub_call_type_t call_type,
+                                    const iotc_sub_call_params_t* const params,
+                                    iotc_state_t state, void* user_data) {
+  IOTC_UNUSED(in_context_handle);
+
+  iotc_utest_sub_call.thread = pthread_self();
+  iotc_utest_sub_call.call_type = call_type;
+  iotc_utest_sub_call.state = state;
+  iotc_utest_sub_call.user_data = user_data;
+  ++iotc_utest_sub_call.calls;
+
+  if (IOTC_SUB_CALL_MESSAGE == call_type) {
+    iotc_utest_sub_call.payload = params->message.temporary_payload_data;
+    iotc_utest_sub_call.payload_length =
+        params->message.temporary_payload_data_length;
+    strncpy(iotc_utest_sub_call.topic, params->message.topic,
+            sizeof(iotc_utest_sub_call.topic) - 1);
+  } else if (IOTC_SUB_CALL_SUBACK == call_type) {
+    strncpy(iotc_utest_sub_call.topic, params->suback.topic,
+            sizeof(iotc_utest_sub_call.topic) - 1);
+  }
+}
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_callback_executor)
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_evtd_submit_queued__many_producer_threads__each_runs_once_in_order,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_utest_queued_producer_t producers[IOTC_UTEST_QUEUED_PRODUCERS];
+      size_t i = 0;
+
+      memset(producers, 0, sizeof(producers));
+
+      iotc_evtd_instance_t* evtd = iotc_evtd_create_instance();
+      tt_ptr_op(NULL, !=, evtd);
+
+      for (; i < IOTC_UTEST_QUEUED_PRODUCERS; ++i) {
+        producers[i].evtd = evtd;
+        producers[i].elems = (iotc_event_handle_queue_t*)calloc(
+            IOTC_UTEST_QUEUED_PER_PRODUCER, sizeof(iotc_event_handle_queue_t));
+        tt_ptr_op(NULL, !=, producers[i].elems);
+        tt_int_op(0, ==, pthread_create(&producers[i].thread, NULL,
+                                        &iotc_utest_queued_producer,
+                                        &producers[i]));
+      }
+
+      /* nothing is refused however far the step falls behind */
+      for (i = 0; i < IOTC_UTEST_QUEUED_PRODUCERS; ++i) {
+        pthread_join(producers[i].thread, NULL);
+      }
+
+      iotc_evtd_step(evtd, 0);
+
+      for (i = 0; i < IOTC_UTEST_QUEUED_PRODUCERS; ++i) {
+        tt_int_op(producers[i].executed, ==, IOTC_UTEST_QUEUED_PER_PRODUCER);
+        tt_int_op(producers[i].out_of_order, ==, 0);
+      }
+
+    end:
+      iotc_evtd_destroy_instance(evtd);
+      for (i = 0; i < IOTC_UTEST_QUEUED_PRODUCERS; ++i) {
+        free(producers[i].elems);
+      }
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_user_sub_call_wrapper__executor_set__message_callback_runs_on_worker_with_received_payload,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_state_t local_state = IOTC_STATE_OK;
+      iotc_mqtt_message_t* msg = NULL;
+      iotc_data_desc_t* payload = NULL;
+      size_t heap_before = 0;
+      size_t heap_after = 0;
+      int task_data = 0;
+
+      memset(&iotc_utest_sub_call, 0, sizeof(iotc_utest_sub_call));
+      iotc_utest_executor_job = NULL;
+
+      iotc_context_handle_t iotc_context_handle = iotc_create_context();
+      tt_int_op(IOTC_INVALID_CONTEXT_HANDLE, <, iotc_context_handle);
+      iotc_context_t* iotc_context = iotc_object_for_handle(
+          iotc_globals.context_handles_vector, iotc_context_handle);
+
+      iotc_set_callback_executor(&iotc_utest_executor, NULL, NULL);
+
+      payload = iotc_make_desc_from_string_share("received payload");
+      iotc_get_heap_usage(&heap_before);
+
+      IOTC_ALLOC_AT(iotc_mqtt_message_t, msg, local_state);
+      tt_int_op(IOTC_STATE_OK, ==,
+                fill_with_publish_data(msg, "a/b", payload,
+                                       IOTC_MQTT_QOS_AT_LEAST_ONCE,
+                                       IOTC_MQTT_RETAIN_FALSE,
+                                       IOTC_MQTT_DUP_FALSE, 7));
+      const uint8_t* received = msg->publish.content->data_ptr;
+
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_user_sub_call_wrapper(iotc_context, msg, IOTC_STATE_OK,
+                                           &iotc_utest_sub_callback,
+                                           &iotc_utest_sub_call, &task_data));
+      msg = NULL; /* the wrapper owns it now */
+
+      /* handed over, not invoked */
+      tt_ptr_op(NULL, !=, iotc_utest_executor_job);
+      tt_int_op(IOTC_SUB_CALL_MESSAGE, ==, iotc_utest_executor_call_type);
+      tt_int_op(0, ==, iotc_utest_sub_call.calls);
+
+      tt_int_op(1, ==, iotc_utest_executor_run_on_worker());
+
+      tt_int_op(1, ==, iotc_utest_sub_call.calls);
+      tt_int_op(0, ==, pthread_equal(pthread_self(), iotc_utest_sub_call.thread));
+      tt_int_op(IOTC_SUB_CALL_MESSAGE, ==, iotc_utest_sub_call.call_type);
+      tt_ptr_op(&iotc_utest_sub_call, ==, iotc_utest_sub_call.user_data);
+      tt_str_op("a/b", ==, iotc_utest_sub_call.topic);
+      tt_ptr_op(received, ==, iotc_utest_sub_call.payload);
+      tt_int_op(strlen("received payload"), ==,
+                iotc_utest_sub_call.payload_length);
+
+      /* the worker gave the job back, the loop frees it with the message */
+      iotc_evtd_step(iotc_globals.evtd_instance, 0);
+
+      iotc_get_heap_usage(&heap_after);
+      tt_int_op(heap_before, ==, heap_after);
+
+    err_handling:
+    end:
+      iotc_set_callback_executor(NULL, NULL, NULL);
+      iotc_mqtt_message_free(&msg);
+      iotc_free_desc(&payload);
+      iotc_delete_context(iotc_context_handle);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_user_sub_call_wrapper__executor_set__failed_suback_keeps_its_topic,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_state_t local_state = IOTC_STATE_OK;
+
+      memset(&iotc_utest_sub_call, 0, sizeof(iotc_utest_sub_call));
+      iotc_utest_executor_job = NULL;
+
+      iotc_context_handle_t iotc_context_handle = iotc_create_context();
+      tt_int_op(IOTC_INVALID_CONTEXT_HANDLE, <, iotc_context_handle);
+      iotc_context_t* iotc_context = iotc_object_for_handle(
+          iotc_globals.context_handles_vector, iotc_context_handle);
+
+      iotc_set_callback_executor(&iotc_utest_executor, NULL, NULL);
+
+      IOTC_ALLOC(iotc_mqtt_task_specific_data_t, sub_data, local_state);
+      IOTC_CHECK_MEMORY(sub_data->subscribe.topic = iotc_str_dup("c/d"),
+                        local_state);
+
+      /* frees the subscription before the callback has run */
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_user_sub_call_wrapper(
+                    iotc_context, (void*)(intptr_t)IOTC_MQTT_SUBACK_FAILED,
+                    IOTC_MQTT_SUBSCRIPTION_FAILED, &iotc_utest_sub_callback,
+                    NULL, sub_data));
+      tt_int_op(IOTC_SUB_CALL_SUBACK, ==, iotc_utest_executor_call_type);
+
+      tt_int_op(1, ==, iotc_utest_executor_run_on_worker());
+
+      tt_int_op(1, ==, iotc_utest_sub_call.calls);
+      tt_int_op(IOTC_MQTT_SUBSCRIPTION_FAILED, ==, iotc_utest_sub_call.state);
+      tt_str_op("c/d", ==, iotc_utest_sub_call.topic);
+
+      iotc_evtd_step(iotc_globals.evtd_instance, 0);
+
+    err_handling:
+    end:
+      iotc_set_callback_executor(NULL, NULL, NULL);
+      iotc_delete_context(iotc_context_handle);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_user_sub_call_wrapper__executor_does_not_take_suback__runs_on_loop_without_job,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_state_t local_state = IOTC_STATE_OK;
+
+      memset(&iotc_utest_sub_call, 0, sizeof(iotc_utest_sub_call));
+      iotc_utest_executor_job = NULL;
+
+      iotc_context_handle_t iotc_context_handle = iotc_create_context();
+      tt_int_op(IOTC_INVALID_CONTEXT_HANDLE, <, iotc_context_handle);
+      iotc_context_t* iotc_context = iotc_object_for_handle(
+          iotc_globals.context_handles_vector, iotc_context_handle);
+
+      iotc_set_callback_executor(&iotc_utest_executor,
+                                 &iotc_utest_executor_takes_messages, NULL);
+
+      IOTC_ALLOC(iotc_mqtt_task_specific_data_t, sub_data, local_state);
+      IOTC_CHECK_MEMORY(sub_data->subscribe.topic = iotc_str_dup("e/f"),
+                        local_state);
+
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_user_sub_call_wrapper(
+                    iotc_context, (void*)(intptr_t)IOTC_MQTT_SUBACK_FAILED,
+                    IOTC_MQTT_SUBSCRIPTION_FAILED, &iotc_utest_sub_callback,
+                    NULL, sub_data));
+
+      /* invoked right here, the executor never saw it */
+      tt_ptr_op(NULL, ==, iotc_utest_executor_job);
+      tt_int_op(1, ==, iotc_utest_sub_call.calls);
+      tt_int_op(0, !=, pthread_equal(pthread_self(), iotc_utest_sub_call.thread));
+      tt_int_op(IOTC_SUB_CALL_SUBACK, ==, iotc_utest_sub_call.call_type);
+      tt_str_op("e/f", ==, iotc_utest_sub_call.topic);
+
+    err_handling:
+    end:
+      iotc_set_callback_executor(NULL, NULL, NULL);
+      iotc_delete_context(iotc_context_handle);
+    })
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
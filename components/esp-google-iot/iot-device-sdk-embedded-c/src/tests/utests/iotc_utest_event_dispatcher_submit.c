@@ -0,0 +1,365 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc.h"
+#include "iotc_bsp_time.h"
+#include "iotc_event_dispatcher_api.h"
+#include "iotc_event_handle_ring.h"
+#include "iotc_event_loop.h"
+#include "iotc_globals.h"
+#include "iotc_macros.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+
+#define IOTC_UTEST_SUBMIT_PRODUCERS 8
+#define IOTC_UTEST_SUBMIT_PER_PRODUCER 20000
+
+typedef struct iotc_utest_submit_producer_s {
+  pthread_t thread;
+  iotc_evtd_instance_t* evtd;
+  iotc_event_handle_ring_t* ring;
+  intptr_t next_expected; /* consumer side */
+  size_t executed;        /* consumer side */
+  size_t out_of_order;    /* consumer side */
+  size_t overflows;       /* producer side */
+} iotc_utest_submit_producer_t;
+
+static iotc_state_t iotc_utest_submit_run(void* producer_arg,
+                                          void* sequence_arg) {
+  iotc_utest_submit_producer_t* producer =
+      (iotc_utest_submit_producer_t*)producer_arg;
+
+  if ((intptr_t)sequence_arg != producer->next_expected) {
+    ++producer->out_of_order;
+  }
+
+  producer->next_expected = (intptr_t)sequence_arg + 1;
+  ++producer->executed;
+
+  return IOTC_STATE_OK;
+}
+
+static void* iotc_utest_submit_producer(void* arg) {
+  iotc_utest_submit_producer_t* producer = (iotc_utest_submit_producer_t*)arg;
+  intptr_t sequence = 0;
+
+  for (; sequence < IOTC_UTEST_SUBMIT_PER_PRODUCER; ++sequence) {
+    const iotc_event_handle_t handle =
+        iotc_make_handle(&iotc_utest_submit_run, producer, (void*)sequence);
+
+    while (IOTC_BUFFER_OVERFLOW ==
+           (NULL != producer->evtd
+                ? iotc_evtd_submit(producer->evtd, handle)
+                : iotc_event_handle_ring_push(producer->ring, &handle))) {
+      ++producer->overflows;
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static int iotc_utest_submit_start(iotc_utest_submit_producer_t* producers,
+                                   iotc_evtd_instance_t* evtd,
+                                   iotc_event_handle_ring_t* ring) {
+  memset(producers, 0,
+         sizeof(iotc_utest_submit_producer_t) * IOTC_UTEST_SUBMIT_PRODUCERS);
+
+  size_t i = 0;
+  for (; i < IOTC_UTEST_SUBMIT_PRODUCERS; ++i) {
+    producers[i].evtd = evtd;
+    producers[i].ring = ring;
+
+    if (0 != pthread_create(&producers[i].thread, NULL,
+                            &iotc_utest_submit_producer, &producers[i])) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static size_t iotc_utest_submit_executed(
+    const iotc_utest_submit_producer_t* producers) {
+  size_t executed = 0;
+
+  size_t i = 0;
+  for (; i < IOTC_UTEST_SUBMIT_PRODUCERS; ++i) {
+    executed += producers[i].executed;
+  }
+
+  return executed;
+}
+
+static int iotc_utest_submit_counter;
+
+static iotc_state_t iotc_utest_submit_count(void) {
+  ++iotc_utest_submit_counter;
+
+  return IOTC_STATE_OK;
+}
+
+static void* iotc_utest_submit_later(void* arg) {
+  usleep(100 * 1000);
+  iotc_evtd_submit((iotc_evtd_instance_t*)arg,
+                   iotc_make_handle(&iotc_utest_submit_count));
+
+  return NULL;
+}
+
+static int iotc_utest_submit_published;
+static int iotc_utest_submit_writable;
+
+static void iotc_utest_submit_on_publish(iotc_context_handle_t in_context_handle,
+                                         void* data, iotc_state_t state) {
+  IOTC_UNUSED(in_context_handle);
+  IOTC_UNUSED(data);
+  IOTC_UNUSED(state);
+
+  ++iotc_utest_submit_published;
+}
+
+static void iotc_utest_submit_on_writable(
+    iotc_context_handle_t in_context_handle, void* data, iotc_state_t state) {
+  IOTC_UNUSED(in_context_handle);
+  IOTC_UNUSED(data);
+
+  if (IOTC_STATE_OK == state) {
+    ++iotc_utest_submit_writable;
+  }
+}
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_event_dispatcher_submit)
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_event_handle_ring_push__many_producers__each_handle_popped_once_in_order,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_utest_submit_producer_t producers[IOTC_UTEST_SUBMIT_PRODUCERS];
+      iotc_event_handle_ring_t* ring = iotc_event_handle_ring_create(64);
+      tt_ptr_op(NULL, !=, ring);
+
+      tt_int_op(1, ==, iotc_utest_submit_start(producers, NULL, ring));
+
+      const size_t total =
+          IOTC_UTEST_SUBMIT_PRODUCERS * IOTC_UTEST_SUBMIT_PER_PRODUCER;
+      size_t popped = 0;
+      iotc_event_handle_t handle;
+
+      while (popped < total) {
+        if (iotc_event_handle_ring_pop(ring, &handle)) {
+          iotc_evtd_execute_handle(&handle);
+          ++popped;
+        } else {
+          sched_yield();
+        }
+      }
+
+      size_t i = 0;
+      for (; i < IOTC_UTEST_SUBMIT_PRODUCERS; ++i) {
+        pthread_join(producers[i].thread, NULL);
+        tt_int_op(producers[i].executed, ==, IOTC_UTEST_SUBMIT_PER_PRODUCER);
+        tt_int_op(producers[i].out_of_order, ==, 0);
+      }
+
+      tt_int_op(0, ==, iotc_event_handle_ring_pop(ring, &handle));
+
+    end:
+      iotc_event_handle_ring_destroy(&ring);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_evtd_submit__many_producer_threads__event_loop_runs_each_handle_once_in_order,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_utest_submit_producer_t producers[IOTC_UTEST_SUBMIT_PRODUCERS];
+      iotc_evtd_instance_t* evtd = iotc_evtd_create_instance();
+      tt_ptr_op(NULL, !=, evtd);
+
+      const iotc_time_t start_ms = iotc_bsp_time_getmonotonictime_milliseconds();
+
+      tt_int_op(1, ==, iotc_utest_submit_start(producers, evtd, NULL));
+
+      /* each iteration blocks in select until a producer wakes it up */
+      const size_t total =
+          IOTC_UTEST_SUBMIT_PRODUCERS * IOTC_UTEST_SUBMIT_PER_PRODUCER;
+      size_t iterations = 0;
+
+      while (iotc_utest_submit_executed(producers) < total &&
+             iotc_bsp_time_getmonotonictime_milliseconds() - start_ms <
+                 60 * 1000) {
+        iotc_event_loop_with_evtds(1, &evtd, 1);
+        ++iterations;
+      }
+
+      const iotc_time_t elapsed_ms =
+          iotc_bsp_time_getmonotonictime_milliseconds() - start_ms;
+
+      size_t overflows = 0;
+      size_t i = 0;
+      for (; i < IOTC_UTEST_SUBMIT_PRODUCERS; ++i) {
+        pthread_join(producers[i].thread, NULL);
+        tt_int_op(producers[i].executed, ==, IOTC_UTEST_SUBMIT_PER_PRODUCER);
+        tt_int_op(producers[i].out_of_order, ==, 0);
+        overflows += producers[i].overflows;
+      }
+
+      TT_BLATHER(("%u threads, %u submissions in %ld ms, %u loop iterations, "
+                  "%u times the ring was full",
+                  IOTC_UTEST_SUBMIT_PRODUCERS, (unsigned)total,
+                  (long)elapsed_ms, (unsigned)iterations,
+                  (unsigned)overflows));
+
+    end:
+      iotc_evtd_destroy_instance(evtd);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_evtd_submit__while_loop_waits_in_select__loop_wakes_up,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      pthread_t thread;
+      iotc_evtd_instance_t* evtd = iotc_evtd_create_instance();
+      tt_ptr_op(NULL, !=, evtd);
+
+      iotc_utest_submit_counter = 0;
+
+      /* a wakeup left over from before would only make this end sooner */
+      tt_int_op(0, ==, pthread_create(&thread, NULL, &iotc_utest_submit_later,
+                                      evtd));
+
+      const iotc_time_t start_ms = iotc_bsp_time_getmonotonictime_milliseconds();
+
+      /* without the wakeup each iteration waits for the idle timeout */
+      while (0 == iotc_utest_submit_counter &&
+             iotc_bsp_time_getmonotonictime_milliseconds() - start_ms <
+                 (IOTC_DEFAULT_IDLE_TIMEOUT + 1) * 1000) {
+        iotc_event_loop_with_evtds(1, &evtd, 1);
+      }
+
+      const iotc_time_t elapsed_ms =
+          iotc_bsp_time_getmonotonictime_milliseconds() - start_ms;
+
+      pthread_join(thread, NULL);
+
+      tt_int_op(iotc_utest_submit_counter, ==, 1);
+      tt_int_op(elapsed_ms, <, IOTC_DEFAULT_IDLE_TIMEOUT * 1000 / 2);
+
+    end:
+      iotc_evtd_destroy_instance(evtd);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_evtd_submit__ring_full__overflow_reported_and_pending_run_on_destroy,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_evtd_instance_t* evtd = iotc_evtd_create_instance();
+      tt_ptr_op(NULL, !=, evtd);
+
+      iotc_utest_submit_counter = 0;
+
+      size_t i = 0;
+      for (; i < IOTC_EVTD_SUBMISSION_RING_SIZE; ++i) {
+        tt_int_op(IOTC_STATE_OK, ==,
+                  iotc_evtd_submit(
+                      evtd, iotc_make_handle(&iotc_utest_submit_count)));
+      }
+
+      tt_int_op(IOTC_BUFFER_OVERFLOW, ==,
+                iotc_evtd_submit(evtd,
+                                 iotc_make_handle(&iotc_utest_submit_count)));
+
+      iotc_evtd_step(evtd, 0);
+      tt_int_op(iotc_utest_submit_counter, ==, IOTC_EVTD_SUBMISSION_RING_SIZE);
+
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_evtd_submit(evtd,
+                                 iotc_make_handle(&iotc_utest_submit_count)));
+
+    end:
+      iotc_evtd_destroy_instance(evtd);
+      tt_want_int_op(iotc_utest_submit_counter, ==,
+                     IOTC_EVTD_SUBMISSION_RING_SIZE + 1);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_submit_publish_data__queue_full__writable_callback_once_the_loop_took_them,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      const uint8_t payload[] = {0x42};
+      iotc_context_handle_t iotc_h = iotc_create_context();
+      tt_int_op(iotc_h, >, IOTC_INVALID_CONTEXT_HANDLE);
+
+      /* publishes to a context which does not exist are refused by the loop
+       * right away, through their callback */
+      const iotc_context_handle_t gone_h = iotc_h + 1;
+
+      iotc_utest_submit_published = 0;
+      iotc_utest_submit_writable = 0;
+
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_set_submit_writable_callback(
+                    iotc_h, &iotc_utest_submit_on_writable, NULL));
+
+      size_t i = 0;
+      for (; i < IOTC_EVTD_SUBMISSION_RING_SIZE; ++i) {
+        tt_int_op(IOTC_STATE_OK, ==,
+                  iotc_submit_publish_data(
+                      gone_h, "topic", payload, sizeof(payload),
+                      IOTC_MQTT_QOS_AT_LEAST_ONCE, IOTC_MQTT_PRIORITY_NORMAL,
+                      &iotc_utest_submit_on_publish, NULL));
+      }
+
+      tt_int_op(IOTC_SUBMIT_QUEUE_FULL, ==,
+                iotc_submit_publish_data(
+                    gone_h, "topic", payload, sizeof(payload),
+                    IOTC_MQTT_QOS_AT_LEAST_ONCE, IOTC_MQTT_PRIORITY_NORMAL,
+                    &iotc_utest_submit_on_publish, NULL));
+      tt_int_op(iotc_utest_submit_writable, ==, 0);
+
+      iotc_evtd_step(iotc_globals.evtd_instance, 0);
+      tt_int_op(iotc_utest_submit_published, ==,
+                IOTC_EVTD_SUBMISSION_RING_SIZE);
+      tt_int_op(iotc_utest_submit_writable, ==, 1);
+
+      /* nothing was refused since */
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_submit_publish_data(
+                    gone_h, "topic", payload, sizeof(payload),
+                    IOTC_MQTT_QOS_AT_LEAST_ONCE, IOTC_MQTT_PRIORITY_NORMAL,
+                    &iotc_utest_submit_on_publish, NULL));
+      iotc_evtd_step(iotc_globals.evtd_instance, 0);
+      tt_int_op(iotc_utest_submit_writable, ==, 1);
+
+    end:
+      iotc_set_submit_writable_callback(iotc_h, NULL, NULL);
+      iotc_delete_context(iotc_h);
+    })
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
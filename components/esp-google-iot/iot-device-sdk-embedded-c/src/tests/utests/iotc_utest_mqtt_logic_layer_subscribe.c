@@ -26,6 +26,7 @@
 #include "iotc_memory_checks.h"
 #include "iotc_mqtt_logic_layer_data.h"
 #include "iotc_mqtt_logic_layer_subscribe_command.h"
+#include "iotc_mqtt_logic_task_queue.h"
 #include "iotc_mqtt_message.h"
 #include "iotc_user_sub_call_wrapper.h"
 
@@ -73,84 +74,80 @@ static iotc_state_t failed_subscribe_handler(
   return IOTC_STATE_OK;
 }
 
-#endif
+static uint8_t granted_subacks = 0;
+static uint8_t failed_subacks = 0;
 
-IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_layer_subscribe)
+static iotc_state_t counting_subscribe_handler(
+    iotc_context_handle_t in_context_handle, iotc_sub_call_type_t call_type,
+    const iotc_sub_call_params_t* const params, iotc_state_t state,
+    void* user_data) {
+  IOTC_UNUSED(in_context_handle);
+  IOTC_UNUSED(params);
+  IOTC_UNUSED(user_data);
 
+  tt_want_int_op(call_type, ==, IOTC_SUB_CALL_SUBACK);
 
-IOTC_TT_TESTCASE(utest__match_topics__batch_tests, {
-  iotc_event_handle_t handle = iotc_make_empty_handle();
-
-  typedef struct {
-    char* subscription_topic;
-    const char* published_topic;
-    const uint8_t expected_result;
-  } iotc_match_topics_test_cases_t;
-
-  iotc_match_topics_test_cases_t test_cases[] = {
-    // non-wildcard tests
-    {"long_topic_name_same_length_1", "long_topic_name_same_length_2", 1},
-    {"long_topic_name_same_length_2", "long_topic_name_same_length_1", 1},
-    {"long_topic_name", "long_topic_name_different_length", 1},
-    {"long_topic_name_different_length", "short", 1},
-    {"t1", "t2", 1},
-    {"t", "t", 0},
-    {"t", "t/", 1},
-    {"t/subfolder", "t", 1},
-
-    // wildcard tests
-    {"t1/#", "t2", 1},
-    {"t/#", "t", 0},
-    {"t/#", "t/", 0},
-    {"t/#", "t/subfolder", 0},
-    {"t1/#", "t2/subfolder", 1},
-    {"multi/level/#", "multi/level", 0},
-    {"multi/level/#", "multi/level/", 0},
-    {"multi/level/#", "multi/level/topic", 0},
-    {"multi/level/#", "multi/level/topic/", 0},
-    {"multi/level/#", "multi/level/topic/name", 0},
-    {"multi/level/#", "multi/level/topic/name/", 0},
-    {"multi/level/#", "multi/leve", 1},
-    {"multi/level/#", "multi/level2", 1},
-    {"multi/level/#", "multi/level2/topic/name", 1},
-    {"multi/#", "multi/level/topic/name", 0},
-
-    // NULL cases
-    {NULL, "short", 1},
-    {"sub", NULL, 1},
-    {NULL, NULL, 1},
-    {"#", NULL, 1},
-    {"#", "", 1},
-    {"", "", 1},
-
-    // root wildcard tests
-    {"#", "t", 0},
-    {"#", "long_topic_name", 0},
-    {"#", "multi/level/topic/name", 0},
-  };
-
-  uint8_t i = 0;
-  for (; i < sizeof(test_cases) / sizeof(iotc_match_topics_test_cases_t); ++i) {
-    iotc_match_topics_test_cases_t* test_case = test_cases + i;
-    // printf("match publish topics with subscriptions, expected: %s, %s, %s\n",
-           // test_case->expected_result ? "MISMATCH" : "MATCH",
-           // test_case->subscription_topic,
-           // test_case->published_topic);
-
-    const size_t string_len = test_case->published_topic ? strlen(test_case->published_topic) : 0;
-
-    iotc_mqtt_task_specific_data_t spd = {.subscribe = {test_case->subscription_topic, handle, 0}};
-    iotc_data_desc_t data = {
-        (unsigned char*)test_case->published_topic, NULL, string_len, string_len, string_len,
-        IOTC_MEMORY_TYPE_UNMANAGED};
-
-    union iotc_vector_selector_u a = {&spd};
-    union iotc_vector_selector_u b = {&data};
-
-    tt_want_int_op(match_topics(&a, &b), ==, test_case->expected_result);
+  if (IOTC_MQTT_SUBSCRIPTION_SUCCESSFULL == state) {
+    ++granted_subacks;
+  } else {
+    ++failed_subacks;
   }
-})
 
+  return IOTC_STATE_OK;
+}
+
+static iotc_mqtt_task_specific_data_t* utest_make_subscription(
+    iotc_context_t* iotc_context, const char* topic) {
+  iotc_state_t local_state = IOTC_STATE_OK;
+
+  IOTC_ALLOC(iotc_mqtt_task_specific_data_t, data, local_state);
+  IOTC_CHECK_MEMORY(data->subscribe.topic = iotc_str_dup(topic), local_state);
+
+  data->subscribe.handler = iotc_make_threaded_handle(
+      IOTC_THREADID_THREAD_0, &iotc_user_sub_call_wrapper, iotc_context, NULL,
+      IOTC_STATE_OK, (void*)&counting_subscribe_handler, (void*)NULL,
+      (void*)data);
+
+  return data;
+
+err_handling:
+  if (NULL != data) {
+    iotc_mqtt_task_spec_data_free_subscribe_data(&data);
+  }
+  return NULL;
+}
+
+static iotc_sub_call_type_t stream_calls[8];
+static size_t stream_call_count = 0;
+static size_t stream_delivered = 0;
+static iotc_state_t stream_end_state = IOTC_STATE_OK;
+
+static void stream_subscribe_handler(iotc_context_handle_t in_context_handle,
+                                     iotc_sub_call_type_t call_type,
+                                     const iotc_sub_call_params_t* const params,
+                                     iotc_state_t state, void* user_data) {
+  IOTC_UNUSED(in_context_handle);
+
+  tt_want_ptr_op(user_data, ==, &stream_calls);
+  tt_want_int_op(params->stream.total_length, ==, 6);
+  tt_want_str_op(params->stream.topic, ==, "test/topic");
+
+  if (stream_call_count < IOTC_ARRAYSIZE(stream_calls)) {
+    stream_calls[stream_call_count++] = call_type;
+  }
+
+  if (IOTC_SUB_CALL_MESSAGE_CHUNK == call_type) {
+    tt_want_int_op(params->stream.offset, ==, stream_delivered);
+    stream_delivered += params->stream.temporary_chunk_data_length;
+  } else if (IOTC_SUB_CALL_MESSAGE_END == call_type) {
+    tt_want_int_op(params->stream.offset, ==, stream_delivered);
+    stream_end_state = state;
+  }
+}
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_layer_subscribe)
 
 
 IOTC_TT_TESTCASE_WITH_SETUP(
@@ -175,7 +172,7 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       // set the task data
       IOTC_ALLOC_AT(iotc_mqtt_logic_task_t, task, local_state);
 
-      task->cs = 118;  // this is very hakish since it depends on the code
+      task->cs = 146;  // this is very hakish since it depends on the code
       // so most probably this test will fail everytime we change anything in
       // tested function which is not too good at least you know what to check
       // if the test fails
@@ -191,6 +188,8 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       IOTC_ALLOC_AT(iotc_mqtt_task_specific_data_t, task->data.data_u,
                     local_state);
       iotc_mqtt_task_specific_data_t* data_u = task->data.data_u;
+      IOTC_CHECK_MEMORY(data_u->subscribe.topic = iotc_str_dup("test/topic"),
+                        local_state);
 
       task->data.data_u->subscribe.handler = iotc_make_threaded_handle(
           IOTC_THREADID_THREAD_0, &iotc_user_sub_call_wrapper, iotc_context,
@@ -209,9 +208,12 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       iotc_mqtt_logic_layer_data_t logic_layer_data;
       memset(&logic_layer_data, 0, sizeof(iotc_mqtt_logic_layer_data_t));
 
-      logic_layer_data.q12_tasks_queue = task;
+      tt_want_int_op(iotc_mqtt_logic_task_queue_push_back(
+                         &logic_layer_data.q12_tasks_queue, task),
+                     ==, IOTC_STATE_OK);
 
-      logic_layer_data.handlers_for_topics = iotc_vector_create();
+      logic_layer_data.handlers_for_topics =
+          iotc_mqtt_logic_topic_trie_create();
 
       iotc_layer_t* layer = iotc_context->layer_chain.bottom;
       layer->user_data = &logic_layer_data;
@@ -220,10 +222,11 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       tt_want_int_op(
           do_mqtt_subscribe(&layer->layer_connection, task, IOTC_STATE_OK, msg),
           ==, IOTC_STATE_OK);
-      tt_want_int_op(logic_layer_data.handlers_for_topics->elem_no, ==, 1);
-      tt_want_ptr_op(
-          logic_layer_data.handlers_for_topics->array[0].selector_t.ptr_value,
-          ==, data_u);
+      tt_want_int_op(logic_layer_data.handlers_for_topics->count, ==, 1);
+      tt_want_ptr_op(iotc_mqtt_logic_topic_trie_match(
+                         logic_layer_data.handlers_for_topics, "test/topic",
+                         strlen("test/topic")),
+                     ==, data_u);
 
       // make the handler to be called
       iotc_evtd_step(iotc_globals.evtd_instance, 20);
@@ -231,11 +234,14 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       tt_want_int_op(global_value_to_test, ==, 1);
       global_value_to_test = 0;
 
-      IOTC_SAFE_FREE(data_u);
-      iotc_vector_del(logic_layer_data.handlers_for_topics, 0);
+      /* the task has left the queue, this releases the index */
+      tt_want_ptr_op(
+          iotc_mqtt_logic_task_queue_detach(&logic_layer_data.q12_tasks_queue),
+          ==, NULL);
 
-      logic_layer_data.handlers_for_topics =
-          iotc_vector_destroy(logic_layer_data.handlers_for_topics);
+      iotc_mqtt_logic_topic_trie_destroy(
+          &logic_layer_data.handlers_for_topics,
+          &iotc_mqtt_task_spec_data_free_subscribe_data_trie);
 
       iotc_delete_context(iotc_context_handle);
 
@@ -271,7 +277,7 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       // set the task data
       IOTC_ALLOC_AT(iotc_mqtt_logic_task_t, task, local_state);
 
-      task->cs = 118;  // this is very hakish since it depends on the code
+      task->cs = 146;  // this is very hakish since it depends on the code
       // so most probably this test will fail everytime we change anything in
       // tested function which is not too good at least you know what to check
       // if the test fails
@@ -304,9 +310,12 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       iotc_mqtt_logic_layer_data_t logic_layer_data;
       memset(&logic_layer_data, 0, sizeof(iotc_mqtt_logic_layer_data_t));
 
-      logic_layer_data.q12_tasks_queue = task;
+      tt_want_int_op(iotc_mqtt_logic_task_queue_push_back(
+                         &logic_layer_data.q12_tasks_queue, task),
+                     ==, IOTC_STATE_OK);
 
-      logic_layer_data.handlers_for_topics = iotc_vector_create();
+      logic_layer_data.handlers_for_topics =
+          iotc_mqtt_logic_topic_trie_create();
 
       iotc_layer_t* layer = iotc_context->layer_chain.bottom;
       layer->user_data = &logic_layer_data;
@@ -316,7 +325,7 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       tt_want_int_op(
           do_mqtt_subscribe(&layer->layer_connection, task, IOTC_STATE_OK, msg),
           ==, IOTC_STATE_OK);
-      tt_want_int_op(logic_layer_data.handlers_for_topics->elem_no, ==, 0);
+      tt_want_int_op(logic_layer_data.handlers_for_topics->count, ==, 0);
 
       // make the handler to be called
       iotc_evtd_step(iotc_globals.evtd_instance, 20);
@@ -324,9 +333,14 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       tt_want_int_op(global_value_to_test, ==, 1);
       global_value_to_test = 0;
 
+      /* the task has left the queue, this releases the index */
+      tt_want_ptr_op(
+          iotc_mqtt_logic_task_queue_detach(&logic_layer_data.q12_tasks_queue),
+          ==, NULL);
+
       iotc_delete_context(iotc_context_handle);
-      logic_layer_data.handlers_for_topics =
-          iotc_vector_destroy(logic_layer_data.handlers_for_topics);
+      iotc_mqtt_logic_topic_trie_destroy(&logic_layer_data.handlers_for_topics,
+                                         NULL);
 
       return;
 
@@ -338,6 +352,205 @@ IOTC_TT_TESTCASE_WITH_SETUP(
       iotc_delete_context(iotc_context_handle);
       tt_int_op(iotc_is_whole_memory_deallocated(), >, 0);
     })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__do_mqtt_subscribe__two_topics__handed_out_one_by_one,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_state_t local_state = IOTC_STATE_OK;
+
+      iotc_context_handle_t iotc_context_handle = iotc_create_context();
+      if (IOTC_INVALID_CONTEXT_HANDLE >= iotc_context_handle) {
+        tt_fail_msg("Failed to create default context!");
+        return;
+      }
+
+      iotc_mqtt_logic_task_t* task = 0;
+      iotc_mqtt_message_t* msg = 0;
+      iotc_mqtt_task_specific_data_t* earlier = 0;
+      iotc_mqtt_logic_layer_data_t logic_layer_data;
+      memset(&logic_layer_data, 0, sizeof(iotc_mqtt_logic_layer_data_t));
+
+      iotc_context_t* iotc_context = iotc_object_for_handle(
+          iotc_globals.context_handles_vector, iotc_context_handle);
+      tt_assert(NULL != iotc_context);
+
+      IOTC_ALLOC_AT(iotc_mqtt_logic_task_t, task, local_state);
+
+      task->cs = 146;  // waiting for the suback, see the tests above
+
+      iotc_evtd_execute_in(
+          iotc_globals.evtd_instance,
+          iotc_make_handle(&do_mqtt_subscribe, 0, &task, IOTC_STATE_TIMEOUT, 0),
+          10, &task->timeout);
+
+      task->data.mqtt_settings.scenario = IOTC_MQTT_SUBSCRIBE;
+      task->data.mqtt_settings.qos = IOTC_MQTT_QOS_AT_LEAST_ONCE;
+
+      task->data.data_u = utest_make_subscription(iotc_context, "a/#");
+      tt_assert(NULL != task->data.data_u);
+      task->data.data_u->subscribe.next =
+          utest_make_subscription(iotc_context, "b");
+      tt_assert(NULL != task->data.data_u->subscribe.next);
+
+      iotc_mqtt_task_specific_data_t* first = task->data.data_u;
+
+      // the first topic was subscribed before, its handler gets replaced
+      earlier = utest_make_subscription(iotc_context, "a/#");
+      tt_assert(NULL != earlier);
+
+      logic_layer_data.handlers_for_topics =
+          iotc_mqtt_logic_topic_trie_create();
+      tt_assert(NULL != logic_layer_data.handlers_for_topics);
+
+      void* replaced = NULL;
+      tt_int_op(iotc_mqtt_logic_topic_trie_insert(
+                    logic_layer_data.handlers_for_topics, "a/#", earlier,
+                    &replaced),
+                ==, IOTC_STATE_OK);
+      earlier = 0;
+
+      // one suback with a return code for each topic
+      IOTC_ALLOC_AT(iotc_mqtt_message_t, msg, local_state);
+
+      msg->common.common_u.common_bits.type = IOTC_MQTT_TYPE_SUBACK;
+      IOTC_ALLOC_AT(iotc_mqtt_topicpair_t, msg->suback.topics, local_state);
+      msg->suback.topics->iotc_mqtt_topic_pair_payload_u.status =
+          IOTC_MQTT_QOS_1_GRANTED;
+      IOTC_ALLOC_AT(iotc_mqtt_topicpair_t, msg->suback.topics->next,
+                    local_state);
+      msg->suback.topics->next->iotc_mqtt_topic_pair_payload_u.status =
+          IOTC_MQTT_SUBACK_FAILED;
+
+      tt_want_int_op(iotc_mqtt_logic_task_queue_push_back(
+                         &logic_layer_data.q12_tasks_queue, task),
+                     ==, IOTC_STATE_OK);
+
+      iotc_layer_t* layer = iotc_context->layer_chain.bottom;
+      layer->user_data = &logic_layer_data;
+
+      tt_int_op(
+          do_mqtt_subscribe(&layer->layer_connection, task, IOTC_STATE_OK, msg),
+          ==, IOTC_STATE_OK);
+      task = 0;
+      msg = 0;
+
+      tt_int_op(logic_layer_data.handlers_for_topics->count, ==, 1);
+      tt_ptr_op(iotc_mqtt_logic_topic_trie_match(
+                    logic_layer_data.handlers_for_topics, "a/x", strlen("a/x")),
+                ==, first);
+      tt_ptr_op(first->subscribe.next, ==, NULL);
+
+      // the failed topic releases its data in the callback
+      iotc_evtd_step(iotc_globals.evtd_instance, 20);
+
+      tt_int_op(granted_subacks, ==, 1);
+      tt_int_op(failed_subacks, ==, 1);
+
+      tt_ptr_op(
+          iotc_mqtt_logic_task_queue_detach(&logic_layer_data.q12_tasks_queue),
+          ==, NULL);
+
+    err_handling:
+    end:
+      granted_subacks = 0;
+      failed_subacks = 0;
+      if (task != 0) iotc_mqtt_logic_free_task(&task);
+      if (earlier != 0) iotc_mqtt_task_spec_data_free_subscribe_data(&earlier);
+      iotc_mqtt_message_free(&msg);
+      iotc_mqtt_logic_topic_trie_destroy(
+          &logic_layer_data.handlers_for_topics,
+          &iotc_mqtt_task_spec_data_free_subscribe_data_trie);
+      iotc_delete_context(iotc_context_handle);
+      tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
+    })
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_user_sub_stream__streaming_subscription__begin_chunks_end,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_state_t local_state = IOTC_STATE_OK;
+      iotc_mqtt_message_t* msg = NULL;
+      iotc_mqtt_logic_topic_trie_t* trie = NULL;
+      iotc_mqtt_task_specific_data_t* streamed = NULL;
+      iotc_mqtt_task_specific_data_t* buffered = NULL;
+      iotc_user_sub_stream_t stream;
+      void* replaced = NULL;
+      const uint8_t payload[] = "abcdef";
+
+      memset(&stream, 0, sizeof(stream));
+      stream_call_count = 0;
+      stream_delivered = 0;
+
+      tt_assert(NULL != (trie = iotc_mqtt_logic_topic_trie_create()));
+      tt_assert(NULL != (streamed = utest_make_subscription(NULL, "test/#")));
+      tt_assert(NULL != (buffered = utest_make_subscription(NULL, "other")));
+
+      streamed->subscribe.stream = 1;
+      streamed->subscribe.handler.handlers.h6.a4 =
+          (void*)&stream_subscribe_handler;
+      streamed->subscribe.handler.handlers.h6.a5 = &stream_calls;
+
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_mqtt_logic_topic_trie_insert(trie, "test/#", streamed,
+                                                  &replaced));
+      tt_int_op(IOTC_STATE_OK, ==,
+                iotc_mqtt_logic_topic_trie_insert(trie, "other", buffered,
+                                                  &replaced));
+      streamed = buffered = NULL;
+
+      IOTC_ALLOC_AT(iotc_mqtt_message_t, msg, local_state);
+      IOTC_CHECK_MEMORY(msg->publish.topic_name = iotc_make_desc_from_string_share(
+                            "other"),
+                        local_state);
+
+      /* a subscription of iotc_subscribe() gets the payload assembled */
+      tt_int_op(0, ==, iotc_user_sub_stream_begin(&stream, trie, msg, 6));
+      tt_int_op(stream_call_count, ==, 0);
+
+      iotc_free_desc(&msg->publish.topic_name);
+      IOTC_CHECK_MEMORY(msg->publish.topic_name = iotc_make_desc_from_string_share(
+                            "test/topic"),
+                        local_state);
+
+      tt_int_op(1, ==, iotc_user_sub_stream_begin(&stream, trie, msg, 6));
+      iotc_user_sub_stream_chunk(&stream, payload, 0, 4);
+      iotc_user_sub_stream_chunk(&stream, payload + 4, 4, 2);
+      iotc_user_sub_stream_end(&stream, IOTC_STATE_OK);
+
+      /* nothing is streamed anymore, a second end is not delivered */
+      iotc_user_sub_stream_end(&stream, IOTC_STATE_OK);
+
+      tt_int_op(stream_call_count, ==, 4);
+      tt_int_op(stream_calls[0], ==, IOTC_SUB_CALL_MESSAGE_BEGIN);
+      tt_int_op(stream_calls[1], ==, IOTC_SUB_CALL_MESSAGE_CHUNK);
+      tt_int_op(stream_calls[2], ==, IOTC_SUB_CALL_MESSAGE_CHUNK);
+      tt_int_op(stream_calls[3], ==, IOTC_SUB_CALL_MESSAGE_END);
+      tt_int_op(stream_end_state, ==, IOTC_STATE_OK);
+      tt_int_op(stream_delivered, ==, 6);
+
+      /* a connection lost halfway ends the stream with its error */
+      stream_call_count = 0;
+      stream_delivered = 0;
+
+      tt_int_op(1, ==, iotc_user_sub_stream_begin(&stream, trie, msg, 6));
+      iotc_user_sub_stream_chunk(&stream, payload, 0, 3);
+      iotc_user_sub_stream_end(&stream, IOTC_SOCKET_NO_ACTIVE_CONNECTION_ERROR);
+
+      tt_int_op(stream_call_count, ==, 3);
+      tt_int_op(stream_end_state, ==, IOTC_SOCKET_NO_ACTIVE_CONNECTION_ERROR);
+
+    end:
+    err_handling:
+      iotc_mqtt_message_free(&msg);
+      if (NULL != streamed) {
+        iotc_mqtt_task_spec_data_free_subscribe_data(&streamed);
+      }
+      if (NULL != buffered) {
+        iotc_mqtt_task_spec_data_free_subscribe_data(&buffered);
+      }
+      iotc_mqtt_logic_topic_trie_destroy(
+          &trie, &iotc_mqtt_task_spec_data_free_subscribe_data_trie);
+      tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
+    })
+
 IOTC_TT_TESTGROUP_END
 
 #ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
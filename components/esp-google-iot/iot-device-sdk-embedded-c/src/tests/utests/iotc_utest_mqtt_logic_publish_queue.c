@@ -0,0 +1,252 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc_config.h"
+#include "iotc_handle.h"
+#include "iotc_macros.h"
+#include "iotc_mqtt_logic_layer_data.h"
+#include "iotc_mqtt_logic_publish_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+
+static iotc_mqtt_logic_task_t* iotc_utest_push_publish(
+    iotc_mqtt_logic_publish_queue_t* queue, iotc_mqtt_priority_t priority,
+    iotc_mqtt_qos_t qos, iotc_time_t queued_time_ms) {
+  iotc_mqtt_logic_task_t* task = iotc_mqtt_logic_make_publish_task(
+      "priority", iotc_make_desc_from_string_copy("payload"), qos,
+      IOTC_MQTT_RETAIN_FALSE, priority, iotc_make_empty_handle());
+
+  task->queued_time_ms = queued_time_ms;
+  iotc_mqtt_logic_publish_queue_push(queue, task);
+
+  return task;
+}
+
+static void iotc_utest_free_publishes(iotc_mqtt_logic_publish_queue_t* queue) {
+  iotc_mqtt_logic_task_t* list = iotc_mqtt_logic_publish_queue_detach(queue);
+
+  while (NULL != list) {
+    iotc_mqtt_logic_task_t* task = list;
+    list = list->__next;
+    iotc_mqtt_logic_free_task(&task);
+  }
+}
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_publish_queue)
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__publish_queue_pop__mixed_classes__strict_priority_fifo_within_class,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_publish_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      iotc_mqtt_logic_task_t* bulk = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_BULK, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+      iotc_mqtt_logic_task_t* normal1 = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_NORMAL, IOTC_MQTT_QOS_AT_LEAST_ONCE, 0);
+      iotc_mqtt_logic_task_t* normal2 = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_NORMAL, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+      iotc_mqtt_logic_task_t* urgent = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_URGENT, IOTC_MQTT_QOS_AT_LEAST_ONCE, 0);
+
+      tt_int_op(queue.count, ==, 4);
+
+      iotc_mqtt_logic_task_t* order[4] = {urgent, normal1, normal2, bulk};
+      int i = 0;
+      for (; i < 4; ++i) {
+        iotc_mqtt_logic_task_t* task =
+            iotc_mqtt_logic_publish_queue_pop(&queue, 0, 0);
+        tt_want_ptr_op(task, ==, order[i]);
+        tt_want_ptr_op(task->__next, ==, NULL);
+        iotc_mqtt_logic_free_task(&task);
+      }
+
+      tt_want_int_op(queue.count, ==, 0);
+      tt_want_ptr_op(iotc_mqtt_logic_publish_queue_pop(&queue, 0, 0), ==,
+                     NULL);
+    end:;
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__publish_queue_pop__q1_blocked__qos0_of_lower_class_goes_first,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_publish_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      iotc_mqtt_logic_task_t* urgent = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_URGENT, IOTC_MQTT_QOS_AT_LEAST_ONCE, 0);
+      iotc_mqtt_logic_task_t* bulk = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_BULK, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+
+      /* the full publish window holds the QoS 1 alarm back */
+      iotc_mqtt_logic_task_t* task =
+          iotc_mqtt_logic_publish_queue_pop(&queue, 0, 1);
+      tt_ptr_op(task, ==, bulk);
+      iotc_mqtt_logic_free_task(&task);
+
+      tt_want_ptr_op(iotc_mqtt_logic_publish_queue_pop(&queue, 0, 1), ==,
+                     NULL);
+
+      /* and it is the first to go when there is room again */
+      task = iotc_mqtt_logic_publish_queue_pop(&queue, 0, 0);
+      tt_want_ptr_op(task, ==, urgent);
+      iotc_mqtt_logic_free_task(&task);
+    end:;
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__publish_queue_pop__lower_classes_aged__every_other_turn,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_publish_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      iotc_mqtt_logic_task_t* bulk = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_BULK, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+      iotc_mqtt_logic_task_t* normal = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_NORMAL, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+
+      const iotc_time_t now = IOTC_MQTT_PUBLISH_MAX_WAIT_BULK_MS;
+
+      iotc_mqtt_logic_task_t* urgent[3] = {NULL, NULL, NULL};
+      int i = 0;
+      for (; i < 3; ++i) {
+        urgent[i] = iotc_utest_push_publish(&queue, IOTC_MQTT_PRIORITY_URGENT,
+                                            IOTC_MQTT_QOS_AT_MOST_ONCE, now);
+      }
+
+      /* both lower classes have waited too long, they take turns with the
+       * urgent publishes, the higher class first */
+      tt_int_op(queue.count, ==, 5);
+
+      iotc_mqtt_logic_task_t* order[5] = {normal, urgent[0], bulk, urgent[1],
+                                          urgent[2]};
+      for (i = 0; i < 5; ++i) {
+        iotc_mqtt_logic_task_t* task =
+            iotc_mqtt_logic_publish_queue_pop(&queue, now, 0);
+        tt_want_ptr_op(task, ==, order[i]);
+        iotc_mqtt_logic_free_task(&task);
+      }
+    end:;
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__publish_queue_pop__lower_class_not_aged__strict_priority,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_publish_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      iotc_mqtt_logic_task_t* normal = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_NORMAL, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+      iotc_mqtt_logic_task_t* urgent = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_URGENT, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+
+      iotc_mqtt_logic_task_t* task = iotc_mqtt_logic_publish_queue_pop(
+          &queue, IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS - 1, 0);
+      tt_ptr_op(task, ==, urgent);
+      iotc_mqtt_logic_free_task(&task);
+
+      task = iotc_mqtt_logic_publish_queue_pop(
+          &queue, IOTC_MQTT_PUBLISH_MAX_WAIT_NORMAL_MS - 1, 0);
+      tt_want_ptr_op(task, ==, normal);
+      iotc_mqtt_logic_free_task(&task);
+    end:;
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__publish_queue_push__immediate__front_of_its_class,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_publish_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      iotc_mqtt_logic_task_t* first = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_NORMAL, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+
+      iotc_mqtt_logic_task_t* immediate = iotc_mqtt_logic_make_publish_task(
+          "priority", iotc_make_desc_from_string_copy("payload"),
+          IOTC_MQTT_QOS_AT_MOST_ONCE, IOTC_MQTT_RETAIN_FALSE,
+          IOTC_MQTT_PRIORITY_NORMAL, iotc_make_empty_handle());
+      immediate->priority = IOTC_MQTT_LOGIC_TASK_IMMEDIATE;
+      iotc_mqtt_logic_publish_queue_push(&queue, immediate);
+
+      iotc_mqtt_logic_task_t* urgent = iotc_utest_push_publish(
+          &queue, IOTC_MQTT_PRIORITY_URGENT, IOTC_MQTT_QOS_AT_MOST_ONCE, 0);
+
+      /* detached in order, the urgent class first */
+      iotc_mqtt_logic_task_t* list =
+          iotc_mqtt_logic_publish_queue_detach(&queue);
+      tt_ptr_op(list, ==, urgent);
+      tt_want_ptr_op(list->__next, ==, immediate);
+      tt_want_ptr_op(list->__next->__next, ==, first);
+      tt_want_ptr_op(list->__next->__next->__next, ==, NULL);
+      tt_want_int_op(queue.count, ==, 0);
+
+      while (NULL != list) {
+        iotc_mqtt_logic_task_t* task = list;
+        list = list->__next;
+        iotc_mqtt_logic_free_task(&task);
+      }
+
+      iotc_utest_free_publishes(&queue);
+    end:;
+    })
+
+IOTC_TT_TESTCASE(utest__publish_queue_record_delay__delays__bucketed_by_class, {
+  iotc_mqtt_publish_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+
+  iotc_mqtt_logic_publish_queue_record_delay(&stats, IOTC_MQTT_PRIORITY_URGENT,
+                                             0);
+  iotc_mqtt_logic_publish_queue_record_delay(&stats, IOTC_MQTT_PRIORITY_URGENT,
+                                             15);
+  iotc_mqtt_logic_publish_queue_record_delay(&stats, IOTC_MQTT_PRIORITY_URGENT,
+                                             16);
+  iotc_mqtt_logic_publish_queue_record_delay(&stats, IOTC_MQTT_PRIORITY_NORMAL,
+                                             1000);
+  iotc_mqtt_logic_publish_queue_record_delay(&stats, IOTC_MQTT_PRIORITY_BULK,
+                                             10 * 60 * 1000);
+
+  tt_int_op(stats.queue_delay[IOTC_MQTT_PRIORITY_URGENT][0], ==, 2);
+  tt_want_int_op(stats.queue_delay[IOTC_MQTT_PRIORITY_URGENT][1], ==, 1);
+  tt_want_int_op(stats.max_queue_delay_ms[IOTC_MQTT_PRIORITY_URGENT], ==, 16);
+
+  /* below 1024 ms is bucket 3 */
+  tt_want_int_op(stats.queue_delay[IOTC_MQTT_PRIORITY_NORMAL][3], ==, 1);
+
+  tt_want_int_op(stats.queue_delay[IOTC_MQTT_PRIORITY_BULK]
+                                  [IOTC_MQTT_QUEUE_DELAY_BUCKETS - 1],
+                 ==, 1);
+  tt_want_int_op(stats.max_queue_delay_ms[IOTC_MQTT_PRIORITY_BULK], ==,
+                 10 * 60 * 1000);
+end:;
+})
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
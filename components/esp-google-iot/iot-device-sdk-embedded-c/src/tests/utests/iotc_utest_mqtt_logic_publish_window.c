@@ -0,0 +1,268 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc.h"
+#include "iotc_globals.h"
+#include "iotc_handle.h"
+#include "iotc_list.h"
+#include "iotc_macros.h"
+#include "iotc_mqtt_logic_layer_data.h"
+#include "iotc_mqtt_logic_layer_task_helpers.h"
+#include "iotc_mqtt_logic_publish_queue.h"
+#include "iotc_mqtt_logic_task_queue.h"
+
+#include <iotc_error.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+
+static int iotc_utest_writable_calls = 0;
+
+static void iotc_utest_on_writable(iotc_context_handle_t in_context_handle,
+                                   void* data, iotc_state_t state) {
+  IOTC_UNUSED(in_context_handle);
+  IOTC_UNUSED(data);
+
+  tt_want_int_op(state, ==, IOTC_STATE_OK);
+  ++iotc_utest_writable_calls;
+}
+
+/* stands in for do_mqtt_publish_q1, nothing is sent */
+static iotc_state_t iotc_utest_publish_logic(void* data) {
+  IOTC_UNUSED(data);
+  return IOTC_STATE_OK;
+}
+
+static iotc_mqtt_logic_task_t* iotc_utest_make_q1_publish(void) {
+  iotc_mqtt_logic_task_t* task = iotc_mqtt_logic_make_publish_task(
+      "window", iotc_make_desc_from_string_copy("payload"),
+      IOTC_MQTT_QOS_AT_LEAST_ONCE, IOTC_MQTT_RETAIN_FALSE,
+      IOTC_MQTT_PRIORITY_NORMAL, iotc_make_empty_handle());
+  task->logic = iotc_make_handle(&iotc_utest_publish_logic, NULL);
+  return task;
+}
+
+/* runs the task and lets the codec write the publish it started */
+static iotc_state_t iotc_utest_publish(iotc_layer_t* layer,
+                                       iotc_mqtt_logic_task_t* task) {
+  iotc_mqtt_logic_layer_data_t* layer_data =
+      (iotc_mqtt_logic_layer_data_t*)layer->user_data;
+  iotc_state_t state = run_task(&layer->layer_connection, task);
+
+  if (NULL != layer_data->publish_unwritten) {
+    iotc_mqtt_logic_layer_publish_written(&layer->layer_connection,
+                                          layer_data->publish_unwritten);
+  }
+
+  return state;
+}
+
+/* the tasks are never acknowledged */
+static void iotc_utest_free_window_tasks(
+    iotc_mqtt_logic_layer_data_t* layer_data) {
+  iotc_mqtt_logic_task_t* list =
+      iotc_mqtt_logic_task_queue_detach(&layer_data->q12_tasks_queue);
+
+  iotc_mqtt_logic_task_t* queued =
+      iotc_mqtt_logic_publish_queue_detach(&layer_data->publish_queue);
+  IOTC_LIST_PUSH_BACK(iotc_mqtt_logic_task_t, list, queued);
+
+  while (NULL != list) {
+    iotc_mqtt_logic_task_t* task = NULL;
+    IOTC_LIST_POP(iotc_mqtt_logic_task_t, list, task);
+    iotc_mqtt_logic_free_task(&task);
+  }
+}
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_publish_window)
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__run_task__window_and_backlog_full__publish_refused,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_context_handle_t iotc_h = iotc_create_context();
+      tt_assert(IOTC_INVALID_CONTEXT_HANDLE < iotc_h);
+
+      iotc_context_t* iotc =
+          iotc_object_for_handle(iotc_globals.context_handles_vector, iotc_h);
+      tt_assert(NULL != iotc);
+
+      iotc_connection_data_t connection_data;
+      memset(&connection_data, 0, sizeof(connection_data));
+      connection_data.connection_state = IOTC_CONNECTION_STATE_OPENED;
+      iotc->context_data.connection_data = &connection_data;
+
+      iotc_mqtt_logic_layer_data_t layer_data;
+      memset(&layer_data, 0, sizeof(layer_data));
+
+      iotc_layer_t* layer = iotc->layer_chain.top;
+      layer->user_data = &layer_data;
+
+      tt_want_int_op(
+          iotc_set_publish_window(iotc_h, 2, 2, &iotc_utest_on_writable, NULL),
+          ==, IOTC_STATE_OK);
+
+      int i = 0;
+      for (; i < 4; ++i) {
+        tt_want_int_op(iotc_utest_publish(layer, iotc_utest_make_q1_publish()),
+                       ==, IOTC_STATE_OK);
+      }
+
+      /* two are sent, two wait for a PUBACK to make room */
+      tt_want_int_op(layer_data.q1_in_flight_count, ==, 2);
+      tt_want_int_op(layer_data.q12_tasks_queue.count, ==, 2);
+      tt_want_int_op(layer_data.publish_queue.count, ==, 2);
+      tt_want_int_op(
+          layer_data.publish_queue.head[IOTC_MQTT_PRIORITY_NORMAL]->msg_id, ==,
+          0);
+
+      tt_want_int_op(iotc_utest_publish(layer, iotc_utest_make_q1_publish()),
+                     ==, IOTC_PUBLISH_WINDOW_FULL);
+      tt_want_int_op(layer_data.publish_queue.count, ==, 2);
+
+      iotc_mqtt_publish_stats_t stats;
+      tt_want_int_op(iotc_get_mqtt_publish_stats(iotc_h, &stats), ==,
+                     IOTC_STATE_OK);
+      tt_want_int_op(stats.refused, ==, 1);
+      tt_want_int_op(stats.in_flight, ==, 2);
+      tt_want_int_op(stats.queued, ==, 2);
+
+      iotc_utest_free_window_tasks(&layer_data);
+      layer->user_data = NULL;
+      iotc->context_data.connection_data = NULL;
+      iotc_delete_context(iotc_h);
+    end:;
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__finalize_task__puback_frees_window__next_publish_started_and_writable,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_context_handle_t iotc_h = iotc_create_context();
+      tt_assert(IOTC_INVALID_CONTEXT_HANDLE < iotc_h);
+
+      iotc_context_t* iotc =
+          iotc_object_for_handle(iotc_globals.context_handles_vector, iotc_h);
+      tt_assert(NULL != iotc);
+
+      iotc_connection_data_t connection_data;
+      memset(&connection_data, 0, sizeof(connection_data));
+      connection_data.connection_state = IOTC_CONNECTION_STATE_OPENED;
+      iotc->context_data.connection_data = &connection_data;
+
+      iotc_mqtt_logic_layer_data_t layer_data;
+      memset(&layer_data, 0, sizeof(layer_data));
+
+      iotc_layer_t* layer = iotc->layer_chain.top;
+      layer->user_data = &layer_data;
+
+      iotc_utest_writable_calls = 0;
+      tt_want_int_op(
+          iotc_set_publish_window(iotc_h, 1, 2, &iotc_utest_on_writable, NULL),
+          ==, IOTC_STATE_OK);
+
+      int i = 0;
+      for (; i < 3; ++i) {
+        iotc_utest_publish(layer, iotc_utest_make_q1_publish());
+      }
+
+      tt_want_int_op(iotc_utest_publish(layer, iotc_utest_make_q1_publish()),
+                     ==, IOTC_PUBLISH_WINDOW_FULL);
+
+      /* the PUBACK of the first publish starts the second */
+      iotc_mqtt_logic_task_t* acked = layer_data.q12_tasks_queue.head;
+      const uint16_t acked_msg_id = acked->msg_id;
+      iotc_mqtt_logic_layer_finalize_task(&layer->layer_connection, acked);
+
+      tt_want_int_op(layer_data.q1_in_flight_count, ==, 1);
+      tt_want_int_op(layer_data.publish_queue.count, ==, 1);
+      tt_want_int_op(layer_data.q12_tasks_queue.count, ==, 1);
+      tt_want_int_op(layer_data.q12_tasks_queue.head->msg_id, !=, 0);
+      tt_want_int_op(layer_data.q12_tasks_queue.head->msg_id, !=,
+                     acked_msg_id);
+
+      /* half the backlog is free, the producer may go on */
+      iotc_evtd_step(iotc_globals.evtd_instance, 20);
+      tt_want_int_op(iotc_utest_writable_calls, ==, 1);
+
+      /* and it is told only once */
+      iotc_mqtt_logic_layer_finalize_task(&layer->layer_connection,
+                                          layer_data.q12_tasks_queue.head);
+      iotc_evtd_step(iotc_globals.evtd_instance, 20);
+      tt_want_int_op(iotc_utest_writable_calls, ==, 1);
+      tt_want_int_op(layer_data.q1_in_flight_count, ==, 1);
+      tt_want_int_op(layer_data.publish_queue.count, ==, 0);
+
+      iotc_utest_free_window_tasks(&layer_data);
+      layer->user_data = NULL;
+      iotc->context_data.connection_data = NULL;
+      iotc_delete_context(iotc_h);
+    end:;
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__run_task__no_window__publishes_never_queued,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_context_handle_t iotc_h = iotc_create_context();
+      tt_assert(IOTC_INVALID_CONTEXT_HANDLE < iotc_h);
+
+      iotc_context_t* iotc =
+          iotc_object_for_handle(iotc_globals.context_handles_vector, iotc_h);
+      tt_assert(NULL != iotc);
+
+      iotc_connection_data_t connection_data;
+      memset(&connection_data, 0, sizeof(connection_data));
+      connection_data.connection_state = IOTC_CONNECTION_STATE_OPENED;
+      iotc->context_data.connection_data = &connection_data;
+
+      iotc_mqtt_logic_layer_data_t layer_data;
+      memset(&layer_data, 0, sizeof(layer_data));
+
+      iotc_layer_t* layer = iotc->layer_chain.top;
+      layer->user_data = &layer_data;
+
+      int i = 0;
+      for (; i < 50; ++i) {
+        tt_want_int_op(iotc_utest_publish(layer, iotc_utest_make_q1_publish()),
+                       ==, IOTC_STATE_OK);
+      }
+
+      tt_want_int_op(layer_data.q1_in_flight_count, ==, 50);
+      tt_want_int_op(layer_data.publish_queue.count, ==, 0);
+      tt_want_ptr_op(layer_data.publish_queue.head[IOTC_MQTT_PRIORITY_NORMAL],
+                     ==, NULL);
+
+      iotc_utest_free_window_tasks(&layer_data);
+      layer->user_data = NULL;
+      iotc->context_data.connection_data = NULL;
+      iotc_delete_context(iotc_h);
+    end:;
+    })
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
@@ -0,0 +1,118 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc_config.h"
+#include "iotc_mqtt_logic_rtt.h"
+
+#include <stdio.h>
+#include <string.h>
+
+IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_rtt)
+
+IOTC_TT_TESTCASE(utest__iotc_mqtt_logic_rtt_reset__no_sample__initial_timeout, {
+  iotc_mqtt_publish_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.acked = 5;
+  stats.srtt_ms = 800;
+
+  iotc_mqtt_logic_rtt_reset(&stats);
+
+  tt_int_op(stats.srtt_ms, ==, 0);
+  tt_int_op(stats.rto_ms, ==, IOTC_MQTT_PUBACK_RTO_INITIAL_MS);
+  tt_int_op(stats.acked, ==, 5);
+  tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 0), ==,
+            (IOTC_MQTT_PUBACK_RTO_INITIAL_MS + 999) / 1000);
+end:;
+})
+
+IOTC_TT_TESTCASE(
+    utest__iotc_mqtt_logic_rtt_sample__first_sample__rfc6298_initial_values, {
+      iotc_mqtt_publish_stats_t stats;
+      memset(&stats, 0, sizeof(stats));
+      iotc_mqtt_logic_rtt_reset(&stats);
+
+      iotc_mqtt_logic_rtt_sample(&stats, 2000);
+
+      /* SRTT = R, RTTVAR = R / 2, RTO = SRTT + 4 * RTTVAR */
+      tt_int_op(stats.srtt_ms, ==, 2000);
+      tt_int_op(stats.rttvar_ms, ==, 1000);
+      tt_int_op(stats.rto_ms, ==, 6000);
+      tt_int_op(stats.rtt_samples, ==, 1);
+      tt_int_op(stats.min_rtt_ms, ==, 2000);
+      tt_int_op(stats.max_rtt_ms, ==, 2000);
+      tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 0), ==, 6);
+    end:;
+    })
+
+IOTC_TT_TESTCASE(
+    utest__iotc_mqtt_logic_rtt_sample__steady_samples__converges_to_min, {
+      iotc_mqtt_publish_stats_t stats;
+      memset(&stats, 0, sizeof(stats));
+      iotc_mqtt_logic_rtt_reset(&stats);
+
+      int i = 0;
+      for (; i < 50; ++i) {
+        iotc_mqtt_logic_rtt_sample(&stats, 120);
+      }
+
+      tt_int_op(stats.srtt_ms, ==, 120);
+      tt_int_op(stats.rttvar_ms, <, 10);
+      /* the variation term never drops below the dispatcher's second */
+      tt_int_op(stats.rto_ms, ==, 1120);
+      tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 0), ==, 2);
+
+      iotc_mqtt_logic_rtt_sample(&stats, 900);
+
+      tt_int_op(stats.last_rtt_ms, ==, 900);
+      tt_int_op(stats.max_rtt_ms, ==, 900);
+      tt_int_op(stats.min_rtt_ms, ==, 120);
+      tt_int_op(stats.srtt_ms, >, 120);
+      tt_int_op(stats.rttvar_ms, >=, 195);
+    end:;
+    })
+
+IOTC_TT_TESTCASE(utest__iotc_mqtt_logic_rtt_timeout__resends__backoff_capped, {
+  iotc_mqtt_publish_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  iotc_mqtt_logic_rtt_reset(&stats);
+
+  iotc_mqtt_logic_rtt_sample(&stats, 2000);
+
+  tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 1), ==, 12);
+  tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 2), ==, 24);
+  tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 4), ==,
+            IOTC_MQTT_PUBACK_RTO_MAX_MS / 1000);
+  tt_int_op(iotc_mqtt_logic_rtt_timeout(&stats, 255), ==,
+            IOTC_MQTT_PUBACK_RTO_MAX_MS / 1000);
+
+  /* a lost PUBACK must not make the timeout unbounded either */
+  iotc_mqtt_logic_rtt_sample(&stats, 10 * IOTC_MQTT_PUBACK_RTO_MAX_MS);
+  tt_int_op(stats.rto_ms, ==, IOTC_MQTT_PUBACK_RTO_MAX_MS);
+end:;
+})
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
@@ -0,0 +1,299 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc_list.h"
+#include "iotc_macros.h"
+#include "iotc_mqtt_logic_layer_data.h"
+#include "iotc_mqtt_logic_task_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+
+/* number of publishes waiting for their PUBACK in the replay */
+#define IOTC_UTEST_TASK_QUEUE_OUTSTANDING 1000
+#define IOTC_UTEST_TASK_QUEUE_REPLAYS 20
+
+/* the tasks are not allocated, so the memory limiter only sees the index */
+static iotc_mqtt_logic_task_t
+    iotc_utest_tasks[IOTC_UTEST_TASK_QUEUE_OUTSTANDING];
+static size_t iotc_utest_ack_order[IOTC_UTEST_TASK_QUEUE_OUTSTANDING];
+
+/* deterministic, so that a failing order can be reproduced */
+static uint32_t iotc_utest_task_queue_rand(uint32_t* seed) {
+  *seed = *seed * 1103515245u + 12345u;
+  return *seed >> 16;
+}
+
+static void iotc_utest_task_queue_make_tasks(size_t count,
+                                             uint16_t first_msg_id) {
+  memset(iotc_utest_tasks, 0, sizeof(iotc_utest_tasks));
+
+  uint16_t msg_id = first_msg_id;
+
+  size_t i = 0;
+  for (; i < count; ++i) {
+    /* 0 is skipped the same way run_task does */
+    if (0 == msg_id) {
+      ++msg_id;
+    }
+    iotc_utest_tasks[i].msg_id = msg_id++;
+  }
+}
+
+static void iotc_utest_task_queue_shuffle(size_t count, uint32_t seed) {
+  size_t i = 0;
+  for (; i < count; ++i) {
+    iotc_utest_ack_order[i] = i;
+  }
+
+  for (i = count - 1; i > 0; --i) {
+    size_t j = iotc_utest_task_queue_rand(&seed) % (i + 1);
+    size_t tmp = iotc_utest_ack_order[i];
+    iotc_utest_ack_order[i] = iotc_utest_ack_order[j];
+    iotc_utest_ack_order[j] = tmp;
+  }
+}
+
+#define IOTC_UTEST_CMP_TASK_MSG_ID(task, id) (task->msg_id == id)
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_task_queue)
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_mqtt_logic_task_queue__push_back_find_drop__fifo_order_kept,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_task_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      /* the ids wrap around, so the home slots do too */
+      iotc_utest_task_queue_make_tasks(40, 65520);
+
+      tt_ptr_op(iotc_mqtt_logic_task_queue_find(&queue, 1), ==, NULL);
+
+      size_t i = 0;
+      for (; i < 40; ++i) {
+        tt_int_op(
+            iotc_mqtt_logic_task_queue_push_back(&queue, &iotc_utest_tasks[i]),
+            ==, IOTC_STATE_OK);
+      }
+
+      tt_int_op(queue.count, ==, 40);
+      tt_ptr_op(queue.head, ==, &iotc_utest_tasks[0]);
+      tt_ptr_op(queue.tail, ==, &iotc_utest_tasks[39]);
+
+      for (i = 0; i < 40; ++i) {
+        tt_ptr_op(iotc_mqtt_logic_task_queue_find(
+                      &queue, iotc_utest_tasks[i].msg_id),
+                  ==, &iotc_utest_tasks[i]);
+      }
+
+      /* head, middle and tail */
+      iotc_mqtt_logic_task_queue_drop(&queue, &iotc_utest_tasks[0]);
+      iotc_mqtt_logic_task_queue_drop(&queue, &iotc_utest_tasks[20]);
+      iotc_mqtt_logic_task_queue_drop(&queue, &iotc_utest_tasks[39]);
+
+      /* a second drop must not touch the queue */
+      iotc_mqtt_logic_task_queue_drop(&queue, &iotc_utest_tasks[20]);
+
+      tt_int_op(queue.count, ==, 37);
+      tt_ptr_op(queue.head, ==, &iotc_utest_tasks[1]);
+      tt_ptr_op(queue.tail, ==, &iotc_utest_tasks[38]);
+      tt_ptr_op(iotc_utest_tasks[19].__next, ==, &iotc_utest_tasks[21]);
+      tt_ptr_op(iotc_utest_tasks[21].__prev, ==, &iotc_utest_tasks[19]);
+
+      tt_ptr_op(iotc_mqtt_logic_task_queue_find(&queue,
+                                                iotc_utest_tasks[20].msg_id),
+                ==, NULL);
+      tt_ptr_op(iotc_mqtt_logic_task_queue_find(&queue,
+                                                iotc_utest_tasks[21].msg_id),
+                ==, &iotc_utest_tasks[21]);
+
+      iotc_mqtt_logic_task_t* list =
+          iotc_mqtt_logic_task_queue_detach(&queue);
+
+      tt_ptr_op(list, ==, &iotc_utest_tasks[1]);
+      tt_ptr_op(queue.index, ==, NULL);
+      tt_int_op(queue.count, ==, 0);
+
+    end:
+      iotc_mqtt_logic_task_queue_detach(&queue);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_mqtt_logic_task_queue__random_drops__remaining_tasks_found,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_task_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      const size_t count = 300;
+
+      iotc_utest_task_queue_make_tasks(count, 65400);
+      iotc_utest_task_queue_shuffle(count, 7);
+
+      size_t i = 0;
+      for (; i < count; ++i) {
+        tt_int_op(
+            iotc_mqtt_logic_task_queue_push_back(&queue, &iotc_utest_tasks[i]),
+            ==, IOTC_STATE_OK);
+      }
+
+      /* after every backward shift each remaining task must still be
+       * reachable from its home slot */
+      for (i = 0; i < count; ++i) {
+        iotc_mqtt_logic_task_t* dropped =
+            &iotc_utest_tasks[iotc_utest_ack_order[i]];
+        iotc_mqtt_logic_task_queue_drop(&queue, dropped);
+
+        tt_ptr_op(iotc_mqtt_logic_task_queue_find(&queue, dropped->msg_id),
+                  ==, NULL);
+
+        size_t j = i + 1;
+        for (; j < count; ++j) {
+          iotc_mqtt_logic_task_t* task =
+              &iotc_utest_tasks[iotc_utest_ack_order[j]];
+          tt_ptr_op(iotc_mqtt_logic_task_queue_find(&queue, task->msg_id), ==,
+                    task);
+        }
+      }
+
+      tt_int_op(queue.count, ==, 0);
+      tt_ptr_op(queue.head, ==, NULL);
+      tt_ptr_op(queue.tail, ==, NULL);
+
+    end:
+      iotc_mqtt_logic_task_queue_detach(&queue);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_mqtt_logic_task_queue__append_list__order_kept,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_task_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      iotc_mqtt_logic_task_t* list = NULL;
+
+      iotc_utest_task_queue_make_tasks(5, 100);
+
+      size_t i = 0;
+      for (; i < 5; ++i) {
+        IOTC_LIST_PUSH_BACK(iotc_mqtt_logic_task_t, list,
+                            (&iotc_utest_tasks[i]));
+      }
+
+      tt_int_op(iotc_mqtt_logic_task_queue_append_list(&queue, &list), ==,
+                IOTC_STATE_OK);
+      tt_ptr_op(list, ==, NULL);
+
+      iotc_mqtt_logic_task_t* task = queue.head;
+      for (i = 0; i < 5; ++i, task = task->__next) {
+        tt_ptr_op(task, ==, &iotc_utest_tasks[i]);
+        tt_ptr_op(iotc_mqtt_logic_task_queue_find(&queue, 100 + i), ==, task);
+      }
+
+    end:
+      iotc_mqtt_logic_task_queue_detach(&queue);
+    })
+
+/* Replays a thousand publishes waiting for their PUBACK, which arrive in random
+ * order, and compares the index against the linear search the layer used
+ * before. The timings are only printed with --verbose, they depend too much
+ * on the host. */
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__iotc_mqtt_logic_task_queue__outstanding_publishes__benchmark,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      iotc_mqtt_logic_task_queue_t queue;
+      memset(&queue, 0, sizeof(queue));
+
+      const size_t count = IOTC_UTEST_TASK_QUEUE_OUTSTANDING;
+      clock_t index_ticks = 0;
+      clock_t list_ticks = 0;
+
+      size_t replay = 0;
+      for (; replay < IOTC_UTEST_TASK_QUEUE_REPLAYS; ++replay) {
+        iotc_utest_task_queue_make_tasks(count, (uint16_t)(replay * 3331));
+        iotc_utest_task_queue_shuffle(count, (uint32_t)replay);
+
+        size_t i = 0;
+
+        /* linear search over the plain list */
+        iotc_mqtt_logic_task_t* list = NULL;
+        for (i = count; i > 0; --i) {
+          IOTC_LIST_PUSH_FRONT(iotc_mqtt_logic_task_t, list,
+                               (&iotc_utest_tasks[i - 1]));
+        }
+
+        clock_t start = clock();
+        for (i = 0; i < count; ++i) {
+          iotc_mqtt_logic_task_t* acked = NULL;
+          uint16_t msg_id = iotc_utest_tasks[iotc_utest_ack_order[i]].msg_id;
+          IOTC_LIST_FIND(iotc_mqtt_logic_task_t, list,
+                         IOTC_UTEST_CMP_TASK_MSG_ID, msg_id, acked);
+          tt_ptr_op(acked, ==, &iotc_utest_tasks[iotc_utest_ack_order[i]]);
+          IOTC_LIST_DROP(iotc_mqtt_logic_task_t, list, acked);
+        }
+        list_ticks += clock() - start;
+
+        tt_ptr_op(list, ==, NULL);
+
+        /* the same acks through the index */
+        iotc_utest_task_queue_make_tasks(count, (uint16_t)(replay * 3331));
+
+        for (i = 0; i < count; ++i) {
+          tt_int_op(iotc_mqtt_logic_task_queue_push_back(&queue,
+                                                         &iotc_utest_tasks[i]),
+                    ==, IOTC_STATE_OK);
+        }
+
+        start = clock();
+        for (i = 0; i < count; ++i) {
+          uint16_t msg_id = iotc_utest_tasks[iotc_utest_ack_order[i]].msg_id;
+          iotc_mqtt_logic_task_t* acked =
+              iotc_mqtt_logic_task_queue_find(&queue, msg_id);
+          tt_ptr_op(acked, ==, &iotc_utest_tasks[iotc_utest_ack_order[i]]);
+          iotc_mqtt_logic_task_queue_drop(&queue, acked);
+        }
+        index_ticks += clock() - start;
+
+        tt_int_op(queue.count, ==, 0);
+      }
+
+      TT_BLATHER(("%d outstanding publishes acked %d times, list %ld us, "
+                  "index %ld us",
+                  IOTC_UTEST_TASK_QUEUE_OUTSTANDING,
+                  IOTC_UTEST_TASK_QUEUE_REPLAYS,
+                  (long)(list_ticks * 1000000 / CLOCKS_PER_SEC),
+                  (long)(index_ticks * 1000000 / CLOCKS_PER_SEC)));
+
+    end:
+      iotc_mqtt_logic_task_queue_detach(&queue);
+    })
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
@@ -0,0 +1,351 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_tt_testcase_management.h"
+#include "iotc_utest_basic_testcase_frame.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+#include "iotc_bsp_time.h"
+#include "iotc_macros.h"
+#include "iotc_mqtt_logic_topic_trie.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+
+#define IOTC_UTEST_TOPIC_TRIE_DEVICES 500
+#define IOTC_UTEST_TOPIC_TRIE_MESSAGES 20000
+
+static void* iotc_utest_topic_trie_match(
+    const iotc_mqtt_logic_topic_trie_t* trie, const char* topic) {
+  return iotc_mqtt_logic_topic_trie_match(trie, topic, strlen(topic));
+}
+
+/* What the logic layer did before the trie, one filter after the other. */
+static int iotc_utest_topic_trie_linear_match(const char* filter,
+                                              const char* topic) {
+  if ('$' == *topic && ('+' == *filter || '#' == *filter)) {
+    return 0;
+  }
+
+  for (;;) {
+    if ('#' == *filter) {
+      return 1;
+    }
+
+    const char* filter_stop = strchr(filter, '/');
+    const char* topic_stop = strchr(topic, '/');
+    size_t filter_length =
+        filter_stop ? (size_t)(filter_stop - filter) : strlen(filter);
+    size_t topic_length =
+        topic_stop ? (size_t)(topic_stop - topic) : strlen(topic);
+
+    if (!('+' == *filter && 1 == filter_length) &&
+        (filter_length != topic_length ||
+         0 != memcmp(filter, topic, filter_length))) {
+      return 0;
+    }
+
+    if (NULL == topic_stop) {
+      return NULL == filter_stop || 0 == strcmp(filter_stop, "/#");
+    }
+
+    if (NULL == filter_stop) {
+      return 0;
+    }
+
+    filter = filter_stop + 1;
+    topic = topic_stop + 1;
+  }
+}
+
+#endif
+
+IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_logic_topic_trie)
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__topic_trie_match__single_filter__matches_per_mqtt_rules,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      typedef struct {
+        const char* filter;
+        const char* topic;
+        const uint8_t expected_match;
+      } iotc_topic_trie_test_case_t;
+
+      const iotc_topic_trie_test_case_t test_cases[] = {
+          // non-wildcard tests
+          {"long_topic_name_same_length_1", "long_topic_name_same_length_2", 0},
+          {"long_topic_name_same_length_2", "long_topic_name_same_length_1", 0},
+          {"long_topic_name", "long_topic_name_different_length", 0},
+          {"long_topic_name_different_length", "short", 0},
+          {"t1", "t2", 0},
+          {"t", "t", 1},
+          {"t", "t/", 0},
+          {"t/subfolder", "t", 0},
+          {"/leading/slash", "/leading/slash", 1},
+          {"/leading/slash", "leading/slash", 0},
+
+          // multi-level wildcard tests
+          {"t1/#", "t2", 0},
+          {"t/#", "t", 1},
+          {"t/#", "t/", 1},
+          {"t/#", "t/subfolder", 1},
+          {"t1/#", "t2/subfolder", 0},
+          {"multi/level/#", "multi/level", 1},
+          {"multi/level/#", "multi/level/", 1},
+          {"multi/level/#", "multi/level/topic", 1},
+          {"multi/level/#", "multi/level/topic/", 1},
+          {"multi/level/#", "multi/level/topic/name", 1},
+          {"multi/level/#", "multi/level/topic/name/", 1},
+          {"multi/level/#", "multi/leve", 0},
+          {"multi/level/#", "multi/level2", 0},
+          {"multi/level/#", "multi/level2/topic/name", 0},
+          {"multi/#", "multi/level/topic/name", 1},
+
+          // single-level wildcard tests
+          {"+", "t", 1},
+          {"+", "t/", 0},
+          {"+", "/t", 0},
+          {"+/+", "/t", 1},
+          {"t/+", "t/", 1},
+          {"t/+", "t", 0},
+          {"t/+", "t/subfolder", 1},
+          {"t/+", "t/subfolder/more", 0},
+          {"t/+/c", "t/b/c", 1},
+          {"t/+/c", "t//c", 1},
+          {"t/+/c", "t/b/d", 0},
+          {"+/+/#", "a/b", 1},
+          {"/devices/+/commands/#", "/devices/hub/commands", 1},
+          {"/devices/+/commands/#", "/devices/hub/commands/reboot", 1},
+          {"/devices/+/commands/#", "/devices/hub/config", 0},
+
+          // topics starting with '$' are not matched by a leading wildcard
+          {"#", "$SYS/uptime", 0},
+          {"+/uptime", "$SYS/uptime", 0},
+          {"$SYS/#", "$SYS/uptime", 1},
+          {"$SYS/+", "$SYS/uptime", 1},
+
+          // root wildcard tests
+          {"#", "t", 1},
+          {"#", "long_topic_name", 1},
+          {"#", "multi/level/topic/name", 1},
+          {"#", "", 0},
+          {"#", NULL, 0},
+      };
+
+      iotc_mqtt_logic_topic_trie_t* trie = NULL;
+      int value = 0;
+      void* replaced = NULL;
+
+      size_t i = 0;
+      for (; i < sizeof(test_cases) / sizeof(test_cases[0]); ++i) {
+        const iotc_topic_trie_test_case_t* test_case = test_cases + i;
+
+        trie = iotc_mqtt_logic_topic_trie_create();
+        tt_assert(NULL != trie);
+
+        tt_int_op(iotc_mqtt_logic_topic_trie_insert(trie, test_case->filter,
+                                                    &value, &replaced),
+                  ==, IOTC_STATE_OK);
+
+        void* match = iotc_mqtt_logic_topic_trie_match(
+            trie, test_case->topic,
+            test_case->topic ? strlen(test_case->topic) : 0);
+
+        if ((NULL != match) != test_case->expected_match) {
+          TT_DIE(("filter %s, topic %s: expected %s", test_case->filter,
+                  test_case->topic ? test_case->topic : "NULL",
+                  test_case->expected_match ? "a match" : "no match"));
+        }
+
+        iotc_mqtt_logic_topic_trie_destroy(&trie, NULL);
+        tt_ptr_op(trie, ==, NULL);
+      }
+
+    end:
+      iotc_mqtt_logic_topic_trie_destroy(&trie, NULL);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__topic_trie_match__overlapping_filters__most_specific_wins,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      const char* filters[] = {"a/b/c", "a/+/c", "a/#", "+/b/c", "#"};
+      int values[5] = {0};
+      void* replaced = NULL;
+
+      iotc_mqtt_logic_topic_trie_t* trie = iotc_mqtt_logic_topic_trie_create();
+      tt_assert(NULL != trie);
+
+      size_t i = 0;
+      for (; i < 5; ++i) {
+        tt_int_op(iotc_mqtt_logic_topic_trie_insert(trie, filters[i],
+                                                    &values[i], &replaced),
+                  ==, IOTC_STATE_OK);
+        tt_ptr_op(replaced, ==, NULL);
+      }
+
+      tt_int_op(trie->count, ==, 5);
+
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "a/b/c"), ==, &values[0]);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "a/x/c"), ==, &values[1]);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "a/b/d"), ==, &values[2]);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "a"), ==, &values[2]);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "x/b/c"), ==, &values[3]);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "x/b/d"), ==, &values[4]);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "$SYS/b/c"), ==, NULL);
+
+    end:
+      iotc_mqtt_logic_topic_trie_destroy(&trie, NULL);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__topic_trie_insert__same_filter__value_replaced,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      int first = 0;
+      int second = 0;
+      void* replaced = NULL;
+
+      iotc_mqtt_logic_topic_trie_t* trie = iotc_mqtt_logic_topic_trie_create();
+      tt_assert(NULL != trie);
+
+      tt_int_op(
+          iotc_mqtt_logic_topic_trie_insert(trie, "a/+", &first, &replaced),
+          ==, IOTC_STATE_OK);
+      tt_ptr_op(replaced, ==, NULL);
+
+      const size_t node_count = trie->node_count;
+
+      tt_int_op(
+          iotc_mqtt_logic_topic_trie_insert(trie, "a/+", &second, &replaced),
+          ==, IOTC_STATE_OK);
+      tt_ptr_op(replaced, ==, &first);
+      tt_int_op(trie->count, ==, 1);
+      tt_int_op(trie->node_count, ==, node_count);
+      tt_ptr_op(iotc_utest_topic_trie_match(trie, "a/b"), ==, &second);
+
+    end:
+      iotc_mqtt_logic_topic_trie_destroy(&trie, NULL);
+    })
+
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__topic_trie_insert__invalid_filter__refused_without_nodes,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      const char* filters[] = {"", "a/b#", "a+/b", "a/#/b", "##", NULL};
+      int value = 0;
+      void* replaced = NULL;
+
+      iotc_mqtt_logic_topic_trie_t* trie = iotc_mqtt_logic_topic_trie_create();
+      tt_assert(NULL != trie);
+
+      size_t i = 0;
+      for (; i < sizeof(filters) / sizeof(filters[0]); ++i) {
+        tt_int_op(
+            iotc_mqtt_logic_topic_trie_insert(trie, filters[i], &value,
+                                              &replaced),
+            ==, IOTC_INVALID_PARAMETER);
+      }
+
+      tt_int_op(trie->count, ==, 0);
+      tt_int_op(trie->node_count, ==, 0);
+
+    end:
+      iotc_mqtt_logic_topic_trie_destroy(&trie, NULL);
+    })
+
+/* A gateway with 500 devices subscribed to the commands and the config of
+ * each, 1000 filters. Each message is dispatched through the trie and through
+ * the linear scan the trie replaced, run with --verbose to see the timing. */
+IOTC_TT_TESTCASE_WITH_SETUP(
+    utest__topic_trie_match__1k_subscriptions__same_result_as_linear_scan,
+    iotc_utest_setup_basic, iotc_utest_teardown_basic, NULL, {
+      static char filters[IOTC_UTEST_TOPIC_TRIE_DEVICES * 2][48];
+      static char topics[IOTC_UTEST_TOPIC_TRIE_DEVICES * 2][48];
+      const size_t filter_count = IOTC_UTEST_TOPIC_TRIE_DEVICES * 2;
+      void* replaced = NULL;
+      size_t matched = 0;
+
+      iotc_mqtt_logic_topic_trie_t* trie = iotc_mqtt_logic_topic_trie_create();
+      tt_assert(NULL != trie);
+
+      size_t i = 0;
+      for (; i < IOTC_UTEST_TOPIC_TRIE_DEVICES; ++i) {
+        sprintf(filters[2 * i], "/devices/dev%04u/commands/#", (unsigned)i);
+        sprintf(filters[2 * i + 1], "/devices/dev%04u/config", (unsigned)i);
+        sprintf(topics[2 * i], "/devices/dev%04u/commands/reboot",
+                (unsigned)i);
+        sprintf(topics[2 * i + 1], "/devices/dev%04u/config", (unsigned)i);
+      }
+
+      for (i = 0; i < filter_count; ++i) {
+        tt_int_op(iotc_mqtt_logic_topic_trie_insert(trie, filters[i],
+                                                    filters[i], &replaced),
+                  ==, IOTC_STATE_OK);
+      }
+
+      tt_int_op(trie->count, ==, filter_count);
+
+      /* the messages go to the devices in a scattered order */
+      iotc_time_t start_ms = iotc_bsp_time_getmonotonictime_milliseconds();
+      for (i = 0; i < IOTC_UTEST_TOPIC_TRIE_MESSAGES; ++i) {
+        const char* topic = topics[(i * 7919) % filter_count];
+
+        if (NULL != iotc_utest_topic_trie_match(trie, topic)) {
+          ++matched;
+        }
+      }
+      const iotc_time_t trie_ms =
+          iotc_bsp_time_getmonotonictime_milliseconds() - start_ms;
+
+      tt_int_op(matched, ==, IOTC_UTEST_TOPIC_TRIE_MESSAGES);
+
+      start_ms = iotc_bsp_time_getmonotonictime_milliseconds();
+      for (i = 0; i < IOTC_UTEST_TOPIC_TRIE_MESSAGES; ++i) {
+        const char* topic = topics[(i * 7919) % filter_count];
+        const char* expected = NULL;
+
+        size_t j = 0;
+        for (; j < filter_count && NULL == expected; ++j) {
+          if (iotc_utest_topic_trie_linear_match(filters[j], topic)) {
+            expected = filters[j];
+          }
+        }
+
+        if (iotc_utest_topic_trie_match(trie, topic) != expected) {
+          TT_DIE(("%s dispatched differently", topic));
+        }
+      }
+      const iotc_time_t linear_ms =
+          iotc_bsp_time_getmonotonictime_milliseconds() - start_ms;
+
+      TT_BLATHER(("%u messages, %u filters: trie %ld ms, linear scan %ld ms",
+                  IOTC_UTEST_TOPIC_TRIE_MESSAGES, (unsigned)filter_count,
+                  (long)trie_ms, (long)linear_ms));
+
+      tt_int_op(trie_ms, <=, linear_ms);
+
+    end:
+      iotc_mqtt_logic_topic_trie_destroy(&trie, NULL);
+    })
+
+IOTC_TT_TESTGROUP_END
+
+#ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#define IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#include __FILE__
+#undef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
+#endif
@@ -21,6 +21,7 @@
 #include "iotc.h"
 #include "iotc_globals.h"
 #include "iotc_helpers.h"
+#include "iotc_mqtt_message.h"
 #include "iotc_mqtt_parser.h"
 
 #include "iotc_memory_checks.h"
@@ -35,6 +36,48 @@
 
 #ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
 
+typedef struct iotc_utest_payload_stream_s {
+  uint8_t stream;
+  size_t begun;
+  size_t total_length;
+  size_t chunks;
+  const uint8_t* first_chunk;
+  size_t next_offset;
+  size_t out_of_order;
+  uint8_t payload[16];
+} iotc_utest_payload_stream_t;
+
+static uint8_t iotc_utest_payload_begin(void* data,
+                                        const iotc_mqtt_message_t* message,
+                                        size_t total_length) {
+  iotc_utest_payload_stream_t* stream = (iotc_utest_payload_stream_t*)data;
+
+  IOTC_UNUSED(message);
+
+  ++stream->begun;
+  stream->total_length = total_length;
+
+  return stream->stream;
+}
+
+static void iotc_utest_payload_chunk(void* data, const uint8_t* chunk,
+                                     size_t offset, size_t length) {
+  iotc_utest_payload_stream_t* stream = (iotc_utest_payload_stream_t*)data;
+
+  if (offset != stream->next_offset ||
+      offset + length > sizeof(stream->payload)) {
+    ++stream->out_of_order;
+    return;
+  }
+
+  if (0 == stream->chunks++) {
+    stream->first_chunk = chunk;
+  }
+
+  memcpy(stream->payload + offset, chunk, length);
+  stream->next_offset = offset + length;
+}
+
 #endif
 
 IOTC_TT_TESTGROUP_BEGIN(utest_mqtt_parser)
@@ -100,6 +143,152 @@ IOTC_TT_TESTCASE(utest__parse_suback_response__invalid_data__parser_error, {
   tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
 })
 
+IOTC_TT_TESTCASE(utest__parse_suback__three_topics__status_for_each, {
+  iotc_mqtt_parser_t parser;
+  iotc_mqtt_message_t* msg = NULL;
+  iotc_state_t local_state = IOTC_STATE_OK;
+
+  uint8_t suback[] = {0x90, 0x05, 0x00, 0x2a, 0x01, 0x80, 0x00};
+  iotc_data_desc_t* src = iotc_make_desc_from_buffer_share(suback, 2);
+  tt_assert(NULL != src);
+
+  IOTC_ALLOC_AT(iotc_mqtt_message_t, msg, local_state);
+
+  iotc_mqtt_parser_init(&parser);
+
+  /* the statuses are split over reads to resume in the middle of the list */
+  tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==,
+            IOTC_STATE_WANT_READ);
+
+  src->data_ptr = suback + 2;
+  src->length = 3;
+  src->curr_pos = 0;
+  tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==,
+            IOTC_STATE_WANT_READ);
+
+  src->data_ptr = suback + 5;
+  src->length = 2;
+  src->curr_pos = 0;
+  tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==, IOTC_STATE_OK);
+
+  tt_int_op(msg->suback.message_id, ==, 0x2a);
+
+  const iotc_mqtt_topicpair_t* topic = msg->suback.topics;
+  tt_assert(NULL != topic);
+  tt_int_op(topic->iotc_mqtt_topic_pair_payload_u.status, ==,
+            IOTC_MQTT_QOS_1_GRANTED);
+
+  topic = topic->next;
+  tt_assert(NULL != topic);
+  tt_int_op(topic->iotc_mqtt_topic_pair_payload_u.status, ==,
+            IOTC_MQTT_SUBACK_FAILED);
+
+  topic = topic->next;
+  tt_assert(NULL != topic);
+  tt_int_op(topic->iotc_mqtt_topic_pair_payload_u.status, ==,
+            IOTC_MQTT_QOS_0_GRANTED);
+  tt_ptr_op(topic->next, ==, NULL);
+
+end:
+err_handling:
+  iotc_mqtt_message_free(&msg);
+  iotc_free_desc(&src);
+  tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
+})
+
+IOTC_TT_TESTCASE(
+    utest__parse_publish__payload_streamed__chunks_point_into_each_read, {
+      iotc_mqtt_parser_t parser;
+      iotc_mqtt_message_t* msg = NULL;
+      iotc_state_t local_state = IOTC_STATE_OK;
+      iotc_utest_payload_stream_t stream;
+
+      /* topic "a/b", payload "0123456789" */
+      uint8_t publish[] = {0x30, 0x0f, 0x00, 0x03, 'a', '/', 'b', '0', '1',
+                           '2',  '3',  '4',  '5',  '6', '7', '8', '9'};
+      iotc_data_desc_t* src = iotc_make_desc_from_buffer_share(publish, 8);
+      tt_assert(NULL != src);
+
+      IOTC_ALLOC_AT(iotc_mqtt_message_t, msg, local_state);
+
+      memset(&stream, 0, sizeof(stream));
+      stream.stream = 1;
+
+      iotc_mqtt_parser_init(&parser);
+      parser.payload_begin = &iotc_utest_payload_begin;
+      parser.payload_chunk = &iotc_utest_payload_chunk;
+      parser.payload_data = &stream;
+
+      tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==,
+                IOTC_STATE_WANT_READ);
+      tt_int_op(stream.begun, ==, 1);
+      tt_int_op(stream.total_length, ==, 10);
+      tt_ptr_op(stream.first_chunk, ==, publish + 7);
+
+      src->data_ptr = publish + 8;
+      src->length = 5;
+      src->curr_pos = 0;
+      tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==,
+                IOTC_STATE_WANT_READ);
+
+      src->data_ptr = publish + 13;
+      src->length = 4;
+      src->curr_pos = 0;
+      tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==,
+                IOTC_STATE_OK);
+
+      tt_int_op(stream.begun, ==, 1);
+      tt_int_op(stream.chunks, ==, 3);
+      tt_int_op(stream.out_of_order, ==, 0);
+      tt_int_op(stream.next_offset, ==, 10);
+      tt_int_op(memcmp(stream.payload, "0123456789", 10), ==, 0);
+
+      /* nothing of the payload was copied */
+      tt_ptr_op(msg->publish.content, ==, NULL);
+      tt_int_op(msg->publish.topic_name->length, ==, 3);
+
+    end:
+    err_handling:
+      iotc_mqtt_message_free(&msg);
+      iotc_free_desc(&src);
+      tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
+    })
+
+IOTC_TT_TESTCASE(utest__parse_publish__stream_declined__payload_buffered, {
+  iotc_mqtt_parser_t parser;
+  iotc_mqtt_message_t* msg = NULL;
+  iotc_state_t local_state = IOTC_STATE_OK;
+  iotc_utest_payload_stream_t stream;
+
+  uint8_t publish[] = {0x30, 0x08, 0x00, 0x03, 'a', '/', 'b', 'x', 'y', 'z'};
+  iotc_data_desc_t* src =
+      iotc_make_desc_from_buffer_share(publish, sizeof(publish));
+  tt_assert(NULL != src);
+
+  IOTC_ALLOC_AT(iotc_mqtt_message_t, msg, local_state);
+
+  memset(&stream, 0, sizeof(stream));
+
+  iotc_mqtt_parser_init(&parser);
+  parser.payload_begin = &iotc_utest_payload_begin;
+  parser.payload_chunk = &iotc_utest_payload_chunk;
+  parser.payload_data = &stream;
+
+  tt_int_op(iotc_mqtt_parser_execute(&parser, msg, src), ==, IOTC_STATE_OK);
+
+  tt_int_op(stream.begun, ==, 1);
+  tt_int_op(stream.chunks, ==, 0);
+  tt_assert(NULL != msg->publish.content);
+  tt_int_op(msg->publish.content->length, ==, 3);
+  tt_int_op(memcmp(msg->publish.content->data_ptr, "xyz", 3), ==, 0);
+
+end:
+err_handling:
+  iotc_mqtt_message_free(&msg);
+  iotc_free_desc(&src);
+  tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
+})
+
 IOTC_TT_TESTGROUP_END
 
 #ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
@@ -142,6 +142,55 @@ IOTC_TT_TESTCASE(
       utest__serialize_publish__valid_data_border_case__size_is_correct_impl();
     })
 
+IOTC_TT_TESTCASE(utest__serialize_subscribe__two_topics__one_packet, {
+  iotc_state_t local_state = IOTC_STATE_OK;
+  iotc_data_desc_t* buffer = NULL;
+
+  iotc_data_desc_t first_desc = make_static_desc("a/b", 3);
+  iotc_data_desc_t second_desc = make_static_desc("c", 1);
+
+  iotc_mqtt_topicpair_t second = {NULL, &second_desc, {0}};
+  iotc_mqtt_topicpair_t first = {&second, &first_desc, {0}};
+  first.iotc_mqtt_topic_pair_payload_u.qos = IOTC_MQTT_QOS_AT_LEAST_ONCE;
+  second.iotc_mqtt_topic_pair_payload_u.qos = IOTC_MQTT_QOS_AT_MOST_ONCE;
+
+  iotc_mqtt_message_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.common.common_u.common_bits.type = IOTC_MQTT_TYPE_SUBSCRIBE;
+  msg.common.common_u.common_bits.qos = IOTC_MQTT_QOS_AT_LEAST_ONCE;
+  msg.subscribe.message_id = 0x0102;
+  msg.subscribe.topics = &first;
+
+  /* both topic filters with their QoS follow the message id */
+  const uint8_t reference[] = {0x82, 0x0c, 0x01, 0x02, 0x00, 0x03, 'a',
+                               '/',  'b',  0x01, 0x00, 0x01, 'c',  0x00};
+
+  iotc_mqtt_serialiser_t serializer;
+  iotc_mqtt_serialiser_init(&serializer);
+
+  size_t message_len, remaining_len, payload_size = 0;
+  local_state = iotc_mqtt_serialiser_size(&message_len, &remaining_len,
+                                          &payload_size, NULL, &msg);
+
+  tt_int_op(local_state, ==, IOTC_STATE_OK);
+  tt_int_op(message_len, ==, sizeof(reference));
+  tt_int_op(remaining_len, ==, sizeof(reference) - 2);
+
+  buffer = iotc_make_empty_desc_alloc(message_len);
+  IOTC_CHECK_MEMORY(buffer, local_state);
+
+  tt_int_op(iotc_mqtt_serialiser_write(NULL, &msg, buffer, message_len,
+                                       remaining_len),
+            ==, IOTC_MQTT_SERIALISER_RC_SUCCESS);
+  tt_int_op(buffer->length, ==, sizeof(reference));
+  tt_int_op(memcmp(buffer->data_ptr, reference, sizeof(reference)), ==, 0);
+
+end:
+err_handling:
+  iotc_free_desc(&buffer);
+  tt_want_int_op(iotc_is_whole_memory_deallocated(), >, 0);
+})
+
 IOTC_TT_TESTGROUP_END
 
 #ifndef IOTC_TT_TESTCASE_ENUMERATION__SECONDPREPROCESSORRUN
@@ -44,6 +44,13 @@
 #define IOTC_TT_RESOURCE_MANAGER                  ( IOTC_TT_FS << 1 )
 #define IOTC_TT_IO_LAYER                          ( IOTC_TT_RESOURCE_MANAGER << 1 )
 #define IOTC_TT_TIME_EVENT                        ( IOTC_TT_IO_LAYER << 1 )
+#define IOTC_TT_MQTT_LOGIC_TASK_QUEUE             ( IOTC_TT_TIME_EVENT << 1 )
+#define IOTC_TT_MQTT_LOGIC_RTT                    ( IOTC_TT_MQTT_LOGIC_TASK_QUEUE << 1 )
+#define IOTC_TT_MQTT_LOGIC_PUBLISH_WINDOW         ( IOTC_TT_MQTT_LOGIC_RTT << 1 )
+#define IOTC_TT_MQTT_LOGIC_PUBLISH_QUEUE          ( IOTC_TT_MQTT_LOGIC_PUBLISH_WINDOW << 1 )
+#define IOTC_TT_MQTT_LOGIC_TOPIC_TRIE             ( IOTC_TT_MQTT_LOGIC_PUBLISH_QUEUE << 1 )
+#define IOTC_TT_EVENT_DISPATCHER_SUBMIT           ( IOTC_TT_MQTT_LOGIC_TOPIC_TRIE << 1 )
+#define IOTC_TT_CALLBACK_EXECUTOR                 ( IOTC_TT_EVENT_DISPATCHER_SUBMIT << 1 )
 
 // clang-format on
 
@@ -59,6 +66,8 @@
 IOTC_TT_TESTCASE_PREDECLARATION(utest_connect);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_event_dispatcher);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_event_dispatcher_timed);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_event_dispatcher_submit);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_callback_executor);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_datastructures);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_list);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_data_desc);
@@ -66,6 +75,11 @@ IOTC_TT_TESTCASE_PREDECLARATION(utest_backoff);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_ctors_dtors);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_parser);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_logic_layer_subscribe);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_logic_task_queue);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_logic_rtt);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_logic_publish_window);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_logic_publish_queue);
+IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_logic_topic_trie);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_mqtt_codec_layer_data);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_publish);
 IOTC_TT_TESTCASE_PREDECLARATION(utest_helpers);
@@ -129,6 +143,14 @@ struct testgroup_t groups[] = {
     {"utest_event_dispatcher_timed - ", utest_event_dispatcher_timed},
 #endif
 
+#if (IOTC_TT_TEST_SET & IOTC_TT_EVENT_DISPATCHER_SUBMIT)
+    {"utest_event_dispatcher_submit - ", utest_event_dispatcher_submit},
+#endif
+
+#if (IOTC_TT_TEST_SET & IOTC_TT_CALLBACK_EXECUTOR)
+    {"utest_callback_executor - ", utest_callback_executor},
+#endif
+
 #if (IOTC_TT_TEST_SET & IOTC_TT_IO_FILE)
     {"utest_io_file - ", utest_io_file},
 #endif
@@ -157,6 +179,25 @@ struct testgroup_t groups[] = {
     {"utest_mqtt_logic_layer_subscribe - ", utest_mqtt_logic_layer_subscribe},
 #endif
 
+#if (IOTC_TT_TEST_SET & IOTC_TT_MQTT_LOGIC_TASK_QUEUE)
+    {"utest_mqtt_logic_task_queue - ", utest_mqtt_logic_task_queue},
+#endif
+
+#if (IOTC_TT_TEST_SET & IOTC_TT_MQTT_LOGIC_RTT)
+    {"utest_mqtt_logic_rtt - ", utest_mqtt_logic_rtt},
+#endif
+
+#if (IOTC_TT_TEST_SET & IOTC_TT_MQTT_LOGIC_PUBLISH_WINDOW)
+    {"utest_mqtt_logic_publish_window - ", utest_mqtt_logic_publish_window},
+#endif
+
+#if (IOTC_TT_TEST_SET & IOTC_TT_MQTT_LOGIC_PUBLISH_QUEUE)
+    {"utest_mqtt_logic_publish_queue - ", utest_mqtt_logic_publish_queue},
+#endif
+#if (IOTC_TT_TEST_SET & IOTC_TT_MQTT_LOGIC_TOPIC_TRIE)
+    {"utest_mqtt_logic_topic_trie - ", utest_mqtt_logic_topic_trie},
+#endif
+
 #if (IOTC_TT_TEST_SET & IOTC_TT_PUBLISH)
     {"utest_publish - ", utest_publish},
 #endif
@@ -100,6 +100,17 @@ void iotc_debug_mqtt_message_dump(const iotc_mqtt_message_t* message) {
 }
 #endif
 
+static void iotc_mqtt_topicpair_list_free(iotc_mqtt_topicpair_t** topics) {
+  while (NULL != *topics) {
+    iotc_mqtt_topicpair_t* next = (*topics)->next;
+
+    if ((*topics)->name) iotc_free_desc(&(*topics)->name);
+    IOTC_SAFE_FREE(*topics);
+
+    *topics = next;
+  }
+}
+
 void iotc_mqtt_message_free(iotc_mqtt_message_t** msg) {
   if (msg == NULL || *msg == NULL) {
     return;
@@ -121,16 +132,10 @@ void iotc_mqtt_message_free(iotc_mqtt_message_t** msg) {
       if (m->publish.topic_name) iotc_free_desc(&m->publish.topic_name);
       break;
     case IOTC_MQTT_TYPE_SUBSCRIBE:
-      if (m->subscribe.topics) {
-        if (m->subscribe.topics) iotc_free_desc(&m->subscribe.topics->name);
-        IOTC_SAFE_FREE(m->subscribe.topics);
-      }
+      iotc_mqtt_topicpair_list_free(&m->subscribe.topics);
       break;
     case IOTC_MQTT_TYPE_SUBACK:
-      if (m->suback.topics) {
-        if (m->suback.topics->name) iotc_free_desc(&m->suback.topics->name);
-        IOTC_SAFE_FREE(m->suback.topics);
-      }
+      iotc_mqtt_topicpair_list_free(&m->suback.topics);
       break;
   }
 
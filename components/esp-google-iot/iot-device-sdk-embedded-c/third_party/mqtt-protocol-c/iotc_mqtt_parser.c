@@ -156,6 +156,56 @@ err_handling:
   IOTC_CR_END();
 }
 
+/* Hands what the source has of the payload to the chunk hook, nothing is
+ * copied so nothing can fail. */
+static iotc_state_t stream_data(iotc_mqtt_parser_t* parser,
+                                iotc_data_desc_t* src) {
+  assert(NULL != parser);
+  assert(NULL != parser->payload_chunk);
+  assert(NULL != src);
+
+  const size_t len_to_stream =
+      IOTC_MIN(parser->str_length - parser->payload_offset,
+               src->length - src->curr_pos);
+
+  if (len_to_stream > 0) {
+    parser->payload_chunk(parser->payload_data, src->data_ptr + src->curr_pos,
+                          parser->payload_offset, len_to_stream);
+
+    src->curr_pos += len_to_stream;
+    parser->payload_offset += len_to_stream;
+  }
+
+  return parser->payload_offset < parser->str_length ? IOTC_STATE_WANT_READ
+                                                      : IOTC_STATE_OK;
+}
+
+/* The lists of topic pairs are walked instead of keeping a tail pointer
+ * because the parser has to resume from a yield with nothing but the message
+ * at hand. */
+static iotc_state_t append_topicpair(iotc_mqtt_topicpair_t** list) {
+  iotc_state_t local_state = IOTC_STATE_OK;
+
+  while (NULL != *list) {
+    list = &(*list)->next;
+  }
+
+  IOTC_ALLOC_AT(iotc_mqtt_topicpair_t, *list, local_state);
+
+err_handling:
+  return local_state;
+}
+
+static iotc_mqtt_topicpair_t* last_topicpair(iotc_mqtt_topicpair_t* list) {
+  assert(NULL != list);
+
+  while (NULL != list->next) {
+    list = list->next;
+  }
+
+  return list;
+}
+
 #define READ_STRING(into)                                                  \
   do {                                                                     \
     local_state = read_string(parser, into, src);                          \
@@ -176,6 +226,13 @@ err_handling:
     }                                                                      \
   } while (local_state != IOTC_STATE_OK)
 
+#define STREAM_DATA()                                                      \
+  do {                                                                     \
+    local_state = stream_data(parser, src);                                \
+    IOTC_CR_YIELD_UNTIL(parser->cs, (local_state == IOTC_STATE_WANT_READ), \
+                        IOTC_STATE_WANT_READ);                             \
+  } while (local_state != IOTC_STATE_OK)
+
 void iotc_mqtt_parser_init(iotc_mqtt_parser_t* parser) {
   memset(parser, 0, sizeof(iotc_mqtt_parser_t));
 }
@@ -326,8 +383,18 @@ iotc_state_t iotc_mqtt_parser_execute(iotc_mqtt_parser_t* parser,
 
     parser->str_length = (parser->remaining_length + 2) - parser->data_length;
 
+    /* asked before the yields below, a resumed parser jumps past it */
+    parser->payload_streamed =
+        NULL != parser->payload_begin && NULL != parser->payload_chunk &&
+        parser->payload_begin(parser->payload_data, message,
+                              parser->str_length);
+
     if (parser->str_length > 0) {
-      READ_DATA(&message->publish.content);
+      if (parser->payload_streamed) {
+        STREAM_DATA();
+      } else {
+        READ_DATA(&message->publish.content);
+      }
     }
 
     IOTC_CR_EXIT(parser->cs, IOTC_STATE_OK);
@@ -415,21 +482,26 @@ iotc_state_t iotc_mqtt_parser_execute(iotc_mqtt_parser_t* parser,
     src->curr_pos += 1;
     parser->data_length += 1;
 
-    IOTC_CR_YIELD_ON(parser->cs, ((src->curr_pos - src->length) == 0),
-                     IOTC_STATE_WANT_READ);
+    /* one topic filter and QoS pair after another until the remaining
+     * length is used up */
+    do {
+      IOTC_CR_YIELD_ON(parser->cs, ((src->curr_pos - src->length) == 0),
+                       IOTC_STATE_WANT_READ);
 
-    IOTC_ALLOC_AT(iotc_mqtt_topicpair_t, message->subscribe.topics,
-                  local_state);
+      IOTC_CHECK_STATE(local_state =
+                           append_topicpair(&message->subscribe.topics));
 
-    READ_STRING(&message->subscribe.topics->name);
+      READ_STRING(&last_topicpair(message->subscribe.topics)->name);
 
-    IOTC_CR_YIELD_ON(parser->cs, ((src->curr_pos - src->length) == 0),
-                     IOTC_STATE_WANT_READ);
+      IOTC_CR_YIELD_ON(parser->cs, ((src->curr_pos - src->length) == 0),
+                       IOTC_STATE_WANT_READ);
 
-    message->subscribe.topics->iotc_mqtt_topic_pair_payload_u.qos =
-        (iotc_mqtt_qos_t)src->data_ptr[src->curr_pos];
-    src->curr_pos += 1;
-    parser->data_length += 1;
+      last_topicpair(message->subscribe.topics)
+          ->iotc_mqtt_topic_pair_payload_u.qos =
+          (iotc_mqtt_qos_t)src->data_ptr[src->curr_pos];
+      src->curr_pos += 1;
+      parser->data_length += 1;
+    } while (parser->data_length < parser->remaining_length + 2);
 
     IOTC_CR_EXIT(parser->cs, IOTC_STATE_OK);
   } else if (message->common.common_u.common_bits.type ==
@@ -448,18 +520,22 @@ iotc_state_t iotc_mqtt_parser_execute(iotc_mqtt_parser_t* parser,
     src->curr_pos += 1;
     parser->data_length += 1;
 
-    IOTC_CR_YIELD_ON(parser->cs, ((src->curr_pos - src->length) == 0),
-                     IOTC_STATE_WANT_READ);
+    /* a return code for each topic of the SUBSCRIBE, in the same order */
+    do {
+      IOTC_CR_YIELD_ON(parser->cs, ((src->curr_pos - src->length) == 0),
+                       IOTC_STATE_WANT_READ);
 
-    IOTC_ALLOC_AT(iotc_mqtt_topicpair_t, message->suback.topics, local_state);
+      IOTC_CHECK_STATE(local_state =
+                           append_topicpair(&message->suback.topics));
 
-    IOTC_CHECK_STATE(
-        local_state = iotc_mqtt_parse_suback_response(
-            &message->suback.topics->iotc_mqtt_topic_pair_payload_u.status,
-            src->data_ptr[src->curr_pos]));
+      IOTC_CHECK_STATE(local_state = iotc_mqtt_parse_suback_response(
+                           &last_topicpair(message->suback.topics)
+                                ->iotc_mqtt_topic_pair_payload_u.status,
+                           src->data_ptr[src->curr_pos]));
 
-    src->curr_pos += 1;
-    parser->data_length += 1;
+      src->curr_pos += 1;
+      parser->data_length += 1;
+    } while (parser->data_length < parser->remaining_length + 2);
 
     IOTC_CR_EXIT(parser->cs, IOTC_STATE_OK);
   } else if (message->common.common_u.common_bits.type ==
@@ -37,6 +37,18 @@ typedef enum iotc_mqtt_parser_rc_e {
   IOTC_MQTT_PARSER_RC_WANT_MEMORY,
 } iotc_mqtt_parser_rc_t;
 
+/* Asked once the topic of a PUBLISH is read whether its payload is to be
+ * streamed, return 1 to get it through iotc_mqtt_parser_payload_chunk_t
+ * instead of in message->publish.content. */
+typedef uint8_t(iotc_mqtt_parser_payload_begin_t)(
+    void* data, const iotc_mqtt_message_t* message, size_t total_length);
+
+/* A part of a streamed payload, valid only during the call as it points into
+ * the buffer being parsed. */
+typedef void(iotc_mqtt_parser_payload_chunk_t)(void* data,
+                                                const uint8_t* chunk,
+                                                size_t offset, size_t length);
+
 typedef struct iotc_mqtt_parser_s {
   iotc_mqtt_error_t error;
   uint16_t cs;
@@ -49,6 +61,12 @@ typedef struct iotc_mqtt_parser_s {
   size_t remaining_length;
   size_t str_length;
   size_t data_length;
+  /* optional, set after iotc_mqtt_parser_init() */
+  iotc_mqtt_parser_payload_begin_t* payload_begin;
+  iotc_mqtt_parser_payload_chunk_t* payload_chunk;
+  void* payload_data;
+  uint8_t payload_streamed;
+  size_t payload_offset;
 } iotc_mqtt_parser_t;
 
 extern void iotc_mqtt_parser_init(iotc_mqtt_parser_t* parser);
@@ -133,16 +133,24 @@ iotc_state_t iotc_mqtt_serialiser_size(size_t* msg_len, size_t* remaining_len,
     /* Empty. */
   } else if (message->common.common_u.common_bits.type ==
              IOTC_MQTT_TYPE_SUBSCRIBE) {
+    const iotc_mqtt_topicpair_t* topic = message->subscribe.topics;
+
     *msg_len += 2; /* Size msgid. */
-    *msg_len += 2; /* Size of topic. */
 
-    /* @TODO add support for multiple topics per request */
-    *msg_len += message->subscribe.topics->name->length;
-    *msg_len += 1; /* QoS. */
+    for (; NULL != topic; topic = topic->next) {
+      *msg_len += 2; /* Size of topic. */
+      *msg_len += topic->name->length;
+      *msg_len += 1; /* QoS. */
+    }
   } else if (message->common.common_u.common_bits.type ==
              IOTC_MQTT_TYPE_SUBACK) {
+    const iotc_mqtt_topicpair_t* topic = message->suback.topics;
+
     *msg_len += 2; /* Xize of the msg id. */
-    *msg_len += 1; /* QoS */
+
+    for (; NULL != topic; topic = topic->next) {
+      *msg_len += 1; /* QoS */
+    }
   } else if (message->common.common_u.common_bits.type ==
                  IOTC_MQTT_TYPE_PINGREQ ||
              message->common.common_u.common_bits.type ==
@@ -246,22 +254,26 @@ iotc_mqtt_serialiser_rc_t iotc_mqtt_serialiser_write(
       /* Write the message identifier the subscribe is using
        * the QoS 1 anyway. */
 
+      const iotc_mqtt_topicpair_t* topic = message->subscribe.topics;
+
       WRITE_16(buffer, message->subscribe.message_id);
 
-      WRITE_STRING(buffer, message->subscribe.topics->name);
+      for (; NULL != topic; topic = topic->next) {
+        WRITE_STRING(buffer, topic->name);
 
-      WRITE_8(
-          buffer,
-          message->subscribe.topics->iotc_mqtt_topic_pair_payload_u.qos & 0xFF);
+        WRITE_8(buffer, topic->iotc_mqtt_topic_pair_payload_u.qos & 0xFF);
+      }
       break;
     }
 
     case IOTC_MQTT_TYPE_SUBACK: {
+      const iotc_mqtt_topicpair_t* topic = message->suback.topics;
+
       WRITE_16(buffer, message->suback.message_id);
 
-      WRITE_8(buffer,
-              message->subscribe.topics->iotc_mqtt_topic_pair_payload_u.status &
-                  0xFF);
+      for (; NULL != topic; topic = topic->next) {
+        WRITE_8(buffer, topic->iotc_mqtt_topic_pair_payload_u.status & 0xFF);
+      }
       break;
     }
 
@@ -0,0 +1,50 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_BSP_IO_NET_ROUTE_H__
+#define __IOTC_BSP_IO_NET_ROUTE_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sets the source address of new connections.
+ *
+ * With more than one network interface up, binding to the address of an
+ * interface routes the connection through it. Established connections keep
+ * their route.
+ *
+ * @param [in] source IPv4 address of the interface, NULL for any. IPv6
+ * results of the name lookup are skipped while a source is set.
+ */
+void iotc_bsp_io_net_set_source(const struct in_addr* source);
+
+/**
+ * @brief Gets the bytes written to and read from the library's sockets.
+ *
+ * The counters start at boot and include TLS records, not TCP/IP headers.
+ */
+void iotc_bsp_io_net_get_counters(uint64_t* sent, uint64_t* received);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_BSP_IO_NET_ROUTE_H__ */
@@ -0,0 +1,56 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IOTC_BSP_TLS_SESSION_H__
+#define __IOTC_BSP_TLS_SESSION_H__
+
+#include <mbedtls/ssl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief TLS session cache shared by all connections to the broker.
+ *
+ * The session of the last full handshake is offered by the next one, which
+ * then skips the certificate exchange and the key agreement if the server
+ * still knows it. Sessions do not depend on the route, so a session set up on
+ * one network interface is resumed on another.
+ */
+
+/**
+ * @brief Keeps the session of an established connection.
+ */
+void iotc_bsp_tls_session_save(const mbedtls_ssl_context* ssl);
+
+/**
+ * @brief Offers the kept session, to be called before the handshake.
+ *
+ * @return 1 if a session was offered, 0 otherwise.
+ */
+int iotc_bsp_tls_session_load(mbedtls_ssl_context* ssl);
+
+/**
+ * @brief Drops the kept session.
+ */
+void iotc_bsp_tls_session_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IOTC_BSP_TLS_SESSION_H__ */
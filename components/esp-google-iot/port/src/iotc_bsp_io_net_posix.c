@@ -20,11 +20,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include "iotc_bsp_io_net_route.h"
 #include "iotc_macros.h"
 
 #ifdef __cplusplus
@@ -35,6 +37,64 @@ extern "C" {
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #endif
 
+/* set by the application, used by the libiotc event loop */
+static pthread_mutex_t route_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct in_addr route_source;
+static int route_source_set = 0;
+static uint64_t route_bytes_sent = 0;
+static uint64_t route_bytes_received = 0;
+
+void iotc_bsp_io_net_set_source(const struct in_addr* source) {
+  pthread_mutex_lock(&route_lock);
+  route_source_set = NULL != source;
+  if (NULL != source) {
+    route_source = *source;
+  }
+  pthread_mutex_unlock(&route_lock);
+}
+
+void iotc_bsp_io_net_get_counters(uint64_t* sent, uint64_t* received) {
+  pthread_mutex_lock(&route_lock);
+  *sent = route_bytes_sent;
+  *received = route_bytes_received;
+  pthread_mutex_unlock(&route_lock);
+}
+
+/* a UDP socket connected to itself on the loopback interface, lwIP has no
+ * pipes. Sending it a datagram cuts the select it is part of short. */
+static int wakeup_socket = -1;
+static pthread_once_t wakeup_once = PTHREAD_ONCE_INIT;
+
+static void wakeup_init(void) {
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  if (-1 == fd) {
+    return;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (-1 == bind(fd, (struct sockaddr*)&address, sizeof(address)) ||
+      -1 == getsockname(fd, (struct sockaddr*)&address, &length) ||
+      -1 == connect(fd, (struct sockaddr*)&address, length)) {
+    close(fd);
+    return;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  wakeup_socket = fd;
+}
+
+static void route_count(uint64_t* counter, int count) {
+  pthread_mutex_lock(&route_lock);
+  *counter += count;
+  pthread_mutex_unlock(&route_lock);
+}
+
 iotc_bsp_io_net_state_t iotc_bsp_io_net_socket_connect(
     iotc_bsp_socket_t* iotc_socket, const char* host, uint16_t port,
     iotc_bsp_socket_type_t socket_type) {
@@ -54,10 +114,27 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_socket_connect(
     return IOTC_BSP_IO_NET_STATE_ERROR;
   }
 
+  struct sockaddr_in source;
+  memset(&source, 0, sizeof(source));
+  pthread_mutex_lock(&route_lock);
+  const int source_set = route_source_set;
+  source.sin_family = AF_INET;
+  source.sin_addr = route_source;
+  pthread_mutex_unlock(&route_lock);
+
   for (rp = result; rp != NULL; rp = rp->ai_next) {
+    if (source_set && AF_INET != rp->ai_family) continue;
+
     *iotc_socket = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
     if (-1 == *iotc_socket) continue;
 
+    // Pick the interface to connect through.
+    if (source_set &&
+        -1 == bind(*iotc_socket, (struct sockaddr*)&source, sizeof(source))) {
+      close(*iotc_socket);
+      continue;
+    }
+
     // Set the socket to be non-blocking.
     const int flags = fcntl(*iotc_socket, F_GETFL);
     if (-1 == fcntl(*iotc_socket, F_SETFL, flags | O_NONBLOCK)) {
@@ -156,6 +233,8 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_write(iotc_bsp_socket_t iotc_socket,
     return IOTC_BSP_IO_NET_STATE_ERROR;
   }
 
+  route_count(&route_bytes_sent, *out_written_count);
+
   return IOTC_BSP_IO_NET_STATE_OK;
 }
 
@@ -190,6 +269,8 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_read(iotc_bsp_socket_t iotc_socket,
     return IOTC_BSP_IO_NET_STATE_CONNECTION_RESET;
   }
 
+  route_count(&route_bytes_received, *out_read_count);
+
   return IOTC_BSP_IO_NET_STATE_OK;
 }
 
@@ -259,6 +340,13 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
     }
   }
 
+  pthread_once(&wakeup_once, wakeup_init);
+
+  if (-1 != wakeup_socket) {
+    FD_SET(wakeup_socket, &rfds);
+    max_fd_read = MAX(max_fd_read, wakeup_socket);
+  }
+
   /* calculate max fd */
   const int max_fd = MAX(max_fd_read, MAX(max_fd_write, max_fd_error));
 
@@ -267,6 +355,13 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
   /* call the actual posix select */
   const int result = select(max_fd + 1, &rfds, &wfds, &efds, &tv);
 
+  if (0 < result && -1 != wakeup_socket && FD_ISSET(wakeup_socket, &rfds)) {
+    char drain;
+
+    while (0 < recv(wakeup_socket, &drain, sizeof(drain), 0))
+      ;
+  }
+
   if (0 < result) {
     /* translate the result back to the socket events structure */
     for (socket_id = 0; socket_id < socket_events_array_size; ++socket_id) {
@@ -299,6 +394,24 @@ iotc_bsp_io_net_state_t iotc_bsp_io_net_select(
   return IOTC_BSP_IO_NET_STATE_ERROR;
 }
 
+iotc_bsp_io_net_state_t iotc_bsp_io_net_select_wakeup(void) {
+  pthread_once(&wakeup_once, wakeup_init);
+
+  if (-1 == wakeup_socket) {
+    return IOTC_BSP_IO_NET_STATE_ERROR;
+  }
+
+  const char wakeup = 0;
+
+  /* a full receive buffer has wakeups enough pending */
+  if (-1 == send(wakeup_socket, &wakeup, sizeof(wakeup), 0) &&
+      EAGAIN != errno && EWOULDBLOCK != errno) {
+    return IOTC_BSP_IO_NET_STATE_ERROR;
+  }
+
+  return IOTC_BSP_IO_NET_STATE_OK;
+}
+
 #ifdef __cplusplus
 }
 #endif
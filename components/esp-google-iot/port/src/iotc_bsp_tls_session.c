@@ -0,0 +1,65 @@
+/* Copyright 2018-2020 Google LLC
+ *
+ * This is part of the Google Cloud IoT Device SDK for Embedded C.
+ * It is licensed under the BSD 3-Clause license; you may not use this file
+ * except in compliance with the License.
+ *
+ * You may obtain a copy of the License at:
+ *  https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iotc_bsp_tls_session.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* saved by the libiotc event loop and by connection probes of the
+ * application, which run in different tasks */
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+static mbedtls_ssl_session session;
+static int session_valid = 0;
+
+void iotc_bsp_tls_session_save(const mbedtls_ssl_context* ssl) {
+  pthread_mutex_lock(&session_lock);
+  if (session_valid) {
+    mbedtls_ssl_session_free(&session);
+  }
+  mbedtls_ssl_session_init(&session);
+  session_valid = 0 == mbedtls_ssl_get_session(ssl, &session);
+  if (!session_valid) {
+    mbedtls_ssl_session_free(&session);
+  }
+  pthread_mutex_unlock(&session_lock);
+}
+
+int iotc_bsp_tls_session_load(mbedtls_ssl_context* ssl) {
+  int offered = 0;
+  pthread_mutex_lock(&session_lock);
+  if (session_valid) {
+    offered = 0 == mbedtls_ssl_set_session(ssl, &session);
+  }
+  pthread_mutex_unlock(&session_lock);
+  return offered;
+}
+
+void iotc_bsp_tls_session_clear(void) {
+  pthread_mutex_lock(&session_lock);
+  if (session_valid) {
+    mbedtls_ssl_session_free(&session);
+    session_valid = 0;
+  }
+  pthread_mutex_unlock(&session_lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
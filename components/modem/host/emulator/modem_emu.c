@@ -0,0 +1,97 @@
+/*
+ * Standalone emulator: serves a transcript on a pseudo terminal until interrupted
+ *
+ * The name of the terminal is printed, e.g. for a terminal program or an application built for the host.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "esp_log.h"
+#include "modem_emulator.h"
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int signal)
+{
+    s_stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    int opt;
+    while ((opt = getopt(argc, argv, "l:j:u:N:f:b:r:L:s:v")) != -1) {
+        switch (opt) {
+        case 'l':
+            config.latency_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            config.jitter_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'u':
+            config.urc_interval_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'N':
+            config.noise_permille = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            config.flip_ppm = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            config.baud = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            config.rtt_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'L':
+            config.loss_permille = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            config.seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            esp_log_level_set("*", ESP_LOG_DEBUG);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind != argc - 1) {
+        goto usage;
+    }
+    int master;
+    int slave;
+    char name[64];
+    if (modem_emulator_open_pty(&master, &slave, name, sizeof(name))) {
+        perror("open pseudo terminal");
+        return 1;
+    }
+    modem_emulator_t *emulator = modem_emulator_start(argv[optind], &config, master);
+    if (emulator == NULL) {
+        return 1;
+    }
+    printf("%s\n", name);
+    fflush(stdout);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    while (!s_stop) {
+        pause();
+    }
+    modem_emulator_stats_t stats;
+    modem_emulator_get_stats(emulator, &stats);
+    modem_emulator_stop(emulator);
+    fprintf(stderr, "%u commands (%u unknown), %u lines, %u URCs, %u garbage lines, %u corrupted bytes, "
+            "%u data bytes, %u frames (%u lost)\n",
+            stats.commands, stats.unknown, stats.lines, stats.urcs, stats.noise_lines, stats.flipped_bytes,
+            stats.data_bytes, stats.data_frames, stats.lost_frames);
+    close(slave);
+    close(master);
+    return 0;
+usage:
+    fprintf(stderr, "usage: %s [-l ms] [-j ms] [-u ms] [-N 1/1000] [-f 1/1e6] [-b baud] [-r ms] [-L 1/1000] [-s seed] "
+            "[-v] <transcript>\n",
+            argv[0]);
+    return 2;
+}
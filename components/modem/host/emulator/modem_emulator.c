@@ -0,0 +1,830 @@
+/*
+ * Scriptable AT modem on the master side of a pseudo terminal, see modem_emulator.h
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "modem_emulator.h"
+
+#define EMULATOR_COMMAND_MAX (512)
+#define EMULATOR_TEXT_MAX (256)
+#define EMULATOR_URC_MAX (16)
+#define EMULATOR_INJECT_MAX (8)
+#define EMULATOR_ESCAPE "+++"
+#define EMULATOR_FRAME_MAX (4096)
+#define EMULATOR_PPP_FLAG (0x7e)
+#define EMULATOR_PPP_ESCAPE (0x7d)
+#define EMULATOR_LCP_MAX (64)
+
+/* statistics are written by the emulator thread and read by others */
+#define STAT_ADD(emulator, field, n) __atomic_fetch_add(&(emulator)->stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_GET(emulator, field) __atomic_load_n(&(emulator)->stats.field, __ATOMIC_RELAXED)
+
+static const char *TAG = "emulator";
+
+typedef enum {
+    ITEM_LINE,      /*!< Line, sent as "\r\n<text>\r\n" */
+    ITEM_RAW,       /*!< Bytes sent as they are */
+    ITEM_DELAY,     /*!< Pause before the next item */
+    ITEM_DATA       /*!< Enter data mode */
+} item_type_t;
+
+typedef struct item {
+    item_type_t type;
+    char *text;
+    size_t length;
+    uint32_t delay_ms;
+    struct item *next;
+} item_t;
+
+/**
+ * @brief Frame on the shaped link
+ */
+typedef struct frame {
+    int64_t deliver_us;         /*!< Time the frame has passed the link */
+    size_t length;
+    struct frame *next;
+    char data[];
+} frame_t;
+
+typedef struct rule {
+    char *command;
+    bool prefix;                /*!< Match commands starting with command */
+    item_t *items;
+    item_t **tail;
+    struct rule *next;
+} rule_t;
+
+struct modem_emulator {
+    int fd;
+    int wakeup[2];              /*!< Pipe, wakes the emulator thread for injected lines and stop */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    modem_emulator_config_t config;
+    modem_emulator_config_t active;  /*!< Copy of config taken by the emulator thread */
+    modem_emulator_stats_t stats;
+    rule_t *rules;
+    char *boot[EMULATOR_URC_MAX];
+    int boot_count;
+    char *urc[EMULATOR_URC_MAX];
+    int urc_count;
+    int urc_next;
+    char *inject[EMULATOR_INJECT_MAX];
+    int inject_count;
+    bool echo;
+    bool data_mode;
+    bool stop;
+    size_t escape_match;
+    char command[EMULATOR_COMMAND_MAX];
+    size_t command_len;
+    char frame[EMULATOR_FRAME_MAX];  /*!< Data mode frame being collected for the shaped link */
+    size_t frame_len;
+    bool frame_data;            /*!< The frame has more than flags */
+    frame_t *link;              /*!< Frames on the shaped link, in delivery order */
+    frame_t **link_tail;
+    int64_t link_free_us;       /*!< Time the shaped link has sent everything queued so far */
+    unsigned int random;
+    int64_t last_response_us;
+    int64_t last_urc_us;
+};
+
+int modem_emulator_open_pty(int *master, int *slave, char *slave_name, size_t size)
+{
+    *master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (*master < 0) {
+        return -1;
+    }
+    if (grantpt(*master) || unlockpt(*master)) {
+        goto err;
+    }
+    const char *name = ptsname(*master);
+    if (name == NULL) {
+        goto err;
+    }
+    if (slave_name) {
+        snprintf(slave_name, size, "%s", name);
+    }
+    *slave = open(name, O_RDWR | O_NOCTTY);
+    if (*slave < 0) {
+        goto err;
+    }
+    /* no echo, no line editing, no CR/LF translation on either side */
+    struct termios tio;
+    tcgetattr(*slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+    tcgetattr(*master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*master, TCSANOW, &tio);
+    return 0;
+err:
+    close(*master);
+    return -1;
+}
+
+/**
+ * @brief Resolve C escapes (\r, \n, \t, \\, \xHH) in place
+ */
+static size_t unescape(char *text)
+{
+    char *out = text;
+    for (char *in = text; *in; in++) {
+        if (*in != '\\' || !in[1]) {
+            *out++ = *in;
+            continue;
+        }
+        switch (*++in) {
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case 'x': {
+            char hex[3] = { in[1], in[1] ? in[2] : '\0', '\0' };
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += strlen(hex);
+            break;
+        }
+        default:
+            *out++ = *in;
+            break;
+        }
+    }
+    *out = '\0';
+    return out - text;
+}
+
+static void free_rules(modem_emulator_t *emulator)
+{
+    while (emulator->rules) {
+        rule_t *rule = emulator->rules;
+        emulator->rules = rule->next;
+        while (rule->items) {
+            item_t *item = rule->items;
+            rule->items = item->next;
+            free(item->text);
+            free(item);
+        }
+        free(rule->command);
+        free(rule);
+    }
+    for (int i = 0; i < emulator->boot_count; i++) {
+        free(emulator->boot[i]);
+    }
+    for (int i = 0; i < emulator->urc_count; i++) {
+        free(emulator->urc[i]);
+    }
+}
+
+static bool add_item(rule_t *rule, item_type_t type, const char *text, uint32_t delay_ms)
+{
+    item_t *item = calloc(1, sizeof(item_t));
+    if (item == NULL) {
+        return false;
+    }
+    item->type = type;
+    item->delay_ms = delay_ms;
+    if (text) {
+        item->text = strdup(text);
+        if (item->text == NULL) {
+            free(item);
+            return false;
+        }
+        item->length = type == ITEM_RAW ? unescape(item->text) : strlen(item->text);
+    }
+    *rule->tail = item;
+    rule->tail = &item->next;
+    return true;
+}
+
+/**
+ * @brief Parse a transcript
+ *
+ * Format, one directive per line:
+ *   # comment
+ *   @echo <0|1>      command echo after boot, ATE0/ATE1 change it
+ *   @boot <line>     sent when the emulator starts
+ *   @urc <line>      sent in turn every urc_interval_ms
+ *   > <command>      starts the rule for a command (without "\r")
+ *   >> <prefix>      starts the rule for all commands starting with prefix
+ *   < <line>         response line
+ *   <= <bytes>       response bytes without line framing, C escapes allowed
+ *   ~ <ms>           pause before the next response item
+ *   & data           data mode after the response, bytes are looped back until "+++", see modem_emulator.h
+ * Rules are matched in transcript order, commands without a rule are answered with ERROR.
+ */
+static bool load_transcript(modem_emulator_t *emulator, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "can not open %s: %s", path, strerror(errno));
+        return false;
+    }
+    char line[EMULATOR_TEXT_MAX];
+    rule_t *rule = NULL;
+    rule_t **tail = &emulator->rules;
+    int number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *arg = strchr(line, ' ');
+        arg = arg ? arg + 1 : line + strlen(line);
+        bool ok = true;
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        } else if (!strncmp(line, "@echo ", 6)) {
+            emulator->echo = atoi(arg) != 0;
+        } else if (!strncmp(line, "@boot ", 6) && emulator->boot_count < EMULATOR_URC_MAX) {
+            ok = (emulator->boot[emulator->boot_count++] = strdup(arg)) != NULL;
+        } else if (!strncmp(line, "@urc ", 5) && emulator->urc_count < EMULATOR_URC_MAX) {
+            ok = (emulator->urc[emulator->urc_count++] = strdup(arg)) != NULL;
+        } else if (!strncmp(line, "> ", 2) || !strncmp(line, ">> ", 3)) {
+            rule = calloc(1, sizeof(rule_t));
+            ok = rule && (rule->command = strdup(arg)) != NULL;
+            if (rule) {
+                rule->prefix = line[1] == '>';
+                rule->tail = &rule->items;
+                *tail = rule;
+                tail = &rule->next;
+            }
+        } else if (rule && !strncmp(line, "<= ", 3)) {
+            ok = add_item(rule, ITEM_RAW, arg, 0);
+        } else if (rule && !strncmp(line, "< ", 2)) {
+            ok = add_item(rule, ITEM_LINE, arg, 0);
+        } else if (rule && !strncmp(line, "~ ", 2)) {
+            ok = add_item(rule, ITEM_DELAY, NULL, atoi(arg));
+        } else if (rule && !strcmp(line, "& data")) {
+            ok = add_item(rule, ITEM_DATA, NULL, 0);
+        } else {
+            ESP_LOGE(TAG, "%s:%d: invalid directive: %s", path, number, line);
+            ok = false;
+        }
+        if (!ok) {
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static uint32_t random_below(modem_emulator_t *emulator, uint32_t limit)
+{
+    return limit ? (uint32_t)rand_r(&emulator->random) % limit : 0;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+    struct timespec delay = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (long)(ms % 1000) * 1000000
+    };
+    while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {
+    }
+}
+
+/**
+ * @brief Write bytes to the DTE, corrupting some of them if configured
+ */
+static void emit(modem_emulator_t *emulator, const char *data, size_t length)
+{
+    char *copy = NULL;
+    if (emulator->active.flip_ppm) {
+        copy = malloc(length);
+        if (copy) {
+            memcpy(copy, data, length);
+            for (size_t i = 0; i < length; i++) {
+                if (random_below(emulator, 1000000) < emulator->active.flip_ppm) {
+                    copy[i] ^= 1 << random_below(emulator, 8);
+                    STAT_ADD(emulator, flipped_bytes, 1);
+                }
+            }
+            data = copy;
+        }
+    }
+    size_t done = 0;
+    while (done < length) {
+        ssize_t written = write(emulator->fd, data + done, length - done);
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            break;
+        }
+        done += written;
+    }
+    free(copy);
+}
+
+static void emit_line(modem_emulator_t *emulator, const char *text)
+{
+    char framed[EMULATOR_TEXT_MAX + 4];
+    int length = snprintf(framed, sizeof(framed), "\r\n%s\r\n", text);
+    emit(emulator, framed, length);
+    STAT_ADD(emulator, lines, 1);
+}
+
+/**
+ * @brief Maybe send a line of printable garbage, like a glitch on the line or a line of an unknown URC
+ */
+static void emit_noise(modem_emulator_t *emulator)
+{
+    if (random_below(emulator, 1000) >= emulator->active.noise_permille) {
+        return;
+    }
+    char garbage[33];
+    uint32_t length = 1 + random_below(emulator, sizeof(garbage) - 1);
+    for (uint32_t i = 0; i < length; i++) {
+        garbage[i] = '!' + random_below(emulator, '~' - '!');
+    }
+    garbage[length] = '\0';
+    emit_line(emulator, garbage);
+    STAT_ADD(emulator, noise_lines, 1);
+}
+
+static void emit_urc(modem_emulator_t *emulator, const char *line)
+{
+    emit_noise(emulator);
+    __atomic_store_n(&emulator->last_urc_us, esp_timer_get_time(), __ATOMIC_RELEASE);
+    emit_line(emulator, line);
+    STAT_ADD(emulator, urcs, 1);
+}
+
+static const rule_t *find_rule(modem_emulator_t *emulator, const char *command)
+{
+    for (const rule_t *rule = emulator->rules; rule; rule = rule->next) {
+        if (rule->prefix ? !strncmp(command, rule->command, strlen(rule->command)) : !strcmp(command, rule->command)) {
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+static void handle_command(modem_emulator_t *emulator, const char *command)
+{
+    STAT_ADD(emulator, commands, 1);
+    if (!strcmp(command, "ATE0")) {
+        emulator->echo = false;
+    } else if (!strcmp(command, "ATE1")) {
+        emulator->echo = true;
+    }
+    const rule_t *rule = find_rule(emulator, command);
+    sleep_ms(emulator->active.latency_ms + random_below(emulator, emulator->active.jitter_ms + 1));
+    emit_noise(emulator);
+    __atomic_store_n(&emulator->last_response_us, esp_timer_get_time(), __ATOMIC_RELEASE);
+    if (rule == NULL) {
+        ESP_LOGD(TAG, "no rule for %s", command);
+        STAT_ADD(emulator, unknown, 1);
+        emit_line(emulator, "ERROR");
+        return;
+    }
+    for (const item_t *item = rule->items; item; item = item->next) {
+        switch (item->type) {
+        case ITEM_LINE:
+            emit_line(emulator, item->text);
+            break;
+        case ITEM_RAW:
+            emit(emulator, item->text, item->length);
+            break;
+        case ITEM_DELAY:
+            sleep_ms(item->delay_ms);
+            __atomic_store_n(&emulator->last_response_us, esp_timer_get_time(), __ATOMIC_RELEASE);
+            break;
+        case ITEM_DATA:
+            emulator->data_mode = true;
+            emulator->escape_match = 0;
+            break;
+        }
+    }
+}
+
+static bool link_shaped(modem_emulator_t *emulator)
+{
+    return emulator->active.baud || emulator->active.rtt_ms || emulator->active.loss_permille;
+}
+
+/**
+ * @brief Put a frame on the shaped link, it is sent back after its transmission time and the round trip time
+ */
+static void link_send(modem_emulator_t *emulator, const char *data, size_t length)
+{
+    STAT_ADD(emulator, data_frames, 1);
+    if (random_below(emulator, 1000) < emulator->active.loss_permille) {
+        STAT_ADD(emulator, lost_frames, 1);
+        return;
+    }
+    frame_t *frame = malloc(sizeof(frame_t) + length);
+    if (frame == NULL) {
+        STAT_ADD(emulator, lost_frames, 1);
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t start = emulator->link_free_us > now ? emulator->link_free_us : now;
+    uint32_t baud = emulator->active.baud;
+    emulator->link_free_us = start + (baud ? (int64_t)length * 10 * 1000000 / baud : 0);
+    frame->deliver_us = emulator->link_free_us + (int64_t)emulator->active.rtt_ms * 1000;
+    frame->length = length;
+    frame->next = NULL;
+    memcpy(frame->data, data, length);
+    *emulator->link_tail = frame;
+    emulator->link_tail = &frame->next;
+}
+
+static uint16_t ppp_fcs(const uint8_t *data, size_t length)
+{
+    uint16_t fcs = 0xffff;
+    while (length--) {
+        fcs ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            fcs = fcs & 1 ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+        }
+    }
+    return fcs;
+}
+
+/**
+ * @brief Turn an LCP Echo-Request into the Echo-Reply of the network side, in place, other frames stay as they are
+ */
+static void lcp_echo_reply(char *frame, size_t *length)
+{
+    uint8_t lcp[EMULATOR_LCP_MAX];
+    size_t lcp_len = 0;
+    bool escaped = false;
+    for (size_t i = 0; i < *length; i++) {
+        uint8_t c = frame[i];
+        if (c == EMULATOR_PPP_FLAG) {
+            if (lcp_len) {
+                break;
+            }
+        } else if (c == EMULATOR_PPP_ESCAPE) {
+            escaped = true;
+        } else if (lcp_len == sizeof(lcp)) {
+            return;
+        } else {
+            lcp[lcp_len++] = escaped ? c ^ 0x20 : c;
+            escaped = false;
+        }
+    }
+    /* address, control, protocol, code 9, id, length, magic number, FCS */
+    if (lcp_len < 4 + 8 + 2 || lcp[0] != 0xff || lcp[1] != 0x03 || lcp[2] != 0xc0 || lcp[3] != 0x21 ||
+            lcp[4] != 9 || ppp_fcs(lcp, lcp_len) != 0xf0b8) {
+        return;
+    }
+    /* no magic number negotiated on this side */
+    lcp[4] = 10;
+    memset(lcp + 8, 0, 4);
+    uint16_t fcs = ppp_fcs(lcp, lcp_len - 2) ^ 0xffff;
+    lcp[lcp_len - 2] = fcs & 0xff;
+    lcp[lcp_len - 1] = fcs >> 8;
+    size_t out = 0;
+    frame[out++] = EMULATOR_PPP_FLAG;
+    for (size_t i = 0; i < lcp_len; i++) {
+        if (lcp[i] < 0x20 || lcp[i] == EMULATOR_PPP_FLAG || lcp[i] == EMULATOR_PPP_ESCAPE) {
+            frame[out++] = EMULATOR_PPP_ESCAPE;
+            frame[out++] = lcp[i] ^ 0x20;
+        } else {
+            frame[out++] = lcp[i];
+        }
+    }
+    frame[out++] = EMULATOR_PPP_FLAG;
+    *length = out;
+}
+
+/**
+ * @brief Send the frames which have passed the shaped link, or all of them
+ */
+static void link_deliver(modem_emulator_t *emulator, bool all)
+{
+    int64_t now = esp_timer_get_time();
+    while (emulator->link && (all || emulator->link->deliver_us <= now)) {
+        frame_t *frame = emulator->link;
+        emulator->link = frame->next;
+        if (emulator->link == NULL) {
+            emulator->link_tail = &emulator->link;
+        }
+        emit(emulator, frame->data, frame->length);
+        STAT_ADD(emulator, data_bytes, frame->length);
+        free(frame);
+    }
+}
+
+/**
+ * @brief Send a partially collected frame as it is
+ */
+static void link_flush(modem_emulator_t *emulator)
+{
+    link_deliver(emulator, true);
+    if (emulator->frame_len) {
+        emit(emulator, emulator->frame, emulator->frame_len);
+        STAT_ADD(emulator, data_bytes, emulator->frame_len);
+    }
+    emulator->frame_len = 0;
+    emulator->frame_data = false;
+}
+
+/**
+ * @brief Loop data back, directly or frame by frame over the shaped link
+ */
+static void loop_back(modem_emulator_t *emulator, const char *data, size_t length)
+{
+    if (!link_shaped(emulator)) {
+        link_flush(emulator);
+        emit(emulator, data, length);
+        STAT_ADD(emulator, data_bytes, length);
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (emulator->frame_len == EMULATOR_FRAME_MAX) {
+            link_send(emulator, emulator->frame, emulator->frame_len);
+            emulator->frame_len = 0;
+        }
+        emulator->frame[emulator->frame_len++] = data[i];
+        if ((uint8_t)data[i] != EMULATOR_PPP_FLAG) {
+            emulator->frame_data = true;
+        } else if (emulator->frame_data) {
+            /* echoes are answered by the network, everything else is looped back */
+            lcp_echo_reply(emulator->frame, &emulator->frame_len);
+            link_send(emulator, emulator->frame, emulator->frame_len);
+            emulator->frame_len = 0;
+            emulator->frame_data = false;
+        }
+    }
+}
+
+/**
+ * @brief Loop data back to the DTE until the escape sequence
+ */
+static void handle_data(modem_emulator_t *emulator, const char *data, size_t length)
+{
+    /* a partial escape sequence held back from the last read is matched again, together with this one */
+    char joined[strlen(EMULATOR_ESCAPE) + length];
+    if (emulator->escape_match) {
+        memcpy(joined, EMULATOR_ESCAPE, emulator->escape_match);
+        memcpy(joined + emulator->escape_match, data, length);
+        data = joined;
+        length += emulator->escape_match;
+        emulator->escape_match = 0;
+    }
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == EMULATOR_ESCAPE[emulator->escape_match]) {
+            if (++emulator->escape_match == strlen(EMULATOR_ESCAPE)) {
+                /* the escape sequence itself is not looped back */
+                size_t end = i + 1 - strlen(EMULATOR_ESCAPE);
+                if (end > start) {
+                    loop_back(emulator, data + start, end - start);
+                }
+                /* whatever is still on the link arrives before the result code */
+                link_flush(emulator);
+                emulator->data_mode = false;
+                emulator->command_len = 0;
+                sleep_ms(emulator->active.latency_ms);
+                __atomic_store_n(&emulator->last_response_us, esp_timer_get_time(), __ATOMIC_RELEASE);
+                emit_line(emulator, "OK");
+                /* the rest is a command already */
+                for (size_t j = i + 1; j < length && emulator->command_len < EMULATOR_COMMAND_MAX - 1; j++) {
+                    emulator->command[emulator->command_len++] = data[j];
+                }
+                return;
+            }
+        } else {
+            emulator->escape_match = data[i] == EMULATOR_ESCAPE[0] ? 1 : 0;
+        }
+    }
+    /* hold back a partial escape sequence, it is sent once it turns out to be data */
+    size_t end = length > emulator->escape_match ? length - emulator->escape_match : 0;
+    if (end > start) {
+        loop_back(emulator, data + start, end - start);
+    }
+}
+
+static void handle_input(modem_emulator_t *emulator, const char *data, size_t length)
+{
+    if (emulator->data_mode) {
+        handle_data(emulator, data, length);
+        return;
+    }
+    if (emulator->echo) {
+        emit(emulator, data, length);
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            continue;
+        }
+        if (c != '\r') {
+            if (emulator->command_len < EMULATOR_COMMAND_MAX - 1) {
+                emulator->command[emulator->command_len++] = c;
+            }
+            continue;
+        }
+        emulator->command[emulator->command_len] = '\0';
+        emulator->command_len = 0;
+        if (emulator->command[0]) {
+            handle_command(emulator, emulator->command);
+            if (emulator->data_mode && i + 1 < length) {
+                handle_data(emulator, data + i + 1, length - i - 1);
+                return;
+            }
+        }
+    }
+}
+
+static void *emulator_task(void *arg)
+{
+    modem_emulator_t *emulator = arg;
+    for (int i = 0; i < emulator->boot_count; i++) {
+        emit_line(emulator, emulator->boot[i]);
+    }
+    int64_t next_urc_us = 0;
+    while (true) {
+        pthread_mutex_lock(&emulator->lock);
+        bool stop = emulator->stop;
+        emulator->active = emulator->config;
+        uint32_t interval_ms = emulator->active.urc_interval_ms;
+        char *inject[EMULATOR_INJECT_MAX];
+        int inject_count = emulator->inject_count;
+        memcpy(inject, emulator->inject, sizeof(inject));
+        emulator->inject_count = 0;
+        pthread_mutex_unlock(&emulator->lock);
+        if (stop) {
+            break;
+        }
+        for (int i = 0; i < inject_count; i++) {
+            emit_urc(emulator, inject[i]);
+            free(inject[i]);
+        }
+
+        link_deliver(emulator, false);
+        int64_t now = esp_timer_get_time();
+        int64_t timeout_us = -1;
+        if (interval_ms && emulator->urc_count && !emulator->data_mode) {
+            if (next_urc_us == 0) {
+                next_urc_us = now + (int64_t)interval_ms * 1000;
+            }
+            if (now >= next_urc_us) {
+                emit_urc(emulator, emulator->urc[emulator->urc_next]);
+                emulator->urc_next = (emulator->urc_next + 1) % emulator->urc_count;
+                next_urc_us += (int64_t)interval_ms * 1000;
+                if (next_urc_us < now) {
+                    next_urc_us = now + (int64_t)interval_ms * 1000;
+                }
+            }
+            timeout_us = next_urc_us - now;
+        } else {
+            next_urc_us = 0;
+        }
+        if (emulator->link) {
+            int64_t link_us = emulator->link->deliver_us > now ? emulator->link->deliver_us - now : 0;
+            timeout_us = timeout_us < 0 || link_us < timeout_us ? link_us : timeout_us;
+        }
+        struct timespec timeout = {
+            .tv_sec = timeout_us / 1000000,
+            .tv_nsec = (long)(timeout_us % 1000000) * 1000,
+        };
+
+        struct pollfd fds[2] = {
+            { .fd = emulator->fd, .events = POLLIN },
+            { .fd = emulator->wakeup[0], .events = POLLIN },
+        };
+        if (ppoll(fds, 2, timeout_us < 0 ? NULL : &timeout, NULL) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            char drain[16];
+            (void)!read(emulator->wakeup[0], drain, sizeof(drain));
+            /* a command sent after modem_emulator_set_config() may be read right below, it sees the new config */
+            pthread_mutex_lock(&emulator->lock);
+            emulator->active = emulator->config;
+            pthread_mutex_unlock(&emulator->lock);
+        }
+        if (fds[0].revents & POLLIN) {
+            char data[EMULATOR_COMMAND_MAX];
+            ssize_t length = read(emulator->fd, data, sizeof(data));
+            if (length > 0) {
+                handle_input(emulator, data, length);
+            }
+        }
+    }
+    return NULL;
+}
+
+modem_emulator_t *modem_emulator_start(const char *transcript, const modem_emulator_config_t *config, int fd)
+{
+    modem_emulator_t *emulator = calloc(1, sizeof(modem_emulator_t));
+    if (emulator == NULL) {
+        return NULL;
+    }
+    emulator->fd = fd;
+    emulator->echo = true;
+    emulator->link_tail = &emulator->link;
+    emulator->config = *config;
+    emulator->random = config->seed;
+    if (!load_transcript(emulator, transcript)) {
+        goto err;
+    }
+    if (pipe(emulator->wakeup)) {
+        goto err;
+    }
+    pthread_mutex_init(&emulator->lock, NULL);
+    if (pthread_create(&emulator->thread, NULL, emulator_task, emulator)) {
+        pthread_mutex_destroy(&emulator->lock);
+        close(emulator->wakeup[0]);
+        close(emulator->wakeup[1]);
+        goto err;
+    }
+    return emulator;
+err:
+    free_rules(emulator);
+    free(emulator);
+    return NULL;
+}
+
+static void wakeup(modem_emulator_t *emulator)
+{
+    (void)!write(emulator->wakeup[1], "", 1);
+}
+
+void modem_emulator_stop(modem_emulator_t *emulator)
+{
+    pthread_mutex_lock(&emulator->lock);
+    emulator->stop = true;
+    pthread_mutex_unlock(&emulator->lock);
+    wakeup(emulator);
+    pthread_join(emulator->thread, NULL);
+    for (int i = 0; i < emulator->inject_count; i++) {
+        free(emulator->inject[i]);
+    }
+    while (emulator->link) {
+        frame_t *frame = emulator->link;
+        emulator->link = frame->next;
+        free(frame);
+    }
+    pthread_mutex_destroy(&emulator->lock);
+    close(emulator->wakeup[0]);
+    close(emulator->wakeup[1]);
+    free_rules(emulator);
+    free(emulator);
+}
+
+void modem_emulator_set_config(modem_emulator_t *emulator, const modem_emulator_config_t *config)
+{
+    pthread_mutex_lock(&emulator->lock);
+    emulator->config = *config;
+    pthread_mutex_unlock(&emulator->lock);
+    wakeup(emulator);
+}
+
+void modem_emulator_inject(modem_emulator_t *emulator, const char *line)
+{
+    pthread_mutex_lock(&emulator->lock);
+    if (emulator->inject_count < EMULATOR_INJECT_MAX) {
+        emulator->inject[emulator->inject_count] = strdup(line);
+        if (emulator->inject[emulator->inject_count]) {
+            emulator->inject_count++;
+        }
+    }
+    pthread_mutex_unlock(&emulator->lock);
+    wakeup(emulator);
+}
+
+int64_t modem_emulator_last_response_us(modem_emulator_t *emulator)
+{
+    return __atomic_load_n(&emulator->last_response_us, __ATOMIC_ACQUIRE);
+}
+
+int64_t modem_emulator_last_urc_us(modem_emulator_t *emulator)
+{
+    return __atomic_load_n(&emulator->last_urc_us, __ATOMIC_ACQUIRE);
+}
+
+void modem_emulator_get_stats(modem_emulator_t *emulator, modem_emulator_stats_t *stats)
+{
+    stats->commands = STAT_GET(emulator, commands);
+    stats->unknown = STAT_GET(emulator, unknown);
+    stats->lines = STAT_GET(emulator, lines);
+    stats->urcs = STAT_GET(emulator, urcs);
+    stats->noise_lines = STAT_GET(emulator, noise_lines);
+    stats->flipped_bytes = STAT_GET(emulator, flipped_bytes);
+    stats->data_bytes = STAT_GET(emulator, data_bytes);
+    stats->data_frames = STAT_GET(emulator, data_frames);
+    stats->lost_frames = STAT_GET(emulator, lost_frames);
+}
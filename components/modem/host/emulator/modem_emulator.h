@@ -0,0 +1,118 @@
+/*
+ * Scriptable AT modem on the master side of a pseudo terminal
+ *
+ * Replays a transcript of command/response pairs, see transcripts/ for the format. Responses can be delayed,
+ * unsolicited result codes injected periodically and the line disturbed by garbage lines and corrupted bytes.
+ * In data mode the bytes are looped back, optionally over a shaped link: PPP frames (delimited by 0x7e) are
+ * delayed by their transmission time at a given baud rate plus a round trip time, and some can be dropped.
+ * On the shaped link LCP Echo-Requests come back as Echo-Replies, as from the network side of the session.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Emulator configuration, can be changed while the emulator runs
+ *
+ */
+typedef struct {
+    uint32_t latency_ms;       /*!< Delay between the end of a command and its response */
+    uint32_t jitter_ms;        /*!< Random extra delay, up to this value */
+    uint32_t urc_interval_ms;  /*!< Interval of the transcript URCs, sent in turn, 0 for none */
+    uint32_t noise_permille;   /*!< Chance of a garbage line in front of a response or URC */
+    uint32_t flip_ppm;         /*!< Chance of a corrupted byte, per byte sent */
+    uint32_t baud;             /*!< Data mode: link rate in bit/s, 10 bits per byte, 0 for no limit */
+    uint32_t rtt_ms;           /*!< Data mode: round trip time added to every looped back frame */
+    uint32_t loss_permille;    /*!< Data mode: chance of a looped back frame being dropped */
+    uint32_t seed;             /*!< Seed of the random generator */
+} modem_emulator_config_t;
+
+#define MODEM_EMULATOR_DEFAULT_CONFIG() \
+    {                                   \
+        .latency_ms = 0,                \
+        .jitter_ms = 0,                 \
+        .urc_interval_ms = 0,           \
+        .noise_permille = 0,            \
+        .flip_ppm = 0,                  \
+        .baud = 0,                      \
+        .rtt_ms = 0,                    \
+        .loss_permille = 0,             \
+        .seed = 1,                      \
+    }
+
+/**
+ * @brief Emulator statistics
+ *
+ */
+typedef struct {
+    uint32_t commands;         /*!< Commands received */
+    uint32_t unknown;          /*!< Commands without a transcript entry, answered with ERROR */
+    uint32_t lines;            /*!< Lines sent, responses, URCs and garbage */
+    uint32_t urcs;             /*!< URCs sent */
+    uint32_t noise_lines;      /*!< Garbage lines sent */
+    uint32_t flipped_bytes;    /*!< Bytes corrupted */
+    uint32_t data_bytes;       /*!< Bytes looped back in data mode */
+    uint32_t data_frames;      /*!< Frames put on the shaped link, including dropped ones */
+    uint32_t lost_frames;      /*!< Frames dropped by the shaped link */
+} modem_emulator_stats_t;
+
+typedef struct modem_emulator modem_emulator_t;
+
+/**
+ * @brief Open a pseudo terminal in raw mode
+ *
+ * @param master master side, for the emulator
+ * @param slave slave side, for the DTE
+ * @param slave_name name of the slave device, may be NULL
+ * @param size size of slave_name
+ * @return 0 on success, -1 on error
+ */
+int modem_emulator_open_pty(int *master, int *slave, char *slave_name, size_t size);
+
+/**
+ * @brief Load a transcript and start emulating on a file descriptor
+ *
+ * The boot lines of the transcript are sent right away.
+ *
+ * @param transcript path of the transcript
+ * @param config configuration
+ * @param fd master side of the pseudo terminal, not closed by the emulator
+ * @return emulator, NULL on error
+ */
+modem_emulator_t *modem_emulator_start(const char *transcript, const modem_emulator_config_t *config, int fd);
+
+/**
+ * @brief Stop the emulator and free it
+ */
+void modem_emulator_stop(modem_emulator_t *emulator);
+
+/**
+ * @brief Replace the configuration of a running emulator
+ */
+void modem_emulator_set_config(modem_emulator_t *emulator, const modem_emulator_config_t *config);
+
+/**
+ * @brief Send a line as URC now, outside of the URC interval
+ */
+void modem_emulator_inject(modem_emulator_t *emulator, const char *line);
+
+/**
+ * @brief Time the last response started to be written, in esp_timer_get_time() microseconds
+ */
+int64_t modem_emulator_last_response_us(modem_emulator_t *emulator);
+
+/**
+ * @brief Time the last URC started to be written, in esp_timer_get_time() microseconds
+ */
+int64_t modem_emulator_last_urc_us(modem_emulator_t *emulator);
+
+void modem_emulator_get_stats(modem_emulator_t *emulator, modem_emulator_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,220 @@
+/*
+ * AT command throughput and latency of the modem component against the emulator
+ *
+ * For each transcript the real DTE and DCE drivers are started on a pseudo terminal, then AT+CSQ is sent in a
+ * loop. Reported:
+ *   - commands per second, including the emulated response latency
+ *   - command latency, from the response leaving the emulator to send_cmd() returning, average and worst case
+ *   - URC latency, from the URC leaving the emulator to its event handler running, average and worst case
+ *   - CPU time of the UART event task per received line, this task splits lines and runs all handlers
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "bg96.h"
+#include "sim800.h"
+#include "esp_modem_dce_cache.h"
+#include "modem_host.h"
+
+#define BENCH_DEFAULT_COMMANDS (2000)
+#define BENCH_READY_TIMEOUT_MS (5000)
+
+static const char *TAG = "modem_bench";
+
+typedef struct {
+    const char *name;
+    const char *transcript;
+    modem_dce_t *(*init)(modem_dte_t *dte);
+} bench_model_t;
+
+typedef struct {
+    uint32_t commands;
+    uint32_t failed;
+    int64_t elapsed_us;
+    int64_t init_us;
+    int64_t cmd_latency_sum_us;
+    int64_t cmd_latency_max_us;
+    uint32_t urcs;
+    int64_t urc_latency_sum_us;
+    int64_t urc_latency_max_us;
+    uint32_t unknown_lines;
+    uint32_t lines;
+    int64_t parser_cpu_us;
+} bench_result_t;
+
+typedef struct {
+    modem_emulator_t *emulator;
+    bench_result_t *result;
+} bench_context_t;
+
+static const bench_model_t s_models[] = {
+    { "BG96", TRANSCRIPT_DIR "/bg96.at", bg96_init },
+    { "SIM800", TRANSCRIPT_DIR "/sim800.at", sim800_init },
+};
+
+/**
+ * @brief Runs in the UART event task, like every handler
+ */
+static void bench_on_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    bench_context_t *context = arg;
+    if (event_id == ESP_MODEM_EVENT_NETWORK_REG) {
+        int64_t latency = esp_timer_get_time() - modem_emulator_last_urc_us(context->emulator);
+        context->result->urcs++;
+        context->result->urc_latency_sum_us += latency;
+        if (latency > context->result->urc_latency_max_us) {
+            context->result->urc_latency_max_us = latency;
+        }
+    } else if (event_id == ESP_MODEM_EVENT_UNKNOWN) {
+        context->result->unknown_lines++;
+    }
+}
+
+static esp_err_t bench_run(const bench_model_t *model, const modem_emulator_config_t *config, uint32_t count,
+                           bench_result_t *result)
+{
+    memset(result, 0, sizeof(bench_result_t));
+    /* the identity is cached per SIM, start cold */
+    esp_modem_dce_cache_erase();
+    modem_host_t host;
+    if (modem_host_start(&host, model->transcript, config) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    bench_context_t context = {
+        .emulator = host.emulator,
+        .result = result,
+    };
+    esp_err_t err = ESP_FAIL;
+    esp_modem_set_event_handler(host.dte, bench_on_event, ESP_EVENT_ANY_ID, &context);
+    int64_t start = esp_timer_get_time();
+    if (esp_modem_wait_ready(host.dte, BENCH_READY_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGE(TAG, "%s: modem not ready", model->name);
+        goto end;
+    }
+    modem_dce_t *dce = model->init(host.dte);
+    if (dce == NULL) {
+        ESP_LOGE(TAG, "%s: DCE init failed", model->name);
+        goto end;
+    }
+    result->init_us = esp_timer_get_time() - start;
+
+    TaskHandle_t uart_task = xTaskGetHandle("uart_event");
+    modem_emulator_stats_t before;
+    modem_emulator_get_stats(host.emulator, &before);
+    int64_t cpu_start = host_task_cpu_time_us(uart_task);
+    start = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t rssi = 0;
+        uint32_t ber = 0;
+        if (dce->get_signal_quality(dce, &rssi, &ber) != ESP_OK) {
+            result->failed++;
+            continue;
+        }
+        int64_t latency = esp_timer_get_time() - modem_emulator_last_response_us(host.emulator);
+        result->commands++;
+        result->cmd_latency_sum_us += latency;
+        if (latency > result->cmd_latency_max_us) {
+            result->cmd_latency_max_us = latency;
+        }
+    }
+    result->elapsed_us = esp_timer_get_time() - start;
+    result->parser_cpu_us = host_task_cpu_time_us(uart_task) - cpu_start;
+    modem_emulator_stats_t after;
+    modem_emulator_get_stats(host.emulator, &after);
+    result->lines = after.lines - before.lines;
+    err = ESP_OK;
+end:
+    esp_modem_remove_event_handler(host.dte, bench_on_event);
+    modem_host_stop(&host);
+    return err;
+}
+
+static void bench_print(const bench_model_t *model, const bench_result_t *result)
+{
+    uint32_t done = result->commands ? result->commands : 1;
+    uint32_t urcs = result->urcs ? result->urcs : 1;
+    uint32_t lines = result->lines ? result->lines : 1;
+    printf("%-8s init %6.1f ms | %8.0f cmd/s, %u failed | cmd latency avg %6.1f us, max %7.1f us | "
+           "urc latency avg %6.1f us, max %7.1f us (%u) | parser %5.2f us/line (%u lines, %u unknown)\n",
+           model->name, result->init_us / 1000.0,
+           result->elapsed_us ? result->commands * 1e6 / result->elapsed_us : 0.0, result->failed,
+           (double)result->cmd_latency_sum_us / done, (double)result->cmd_latency_max_us,
+           (double)result->urc_latency_sum_us / urcs, (double)result->urc_latency_max_us, result->urcs,
+           (double)result->parser_cpu_us / lines, result->lines, result->unknown_lines);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] [BG96|SIM800]...\n"
+            "  -n <count>   commands per model (%d)\n"
+            "  -l <ms>      response latency of the emulator\n"
+            "  -j <ms>      random extra latency, up to this value\n"
+            "  -u <ms>      URC interval, 0 for none\n"
+            "  -N <1/1000>  chance of a garbage line in front of a response or URC\n"
+            "  -f <1/1e6>   chance of a corrupted byte\n"
+            "  -s <seed>    seed of the emulator\n"
+            "  -v           debug log\n",
+            name, BENCH_DEFAULT_COMMANDS);
+}
+
+int main(int argc, char **argv)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    uint32_t count = BENCH_DEFAULT_COMMANDS;
+    esp_log_level_set("*", ESP_LOG_WARN);
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:j:u:N:f:s:vh")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            config.latency_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            config.jitter_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'u':
+            config.urc_interval_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'N':
+            config.noise_permille = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            config.flip_ppm = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            config.seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            esp_log_level_set("*", ESP_LOG_DEBUG);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(s_models) / sizeof(s_models[0]); i++) {
+        bool selected = optind == argc;
+        for (int j = optind; j < argc; j++) {
+            selected |= !strcasecmp(argv[j], s_models[i].name);
+        }
+        if (!selected) {
+            continue;
+        }
+        bench_result_t result;
+        if (bench_run(&s_models[i], &config, count, &result) != ESP_OK) {
+            failed++;
+            continue;
+        }
+        bench_print(&s_models[i], &result);
+    }
+    return failed ? 1 : 0;
+}
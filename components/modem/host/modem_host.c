@@ -0,0 +1,49 @@
+/*
+ * Harness of the host tools, see modem_host.h
+ */
+#include <unistd.h>
+#include "esp_log.h"
+#include "modem_host.h"
+
+static const char *TAG = "modem_host";
+
+esp_err_t modem_host_start(modem_host_t *host, const char *transcript, const modem_emulator_config_t *config)
+{
+    host->emulator = NULL;
+    host->dte = NULL;
+    if (modem_emulator_open_pty(&host->master, &host->slave, NULL, 0)) {
+        ESP_LOGE(TAG, "open pseudo terminal failed");
+        return ESP_FAIL;
+    }
+    host->emulator = modem_emulator_start(transcript, config, host->master);
+    if (host->emulator == NULL) {
+        goto err;
+    }
+    esp_modem_dte_config_t dte_config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    uart_host_attach(dte_config.port_num, host->slave);
+    host->dte = esp_modem_dte_init(&dte_config);
+    if (host->dte == NULL) {
+        goto err;
+    }
+    return ESP_OK;
+err:
+    modem_host_stop(host);
+    return ESP_FAIL;
+}
+
+void modem_host_stop(modem_host_t *host)
+{
+    if (host->dte) {
+        if (host->dte->dce) {
+            host->dte->dce->deinit(host->dte->dce);
+        }
+        host->dte->deinit(host->dte);
+        host->dte = NULL;
+    }
+    if (host->emulator) {
+        modem_emulator_stop(host->emulator);
+        host->emulator = NULL;
+    }
+    close(host->slave);
+    close(host->master);
+}
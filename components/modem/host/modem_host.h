@@ -0,0 +1,43 @@
+/*
+ * Harness of the host tools: a DTE on the slave side of a pseudo terminal, the emulator on the master side
+ */
+#pragma once
+
+#include "esp_modem.h"
+#include "modem_emulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TRANSCRIPT_DIR
+#define TRANSCRIPT_DIR "transcripts"
+#endif
+
+typedef struct {
+    int master;                     /*!< Master side of the pseudo terminal, used by the emulator */
+    int slave;                      /*!< Slave side of the pseudo terminal, used by the DTE */
+    modem_emulator_t *emulator;     /*!< Emulator */
+    modem_dte_t *dte;               /*!< DTE, no DCE bound yet */
+} modem_host_t;
+
+/**
+ * @brief Start the emulator on a transcript and a DTE connected to it
+ *
+ * @param host harness
+ * @param transcript path of the transcript
+ * @param config emulator configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t modem_host_start(modem_host_t *host, const char *transcript, const modem_emulator_config_t *config);
+
+/**
+ * @brief Deinitialize the DTE (and a DCE bound to it), stop the emulator and close the terminal
+ */
+void modem_host_stop(modem_host_t *host);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Host build of the modem component: user event loops without a dedicated task
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "esp_event.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+typedef struct host_event_handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct host_event_handler *next;
+} host_event_handler_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+} host_event_post_t;
+
+struct host_event_loop {
+    QueueHandle_t queue;
+    pthread_mutex_t lock;           /*!< Recursive, handlers may (un)register handlers */
+    host_event_handler_t *handlers;
+};
+
+esp_err_t esp_event_loop_create(const esp_event_loop_args_t *event_loop_args, esp_event_loop_handle_t *event_loop)
+{
+    if (event_loop_args == NULL || event_loop == NULL || event_loop_args->queue_size <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (event_loop_args->task_name != NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    struct host_event_loop *loop = calloc(1, sizeof(struct host_event_loop));
+    if (loop == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    loop->queue = xQueueCreate(event_loop_args->queue_size, sizeof(host_event_post_t));
+    if (loop->queue == NULL) {
+        free(loop);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&loop->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    *event_loop = loop;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
+{
+    host_event_post_t post;
+    while (xQueueReceive(event_loop->queue, &post, 0) == pdTRUE) {
+        free(post.data);
+    }
+    vQueueDelete(event_loop->queue);
+    while (event_loop->handlers) {
+        host_event_handler_t *next = event_loop->handlers->next;
+        free(event_loop->handlers);
+        event_loop->handlers = next;
+    }
+    pthread_mutex_destroy(&event_loop->lock);
+    free(event_loop);
+    return ESP_OK;
+}
+
+static void event_dispatch(esp_event_loop_handle_t event_loop, host_event_post_t *post)
+{
+    pthread_mutex_lock(&event_loop->lock);
+    host_event_handler_t *entry = event_loop->handlers;
+    while (entry) {
+        /* a handler may unregister itself */
+        host_event_handler_t *next = entry->next;
+        if ((entry->base == ESP_EVENT_ANY_BASE || entry->base == post->base) &&
+                (entry->id == ESP_EVENT_ANY_ID || entry->id == post->id)) {
+            entry->handler(entry->arg, post->base, post->id, post->data);
+        }
+        entry = next;
+    }
+    pthread_mutex_unlock(&event_loop->lock);
+}
+
+esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
+{
+    TickType_t start = xTaskGetTickCount();
+    host_event_post_t post;
+    while (xQueueReceive(event_loop->queue, &post, ticks_to_run) == pdTRUE) {
+        event_dispatch(event_loop, &post);
+        free(post.data);
+        if (ticks_to_run != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= ticks_to_run) {
+                break;
+            }
+            ticks_to_run -= elapsed;
+            start += elapsed;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base,
+        int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (event_loop == NULL || event_handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_event_handler_t *entry = calloc(1, sizeof(host_event_handler_t));
+    if (entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    entry->base = event_base;
+    entry->id = event_id;
+    entry->handler = event_handler;
+    entry->arg = event_handler_arg;
+    pthread_mutex_lock(&event_loop->lock);
+    /* handlers run in the order they were registered */
+    host_event_handler_t **p = &event_loop->handlers;
+    while (*p) {
+        p = &(*p)->next;
+    }
+    *p = entry;
+    pthread_mutex_unlock(&event_loop->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base,
+        int32_t event_id, esp_event_handler_t event_handler)
+{
+    if (event_loop == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&event_loop->lock);
+    host_event_handler_t **p = &event_loop->handlers;
+    while (*p) {
+        host_event_handler_t *entry = *p;
+        if (entry->handler == event_handler && entry->base == event_base && entry->id == event_id) {
+            *p = entry->next;
+            free(entry);
+        } else {
+            p = &entry->next;
+        }
+    }
+    pthread_mutex_unlock(&event_loop->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                            void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    host_event_post_t post = {
+        .base = event_base,
+        .id = event_id,
+    };
+    if (event_data && event_data_size) {
+        post.data = malloc(event_data_size);
+        if (post.data == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(post.data, event_data, event_data_size);
+    }
+    if (xQueueSend(event_loop->queue, &post, ticks_to_wait) != pdTRUE) {
+        free(post.data);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,114 @@
+/*
+ * Host build of the modem component: netif without an IP stack, see esp_netif.h
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "esp_netif.h"
+
+/* statistics are written by the driver and the transmitting task, read by others */
+#define STAT_ADD(netif, field, n) __atomic_fetch_add(&(netif)->stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_GET(netif, field) __atomic_load_n(&(netif)->stats.field, __ATOMIC_RELAXED)
+
+struct esp_netif_obj {
+    esp_netif_driver_ifconfig_t driver;
+    esp_netif_host_input_t input;
+    void *context;
+    bool started;
+    esp_netif_host_stats_t stats;
+};
+
+esp_netif_t *esp_netif_host_new(esp_netif_host_input_t input, void *context)
+{
+    esp_netif_t *esp_netif = calloc(1, sizeof(esp_netif_t));
+    if (esp_netif == NULL) {
+        return NULL;
+    }
+    esp_netif->input = input;
+    esp_netif->context = context;
+    return esp_netif;
+}
+
+void esp_netif_host_get_stats(esp_netif_t *esp_netif, esp_netif_host_stats_t *stats)
+{
+    stats->rx_bytes = STAT_GET(esp_netif, rx_bytes);
+    stats->rx_copied = STAT_GET(esp_netif, rx_copied);
+    stats->rx_calls = STAT_GET(esp_netif, rx_calls);
+    stats->tx_bytes = STAT_GET(esp_netif, tx_bytes);
+    stats->tx_calls = STAT_GET(esp_netif, tx_calls);
+    stats->tx_errors = STAT_GET(esp_netif, tx_errors);
+}
+
+bool esp_netif_host_is_started(esp_netif_t *esp_netif)
+{
+    return __atomic_load_n(&esp_netif->started, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t esp_netif_attach(esp_netif_t *esp_netif, void *driver_handle)
+{
+    esp_netif_driver_base_t *base = driver_handle;
+    if (base->post_attach) {
+        return base->post_attach(esp_netif, driver_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_driver_config(esp_netif_t *esp_netif, const esp_netif_driver_ifconfig_t *driver_config)
+{
+    if (esp_netif == NULL || driver_config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_netif->driver = *driver_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb)
+{
+    STAT_ADD(esp_netif, rx_calls, 1);
+    STAT_ADD(esp_netif, rx_bytes, len);
+    if (esp_netif->input == NULL) {
+        return ESP_OK;
+    }
+    /* pppos_input_tcpip() copies the chunk into a pbuf for the TCP/IP task, so does the host */
+    uint8_t *copy = malloc(len);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, buffer, len);
+    STAT_ADD(esp_netif, rx_copied, len);
+    esp_netif->input(copy, len, esp_netif->context);
+    free(copy);
+    if (esp_netif->driver.driver_free_rx_buffer) {
+        esp_netif->driver.driver_free_rx_buffer(esp_netif->driver.handle, buffer);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_transmit(esp_netif_t *esp_netif, void *data, size_t len)
+{
+    if (esp_netif->driver.transmit == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    STAT_ADD(esp_netif, tx_calls, 1);
+    esp_err_t err = esp_netif->driver.transmit(esp_netif->driver.handle, data, len);
+    if (err == ESP_OK) {
+        STAT_ADD(esp_netif, tx_bytes, len);
+    } else {
+        STAT_ADD(esp_netif, tx_errors, 1);
+    }
+    return err;
+}
+
+void esp_netif_destroy(esp_netif_t *esp_netif)
+{
+    free(esp_netif);
+}
+
+void esp_netif_action_start(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data)
+{
+    __atomic_store_n(&((esp_netif_t *)esp_netif)->started, true, __ATOMIC_RELEASE);
+}
+
+void esp_netif_action_stop(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data)
+{
+    __atomic_store_n(&((esp_netif_t *)esp_netif)->started, false, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,441 @@
+/*
+ * Host build of the modem component: FreeRTOS queues, semaphores, queue sets, tasks and event groups
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#define TASK_NAME_LENGTH (16)
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+    struct host_queue *set;     /*!< Queue set the queue is a member of */
+};
+
+struct host_task {
+    pthread_t thread;
+    char name[TASK_NAME_LENGTH];
+    TaskFunction_t entry;
+    void *param;
+    struct host_task *next;
+};
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+static pthread_mutex_t s_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *s_tasks = NULL;
+static struct host_task s_main_task = { .name = "main" };
+static __thread struct host_task *s_current = NULL;
+
+static struct timespec s_start;
+static pthread_once_t s_start_once = PTHREAD_ONCE_INIT;
+
+static void tick_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    pthread_once(&s_start_once, tick_start);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)((now.tv_sec - s_start.tv_sec) * 1000 + (now.tv_nsec - s_start.tv_nsec) / 1000000);
+}
+
+/**
+ * @brief Absolute CLOCK_MONOTONIC deadline for a timeout in ticks
+ */
+static void deadline_after(TickType_t ticks, struct timespec *deadline)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += ticks / configTICK_RATE_HZ;
+    deadline->tv_nsec += (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ);
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+static void cond_init_monotonic(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void unlock_mutex(void *mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+/**
+ * @brief Wait on a condition with the mutex held, false once the timeout passed
+ *
+ * The mutex is released if the waiting thread gets cancelled by vTaskDelete.
+ */
+static bool cond_wait_until(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t ticks,
+                            const struct timespec *deadline)
+{
+    int ret;
+    if (ticks == 0) {
+        return false;
+    }
+    pthread_cleanup_push(unlock_mutex, mutex);
+    if (ticks == portMAX_DELAY) {
+        ret = pthread_cond_wait(cond, mutex);
+    } else {
+        ret = pthread_cond_timedwait(cond, mutex, deadline);
+    }
+    pthread_cleanup_pop(0);
+    return ret != ETIMEDOUT;
+}
+
+static struct host_queue *queue_create(UBaseType_t length, UBaseType_t item_size, UBaseType_t count)
+{
+    struct host_queue *queue = calloc(1, sizeof(struct host_queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    if (item_size) {
+        queue->items = calloc(length, item_size);
+        if (queue->items == NULL) {
+            free(queue);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init_monotonic(&queue->changed);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->count = count;
+    return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    return queue_create(length, item_size, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return queue_create(max_count, 0, initial_count);
+}
+
+QueueSetHandle_t xQueueCreateSet(UBaseType_t length)
+{
+    return queue_create(length, sizeof(struct host_queue *), 0);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (!cond_wait_until(&queue->changed, &queue->lock, ticks_to_wait, &deadline)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    if (queue->item_size) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    struct host_queue *set = queue->set;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    if (set) {
+        /* sized for all members, never full */
+        xQueueSend(set, &queue, 0);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (!cond_wait_until(&queue->changed, &queue->lock, ticks_to_wait, &deadline)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    if (queue->item_size) {
+        memcpy(buffer, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+    }
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;
+    queue->head = 0;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set)
+{
+    BaseType_t ret = pdFAIL;
+    pthread_mutex_lock(&member->lock);
+    /* like FreeRTOS, only empty queues which are not in a set yet */
+    if (member->set == NULL && member->count == 0) {
+        member->set = set;
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&member->lock);
+    return ret;
+}
+
+BaseType_t xQueueRemoveFromSet(QueueSetMemberHandle_t member, QueueSetHandle_t set)
+{
+    BaseType_t ret = pdFAIL;
+    pthread_mutex_lock(&member->lock);
+    if (member->set == set) {
+        member->set = NULL;
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&member->lock);
+    return ret;
+}
+
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks_to_wait)
+{
+    struct host_queue *member = NULL;
+    if (xQueueReceive(set, &member, ticks_to_wait) != pdTRUE) {
+        return NULL;
+    }
+    return member;
+}
+
+static void *task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    s_current = task;
+    task->entry(task->param);
+    /* returning from a task function is not allowed in FreeRTOS either */
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t entry, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *created_task)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->entry = entry;
+    task->param = param;
+    pthread_mutex_lock(&s_tasks_lock);
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        pthread_mutex_unlock(&s_tasks_lock);
+        free(task);
+        return pdFAIL;
+    }
+    task->next = s_tasks;
+    s_tasks = task;
+    pthread_mutex_unlock(&s_tasks_lock);
+    if (created_task) {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+/**
+ * @brief Remove a task from the list of tasks
+ */
+static void task_unlink(struct host_task *task)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    for (struct host_task **p = &s_tasks; *p; p = &(*p)->next) {
+        if (*p == task) {
+            *p = task->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    struct host_task *self = xTaskGetCurrentTaskHandle();
+    if (task == NULL || task == self) {
+        if (self == &s_main_task) {
+            pthread_exit(NULL);
+        }
+        task_unlink(self);
+        pthread_detach(self->thread);
+        free(self);
+        pthread_exit(NULL);
+    }
+    task_unlink(task);
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec delay = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ)
+    };
+    while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (s_current == NULL) {
+        s_main_task.thread = pthread_self();
+        s_current = &s_main_task;
+    }
+    return s_current;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    struct host_task *found = NULL;
+    pthread_mutex_lock(&s_tasks_lock);
+    for (struct host_task *task = s_tasks; task; task = task->next) {
+        if (!strncmp(task->name, name, TASK_NAME_LENGTH)) {
+            found = task;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    return found;
+}
+
+int64_t host_task_cpu_time_us(TaskHandle_t task)
+{
+    clockid_t clock;
+    struct timespec cpu;
+    if (task == NULL) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+    if (pthread_getcpuclockid(task->thread, &clock) != 0 || clock_gettime(clock, &cpu) != 0) {
+        return -1;
+    }
+    return (int64_t)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *group = calloc(1, sizeof(struct host_event_group));
+    if (group == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    cond_init_monotonic(&group->changed);
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    pthread_cond_destroy(&group->changed);
+    pthread_mutex_destroy(&group->lock);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t result = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t result = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&group->lock);
+    while (true) {
+        EventBits_t set = group->bits & bits;
+        if (wait_for_all ? set == bits : set != 0) {
+            EventBits_t result = group->bits;
+            if (clear_on_exit) {
+                group->bits &= ~bits;
+            }
+            pthread_mutex_unlock(&group->lock);
+            return result;
+        }
+        if (!cond_wait_until(&group->changed, &group->lock, ticks_to_wait, &deadline)) {
+            break;
+        }
+    }
+    EventBits_t result = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
@@ -0,0 +1,64 @@
+/*
+ * Host build of the modem component: the driver side of esp_netif.h
+ *
+ * There is no IP stack on the host. A netif hands the bytes the driver receives to an input callback, after
+ * copying them like the PPP netif of ESP-IDF copies them into a pbuf, and transmits through the driver.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct esp_netif_driver_base_s {
+    esp_err_t (*post_attach)(esp_netif_t *netif, void *h);
+    esp_netif_t *netif;
+} esp_netif_driver_base_t;
+
+typedef struct esp_netif_driver_ifconfig {
+    void *handle;
+    esp_err_t (*transmit)(void *h, void *buffer, size_t len);
+    void (*driver_free_rx_buffer)(void *h, void *buffer);
+} esp_netif_driver_ifconfig_t;
+
+/**
+ * @brief Input of a host netif, runs in the context of the driver (the DTE task for esp_modem)
+ */
+typedef void (*esp_netif_host_input_t)(const uint8_t *data, size_t length, void *context);
+
+/**
+ * @brief Copy and transfer statistics of a host netif
+ */
+typedef struct {
+    uint64_t rx_bytes;      /*!< Bytes received from the driver */
+    uint64_t rx_copied;     /*!< Bytes copied on the way to the input callback */
+    uint32_t rx_calls;      /*!< Calls of esp_netif_receive() */
+    uint64_t tx_bytes;      /*!< Bytes handed to the driver */
+    uint32_t tx_calls;      /*!< Calls of the driver transmit function */
+    uint32_t tx_errors;     /*!< Failed calls of the driver transmit function */
+} esp_netif_host_stats_t;
+
+esp_netif_t *esp_netif_host_new(esp_netif_host_input_t input, void *context);
+void esp_netif_host_get_stats(esp_netif_t *esp_netif, esp_netif_host_stats_t *stats);
+bool esp_netif_host_is_started(esp_netif_t *esp_netif);
+
+esp_err_t esp_netif_attach(esp_netif_t *esp_netif, void *driver_handle);
+esp_err_t esp_netif_set_driver_config(esp_netif_t *esp_netif, const esp_netif_driver_ifconfig_t *driver_config);
+esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb);
+esp_err_t esp_netif_transmit(esp_netif_t *esp_netif, void *data, size_t len);
+void esp_netif_destroy(esp_netif_t *esp_netif);
+
+void esp_netif_action_start(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data);
+void esp_netif_action_stop(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data);
+
+#ifdef __cplusplus
+}
+#endif
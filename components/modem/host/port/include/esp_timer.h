@@ -0,0 +1,19 @@
+/*
+ * Host build of the modem component: esp_timer_get_time() on CLOCK_MONOTONIC
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since the start of the process
+ */
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
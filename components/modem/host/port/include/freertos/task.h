@@ -0,0 +1,37 @@
+/*
+ * Host build of the modem component: FreeRTOS tasks as POSIX threads
+ */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start a thread, stack size and priority are ignored
+ */
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *created_task);
+
+/**
+ * @brief End a task, a task deleted by another one is cancelled and joined
+ */
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char *name);
+TickType_t xTaskGetTickCount(void);
+
+/**
+ * @brief CPU time consumed by a task so far, host only
+ *
+ * @param task task handle, NULL for the calling task
+ * @return CPU time in microseconds, -1 on error
+ */
+int64_t host_task_cpu_time_us(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+/*
+ * Host build of the modem component: the address type used by esp_modem_compat.h
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
@@ -0,0 +1,24 @@
+/*
+ * Configuration of the host build, mirrors the defaults of main/Kconfig.projbuild
+ */
+#pragma once
+
+#define CONFIG_EXAMPLE_MODEM_APN "hologram"
+#define CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME ""
+#define CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD ""
+#define CONFIG_EXAMPLE_MODEM_ADAPTIVE_TIMEOUT 1
+#define CONFIG_EXAMPLE_MODEM_LINK_MONITOR 1
+#define CONFIG_EXAMPLE_MODEM_LINK_MONITOR_MAX_INTERVAL_MS 600000
+#define CONFIG_EXAMPLE_UART_MODEM_TX_PIN 33
+#define CONFIG_EXAMPLE_UART_MODEM_RX_PIN 17
+#define CONFIG_EXAMPLE_UART_MODEM_FLOW_CONTROL_HW 1
+#define CONFIG_EXAMPLE_UART_MODEM_RTS_PIN 27
+#define CONFIG_EXAMPLE_UART_MODEM_CTS_PIN 23
+#define CONFIG_EXAMPLE_UART_MODEM_MAX_BAUD_RATE 921600
+#define CONFIG_EXAMPLE_UART_EVENT_TASK_STACK_SIZE 2048
+#define CONFIG_EXAMPLE_UART_EVENT_TASK_PRIORITY 5
+#define CONFIG_EXAMPLE_UART_EVENT_QUEUE_SIZE 30
+#define CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE 20
+#define CONFIG_EXAMPLE_UART_TX_BUFFER_SIZE 512
+#define CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE 2048
+#define CONFIG_EXAMPLE_UART_RX_LATENCY_MS 20
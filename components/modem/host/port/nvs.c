@@ -0,0 +1,184 @@
+/*
+ * Host build of the modem component: NVS in memory
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "nvs.h"
+
+#define NVS_NAMESPACE_MAX (8)
+#define NVS_NAME_LENGTH (16)
+
+typedef struct nvs_entry {
+    char namespace[NVS_NAME_LENGTH];
+    char key[NVS_NAME_LENGTH];
+    uint8_t *value;
+    size_t length;
+    struct nvs_entry *next;
+} nvs_entry_t;
+
+typedef struct {
+    char name[NVS_NAME_LENGTH];
+    nvs_open_mode_t mode;
+} nvs_open_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvs_entry_t *s_entries = NULL;
+static nvs_open_t s_handles[NVS_NAMESPACE_MAX];
+
+static const nvs_open_t *nvs_lookup_handle(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > NVS_NAMESPACE_MAX || !s_handles[handle - 1].name[0]) {
+        return NULL;
+    }
+    return &s_handles[handle - 1];
+}
+
+static nvs_entry_t **nvs_find(const char *namespace, const char *key)
+{
+    nvs_entry_t **p = &s_entries;
+    while (*p && (strcmp((*p)->namespace, namespace) || strcmp((*p)->key, key))) {
+        p = &(*p)->next;
+    }
+    return p;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (strlen(name) >= NVS_NAME_LENGTH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    /* like on flash, a namespace only exists after something was written to it */
+    if (open_mode == NVS_READONLY && *nvs_find(name, "") == NULL) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (open_mode == NVS_READWRITE && *nvs_find(name, "") == NULL) {
+        nvs_entry_t *marker = calloc(1, sizeof(nvs_entry_t));
+        if (marker == NULL) {
+            pthread_mutex_unlock(&s_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        strcpy(marker->namespace, name);
+        marker->next = s_entries;
+        s_entries = marker;
+    }
+    for (int i = 0; i < NVS_NAMESPACE_MAX; i++) {
+        if (!s_handles[i].name[0]) {
+            strcpy(s_handles[i].name, name);
+            s_handles[i].mode = open_mode;
+            *out_handle = i + 1;
+            pthread_mutex_unlock(&s_lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    if (nvs_lookup_handle(handle)) {
+        s_handles[handle - 1].name[0] = '\0';
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    const nvs_open_t *open = nvs_lookup_handle(handle);
+    nvs_entry_t *entry = open && key[0] ? *nvs_find(open->name, key) : NULL;
+    if (open == NULL) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (entry == NULL) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out_value == NULL) {
+        *length = entry->length;
+    } else if (*length < entry->length) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, entry->value, entry->length);
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!key[0] || strlen(key) >= NVS_NAME_LENGTH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    const nvs_open_t *open = nvs_lookup_handle(handle);
+    if (open == NULL || open->mode != NVS_READWRITE) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+        goto end;
+    }
+    uint8_t *copy = malloc(length ? length : 1);
+    if (copy == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+    memcpy(copy, value, length);
+    nvs_entry_t *entry = *nvs_find(open->name, key);
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(nvs_entry_t));
+        if (entry == NULL) {
+            free(copy);
+            err = ESP_ERR_NO_MEM;
+            goto end;
+        }
+        strcpy(entry->namespace, open->name);
+        strcpy(entry->key, key);
+        entry->next = s_entries;
+        s_entries = entry;
+    }
+    free(entry->value);
+    entry->value = copy;
+    entry->length = length;
+end:
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(uint32_t);
+    return nvs_get_blob(handle, key, out_value, &length);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    const nvs_open_t *open = nvs_lookup_handle(handle);
+    nvs_entry_t **p = open && key[0] ? nvs_find(open->name, key) : NULL;
+    if (open == NULL || open->mode != NVS_READWRITE) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (p == NULL || *p == NULL) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        nvs_entry_t *entry = *p;
+        *p = entry->next;
+        free(entry->value);
+        free(entry);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return nvs_lookup_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
@@ -0,0 +1,437 @@
+/*
+ * Host build of the modem component: UART driver on a pseudo terminal, see driver/uart.h
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include "driver/uart.h"
+#include "freertos/task.h"
+
+#define UART_READ_CHUNK (UART_FIFO_LEN)
+
+typedef struct {
+    int fd;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;      /*!< Signalled when bytes are added to or removed from the ring */
+    QueueHandle_t event_queue;
+    uint8_t *ring;
+    size_t ring_size;
+    size_t head;                 /*!< Offset of the oldest byte in the ring */
+    size_t count;                /*!< Bytes in the ring */
+    uint64_t read_total;         /*!< Bytes taken out of the ring since install */
+    int64_t *pattern_pos;        /*!< Stream offsets of pattern characters, relative to read_total when popped */
+    int pattern_len;
+    int pattern_head;
+    int pattern_count;
+    bool pattern_enabled;
+    char pattern_chr;
+    bool rx_intr_enabled;
+    bool buffer_full;            /*!< UART_BUFFER_FULL posted, not posted again until there is room */
+    uart_host_stats_t stats;     /*!< rx fields under lock, tx_bytes atomic */
+} uart_host_t;
+
+static int s_fds[UART_NUM_MAX] = { -1, -1, -1 };
+static uart_host_t *s_uart[UART_NUM_MAX];
+
+esp_err_t uart_host_attach(uart_port_t uart_num, int fd)
+{
+    if (uart_num >= UART_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_fds[uart_num] = fd;
+    return ESP_OK;
+}
+
+static void uart_unlock(void *lock)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+static void uart_post(uart_host_t *uart, uart_event_type_t type, size_t size)
+{
+    uart_event_t event = {
+        .type = type,
+        .size = size,
+    };
+    /* the interrupt never blocks, events beyond the queue size are lost */
+    xQueueSend(uart->event_queue, &event, 0);
+}
+
+static void uart_pattern_push(uart_host_t *uart, int64_t pos)
+{
+    if (uart->pattern_count == uart->pattern_len) {
+        return;
+    }
+    uart->pattern_pos[(uart->pattern_head + uart->pattern_count) % uart->pattern_len] = pos;
+    uart->pattern_count++;
+}
+
+/**
+ * @brief Move received bytes into the ring, blocks while the ring is full
+ */
+static void uart_receive(uart_host_t *uart, const uint8_t *data, size_t length)
+{
+    pthread_mutex_lock(&uart->lock);
+    size_t done = 0;
+    while (done < length) {
+        while (uart->count == uart->ring_size) {
+            if (!uart->buffer_full) {
+                uart->buffer_full = true;
+                uart_post(uart, UART_BUFFER_FULL, 0);
+            }
+            pthread_cleanup_push(uart_unlock, &uart->lock);
+            pthread_cond_wait(&uart->changed, &uart->lock);
+            pthread_cleanup_pop(0);
+        }
+        size_t chunk = 0;
+        while (done < length && uart->count < uart->ring_size) {
+            uint8_t byte = data[done++];
+            uart->ring[(uart->head + uart->count) % uart->ring_size] = byte;
+            uart->count++;
+            uart->stats.rx_bytes++;
+            uart->stats.rx_copied++;
+            chunk++;
+            if (uart->pattern_enabled && byte == (uint8_t)uart->pattern_chr) {
+                uart_pattern_push(uart, uart->read_total + uart->count - 1);
+                uart_post(uart, UART_PATTERN_DET, chunk);
+                chunk = 0;
+            }
+        }
+        /* like the receive timeout interrupt, for bytes not followed by a pattern character */
+        if (chunk && uart->rx_intr_enabled) {
+            uart_post(uart, UART_DATA, chunk);
+        }
+        pthread_cond_broadcast(&uart->changed);
+    }
+    pthread_mutex_unlock(&uart->lock);
+}
+
+static void *uart_reader(void *arg)
+{
+    uart_host_t *uart = arg;
+    uint8_t buffer[UART_READ_CHUNK];
+    while (true) {
+        ssize_t length = read(uart->fd, buffer, sizeof(buffer));
+        if (length > 0) {
+            uart_receive(uart, buffer, length);
+        } else if (length == 0 || (errno != EINTR && errno != EAGAIN)) {
+            /* the other side hung up, poll until the driver is deleted */
+            usleep(10000);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    if (uart_num >= UART_NUM_MAX || s_fds[uart_num] < 0 || s_uart[uart_num] || rx_buffer_size <= UART_FIFO_LEN) {
+        return ESP_FAIL;
+    }
+    uart_host_t *uart = calloc(1, sizeof(uart_host_t));
+    if (uart == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uart->fd = s_fds[uart_num];
+    uart->ring_size = rx_buffer_size;
+    uart->ring = malloc(rx_buffer_size);
+    uart->event_queue = queue_size ? xQueueCreate(queue_size, sizeof(uart_event_t)) : NULL;
+    if (uart->ring == NULL || (queue_size && uart->event_queue == NULL)) {
+        goto err;
+    }
+    uart->rx_intr_enabled = true;
+    pthread_mutex_init(&uart->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&uart->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&uart->reader, NULL, uart_reader, uart) != 0) {
+        pthread_cond_destroy(&uart->changed);
+        pthread_mutex_destroy(&uart->lock);
+        goto err;
+    }
+    s_uart[uart_num] = uart;
+    if (uart_queue) {
+        *uart_queue = uart->event_queue;
+    }
+    return ESP_OK;
+err:
+    if (uart->event_queue) {
+        vQueueDelete(uart->event_queue);
+    }
+    free(uart->ring);
+    free(uart);
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    if (uart_num >= UART_NUM_MAX || s_uart[uart_num] == NULL) {
+        return ESP_FAIL;
+    }
+    uart_host_t *uart = s_uart[uart_num];
+    s_uart[uart_num] = NULL;
+    pthread_cancel(uart->reader);
+    pthread_join(uart->reader, NULL);
+    if (uart->event_queue) {
+        vQueueDelete(uart->event_queue);
+    }
+    pthread_cond_destroy(&uart->changed);
+    pthread_mutex_destroy(&uart->lock);
+    free(uart->pattern_pos);
+    free(uart->ring);
+    free(uart);
+    return ESP_OK;
+}
+
+static uart_host_t *uart_get(uart_port_t uart_num)
+{
+    return uart_num < UART_NUM_MAX ? s_uart[uart_num] : NULL;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config)
+{
+    return uart_num < UART_NUM_MAX ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    return uart_num < UART_NUM_MAX ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_set_hw_flow_ctrl(uart_port_t uart_num, uart_hw_flowcontrol_t flow_ctrl, uint8_t rx_thresh)
+{
+    return uart_num < UART_NUM_MAX ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_set_sw_flow_ctrl(uart_port_t uart_num, bool enable, uint8_t rx_thresh_xon, uint8_t rx_thresh_xoff)
+{
+    return uart_num < UART_NUM_MAX ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate)
+{
+    return uart_get(uart_num) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_enable_rx_intr(uart_port_t uart_num)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    uart->rx_intr_enabled = true;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_disable_rx_intr(uart_port_t uart_num)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    uart->rx_intr_enabled = false;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t uart_num, char pattern_chr, uint8_t chr_num,
+        int chr_tout, int post_idle, int pre_idle)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL || chr_num != 1) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    uart->pattern_chr = pattern_chr;
+    uart->pattern_enabled = true;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_disable_pattern_det_intr(uart_port_t uart_num)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    uart->pattern_enabled = false;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t uart_num, int queue_length)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL || queue_length <= 0) {
+        return ESP_FAIL;
+    }
+    int64_t *pattern_pos = malloc(queue_length * sizeof(int64_t));
+    if (pattern_pos == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_lock(&uart->lock);
+    free(uart->pattern_pos);
+    uart->pattern_pos = pattern_pos;
+    uart->pattern_len = queue_length;
+    uart->pattern_head = 0;
+    uart->pattern_count = 0;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+int uart_pattern_pop_pos(uart_port_t uart_num)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return -1;
+    }
+    int pos = -1;
+    pthread_mutex_lock(&uart->lock);
+    /* like the driver, positions of bytes read in the meantime are dropped */
+    while (uart->pattern_count && pos < 0) {
+        int64_t offset = uart->pattern_pos[uart->pattern_head] - (int64_t)uart->read_total;
+        uart->pattern_head = (uart->pattern_head + 1) % uart->pattern_len;
+        uart->pattern_count--;
+        pos = offset >= 0 ? (int)offset : -1;
+    }
+    pthread_mutex_unlock(&uart->lock);
+    return pos;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t length = write(uart->fd, (const uint8_t *)src + done, size - done);
+        if (length < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        done += length;
+    }
+    __atomic_fetch_add(&uart->stats.tx_bytes, done, __ATOMIC_RELAXED);
+    return done;
+}
+
+/**
+ * @brief Take bytes out of the ring, with the lock held
+ */
+static size_t uart_take(uart_host_t *uart, uint8_t *buf, size_t length)
+{
+    length = length < uart->count ? length : uart->count;
+    for (size_t i = 0; i < length; i++) {
+        if (buf) {
+            buf[i] = uart->ring[uart->head];
+            uart->stats.rx_copied++;
+        }
+        uart->head = (uart->head + 1) % uart->ring_size;
+    }
+    uart->count -= length;
+    uart->read_total += length;
+    if (length) {
+        uart->buffer_full = false;
+        pthread_cond_broadcast(&uart->changed);
+    }
+    return length;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return -1;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ticks_to_wait / configTICK_RATE_HZ;
+    deadline.tv_nsec += (long)(ticks_to_wait % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    size_t done = 0;
+    pthread_mutex_lock(&uart->lock);
+    pthread_cleanup_push(uart_unlock, &uart->lock);
+    while (true) {
+        done += uart_take(uart, (uint8_t *)buf + done, length - done);
+        if (done == length || ticks_to_wait == 0) {
+            break;
+        }
+        int ret = ticks_to_wait == portMAX_DELAY ? pthread_cond_wait(&uart->changed, &uart->lock) :
+                  pthread_cond_timedwait(&uart->changed, &uart->lock, &deadline);
+        if (ret == ETIMEDOUT) {
+            done += uart_take(uart, (uint8_t *)buf + done, length - done);
+            break;
+        }
+    }
+    pthread_cleanup_pop(1);
+    return done;
+}
+
+esp_err_t uart_host_get_stats(uart_port_t uart_num, uart_host_stats_t *stats)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    stats->rx_bytes = uart->stats.rx_bytes;
+    stats->rx_copied = uart->stats.rx_copied;
+    pthread_mutex_unlock(&uart->lock);
+    stats->tx_bytes = __atomic_load_n(&uart->stats.tx_bytes, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    *size = uart->count;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    /* writes go straight to the terminal */
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    uart_host_t *uart = uart_get(uart_num);
+    if (uart == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    uart_take(uart, NULL, uart->count);
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_flush(uart_port_t uart_num)
+{
+    return uart_flush_input(uart_num);
+}
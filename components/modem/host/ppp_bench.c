@@ -0,0 +1,637 @@
+/*
+ * PPP data path of the modem component against the emulator
+ *
+ * The DTE and the netif glue (esp_modem_netif.c) run unchanged, the emulator loops the data call back over a
+ * shaped link (baud rate, round trip time, frame loss). There is no IP stack on the host, so the benchmark
+ * frames its own packets like pppos does (RFC 1662, ACCM 0 as negotiated by lwIP) and plays both ends through the
+ * loopback:
+ *   - goodput: a window of TCP sized segments, each acknowledged by its echo, lost ones are retransmitted after
+ *     a timeout estimated like TCP does (RFC 6298)
+ *   - publish round trip: one publish sized packet at a time, from esp_netif_transmit() to its echo, including
+ *     retransmissions, like a QoS 1 publish waiting for its PUBACK
+ *   - CPU time per frame of the sending task (framing and the transmit path) and of the UART event task (the
+ *     receive path up to the netif input and the deframing)
+ *   - bytes copied per byte on the line: UART driver, netif and framing, each copy counted where it happens
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "bg96.h"
+#include "esp_modem_netif.h"
+#include "esp_modem_dce_cache.h"
+#include "modem_host.h"
+
+#define BENCH_DEFAULT_BYTES (256 * 1024)
+#define BENCH_DEFAULT_MSS (1440)            /*!< CONFIG_LWIP_TCP_MSS */
+#define BENCH_DEFAULT_WINDOW (4)            /*!< CONFIG_LWIP_TCP_WND_DEFAULT is 4 segments */
+#define BENCH_DEFAULT_PUBLISHES (50)
+#define BENCH_DEFAULT_PUBLISH_SIZE (200)
+#define BENCH_DEFAULT_BAUD (115200)
+#define BENCH_DEFAULT_RTT_MS (100)
+#define BENCH_HEADER_LEN (40)               /*!< IPv4 and TCP headers, the sequence number follows */
+#define BENCH_MTU (1500)
+#define BENCH_WINDOW_MAX (64)
+#define BENCH_ACK_QUEUE_SIZE (2 * BENCH_WINDOW_MAX)
+#define BENCH_RTO_INITIAL_MS (1000)
+#define BENCH_RTO_MIN_MS (200)
+#define BENCH_RTO_MAX_MS (60000)
+#define BENCH_READY_TIMEOUT_MS (5000)
+#define BENCH_START_TIMEOUT_MS (1000)
+#define BENCH_TIMEOUT_S (600)
+#define BENCH_PUBLISH_FLAG (0x80000000)     /*!< Sequence numbers of the round trip test */
+
+#define PPP_FLAG (0x7e)
+#define PPP_ESCAPE (0x7d)
+#define PPP_TRANS (0x20)
+#define PPP_FCS_INIT (0xffff)
+#define PPP_FCS_GOOD (0xf0b8)
+/* address, control, protocol (IPv4) */
+#define PPP_HEADER_LEN (4)
+#define PPP_FCS_LEN (2)
+/* every byte escaped, plus the flags */
+#define PPP_FRAME_MAX (2 * (PPP_HEADER_LEN + BENCH_MTU + PPP_FCS_LEN) + 2)
+
+static const char *TAG = "ppp_bench";
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t mss;
+    uint32_t window;
+    uint32_t publishes;
+    uint32_t publish_size;
+} bench_params_t;
+
+/**
+ * @brief Receive side, runs in the UART event task
+ */
+typedef struct {
+    QueueHandle_t acks;                 /*!< Sequence numbers of received packets */
+    uint8_t frame[BENCH_MTU + PPP_HEADER_LEN + PPP_FCS_LEN];
+    size_t frame_len;
+    bool escaped;
+    bool overrun;
+    uint32_t frames;                    /*!< Frames with a good FCS */
+    uint32_t bad_frames;                /*!< Frames with a bad FCS or too long */
+    uint64_t copied;                    /*!< Bytes copied into frame */
+} bench_rx_t;
+
+typedef struct {
+    int64_t sent_us;
+    uint32_t retransmits;
+    bool acked;
+} bench_segment_t;
+
+typedef struct {
+    int64_t srtt_us;
+    int64_t rttvar_us;
+    int64_t rto_us;
+} bench_rto_t;
+
+typedef struct {
+    uint32_t segments;
+    uint32_t retransmits;
+    int64_t elapsed_us;
+    uint32_t frames_sent;
+    uint64_t tx_copied;                 /*!< Bytes written by the framing */
+    int64_t tx_cpu_us;
+    int64_t rx_cpu_us;
+    uint32_t publishes;
+    uint32_t publish_retransmits;
+    int64_t publish_min_us;
+    int64_t publish_avg_us;
+    int64_t publish_p95_us;
+    int64_t publish_max_us;
+} bench_result_t;
+
+static uint16_t s_fcs_table[256];
+
+static void ppp_fcs_init(void)
+{
+    for (uint32_t b = 0; b < 256; b++) {
+        uint16_t v = b;
+        for (int i = 0; i < 8; i++) {
+            v = v & 1 ? (v >> 1) ^ 0x8408 : v >> 1;
+        }
+        s_fcs_table[b] = v;
+    }
+}
+
+static inline uint16_t ppp_fcs_update(uint16_t fcs, uint8_t byte)
+{
+    return (fcs >> 8) ^ s_fcs_table[(fcs ^ byte) & 0xff];
+}
+
+static inline uint8_t *ppp_put(uint8_t *out, uint8_t byte)
+{
+    /* ACCM 0, control characters are sent as they are */
+    if (byte == PPP_FLAG || byte == PPP_ESCAPE) {
+        *out++ = PPP_ESCAPE;
+        byte ^= PPP_TRANS;
+    }
+    *out++ = byte;
+    return out;
+}
+
+/**
+ * @brief Frame an IPv4 packet, returns the length of the frame in out (PPP_FRAME_MAX bytes)
+ */
+static size_t ppp_encode(const uint8_t *packet, size_t length, uint8_t *out)
+{
+    static const uint8_t header[PPP_HEADER_LEN] = { 0xff, 0x03, 0x00, 0x21 };
+    uint8_t *p = out;
+    uint16_t fcs = PPP_FCS_INIT;
+    *p++ = PPP_FLAG;
+    for (size_t i = 0; i < PPP_HEADER_LEN; i++) {
+        fcs = ppp_fcs_update(fcs, header[i]);
+        p = ppp_put(p, header[i]);
+    }
+    for (size_t i = 0; i < length; i++) {
+        fcs = ppp_fcs_update(fcs, packet[i]);
+        p = ppp_put(p, packet[i]);
+    }
+    fcs ^= 0xffff;
+    p = ppp_put(p, fcs & 0xff);
+    p = ppp_put(p, fcs >> 8);
+    *p++ = PPP_FLAG;
+    return p - out;
+}
+
+static void bench_rx_frame(bench_rx_t *rx)
+{
+    uint16_t fcs = PPP_FCS_INIT;
+    for (size_t i = 0; i < rx->frame_len; i++) {
+        fcs = ppp_fcs_update(fcs, rx->frame[i]);
+    }
+    if (rx->overrun || fcs != PPP_FCS_GOOD ||
+            rx->frame_len < PPP_HEADER_LEN + BENCH_HEADER_LEN + sizeof(uint32_t) + PPP_FCS_LEN) {
+        rx->bad_frames++;
+        return;
+    }
+    rx->frames++;
+    uint32_t seq;
+    memcpy(&seq, rx->frame + PPP_HEADER_LEN + BENCH_HEADER_LEN, sizeof(seq));
+    if (xQueueSend(rx->acks, &seq, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "ack queue full");
+    }
+}
+
+/**
+ * @brief Netif input, deframes like pppos_input() does
+ */
+static void bench_input(const uint8_t *data, size_t length, void *context)
+{
+    bench_rx_t *rx = context;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        if (byte == PPP_FLAG) {
+            if (rx->frame_len) {
+                bench_rx_frame(rx);
+            }
+            rx->frame_len = 0;
+            rx->escaped = false;
+            rx->overrun = false;
+            continue;
+        }
+        if (byte == PPP_ESCAPE) {
+            rx->escaped = true;
+            continue;
+        }
+        if (rx->escaped) {
+            byte ^= PPP_TRANS;
+            rx->escaped = false;
+        }
+        if (rx->frame_len == sizeof(rx->frame)) {
+            rx->overrun = true;
+            continue;
+        }
+        rx->frame[rx->frame_len++] = byte;
+        rx->copied++;
+    }
+}
+
+static int64_t thread_cpu_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void rto_init(bench_rto_t *rto)
+{
+    rto->srtt_us = 0;
+    rto->rttvar_us = 0;
+    rto->rto_us = BENCH_RTO_INITIAL_MS * 1000LL;
+}
+
+/**
+ * @brief Update the retransmission timeout with a round trip sample, RFC 6298 2.2 and 2.3
+ */
+static void rto_sample(bench_rto_t *rto, int64_t rtt_us)
+{
+    if (rto->srtt_us == 0) {
+        rto->srtt_us = rtt_us;
+        rto->rttvar_us = rtt_us / 2;
+    } else {
+        int64_t delta = rto->srtt_us > rtt_us ? rto->srtt_us - rtt_us : rtt_us - rto->srtt_us;
+        rto->rttvar_us = (3 * rto->rttvar_us + delta) / 4;
+        rto->srtt_us = (7 * rto->srtt_us + rtt_us) / 8;
+    }
+    rto->rto_us = rto->srtt_us + 4 * rto->rttvar_us;
+    if (rto->rto_us < BENCH_RTO_MIN_MS * 1000LL) {
+        rto->rto_us = BENCH_RTO_MIN_MS * 1000LL;
+    }
+}
+
+/**
+ * @brief Back off after a timeout, RFC 6298 5.5
+ */
+static void rto_backoff(bench_rto_t *rto)
+{
+    rto->rto_us = rto->rto_us * 2 < BENCH_RTO_MAX_MS * 1000LL ? rto->rto_us * 2 : BENCH_RTO_MAX_MS * 1000LL;
+}
+
+/**
+ * @brief Frame and transmit a packet of length bytes carrying seq
+ */
+static esp_err_t bench_send(esp_netif_t *netif, uint8_t *packet, size_t length, uint32_t seq,
+                            bench_result_t *result)
+{
+    uint8_t frame[PPP_FRAME_MAX];
+    memcpy(packet + BENCH_HEADER_LEN, &seq, sizeof(seq));
+    size_t frame_len = ppp_encode(packet, length, frame);
+    result->tx_copied += frame_len;
+    result->frames_sent++;
+    return esp_netif_transmit(netif, frame, frame_len);
+}
+
+/**
+ * @brief Fill a packet with a pattern, every byte value appears
+ */
+static void bench_fill(uint8_t *packet, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        packet[i] = i;
+    }
+}
+
+static TickType_t bench_wait_ticks(int64_t until_us)
+{
+    int64_t now = esp_timer_get_time();
+    return until_us > now ? (until_us - now + 999) / 1000 / portTICK_PERIOD_MS : 0;
+}
+
+/**
+ * @brief Send params->bytes in segments of params->mss, with up to params->window segments unacknowledged
+ */
+static esp_err_t bench_goodput(esp_netif_t *netif, bench_rx_t *rx, const bench_params_t *params,
+                               bench_result_t *result)
+{
+    uint32_t count = (params->bytes + params->mss - 1) / params->mss;
+    bench_segment_t *segments = calloc(count, sizeof(bench_segment_t));
+    uint8_t *packet = calloc(1, BENCH_HEADER_LEN + params->mss);
+    esp_err_t err = ESP_FAIL;
+    if (segments == NULL || packet == NULL) {
+        goto end;
+    }
+    bench_fill(packet, BENCH_HEADER_LEN + params->mss);
+    bench_rto_t rto;
+    rto_init(&rto);
+    uint32_t base = 0;          /* oldest unacknowledged segment */
+    uint32_t next = 0;          /* next segment to send */
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + BENCH_TIMEOUT_S * 1000000LL;
+    while (base < count) {
+        while (next < count && next - base < params->window) {
+            if (bench_send(netif, packet, BENCH_HEADER_LEN + params->mss, next, result) != ESP_OK) {
+                goto end;
+            }
+            segments[next++].sent_us = esp_timer_get_time();
+        }
+        /* the oldest segment times out first, retransmissions restart its timer */
+        int64_t expiry = INT64_MAX;
+        for (uint32_t i = base; i < next; i++) {
+            if (!segments[i].acked && segments[i].sent_us + rto.rto_us < expiry) {
+                expiry = segments[i].sent_us + rto.rto_us;
+            }
+        }
+        uint32_t seq;
+        if (xQueueReceive(rx->acks, &seq, bench_wait_ticks(expiry)) == pdTRUE) {
+            do {
+                if (seq >= next || segments[seq].acked) {
+                    continue;
+                }
+                segments[seq].acked = true;
+                /* Karn: no samples from retransmitted segments */
+                if (segments[seq].retransmits == 0) {
+                    rto_sample(&rto, esp_timer_get_time() - segments[seq].sent_us);
+                }
+            } while (xQueueReceive(rx->acks, &seq, 0) == pdTRUE);
+            while (base < next && segments[base].acked) {
+                base++;
+            }
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        if (now > deadline) {
+            ESP_LOGE(TAG, "transfer timed out, %u of %u segments acknowledged", base, count);
+            goto end;
+        }
+        bool backoff = false;
+        for (uint32_t i = base; i < next; i++) {
+            if (!segments[i].acked && now - segments[i].sent_us >= rto.rto_us) {
+                if (bench_send(netif, packet, BENCH_HEADER_LEN + params->mss, i, result) != ESP_OK) {
+                    goto end;
+                }
+                segments[i].sent_us = esp_timer_get_time();
+                segments[i].retransmits++;
+                result->retransmits++;
+                backoff = true;
+            }
+        }
+        if (backoff) {
+            rto_backoff(&rto);
+        }
+    }
+    result->elapsed_us = esp_timer_get_time() - start;
+    result->segments = count;
+    err = ESP_OK;
+end:
+    free(packet);
+    free(segments);
+    return err;
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Send publish sized packets one at a time and measure the time to their echo
+ */
+static esp_err_t bench_publish(esp_netif_t *netif, bench_rx_t *rx, const bench_params_t *params,
+                               bench_result_t *result)
+{
+    int64_t *latency = calloc(params->publishes, sizeof(int64_t));
+    uint8_t *packet = calloc(1, BENCH_HEADER_LEN + params->publish_size);
+    esp_err_t err = ESP_FAIL;
+    if (latency == NULL || packet == NULL) {
+        goto end;
+    }
+    bench_fill(packet, BENCH_HEADER_LEN + params->publish_size);
+    bench_rto_t rto;
+    rto_init(&rto);
+    int64_t deadline = esp_timer_get_time() + BENCH_TIMEOUT_S * 1000000LL;
+    for (uint32_t i = 0; i < params->publishes; i++) {
+        uint32_t id = BENCH_PUBLISH_FLAG | i;
+        int64_t start = esp_timer_get_time();
+        int64_t sent = start;
+        bool retransmitted = false;
+        if (bench_send(netif, packet, BENCH_HEADER_LEN + params->publish_size, id, result) != ESP_OK) {
+            goto end;
+        }
+        while (true) {
+            uint32_t seq;
+            if (xQueueReceive(rx->acks, &seq, bench_wait_ticks(sent + rto.rto_us)) == pdTRUE) {
+                if (seq != id) {
+                    /* late echo of an earlier retransmission */
+                    continue;
+                }
+                int64_t now = esp_timer_get_time();
+                if (!retransmitted) {
+                    rto_sample(&rto, now - sent);
+                }
+                latency[i] = now - start;
+                break;
+            }
+            if (esp_timer_get_time() > deadline) {
+                ESP_LOGE(TAG, "round trip test timed out after %u publishes", i);
+                goto end;
+            }
+            if (bench_send(netif, packet, BENCH_HEADER_LEN + params->publish_size, id, result) != ESP_OK) {
+                goto end;
+            }
+            sent = esp_timer_get_time();
+            retransmitted = true;
+            result->publish_retransmits++;
+            rto_backoff(&rto);
+        }
+    }
+    result->publishes = params->publishes;
+    if (params->publishes) {
+        qsort(latency, params->publishes, sizeof(int64_t), compare_i64);
+        int64_t sum = 0;
+        for (uint32_t i = 0; i < params->publishes; i++) {
+            sum += latency[i];
+        }
+        result->publish_min_us = latency[0];
+        result->publish_avg_us = sum / params->publishes;
+        result->publish_p95_us = latency[(params->publishes * 95 - 1) / 100];
+        result->publish_max_us = latency[params->publishes - 1];
+    }
+    err = ESP_OK;
+end:
+    free(packet);
+    free(latency);
+    return err;
+}
+
+static void bench_print(const modem_emulator_config_t *config, const bench_params_t *params,
+                        const bench_result_t *result, const bench_rx_t *rx, const uart_host_stats_t *uart,
+                        const esp_netif_host_stats_t *netif)
+{
+    double goodput = result->elapsed_us ? (double)params->bytes * 1e6 / result->elapsed_us : 0;
+    uint32_t frames_sent = result->frames_sent ? result->frames_sent : 1;
+    uint32_t frames_received = rx->frames + rx->bad_frames ? rx->frames + rx->bad_frames : 1;
+    uint64_t tx_wire = uart->tx_bytes ? uart->tx_bytes : 1;
+    uint64_t rx_wire = uart->rx_bytes ? uart->rx_bytes : 1;
+    printf("link      %u baud, rtt %u ms, loss %.1f %%, mss %u, window %u\n",
+           config->baud, config->rtt_ms, config->loss_permille / 10.0, params->mss, params->window);
+    printf("goodput   %.1f kB/s", goodput / 1000);
+    if (config->baud) {
+        printf(" (%.0f %% of the line rate)", goodput * 10 * 100 / config->baud);
+    }
+    printf(", %u segments, %u retransmitted, %u bad frames\n", result->segments, result->retransmits,
+           rx->bad_frames);
+    printf("cpu       tx %.2f us/frame, rx %.2f us/frame (%u netif inputs)\n",
+           (double)result->tx_cpu_us / frames_sent, (double)result->rx_cpu_us / frames_received, netif->rx_calls);
+    printf("copies    tx %.2f per byte on the line (framing, driver), "
+           "rx %.2f (driver ring in and out, netif, deframing)\n",
+           (double)(result->tx_copied + uart->tx_bytes) / tx_wire,
+           (double)(uart->rx_copied + netif->rx_copied + rx->copied) / rx_wire);
+    printf("publish   %u x %u bytes, round trip min %.1f, avg %.1f, p95 %.1f, max %.1f ms, %u retransmitted\n",
+           result->publishes, params->publish_size, result->publish_min_us / 1000.0,
+           result->publish_avg_us / 1000.0, result->publish_p95_us / 1000.0, result->publish_max_us / 1000.0,
+           result->publish_retransmits);
+}
+
+static esp_err_t bench_run(const modem_emulator_config_t *config, const bench_params_t *params)
+{
+    bench_result_t result = { 0 };
+    bench_rx_t *rx = calloc(1, sizeof(bench_rx_t));
+    if (rx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    rx->acks = xQueueCreate(BENCH_ACK_QUEUE_SIZE, sizeof(uint32_t));
+    if (rx->acks == NULL) {
+        free(rx);
+        return ESP_ERR_NO_MEM;
+    }
+    /* the identity is cached per SIM, start cold */
+    esp_modem_dce_cache_erase();
+    modem_host_t host;
+    esp_err_t err = ESP_FAIL;
+    void *driver = NULL;
+    esp_netif_t *netif = NULL;
+    if (modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", config) != ESP_OK) {
+        goto end;
+    }
+    if (esp_modem_wait_ready(host.dte, BENCH_READY_TIMEOUT_MS) != ESP_OK || bg96_init(host.dte) == NULL) {
+        ESP_LOGE(TAG, "modem init failed");
+        goto end;
+    }
+    netif = esp_netif_host_new(bench_input, rx);
+    driver = esp_modem_netif_setup(host.dte);
+    if (netif == NULL || driver == NULL) {
+        goto end;
+    }
+    esp_modem_netif_set_default_handlers(driver, netif);
+    if (esp_netif_attach(netif, driver) != ESP_OK) {
+        goto end;
+    }
+    for (int i = 0; i < BENCH_START_TIMEOUT_MS && !esp_netif_host_is_started(netif); i++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    if (!esp_netif_host_is_started(netif)) {
+        ESP_LOGE(TAG, "PPP did not start");
+        goto end;
+    }
+
+    TaskHandle_t uart_task = xTaskGetHandle("uart_event");
+    int64_t rx_cpu_start = host_task_cpu_time_us(uart_task);
+    int64_t tx_cpu_start = thread_cpu_time_us();
+    if (bench_goodput(netif, rx, params, &result) != ESP_OK ||
+            bench_publish(netif, rx, params, &result) != ESP_OK) {
+        goto stop;
+    }
+    result.tx_cpu_us = thread_cpu_time_us() - tx_cpu_start;
+    result.rx_cpu_us = host_task_cpu_time_us(uart_task) - rx_cpu_start;
+    uart_host_stats_t uart_stats;
+    esp_netif_host_stats_t netif_stats;
+    uart_host_get_stats(UART_NUM_1, &uart_stats);
+    esp_netif_host_get_stats(netif, &netif_stats);
+    bench_print(config, params, &result, rx, &uart_stats, &netif_stats);
+    err = ESP_OK;
+stop:
+    if (esp_modem_stop_ppp(host.dte) != ESP_OK) {
+        ESP_LOGE(TAG, "leaving data mode failed");
+        err = ESP_FAIL;
+    }
+end:
+    if (driver) {
+        esp_modem_netif_clear_default_handlers(driver);
+        /* destroys the netif */
+        esp_modem_netif_teardown(driver);
+    } else {
+        esp_netif_destroy(netif);
+    }
+    if (host.emulator) {
+        modem_host_stop(&host);
+    }
+    vQueueDelete(rx->acks);
+    free(rx);
+    return err;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -b <baud>    line rate of the emulated link, 0 for no limit (%d)\n"
+            "  -r <ms>      round trip time of the emulated link (%d)\n"
+            "  -L <1/1000>  chance of a frame being lost\n"
+            "  -f <1/1e6>   chance of a corrupted byte\n"
+            "  -n <bytes>   bytes to transfer (%d)\n"
+            "  -m <bytes>   segment size (%d)\n"
+            "  -w <count>   segments in flight, up to %d (%d)\n"
+            "  -p <count>   publish round trips (%d)\n"
+            "  -P <bytes>   publish size (%d)\n"
+            "  -s <seed>    seed of the emulator\n"
+            "  -v           debug log\n",
+            name, BENCH_DEFAULT_BAUD, BENCH_DEFAULT_RTT_MS, BENCH_DEFAULT_BYTES, BENCH_DEFAULT_MSS, BENCH_WINDOW_MAX,
+            BENCH_DEFAULT_WINDOW, BENCH_DEFAULT_PUBLISHES, BENCH_DEFAULT_PUBLISH_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    config.baud = BENCH_DEFAULT_BAUD;
+    config.rtt_ms = BENCH_DEFAULT_RTT_MS;
+    bench_params_t params = {
+        .bytes = BENCH_DEFAULT_BYTES,
+        .mss = BENCH_DEFAULT_MSS,
+        .window = BENCH_DEFAULT_WINDOW,
+        .publishes = BENCH_DEFAULT_PUBLISHES,
+        .publish_size = BENCH_DEFAULT_PUBLISH_SIZE,
+    };
+    esp_log_level_set("*", ESP_LOG_WARN);
+    int opt;
+    while ((opt = getopt(argc, argv, "b:r:L:f:n:m:w:p:P:s:vh")) != -1) {
+        switch (opt) {
+        case 'b':
+            config.baud = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            config.rtt_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'L':
+            config.loss_permille = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            config.flip_ppm = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            params.bytes = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            params.mss = strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            params.window = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            params.publishes = strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            params.publish_size = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            config.seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            esp_log_level_set("*", ESP_LOG_DEBUG);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (params.mss < sizeof(uint32_t) || params.mss > BENCH_MTU - BENCH_HEADER_LEN ||
+            params.publish_size < sizeof(uint32_t) || params.publish_size > BENCH_MTU - BENCH_HEADER_LEN ||
+            params.window == 0 || params.window > BENCH_WINDOW_MAX) {
+        usage(argv[0]);
+        return 2;
+    }
+    ppp_fcs_init();
+    return bench_run(&config, &params) == ESP_OK ? 0 : 1;
+}
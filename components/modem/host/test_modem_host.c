@@ -0,0 +1,535 @@
+/*
+ * Regression test of the modem component against the emulator
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "bg96.h"
+#include "sim800.h"
+#include "esp_modem_dce_cache.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_netif.h"
+#include "bg96_mqtt.h"
+#include "modem_host.h"
+
+#define TEST_READY_TIMEOUT_MS (5000)
+#define TEST_CSQ_ROUNDS (300)
+#define TEST_DATA_TIMEOUT_MS (5000)
+#define TEST_PROMPT_ROUNDS (10)
+#define TEST_PROMPT_TIMEOUT_MS (1000)
+/* learned timeout about twice the latency, slow latency just above the nominal timeout, margins for slow builds */
+#define TEST_CMD_NOMINAL_MS (150)
+#define TEST_CMD_LATENCY_MS (100)
+#define TEST_CMD_SLOW_LATENCY_MS (160)
+#define TEST_LINK_RTT_MS (50)
+#define TEST_LINK_REPLIES (5)
+#define TEST_LINK_TIMEOUT_MS (5000)
+#define TEST_MQTT_MESSAGES (3)
+
+static int s_failures = 0;
+
+#define TEST_ASSERT(condition)                                                      \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #condition); \
+            s_failures++;                                                           \
+            goto cleanup;                                                           \
+        }                                                                           \
+    } while (0)
+
+typedef struct {
+    uint32_t reg[3];                    /*!< NETWORK_REG events per domain */
+    esp_modem_network_reg_stat_t stat;  /*!< Status of the last NETWORK_REG event */
+    uint32_t link_lost;
+    esp_modem_link_lost_reason_t link_lost_reason;
+    uint32_t link_restored;
+    uint32_t ready;
+    uint32_t unknown;
+} test_events_t;
+
+typedef struct {
+    SemaphoreHandle_t received;
+    uint8_t data[64];
+    size_t length;
+} test_data_t;
+
+static void test_on_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    test_events_t *events = arg;
+    if (event_id == ESP_MODEM_EVENT_NETWORK_REG) {
+        esp_modem_network_reg_t *reg = event_data;
+        events->reg[reg->domain]++;
+        events->stat = reg->stat;
+    } else if (event_id == ESP_MODEM_EVENT_LINK_LOST) {
+        events->link_lost_reason = *(esp_modem_link_lost_reason_t *)event_data;
+        __atomic_fetch_add(&events->link_lost, 1, __ATOMIC_RELEASE);
+    } else if (event_id == ESP_MODEM_EVENT_LINK_RESTORED) {
+        __atomic_fetch_add(&events->link_restored, 1, __ATOMIC_RELEASE);
+    } else if (event_id == ESP_MODEM_EVENT_READY) {
+        __atomic_fetch_add(&events->ready, 1, __ATOMIC_RELEASE);
+    } else if (event_id == ESP_MODEM_EVENT_UNKNOWN) {
+        events->unknown++;
+    }
+}
+
+static bool test_wait_event(uint32_t *counter, uint32_t timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + timeout_ms * 1000LL;
+    while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) == 0) {
+        if (esp_timer_get_time() >= deadline) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return true;
+}
+
+static esp_err_t test_on_receive(void *buffer, size_t len, void *context)
+{
+    test_data_t *data = context;
+    size_t length = __atomic_load_n(&data->length, __ATOMIC_RELAXED);
+    size_t room = sizeof(data->data) - length;
+    len = len < room ? len : room;
+    memcpy(data->data + length, buffer, len);
+    __atomic_store_n(&data->length, length + len, __ATOMIC_RELEASE);
+    xSemaphoreGive(data->received);
+    return ESP_OK;
+}
+
+typedef struct {
+    SemaphoreHandle_t received;
+    int count;
+    char topic[TEST_MQTT_MESSAGES][32];
+    char payload[TEST_MQTT_MESSAGES][64];
+    size_t length[TEST_MQTT_MESSAGES];
+} test_messages_t;
+
+static void test_on_message(const char *topic, const char *payload, size_t length, void *context)
+{
+    test_messages_t *messages = context;
+    if (messages->count < TEST_MQTT_MESSAGES) {
+        snprintf(messages->topic[messages->count], sizeof(messages->topic[0]), "%s", topic);
+        snprintf(messages->payload[messages->count], sizeof(messages->payload[0]), "%s", payload);
+        messages->length[messages->count] = length;
+        messages->count++;
+    }
+    xSemaphoreGive(messages->received);
+}
+
+static void test_bg96_identity(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    modem_emulator_stats_t stats;
+    modem_host_t host;
+    printf("bg96 identity\n");
+    esp_modem_dce_cache_erase();
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_dce_t *dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(!strcmp(dce->name, "BG96"));
+    TEST_ASSERT(!strcmp(dce->imei, "866425031234567"));
+    TEST_ASSERT(!strcmp(dce->imsi, "234507098765432"));
+    TEST_ASSERT(!strcmp(dce->iccid, "8944501234567890123F"));
+    TEST_ASSERT(dce->get_operator_name(dce) == ESP_OK);
+    TEST_ASSERT(strstr(dce->oper, "EE Hologram") != NULL);
+    uint32_t bcs = 0, bcl = 0, voltage = 0;
+    TEST_ASSERT(dce->get_battery_status(dce, &bcs, &bcl, &voltage) == ESP_OK);
+    TEST_ASSERT(bcs == 0 && bcl == 78 && voltage == 3902);
+    modem_host_stop(&host);
+
+    /* same SIM, the identity comes from the cache */
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_emulator_get_stats(host.emulator, &stats);
+    uint32_t commands = stats.commands;
+    dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(!strcmp(dce->imei, "866425031234567"));
+    modem_emulator_get_stats(host.emulator, &stats);
+    /* AT, ATE0 and AT+QCCID */
+    TEST_ASSERT(stats.commands - commands == 3);
+
+    /* refreshing a known identity, AT+CGSN and AT+CIMI */
+    commands = stats.commands;
+    TEST_ASSERT(dce->get_identity(dce) == ESP_OK);
+    TEST_ASSERT(!strcmp(dce->name, "BG96") && !strcmp(dce->imsi, "234507098765432"));
+    modem_emulator_get_stats(host.emulator, &stats);
+    TEST_ASSERT(stats.commands - commands == 2);
+cleanup:
+    modem_host_stop(&host);
+}
+
+static void test_sim800_identity(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    modem_host_t host;
+    printf("sim800 identity\n");
+    esp_modem_dce_cache_erase();
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/sim800.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_dce_t *dce = sim800_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(!strcmp(dce->name, "SIMCOM_SIM800L"));
+    TEST_ASSERT(!strcmp(dce->imei, "869170031234567"));
+    TEST_ASSERT(!strcmp(dce->imsi, "234100012345678"));
+    TEST_ASSERT(!strcmp(dce->iccid, "8944100012345678901F"));
+    uint32_t rssi = 0, ber = 0;
+    TEST_ASSERT(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK);
+    TEST_ASSERT(rssi == 17 && ber == 0);
+cleanup:
+    modem_host_stop(&host);
+}
+
+/**
+ * @brief Commands keep working with URCs and garbage lines in between, all URCs arrive as events
+ */
+static void test_bg96_noise(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    test_events_t events = { 0 };
+    modem_host_t host;
+    printf("bg96 urc and noise\n");
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_set_event_handler(host.dte, test_on_event, ESP_EVENT_ANY_ID, &events) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_dce_t *dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(dce->set_network_reg_report(dce, true) == ESP_OK);
+
+    /* +CSQ is matched by prefix, everything else in between has to pass the handler */
+    config.urc_interval_ms = 2;
+    config.noise_permille = 100;
+    config.jitter_ms = 1;
+    modem_emulator_set_config(host.emulator, &config);
+    for (int i = 0; i < TEST_CSQ_ROUNDS; i++) {
+        uint32_t rssi = 0, ber = 0;
+        TEST_ASSERT(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK);
+        TEST_ASSERT(rssi == 24 && ber == 99);
+    }
+    config.urc_interval_ms = 0;
+    config.noise_permille = 0;
+    modem_emulator_set_config(host.emulator, &config);
+    /* a command round trip makes sure all URCs sent so far have been handled */
+    TEST_ASSERT(dce->sync(dce) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    modem_emulator_stats_t stats;
+    modem_emulator_get_stats(host.emulator, &stats);
+    printf("  %u urcs, %u garbage lines, %u unknown events\n", stats.urcs, stats.noise_lines, events.unknown);
+    TEST_ASSERT(stats.urcs > 0 && stats.noise_lines > 0);
+    /* +CEREG and +CGREG from the queries in set_network_reg_report, then 3 of 4 URCs are registration ones */
+    uint32_t reg = events.reg[ESP_MODEM_NETWORK_DOMAIN_EPS] + events.reg[ESP_MODEM_NETWORK_DOMAIN_GPRS];
+    TEST_ASSERT(reg == 2 + stats.urcs - stats.urcs / 4);
+    TEST_ASSERT(events.link_lost == stats.urcs / 4);
+    TEST_ASSERT(events.unknown >= stats.noise_lines);
+cleanup:
+    modem_host_stop(&host);
+}
+
+/**
+ * @brief Data mode loops back through the receive callback, command mode works again after +++
+ */
+static void test_bg96_data_mode(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    test_data_t data = { 0 };
+    test_events_t events = { 0 };
+    modem_host_t host;
+    printf("bg96 data mode\n");
+    data.received = xSemaphoreCreateBinary();
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_set_event_handler(host.dte, test_on_event, ESP_EVENT_ANY_ID, &events) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_dce_t *dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(esp_modem_set_rx_cb(host.dte, test_on_receive, &data) == ESP_OK);
+    TEST_ASSERT(host.dte->change_mode(host.dte, MODEM_PPP_MODE) == ESP_OK);
+    static const char frame[] = "\x7e\xff\x03\xc0\x21\x01\x01\x00\x04\x7e";
+    TEST_ASSERT(host.dte->send_data(host.dte, frame, sizeof(frame) - 1) == sizeof(frame) - 1);
+    /* generous deadline, instrumented builds (-fsanitize=thread) are slow */
+    int64_t deadline = esp_timer_get_time() + TEST_DATA_TIMEOUT_MS * 1000LL;
+    while (__atomic_load_n(&data.length, __ATOMIC_ACQUIRE) < sizeof(frame) - 1) {
+        TEST_ASSERT(esp_timer_get_time() < deadline);
+        xSemaphoreTake(data.received, pdMS_TO_TICKS(100));
+    }
+    TEST_ASSERT(!memcmp(data.data, frame, sizeof(frame) - 1));
+
+    /* NO CARRIER inside a frame is payload */
+    static const char carrier_frame[] = "\x7e\xff\x03\x00\x21\r\nNO CARRIER\r\n\x7e";
+    size_t expected = sizeof(frame) - 1 + sizeof(carrier_frame) - 1;
+    TEST_ASSERT(host.dte->send_data(host.dte, carrier_frame, sizeof(carrier_frame) - 1) == sizeof(carrier_frame) - 1);
+    while (__atomic_load_n(&data.length, __ATOMIC_ACQUIRE) < expected) {
+        TEST_ASSERT(esp_timer_get_time() < deadline);
+        xSemaphoreTake(data.received, pdMS_TO_TICKS(100));
+    }
+    TEST_ASSERT(!test_wait_event(&events.link_lost, 100));
+    /* between frames it is the modem dropping the call */
+    modem_emulator_inject(host.emulator, MODEM_RESULT_CODE_NO_CARRIER);
+    TEST_ASSERT(test_wait_event(&events.link_lost, TEST_DATA_TIMEOUT_MS));
+    TEST_ASSERT(events.link_lost_reason == ESP_MODEM_LINK_LOST_NO_CARRIER);
+    TEST_ASSERT(host.dte->change_mode(host.dte, MODEM_COMMAND_MODE) == ESP_OK);
+    uint32_t rssi = 0, ber = 0;
+    TEST_ASSERT(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK);
+    TEST_ASSERT(rssi == 24);
+cleanup:
+    modem_host_stop(&host);
+    vSemaphoreDelete(data.received);
+}
+
+/**
+ * @brief +QMTRECV payloads keep their commas and quotes, with and without the length field
+ */
+static void test_bg96_mqtt_receive(void)
+{
+    static const struct {
+        const char *urc;
+        const char *topic;
+        const char *payload;
+    } cases[TEST_MQTT_MESSAGES] = {
+        { "+QMTRECV: 0,1,\"cmd\",\"on\"", "cmd", "on" },
+        { "+QMTRECV: 0,2,\"cmd\",\"{\"zone\":3,\"state\":\"open, now\"}\"", "cmd",
+          "{\"zone\":3,\"state\":\"open, now\"}" },
+        { "+QMTRECV: 0,3,\"config\",12,\"a,\"b\",c,d,e\"", "config", "a,\"b\",c,d,e" },
+    };
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    bg96_mqtt_config_t mqtt_config = {
+        .host = "broker",
+        .port = 1883,
+        .client_id = "test",
+        .keepalive_s = 60,
+        .packet_timeout_s = 1,
+    };
+    test_messages_t messages = { 0 };
+    modem_host_t host;
+    modem_dce_t *dce = NULL;
+    printf("bg96 mqtt receive\n");
+    messages.received = xSemaphoreCreateCounting(TEST_MQTT_MESSAGES, 0);
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(bg96_mqtt_connect(dce, &mqtt_config) == ESP_OK);
+    TEST_ASSERT(bg96_mqtt_subscribe(dce, "#", 1, test_on_message, &messages) == ESP_OK);
+    for (int i = 0; i < TEST_MQTT_MESSAGES; i++) {
+        modem_emulator_inject(host.emulator, cases[i].urc);
+        TEST_ASSERT(xSemaphoreTake(messages.received, pdMS_TO_TICKS(TEST_DATA_TIMEOUT_MS)) == pdTRUE);
+        TEST_ASSERT(!strcmp(messages.topic[i], cases[i].topic));
+        TEST_ASSERT(!strcmp(messages.payload[i], cases[i].payload));
+        TEST_ASSERT(messages.length[i] == strlen(cases[i].payload));
+    }
+cleanup:
+    if (dce) {
+        bg96_mqtt_disconnect(dce);
+    }
+    modem_host_stop(&host);
+    vSemaphoreDelete(messages.received);
+}
+
+/**
+ * @brief The prompt is found behind a URC, line handling goes on afterwards and an error ends the wait early
+ */
+static void test_bg96_send_wait(void)
+{
+    static const char publish[] = "AT+QMTPUBEX=0,1,1,0,\"t\",4\r";
+    static const char upload[] = "AT+QFUPL=\"ca.pem\",1024\r";
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    modem_host_t host;
+    printf("bg96 send wait\n");
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_dce_t *dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    for (int i = 0; i < TEST_PROMPT_ROUNDS; i++) {
+        TEST_ASSERT(host.dte->send_wait(host.dte, publish, strlen(publish), "\r\n> ", TEST_PROMPT_TIMEOUT_MS) == ESP_OK);
+        uint32_t rssi = 0, ber = 0;
+        TEST_ASSERT(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK);
+        TEST_ASSERT(rssi == 24);
+    }
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT(host.dte->send_wait(host.dte, upload, strlen(upload), "\r\nCONNECT\r\n", TEST_PROMPT_TIMEOUT_MS) ==
+                ESP_FAIL);
+    TEST_ASSERT(esp_timer_get_time() - start < TEST_PROMPT_TIMEOUT_MS * 1000LL / 2);
+cleanup:
+    modem_host_stop(&host);
+}
+
+static esp_err_t test_send_csq(modem_dte_t *dte, uint32_t timeout_ms)
+{
+    dte->dce->handle_line = esp_modem_dce_handle_response_default;
+    return dte->send_cmd(dte, "AT+CSQ\r", timeout_ms);
+}
+
+static const esp_modem_cmd_stats_t *test_find_cmd_stats(const esp_modem_cmd_stats_t *stats, uint32_t count,
+                                                        const char *command)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (!strcmp(stats[i].command, command)) {
+            return &stats[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Command timeouts follow the latency seen: a modem slower than the nominal timeout keeps working
+ */
+static void test_bg96_adaptive_timeout(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    esp_modem_cmd_stats_t stats[ESP_MODEM_CMD_STATS_MAX_COMMANDS];
+    uint32_t count = 0;
+    modem_host_t host;
+    printf("bg96 adaptive timeout\n");
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    TEST_ASSERT(bg96_init(host.dte) != NULL);
+    esp_modem_reset_cmd_stats(host.dte);
+    config.latency_ms = TEST_CMD_LATENCY_MS;
+    modem_emulator_set_config(host.emulator, &config);
+    for (int i = 0; i < ESP_MODEM_CMD_TIMEOUT_MIN_SAMPLES; i++) {
+        TEST_ASSERT(test_send_csq(host.dte, TEST_CMD_NOMINAL_MS) == ESP_OK);
+    }
+    /* slower than the nominal timeout, but within twice the latency learned */
+    config.latency_ms = TEST_CMD_SLOW_LATENCY_MS;
+    modem_emulator_set_config(host.emulator, &config);
+    TEST_ASSERT(test_send_csq(host.dte, TEST_CMD_NOMINAL_MS) == ESP_OK);
+    TEST_ASSERT(esp_modem_get_cmd_stats(host.dte, stats, ESP_MODEM_CMD_STATS_MAX_COMMANDS, &count) == ESP_OK);
+    const esp_modem_cmd_stats_t *csq = test_find_cmd_stats(stats, count, "AT+CSQ");
+    TEST_ASSERT(csq != NULL);
+    printf("  p50 %d, p99 %d, max %d ms, timeout %d ms\n", esp_modem_cmd_stats_percentile(csq, 50),
+           esp_modem_cmd_stats_percentile(csq, 99), csq->max_ms, csq->timeout_ms);
+    TEST_ASSERT(csq->count == ESP_MODEM_CMD_TIMEOUT_MIN_SAMPLES + 1);
+    TEST_ASSERT(csq->timeouts == 0 && csq->slow >= 1);
+    TEST_ASSERT(csq->timeout_ms > TEST_CMD_SLOW_LATENCY_MS);
+    TEST_ASSERT(csq->timeout_ms <= TEST_CMD_NOMINAL_MS * ESP_MODEM_CMD_TIMEOUT_STRETCH);
+    /* a long nominal timeout shrinks to the floor */
+    TEST_ASSERT(test_send_csq(host.dte, ESP_MODEM_CMD_TIMEOUT_CEILING_MS * 2) == ESP_OK);
+    TEST_ASSERT(esp_modem_get_cmd_stats(host.dte, stats, ESP_MODEM_CMD_STATS_MAX_COMMANDS, &count) == ESP_OK);
+    csq = test_find_cmd_stats(stats, count, "AT+CSQ");
+    TEST_ASSERT(csq != NULL && csq->timeout_ms == ESP_MODEM_CMD_TIMEOUT_FLOOR_MS);
+cleanup:
+    modem_host_stop(&host);
+}
+
+/**
+ * @brief LCP echoes measure the round trip time of the link, a dead link is reported within seconds
+ */
+static void test_bg96_link_monitor(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    esp_modem_link_monitor_config_t monitor_config = {
+        .min_interval_ms = 100,
+        .max_interval_ms = 400,
+        .max_timeout_ms = 1000,
+        .max_failures = 3,
+    };
+    esp_modem_link_stats_t stats = { 0 };
+    test_events_t events = { 0 };
+    modem_host_t host;
+    esp_netif_t *netif = NULL;
+    void *driver = NULL;
+    printf("bg96 link monitor\n");
+    config.rtt_ms = TEST_LINK_RTT_MS;
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_set_event_handler(host.dte, test_on_event, ESP_EVENT_ANY_ID, &events) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    TEST_ASSERT(bg96_init(host.dte) != NULL);
+    netif = esp_netif_host_new(NULL, NULL);
+    TEST_ASSERT(netif != NULL);
+    driver = esp_modem_netif_setup(host.dte);
+    TEST_ASSERT(driver != NULL);
+    TEST_ASSERT(esp_modem_netif_set_default_handlers(driver, netif) == ESP_OK);
+    TEST_ASSERT(esp_netif_attach(netif, driver) == ESP_OK);
+    for (int i = 0; i < TEST_DATA_TIMEOUT_MS && !esp_netif_host_is_started(netif); i++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    TEST_ASSERT(esp_netif_host_is_started(netif));
+
+    TEST_ASSERT(esp_modem_netif_start_link_monitor(driver, &monitor_config) == ESP_OK);
+    int64_t deadline = esp_timer_get_time() + TEST_LINK_TIMEOUT_MS * 1000LL;
+    do {
+        TEST_ASSERT(esp_timer_get_time() < deadline);
+        vTaskDelay(pdMS_TO_TICKS(50));
+        TEST_ASSERT(esp_modem_netif_get_link_stats(driver, &stats) == ESP_OK);
+    } while (stats.replies < TEST_LINK_REPLIES);
+    printf("  rtt min %d, smoothed %d, jitter %d ms, interval %d ms\n", stats.rtt_min_ms, stats.srtt_ms,
+           stats.jitter_ms, stats.interval_ms);
+    TEST_ASSERT(stats.up && stats.lost == 0 && stats.loss_permille == 0);
+    TEST_ASSERT(stats.rtt_min_ms >= TEST_LINK_RTT_MS && stats.srtt_ms < TEST_LINK_RTT_MS * 4);
+    TEST_ASSERT(stats.interval_ms > monitor_config.min_interval_ms);
+
+    /* the network stops answering */
+    config.loss_permille = 1000;
+    modem_emulator_set_config(host.emulator, &config);
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT(test_wait_event(&events.link_lost, TEST_LINK_TIMEOUT_MS));
+    TEST_ASSERT(events.link_lost_reason == ESP_MODEM_LINK_LOST_ECHO_TIMEOUT);
+    printf("  link down after %lld ms\n", (long long)(esp_timer_get_time() - start) / 1000);
+    TEST_ASSERT(esp_modem_netif_get_link_stats(driver, &stats) == ESP_OK);
+    TEST_ASSERT(!stats.up && stats.link_down == 1 && stats.lost >= monitor_config.max_failures);
+    TEST_ASSERT(stats.loss_permille > 0 && stats.interval_ms == monitor_config.min_interval_ms);
+
+    config.loss_permille = 0;
+    modem_emulator_set_config(host.emulator, &config);
+    TEST_ASSERT(test_wait_event(&events.link_restored, TEST_LINK_TIMEOUT_MS));
+    TEST_ASSERT(esp_modem_netif_get_link_stats(driver, &stats) == ESP_OK);
+    TEST_ASSERT(stats.up);
+cleanup:
+    if (driver) {
+        esp_modem_netif_stop_link_monitor(driver);
+        esp_modem_stop_ppp(host.dte);
+        esp_modem_netif_clear_default_handlers(driver);
+        /* destroys the netif */
+        esp_modem_netif_teardown(driver);
+    } else if (netif) {
+        esp_netif_destroy(netif);
+    }
+    modem_host_stop(&host);
+}
+
+/**
+ * @brief The module restarts and takes commands again once it reported ready
+ */
+static void test_bg96_reset(void)
+{
+    modem_emulator_config_t config = MODEM_EMULATOR_DEFAULT_CONFIG();
+    test_events_t events = { 0 };
+    modem_host_t host;
+    printf("bg96 reset\n");
+    TEST_ASSERT(modem_host_start(&host, TRANSCRIPT_DIR "/bg96.at", &config) == ESP_OK);
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    modem_dce_t *dce = bg96_init(host.dte);
+    TEST_ASSERT(dce != NULL);
+    TEST_ASSERT(esp_modem_set_event_handler(host.dte, test_on_event, ESP_EVENT_ANY_ID, &events) == ESP_OK);
+    TEST_ASSERT(dce->reset(dce) == ESP_OK);
+    TEST_ASSERT(test_wait_event(&events.ready, TEST_READY_TIMEOUT_MS));
+    TEST_ASSERT(esp_modem_wait_ready(host.dte, TEST_READY_TIMEOUT_MS) == ESP_OK);
+    uint32_t rssi = 0, ber = 0;
+    TEST_ASSERT(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK);
+    TEST_ASSERT(rssi == 24);
+cleanup:
+    modem_host_stop(&host);
+}
+
+int main(int argc, char **argv)
+{
+    esp_log_level_set("*", argc > 1 ? ESP_LOG_DEBUG : ESP_LOG_ERROR);
+    test_bg96_identity();
+    test_sim800_identity();
+    test_bg96_noise();
+    test_bg96_data_mode();
+    test_bg96_mqtt_receive();
+    test_bg96_send_wait();
+    test_bg96_adaptive_timeout();
+    test_bg96_link_monitor();
+    test_bg96_reset();
+    printf("%s: %d failure(s)\n", s_failures ? "FAIL" : "PASS", s_failures);
+    return s_failures ? 1 : 0;
+}
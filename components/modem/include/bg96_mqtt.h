@@ -0,0 +1,167 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief MQTT client of the BG96 TCP/IP stack (AT+QMT*)
+ *
+ * TCP, TLS and MQTT run inside the modem, the DTE only exchanges AT commands. The modem has to stay in
+ * command mode, so this cannot be used while a PPP session is active. Only one connection (client index 0)
+ * is supported.
+ *
+ */
+
+#define BG96_MQTT_TIMEOUT_PDP_ACTIVATE (150000) /*!< Timeout value for AT+QIACT */
+#define BG96_MQTT_TIMEOUT_OPEN (75000)          /*!< Timeout value for opening the network connection */
+
+/**
+ * @brief BG96 MQTT connection configuration
+ *
+ */
+typedef struct {
+    const char *host;          /*!< Broker host name */
+    uint16_t port;             /*!< Broker port */
+    const char *client_id;     /*!< MQTT client identifier */
+    const char *username;      /*!< MQTT user name, NULL for none */
+    const char *password;      /*!< MQTT password, NULL for none */
+    const char *ca_file;       /*!< CA certificates on the modem file system, NULL for plain TCP */
+    uint32_t context_id;       /*!< PDP context used by the modem TCP/IP stack, see bg96_activate_pdp() */
+    uint16_t keepalive_s;      /*!< Keep alive interval */
+    uint8_t packet_timeout_s;  /*!< Time to wait for an acknowledgement before retransmitting */
+    uint8_t retries;           /*!< Number of retransmissions */
+} bg96_mqtt_config_t;
+
+/**
+ * @brief Callback for received messages
+ *
+ * Runs in the context of the DTE task. The modem delivers payloads as text, binary payloads are not supported.
+ *
+ * @param topic topic of the message, NUL-terminated
+ * @param payload payload, NUL-terminated
+ * @param length length of payload
+ * @param context context passed to bg96_mqtt_subscribe()
+ */
+typedef void (*bg96_mqtt_receive_cb_t)(const char *topic, const char *payload, size_t length, void *context);
+
+/**
+ * @brief Configure and activate a PDP context for the modem TCP/IP stack
+ *
+ * @param dce Modem DCE object
+ * @param context_id PDP context identifier
+ * @param apn Access point name
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_activate_pdp(modem_dce_t *dce, uint32_t context_id, const char *apn);
+
+/**
+ * @brief Deactivate a PDP context activated by bg96_activate_pdp()
+ *
+ * @param dce Modem DCE object
+ * @param context_id PDP context identifier
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_deactivate_pdp(modem_dce_t *dce, uint32_t context_id);
+
+/**
+ * @brief Upload a file to the modem file system, replacing an existing one
+ *
+ * @param dce Modem DCE object
+ * @param name file name
+ * @param data file content
+ * @param length length of file content
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_upload_file(modem_dce_t *dce, const char *name, const uint8_t *data, size_t length);
+
+/**
+ * @brief Open the network connection and connect to the broker
+ *
+ * @param dce Modem DCE object
+ * @param config connection configuration, the strings are not used after the call
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if already connected
+ *      - ESP_ERR_TIMEOUT if the modem did not report the result in time
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_mqtt_connect(modem_dce_t *dce, const bg96_mqtt_config_t *config);
+
+/**
+ * @brief Publish a message and wait until the modem completed it
+ *
+ * For QoS 1 and 2 this includes the acknowledgement of the broker. The payload is sent with a length
+ * prefix (AT+QMTPUBEX), so any byte is allowed.
+ *
+ * @param dce Modem DCE object
+ * @param topic topic
+ * @param payload payload
+ * @param length length of payload
+ * @param qos quality of service, 0 to 2
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if not connected
+ *      - ESP_ERR_TIMEOUT if the modem did not report the result in time
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_mqtt_publish(modem_dce_t *dce, const char *topic, const uint8_t *payload, size_t length, int qos);
+
+/**
+ * @brief Subscribe to a topic
+ *
+ * @param dce Modem DCE object
+ * @param topic topic filter
+ * @param qos quality of service, 0 to 2
+ * @param callback callback for received messages, replaces the previous one
+ * @param context context passed to the callback
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if not connected
+ *      - ESP_ERR_TIMEOUT if the modem did not report the result in time
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_mqtt_subscribe(modem_dce_t *dce, const char *topic, int qos, bg96_mqtt_receive_cb_t callback,
+                              void *context);
+
+/**
+ * @brief Check if the broker connection is up
+ *
+ * @return true if connected
+ */
+bool bg96_mqtt_is_connected(void);
+
+/**
+ * @brief Disconnect from the broker and close the network connection
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t bg96_mqtt_disconnect(modem_dce_t *dce);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,9 +19,12 @@ extern "C" {
 
 #include "esp_modem_dce.h"
 #include "esp_modem_dte.h"
+#include "esp_modem_urc.h"
+#include "esp_modem_cmd_stats.h"
 #include "esp_event.h"
 #include "driver/uart.h"
 #include "esp_modem_compat.h"
+#include "sdkconfig.h"
 
 /**
  * @brief Declare Event Base for ESP Modem
@@ -34,11 +37,57 @@ ESP_EVENT_DECLARE_BASE(ESP_MODEM_EVENT);
  *
  */
 typedef enum {
-    ESP_MODEM_EVENT_PPP_START = 0,       /*!< ESP Modem Start PPP Session */
-    ESP_MODEM_EVENT_PPP_STOP  = 3,       /*!< ESP Modem Stop PPP Session*/
-    ESP_MODEM_EVENT_UNKNOWN   = 4        /*!< ESP Modem Unknown Response */
+    ESP_MODEM_EVENT_PPP_START   = 0,     /*!< ESP Modem Start PPP Session */
+    ESP_MODEM_EVENT_PPP_STOP    = 3,     /*!< ESP Modem Stop PPP Session*/
+    ESP_MODEM_EVENT_UNKNOWN     = 4,     /*!< ESP Modem Unknown Response */
+    ESP_MODEM_EVENT_NETWORK_REG = 5,     /*!< Network registration changed, data: esp_modem_network_reg_t */
+    ESP_MODEM_EVENT_LINK_LOST   = 6,     /*!< Data link lost, data: esp_modem_link_lost_reason_t */
+    ESP_MODEM_EVENT_READY       = 7,     /*!< Modem (re)started and ready for commands, data: URC line */
+    ESP_MODEM_EVENT_LINK_RESTORED = 8    /*!< Link monitor got echo replies again after ESP_MODEM_LINK_LOST_ECHO_TIMEOUT */
 } esp_modem_event_t;
 
+/**
+ * @brief Network registration domain
+ *
+ */
+typedef enum {
+    ESP_MODEM_NETWORK_DOMAIN_CS = 0,     /*!< Circuit switched, +CREG */
+    ESP_MODEM_NETWORK_DOMAIN_GPRS,       /*!< GPRS packet switched, +CGREG */
+    ESP_MODEM_NETWORK_DOMAIN_EPS         /*!< EPS (LTE) packet switched, +CEREG */
+} esp_modem_network_domain_t;
+
+/**
+ * @brief Network registration status, as defined by 3GPP TS 27.007
+ *
+ */
+typedef enum {
+    ESP_MODEM_NETWORK_REG_NOT_REGISTERED = 0, /*!< Not registered, not searching */
+    ESP_MODEM_NETWORK_REG_HOME = 1,           /*!< Registered, home network */
+    ESP_MODEM_NETWORK_REG_SEARCHING = 2,      /*!< Not registered, searching */
+    ESP_MODEM_NETWORK_REG_DENIED = 3,         /*!< Registration denied */
+    ESP_MODEM_NETWORK_REG_UNKNOWN = 4,        /*!< Unknown */
+    ESP_MODEM_NETWORK_REG_ROAMING = 5         /*!< Registered, roaming */
+} esp_modem_network_reg_stat_t;
+
+/**
+ * @brief Payload of ESP_MODEM_EVENT_NETWORK_REG
+ *
+ */
+typedef struct {
+    esp_modem_network_domain_t domain;   /*!< Registration domain */
+    esp_modem_network_reg_stat_t stat;   /*!< Registration status */
+} esp_modem_network_reg_t;
+
+/**
+ * @brief Reason of ESP_MODEM_EVENT_LINK_LOST
+ *
+ */
+typedef enum {
+    ESP_MODEM_LINK_LOST_NO_CARRIER = 0,  /*!< Modem reported NO CARRIER */
+    ESP_MODEM_LINK_LOST_PDP_DEACT,       /*!< Network deactivated the PDP context */
+    ESP_MODEM_LINK_LOST_ECHO_TIMEOUT     /*!< PPP peer stopped answering LCP echoes, see esp_modem_link_monitor.h */
+} esp_modem_link_lost_reason_t;
+
 /**
  * @brief ESP Modem DTE Configuration
  *
@@ -52,12 +101,33 @@ typedef struct {
     uint32_t baud_rate;             /*!< Communication baud rate */
 } esp_modem_dte_config_t;
 
+/**
+ * @brief ESP Modem DTE receive statistics
+ *
+ */
+typedef struct {
+    uint32_t fifo_overflows;    /*!< Hardware FIFO overflows, the driver discards the FIFO content */
+    uint32_t buffer_full;       /*!< Receive ring full events, drained without loss */
+    uint32_t pattern_overflows; /*!< Line positions missed by the pattern queue, lines are split in software */
+    uint32_t bytes_lost;        /*!< Received bytes discarded, FIFO overflows count as a full FIFO (upper bound) */
+} esp_modem_dte_stats_t;
+
 /**
  * @brief Type used for reception callback
  *
  */
 typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *context);
 
+/**
+ * @brief Flow control selected in the configuration
+ *
+ */
+#if CONFIG_EXAMPLE_UART_MODEM_FLOW_CONTROL_HW
+#define ESP_MODEM_DEFAULT_FLOW_CONTROL MODEM_FLOW_CONTROL_HW
+#else
+#define ESP_MODEM_DEFAULT_FLOW_CONTROL MODEM_FLOW_CONTROL_NONE
+#endif
+
 /**
  * @brief ESP Modem DTE Default Configuration
  *
@@ -69,7 +139,7 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
         .stop_bits = UART_STOP_BITS_1,          \
         .parity = UART_PARITY_DISABLE,          \
         .baud_rate = 115200,                    \
-        .flow_control = MODEM_FLOW_CONTROL_NONE \
+        .flow_control = ESP_MODEM_DEFAULT_FLOW_CONTROL \
     }
 
 /**
@@ -105,6 +175,21 @@ esp_err_t esp_modem_set_event_handler(modem_dte_t *dte, esp_event_handler_t hand
  */
 esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t handler);
 
+/**
+ * @brief Wait until the modem has booted and answers commands
+ *
+ * "AT" is sent with exponential backoff. RDY from the modem cuts the current interval short,
+ * so the wait ends shortly after the modem is up instead of after a fixed delay.
+ * Does not require a DCE object.
+ *
+ * @param dte Modem DTE object
+ * @param timeout_ms maximum time to wait
+ * @return esp_err_t
+ *      - ESP_OK if the modem answered
+ *      - ESP_ERR_TIMEOUT if it did not answer in time, possibly at another baud rate
+ */
+esp_err_t esp_modem_wait_ready(modem_dte_t *dte, uint32_t timeout_ms);
+
 /**
  * @brief Setup PPP Session
  *
@@ -125,6 +210,29 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
 
+/**
+ * @brief Suspend the PPP session to send AT commands
+ *
+ * The modem is switched to command mode with "+++", the data call stays up.
+ * Outgoing frames are dropped until esp_modem_resume_ppp() is called.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_pause_ppp(modem_dte_t *dte);
+
+/**
+ * @brief Return to a PPP session suspended by esp_modem_pause_ppp()
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error, e.g. the data call was dropped meanwhile
+ */
+esp_err_t esp_modem_resume_ppp(modem_dte_t *dte);
+
 /**
  * @brief Setup on reception callback
  *
@@ -136,6 +244,125 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb, void *receive_cb_ctx);
 
+/**
+ * @brief Get receive statistics of DTE
+ *
+ * @param dte ESP Modem DTE object
+ * @param stats statistics since the DTE was created
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_get_dte_stats(modem_dte_t *dte, esp_modem_dte_stats_t *stats);
+
+/**
+ * @brief Get the latency statistics of the commands sent
+ *
+ * Commands sent through send_cmd and send_payload are recorded, with the timeout applied to them.
+ * Compare the percentiles with the timeouts to spot a degrading modem or link.
+ *
+ * @param dte ESP Modem DTE object
+ * @param stats array for the statistics, one entry per command
+ * @param max number of entries of stats
+ * @param count number of entries filled in
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_get_cmd_stats(modem_dte_t *dte, esp_modem_cmd_stats_t *stats, uint32_t max, uint32_t *count);
+
+/**
+ * @brief Forget the command latency statistics
+ *
+ * Adaptive timeouts fall back to the nominal ones until enough commands have been seen again.
+ *
+ * @param dte ESP Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_reset_cmd_stats(modem_dte_t *dte);
+
+/**
+ * @brief Load the baud rate stored by the last successful negotiation
+ *
+ * @param baud_rate stored baud rate, left untouched if there is none
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NVS_NOT_FOUND if no baud rate has been stored
+ *      - others on NVS error
+ */
+esp_err_t esp_modem_load_baud_rate(uint32_t *baud_rate);
+
+/**
+ * @brief Find the baud rate the DCE is listening at
+ *
+ * The current baud rate is tried first, then all rates supported by negotiation.
+ * The DTE is left at the rate the DCE answered at. Does not require a DCE object.
+ *
+ * @param dte ESP Modem DTE object
+ * @param baud_rate baud rate the DCE answered at
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the DCE does not answer at any rate, the DTE baud rate is restored
+ */
+esp_err_t esp_modem_probe_baud_rate(modem_dte_t *dte, uint32_t *baud_rate);
+
+/**
+ * @brief Switch DTE and DCE to the highest baud rate both ends handle reliably
+ *
+ * Rates are tried fastest first with AT+IPR. After each switch the link has to answer several
+ * "AT" in a row, otherwise both ends fall back to the previous rate. The result is stored in
+ * the modem profile (AT&W) and in NVS, see esp_modem_load_baud_rate().
+ *
+ * @param dte ESP Modem DTE object, bound to a DCE in command mode
+ * @param max_baud_rate upper limit of the baud rate
+ * @param baud_rate baud rate in use afterwards
+ * @return esp_err_t
+ *      - ESP_OK on success, including when the current rate is kept
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_negotiate_baud_rate(modem_dte_t *dte, uint32_t max_baud_rate, uint32_t *baud_rate);
+
+/**
+ * @brief Register a handler for unsolicited result codes
+ *
+ * Lines which are not consumed by the handler of the command in progress are matched against the registered prefixes.
+ * Lines that match no prefix are posted as ESP_MODEM_EVENT_UNKNOWN.
+ *
+ * @param dte ESP Modem DTE object
+ * @param prefix URC prefix, e.g. "+CEREG"
+ * @param handler URC handler
+ * @param context context passed to the handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid prefix or handler
+ *      - ESP_ERR_NO_MEM if the URC registry is full
+ */
+esp_err_t esp_modem_add_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_handler_t handler, void *context);
+
+/**
+ * @brief Unregister a handler for unsolicited result codes
+ *
+ * @param dte ESP Modem DTE object
+ * @param prefix URC prefix used for registration
+ * @param handler URC handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the handler is not registered
+ */
+esp_err_t esp_modem_remove_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_handler_t handler);
+
+/**
+ * @brief Post an event to the ESP Modem event loop
+ *
+ * @param dte ESP Modem DTE object
+ * @param event_id event id, see esp_modem_event_t
+ * @param event_data event data, copied into the event loop
+ * @param event_data_size size of event data
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the event queue is full
+ */
+esp_err_t esp_modem_post_event(modem_dte_t *dte, int32_t event_id, const void *event_data, size_t event_data_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,128 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "esp_types.h"
+#include "esp_err.h"
+
+/**
+ * @brief Command latency table capacity
+ *
+ * Commands are told apart by their text up to and including the first '=' or '?', e.g. "AT+COPS?" and
+ * "AT+COPS=". Commands beyond the capacity share the last entry.
+ */
+#define ESP_MODEM_CMD_STATS_MAX_COMMANDS (24)    /*!< Max number of commands tracked separately */
+#define ESP_MODEM_CMD_STATS_MAX_NAME_LENGTH (15) /*!< Max length of a command name, longer ones are cut */
+#define ESP_MODEM_CMD_STATS_BUCKETS (14)         /*!< Histogram buckets, 10 ms to 100 s in 1-2-5 steps, and more */
+
+/**
+ * @brief Adaptive timeout parameters
+ *
+ * Once a command has been seen often enough, its timeout is twice the 99th percentile of its latency.
+ * Short timeouts may grow up to four times their nominal value, long ones shrink down to the floor.
+ */
+#define ESP_MODEM_CMD_TIMEOUT_MIN_SAMPLES (20)   /*!< Samples needed before the timeout adapts */
+#define ESP_MODEM_CMD_TIMEOUT_PERCENTILE (99)    /*!< Percentile of the latency the timeout is based on */
+#define ESP_MODEM_CMD_TIMEOUT_MARGIN (2)         /*!< Factor applied to the percentile */
+#define ESP_MODEM_CMD_TIMEOUT_FLOOR_MS (1000)    /*!< Lower limit, unless the nominal timeout is shorter */
+#define ESP_MODEM_CMD_TIMEOUT_CEILING_MS (10000) /*!< Upper limit, unless the nominal timeout is longer */
+#define ESP_MODEM_CMD_TIMEOUT_STRETCH (4)        /*!< Max factor a nominal timeout may grow by */
+
+/**
+ * @brief Latency statistics of one command
+ *
+ */
+typedef struct {
+    char command[ESP_MODEM_CMD_STATS_MAX_NAME_LENGTH + 1]; /*!< Command name, e.g. "AT+CSQ" or "AT+COPS?" */
+    uint32_t count;                                        /*!< Commands answered or timed out */
+    uint32_t timeouts;                                     /*!< Commands not answered in time */
+    uint32_t slow;                                         /*!< Commands answered after their nominal timeout */
+    uint32_t max_ms;                                       /*!< Longest latency */
+    uint64_t total_ms;                                     /*!< Sum of all latencies */
+    uint32_t nominal_ms;                                   /*!< Timeout requested for the last command */
+    uint32_t timeout_ms;                                   /*!< Timeout applied to the last command */
+    uint32_t histogram[ESP_MODEM_CMD_STATS_BUCKETS];       /*!< Latency histogram, timeouts included */
+} esp_modem_cmd_stats_t;
+
+/**
+ * @brief Command latency table
+ *
+ */
+typedef struct {
+    esp_modem_cmd_stats_t entries[ESP_MODEM_CMD_STATS_MAX_COMMANDS]; /*!< Statistics per command */
+    uint32_t count;                                                  /*!< Entries in use */
+} esp_modem_cmd_stats_table_t;
+
+/**
+ * @brief Initialize an empty command latency table
+ *
+ * @param table command latency table
+ */
+void esp_modem_cmd_stats_init(esp_modem_cmd_stats_table_t *table);
+
+/**
+ * @brief Get the name a command is tracked under
+ *
+ * Payloads which are not AT commands are tracked as "<data>".
+ *
+ * @param data command or payload as sent
+ * @param length length of data
+ * @param name buffer of ESP_MODEM_CMD_STATS_MAX_NAME_LENGTH + 1 bytes for the name
+ */
+void esp_modem_cmd_stats_name(const char *data, uint32_t length, char *name);
+
+/**
+ * @brief Get the timeout to apply to a command
+ *
+ * @param table command latency table
+ * @param name command name, see esp_modem_cmd_stats_name()
+ * @param nominal_ms timeout requested by the caller
+ * @return timeout in ms, nominal_ms until enough samples have been recorded
+ */
+uint32_t esp_modem_cmd_stats_timeout(const esp_modem_cmd_stats_table_t *table, const char *name, uint32_t nominal_ms);
+
+/**
+ * @brief Record the outcome of a command
+ *
+ * A timed out command is recorded with the time waited, so its percentile and timeout grow.
+ *
+ * @param table command latency table
+ * @param name command name, see esp_modem_cmd_stats_name()
+ * @param nominal_ms timeout requested by the caller
+ * @param timeout_ms timeout applied
+ * @param elapsed_ms time until the response or the timeout
+ * @param timed_out true if the command was not answered in time
+ */
+void esp_modem_cmd_stats_record(esp_modem_cmd_stats_table_t *table, const char *name, uint32_t nominal_ms,
+                                uint32_t timeout_ms, uint32_t elapsed_ms, bool timed_out);
+
+/**
+ * @brief Get a percentile of the latency of a command
+ *
+ * The result is the upper bound of the histogram bucket the percentile falls into, at most the longest latency.
+ *
+ * @param stats statistics of the command
+ * @param percentile percentile, 1 to 100
+ * @return latency in ms, 0 if nothing has been recorded
+ */
+uint32_t esp_modem_cmd_stats_percentile(const esp_modem_cmd_stats_t *stats, uint32_t percentile);
+
+#ifdef __cplusplus
+}
+#endif
@@ -45,6 +45,8 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_MAX_OPERATOR_LENGTH (32) /*!< Max Operator Name Length */
 #define MODEM_IMEI_LENGTH (15)         /*!< IMEI Number Length */
 #define MODEM_IMSI_LENGTH (15)         /*!< IMSI Number Length */
+#define MODEM_ICCID_LENGTH (20)        /*!< Max ICCID Length */
+#define MODEM_ICCID_MIN_DIGITS (18)    /*!< Min number of digits of an ICCID */
 
 /**
  * @brief Specific Timeout Constraint, Unit: millisecond
@@ -52,9 +54,12 @@ typedef struct modem_dte modem_dte_t;
  */
 #define MODEM_COMMAND_TIMEOUT_DEFAULT (500)      /*!< Default timeout value for most commands */
 #define MODEM_COMMAND_TIMEOUT_OPERATOR (75000)   /*!< Timeout value for getting operator status */
+#define MODEM_COMMAND_TIMEOUT_OPERATOR_READ (3000) /*!< Timeout value for reading the operator once registered */
 #define MODEM_COMMAND_TIMEOUT_MODE_CHANGE (3000) /*!< Timeout value for changing working mode */
 #define MODEM_COMMAND_TIMEOUT_HANG_UP (90000)    /*!< Timeout value for hang up */
 #define MODEM_COMMAND_TIMEOUT_POWEROFF (1000)    /*!< Timeout value for power down */
+#define MODEM_COMMAND_TIMEOUT_RESUME (3000)      /*!< Timeout value for returning to data mode */
+#define MODEM_COMMAND_TIMEOUT_RESET (15000)      /*!< Timeout value for restarting the module */
 
 /**
  * @brief Working state of DCE
@@ -75,6 +80,7 @@ struct modem_dce {
     char imsi[MODEM_IMSI_LENGTH + 1];                                                 /*!< IMSI number */
     char name[MODEM_MAX_NAME_LENGTH];                                                 /*!< Module name */
     char oper[MODEM_MAX_OPERATOR_LENGTH];                                             /*!< Operator name */
+    char iccid[MODEM_ICCID_LENGTH + 1];                                               /*!< SIM card ICCID */
     modem_state_t state;                                                              /*!< Modem working state */
     modem_mode_t mode;                                                                /*!< Working mode */
     modem_dte_t *dte;                                                                 /*!< DTE which connect to DCE */
@@ -83,13 +89,22 @@ struct modem_dce {
     esp_err_t (*echo_mode)(modem_dce_t *dce, bool on);                                /*!< Echo command on or off */
     esp_err_t (*store_profile)(modem_dce_t *dce);                                     /*!< Store user settings */
     esp_err_t (*set_flow_ctrl)(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl);        /*!< Flow control on or off */
+    esp_err_t (*set_baud_rate)(modem_dce_t *dce, uint32_t baud_rate);                 /*!< Change UART baud rate */
     esp_err_t (*get_signal_quality)(modem_dce_t *dce, uint32_t *rssi, uint32_t *ber); /*!< Get signal quality */
     esp_err_t (*get_battery_status)(modem_dce_t *dce, uint32_t *bcs,
                                     uint32_t *bcl, uint32_t *voltage);  /*!< Get battery status */
     esp_err_t (*define_pdp_context)(modem_dce_t *dce, uint32_t cid,
                                     const char *type, const char *apn); /*!< Set PDP Contex */
     esp_err_t (*set_working_mode)(modem_dce_t *dce, modem_mode_t mode); /*!< Set working mode */
+    esp_err_t (*resume_data_mode)(modem_dce_t *dce);                    /*!< Return to a data call left with +++ */
+    esp_err_t (*get_operator_name)(modem_dce_t *dce);                   /*!< Get operator name into oper */
+    esp_err_t (*get_identity)(modem_dce_t *dce);                        /*!< Get IMEI, IMSI and module name if new */
+    esp_err_t (*set_psm)(modem_dce_t *dce, bool on, uint32_t periodic_tau_s,
+                         uint32_t active_time_s);                       /*!< Power saving mode on or off */
+    esp_err_t (*set_edrx)(modem_dce_t *dce, bool on, uint32_t cycle_ms); /*!< Extended DRX on or off */
+    esp_err_t (*set_network_reg_report)(modem_dce_t *dce, bool on);     /*!< Network registration URCs on or off */
     esp_err_t (*hang_up)(modem_dce_t *dce);                             /*!< Hang up */
+    esp_err_t (*reset)(modem_dce_t *dce);                               /*!< Restart the module */
     esp_err_t (*power_down)(modem_dce_t *dce);                          /*!< Normal power down */
     esp_err_t (*deinit)(modem_dce_t *dce);                              /*!< Deinitialize */
 };
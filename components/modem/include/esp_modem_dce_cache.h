@@ -0,0 +1,80 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Load the cached identity of the DCE
+ *
+ * The cache is only used if it was stored for the SIM in dce->iccid. On success
+ * name, imei, imsi and oper of the DCE are filled from the cache.
+ *
+ * @param dce Modem DCE object, iccid must be set
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if there is no cache or it belongs to another SIM
+ *      - others on NVS error
+ */
+esp_err_t esp_modem_dce_cache_load(modem_dce_t *dce);
+
+/**
+ * @brief Store the identity of the DCE
+ *
+ * Flash is only written if the cached identity differs. Storing the identity of another SIM
+ * forgets the cached modem profile, see esp_modem_dce_cache_set_profile().
+ *
+ * @param dce Modem DCE object, iccid must be set
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - others on NVS error
+ */
+esp_err_t esp_modem_dce_cache_store(modem_dce_t *dce);
+
+/**
+ * @brief Check if the modem profile was saved with the given settings
+ *
+ * @param dce Modem DCE object, iccid must be set
+ * @param flow_ctrl flow control which should be in the profile
+ * @return true if set_flow_ctrl and store_profile can be skipped
+ */
+bool esp_modem_dce_cache_profile_stored(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl);
+
+/**
+ * @brief Remember that the modem profile was saved (AT&W) with the given settings
+ *
+ * @param dce Modem DCE object, iccid must be set
+ * @param flow_ctrl flow control saved in the profile
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - others on NVS error
+ */
+esp_err_t esp_modem_dce_cache_set_profile(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl);
+
+/**
+ * @brief Drop the cache, the next boot queries the full identity again
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - others on NVS error
+ */
+esp_err_t esp_modem_dce_cache_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
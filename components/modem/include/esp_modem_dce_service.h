@@ -49,6 +49,18 @@ static inline void strip_cr_lf_tail(char *str, uint32_t len)
     }
 }
 
+/**
+ * @brief Take the ICCID from a response line
+ *
+ * An ICCID is a run of at least MODEM_ICCID_MIN_DIGITS digits, some SIMs pad it with 'F'.
+ * Anything else, e.g. a "Call Ready" URC between the command and its answer, is not an ICCID.
+ *
+ * @param dce Modem DCE object, iccid is only written if the text holds an ICCID
+ * @param text text behind the response prefix, if any
+ * @return true if an ICCID was taken
+ */
+bool esp_modem_dce_parse_iccid(modem_dce_t *dce, const char *text);
+
 /**
  * @brief Default handler for response
  * Some responses for command are simple, commonly will return OK when succeed of ERROR when failed
@@ -103,6 +115,19 @@ esp_err_t esp_modem_dce_store_profile(modem_dce_t *dce);
  */
 esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl);
 
+/**
+ * @brief Set UART baud rate of DCE
+ *
+ * The DCE answers at the current baud rate and switches afterwards, the DTE has to follow right after this returns.
+ *
+ * @param dce Modem DCE object
+ * @param baud_rate new baud rate
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baud_rate);
+
 /**
  * @brief Define PDP context
  *
@@ -116,6 +141,61 @@ esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_c
  */
 esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const char *type, const char *apn);
 
+/**
+ * @brief Enable or disable network registration URCs
+ *
+ * When enabled, the current status is queried right away. The answer is reported like a URC, as
+ * ESP_MODEM_EVENT_NETWORK_REG, so the caller does not miss a registration that completed earlier.
+ *
+ * @param dce Modem DCE object
+ * @param reg registration command without "AT+", e.g. "CEREG"
+ * @param on true to enable URCs, false to disable them
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_reg_report(modem_dce_t *dce, const char *reg, bool on);
+
+/**
+ * @brief Return to a data call left with +++
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_resume_data_mode(modem_dce_t *dce);
+
+/**
+ * @brief Enable or disable power saving mode (AT+CPSMS)
+ *
+ * The timers are rounded up to the next value that 3GPP TS 24.008 can encode. The network
+ * may assign other values.
+ *
+ * @param dce Modem DCE object
+ * @param on true to request PSM, false to disable it
+ * @param periodic_tau_s requested periodic tracking area update interval (T3412 extended)
+ * @param active_time_s requested time the modem stays reachable after an activity (T3324)
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_psm(modem_dce_t *dce, bool on, uint32_t periodic_tau_s, uint32_t active_time_s);
+
+/**
+ * @brief Enable or disable extended DRX for LTE-M (AT+CEDRXS)
+ *
+ * The cycle is rounded down to the next value defined by 3GPP TS 24.008, at least 5.12 s.
+ *
+ * @param dce Modem DCE object
+ * @param on true to request eDRX, false to disable it
+ * @param cycle_ms requested eDRX cycle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_edrx(modem_dce_t *dce, bool on, uint32_t cycle_ms);
+
 /**
  * @brief Hang up
  *
@@ -126,6 +206,18 @@ esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const
  */
 esp_err_t esp_modem_dce_hang_up(modem_dce_t *dce);
 
+/**
+ * @brief Restart the module (full functionality after reset)
+ *
+ * The module drops its network attachment and boots again, it reports RDY when it takes commands.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_reset(modem_dce_t *dce);
+
 #ifdef __cplusplus
 }
 #endif
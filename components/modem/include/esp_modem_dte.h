@@ -54,7 +54,10 @@ struct modem_dte {
     int (*send_data)(modem_dte_t *dte, const char *data, uint32_t length);          /*!< Send data to DCE */
     esp_err_t (*send_wait)(modem_dte_t *dte, const char *data, uint32_t length,
                            const char *prompt, uint32_t timeout);      /*!< Wait for specific prompt */
+    esp_err_t (*send_payload)(modem_dte_t *dte, const char *data, uint32_t length,
+                              uint32_t timeout);                       /*!< Send binary payload after a prompt, like send_cmd */
     esp_err_t (*change_mode)(modem_dte_t *dte, modem_mode_t new_mode); /*!< Changing working mode */
+    esp_err_t (*change_baud)(modem_dte_t *dte, uint32_t baud_rate);    /*!< Changing UART baud rate */
     esp_err_t (*process_cmd_done)(modem_dte_t *dte);                   /*!< Callback when DCE process command done */
     esp_err_t (*deinit)(modem_dte_t *dte);                             /*!< Deinitialize */
 };
@@ -0,0 +1,153 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "esp_types.h"
+#include "esp_err.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief PPP link monitor
+ *
+ * Sends LCP Echo-Requests on the PPP session and times the replies. The interval doubles with every reply
+ * up to max_interval_ms and drops back to min_interval_ms after a lost echo, or when the network stack
+ * sent data and heard nothing back for longer than the reply timeout. The reply timeout follows the round
+ * trip time (smoothed RTT plus four times its mean deviation, as TCP does).
+ *
+ * After max_failures echoes in a row went unanswered, ESP_MODEM_EVENT_LINK_LOST is posted with
+ * ESP_MODEM_LINK_LOST_ECHO_TIMEOUT, and ESP_MODEM_EVENT_LINK_RESTORED once replies come back.
+ */
+
+#define ESP_MODEM_LINK_MONITOR_HISTORY (32)          /*!< Echoes the loss rate is computed over */
+#define ESP_MODEM_LINK_MONITOR_MIN_TIMEOUT_MS (500)  /*!< Lower limit of the reply timeout */
+#define ESP_MODEM_LINK_MONITOR_TASK_STACK_SIZE (2048)
+#define ESP_MODEM_LINK_MONITOR_TASK_PRIORITY (5)
+
+/**
+ * @brief Link monitor configuration
+ *
+ */
+typedef struct {
+    uint32_t min_interval_ms;  /*!< Echo interval at the start and after a lost echo */
+    uint32_t max_interval_ms;  /*!< Upper limit of the echo interval */
+    uint32_t max_timeout_ms;   /*!< Upper limit of the reply timeout, also the timeout of the first echo */
+    uint32_t max_failures;     /*!< Echoes lost in a row until the link is reported down */
+} esp_modem_link_monitor_config_t;
+
+#define ESP_MODEM_LINK_MONITOR_DEFAULT_CONFIG() \
+    {                                           \
+        .min_interval_ms = 1000,                \
+        .max_interval_ms = 16000,               \
+        .max_timeout_ms = 3000,                 \
+        .max_failures = 3,                      \
+    }
+
+/**
+ * @brief Link monitor statistics
+ *
+ */
+typedef struct {
+    bool up;                   /*!< false from ESP_MODEM_EVENT_LINK_LOST until the next reply */
+    uint32_t sent;             /*!< Echo-Requests sent */
+    uint32_t replies;          /*!< Echo-Replies received in time */
+    uint32_t lost;             /*!< Echo-Requests not answered in time */
+    uint32_t loss_permille;    /*!< Loss over the last ESP_MODEM_LINK_MONITOR_HISTORY echoes */
+    uint32_t rtt_ms;           /*!< Round trip time of the last reply */
+    uint32_t srtt_ms;          /*!< Smoothed round trip time */
+    uint32_t jitter_ms;        /*!< Mean deviation of the round trip time */
+    uint32_t rtt_min_ms;       /*!< Shortest round trip time */
+    uint32_t rtt_max_ms;       /*!< Longest round trip time */
+    uint32_t interval_ms;      /*!< Current echo interval */
+    uint32_t timeout_ms;       /*!< Current reply timeout */
+    uint32_t link_down;        /*!< Times the link was reported down */
+    uint32_t detect_ms;        /*!< Time from the last sign of life to the last link down report */
+} esp_modem_link_stats_t;
+
+typedef struct esp_modem_link_monitor esp_modem_link_monitor_t;
+
+/**
+ * @brief Send a complete PPP frame (flags, escaping and FCS included) on the session
+ *
+ * @param frame frame
+ * @param length length of frame
+ * @param context context passed to esp_modem_link_monitor_create()
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the network stack is in the middle of a frame, the echo is sent a bit later
+ *      - ESP_ERR_INVALID_STATE if there is no PPP session, the echo is skipped
+ *      - ESP_FAIL on error
+ */
+typedef esp_err_t (*esp_modem_link_monitor_send_t)(const uint8_t *frame, size_t length, void *context);
+
+/**
+ * @brief Create a stopped link monitor
+ *
+ * @param dte ESP Modem DTE object, events are posted to its event loop
+ * @param send function to send echo frames
+ * @param context context passed to send
+ * @return link monitor, NULL if out of memory
+ */
+esp_modem_link_monitor_t *esp_modem_link_monitor_create(modem_dte_t *dte, esp_modem_link_monitor_send_t send,
+                                                        void *context);
+
+/**
+ * @brief Stop and free a link monitor
+ */
+void esp_modem_link_monitor_delete(esp_modem_link_monitor_t *monitor);
+
+/**
+ * @brief Start monitoring a PPP session
+ *
+ * The round trip estimate and the loss history start over, the counters go on.
+ *
+ * @param monitor link monitor
+ * @param config configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if already started
+ *      - ESP_ERR_INVALID_ARG if the configuration is invalid
+ *      - ESP_FAIL if the task could not be created
+ */
+esp_err_t esp_modem_link_monitor_start(esp_modem_link_monitor_t *monitor, const esp_modem_link_monitor_config_t *config);
+
+/**
+ * @brief Stop monitoring, waits for the monitor task to end
+ */
+void esp_modem_link_monitor_stop(esp_modem_link_monitor_t *monitor);
+
+/**
+ * @brief Feed bytes received on the PPP session
+ *
+ * Echo-Replies are picked out of the HDLC stream and left in it, the network stack ignores them.
+ */
+void esp_modem_link_monitor_input(esp_modem_link_monitor_t *monitor, const uint8_t *data, size_t length);
+
+/**
+ * @brief Note that the network stack sent data on the PPP session
+ */
+void esp_modem_link_monitor_output(esp_modem_link_monitor_t *monitor);
+
+/**
+ * @brief Get the statistics of a link monitor
+ */
+void esp_modem_link_monitor_get_stats(esp_modem_link_monitor_t *monitor, esp_modem_link_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,6 +17,8 @@
 extern "C" {
 #endif
 
+#include "esp_modem_link_monitor.h"
+
 /**
  * @brief Creates handle to esp_modem used as an esp-netif driver
  *
@@ -48,6 +50,41 @@ esp_err_t esp_modem_netif_clear_default_handlers(void *h);
  */
 esp_err_t esp_modem_netif_set_default_handlers(void *h, esp_netif_t * esp_netif);
 
+/**
+ * @brief Start monitoring the PPP session with LCP echoes, see esp_modem_link_monitor.h
+ *
+ * Echoes are put between the frames of the network stack. Should be started once the session is up,
+ * and stopped before it is closed. The monitor itself is created by esp_modem_netif_setup(), so it has
+ * seen the LCP negotiation and its echoes carry the negotiated magic number.
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param config link monitor configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if already started
+ *      - ESP_ERR_INVALID_ARG if the configuration is invalid
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_netif_start_link_monitor(void *h, const esp_modem_link_monitor_config_t *config);
+
+/**
+ * @brief Stop monitoring the PPP session, the statistics are kept
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ */
+void esp_modem_netif_stop_link_monitor(void *h);
+
+/**
+ * @brief Get the link monitor statistics
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the link monitor was never started
+ */
+esp_err_t esp_modem_netif_get_link_stats(void *h, esp_modem_link_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,184 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_types.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief URC registry capacity
+ *
+ */
+#define ESP_MODEM_URC_MAX_HANDLERS (24)      /*!< Max number of registered URC handlers */
+#define ESP_MODEM_URC_MAX_PREFIX_LENGTH (15) /*!< Max length of a URC prefix, e.g. "+CEREG" */
+#define ESP_MODEM_URC_BUCKETS (16)           /*!< Number of prefix index buckets */
+
+/**
+ * @brief Unsolicited result code, as seen by a URC handler
+ *
+ * All pointers refer to the DTE line buffer, nothing is copied. They are only valid while the handler runs.
+ *
+ */
+typedef struct {
+    const char *line;   /*!< Complete line as received (NUL-terminated, includes the trailing "\r\n") */
+    const char *args;   /*!< Arguments following the prefix and the optional ": " separator */
+    size_t args_len;    /*!< Length of the arguments, without the trailing "\r\n" */
+} esp_modem_urc_t;
+
+/**
+ * @brief URC handler
+ *
+ * Handlers run in the context of the DTE task, they should return quickly and post an event if more work is needed.
+ *
+ * @param dte Modem DTE object which received the URC
+ * @param urc parsed URC
+ * @param context context registered with the handler
+ * @return esp_err_t
+ *      - ESP_OK if the URC was consumed
+ *      - ESP_FAIL otherwise
+ */
+typedef esp_err_t (*esp_modem_urc_handler_t)(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context);
+
+/**
+ * @brief URC registry entry
+ *
+ */
+typedef struct {
+    char prefix[ESP_MODEM_URC_MAX_PREFIX_LENGTH + 1]; /*!< Prefix that selects the handler */
+    uint8_t prefix_len;                               /*!< Length of prefix */
+    int8_t next;                                      /*!< Next entry in the same bucket, -1 terminates */
+    esp_modem_urc_handler_t handler;                  /*!< Handler, NULL for a free entry */
+    void *context;                                    /*!< Handler context */
+} esp_modem_urc_entry_t;
+
+/**
+ * @brief URC registry, prefixes are indexed by their first character
+ *
+ */
+typedef struct {
+    esp_modem_urc_entry_t entries[ESP_MODEM_URC_MAX_HANDLERS]; /*!< Entry pool */
+    int8_t buckets[ESP_MODEM_URC_BUCKETS];                     /*!< Head entry of each bucket, -1 if empty */
+    portMUX_TYPE lock;                                         /*!< Protects entries, buckets and the dispatch state */
+    TaskHandle_t dispatcher;                                   /*!< Task running a dispatch, NULL if none */
+    uint32_t dispatch_seq;                                     /*!< Incremented by each dispatch */
+} esp_modem_urc_registry_t;
+
+/**
+ * @brief Initialize an empty URC registry
+ *
+ * @param registry URC registry
+ */
+void esp_modem_urc_registry_init(esp_modem_urc_registry_t *registry);
+
+/**
+ * @brief Register a handler for lines starting with prefix
+ *
+ * The registry may be changed from any task while lines are dispatched.
+ * The prefix only matches whole tokens: "+CREG" matches "+CREG: 1" but not "+CREGX: 1".
+ * Several handlers may share a prefix, they are all called.
+ *
+ * @param registry URC registry
+ * @param prefix URC prefix, e.g. "+CEREG" or "NO CARRIER"
+ * @param handler handler to call
+ * @param context context passed to handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid prefix or handler
+ *      - ESP_ERR_NO_MEM if the registry is full
+ */
+esp_err_t esp_modem_urc_registry_add(esp_modem_urc_registry_t *registry, const char *prefix,
+                                     esp_modem_urc_handler_t handler, void *context);
+
+/**
+ * @brief Unregister a handler
+ *
+ * Once this returns the handler is not called anymore: a dispatch running on another task is waited for.
+ * A handler may unregister itself.
+ *
+ * @param registry URC registry
+ * @param prefix URC prefix used for registration
+ * @param handler registered handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if no such handler is registered
+ */
+esp_err_t esp_modem_urc_registry_remove(esp_modem_urc_registry_t *registry, const char *prefix,
+                                        esp_modem_urc_handler_t handler);
+
+/**
+ * @brief Dispatch one line to the matching URC handlers
+ *
+ * @param registry URC registry
+ * @param dte Modem DTE object which received the line
+ * @param line NUL-terminated line
+ * @return esp_err_t
+ *      - ESP_OK if at least one handler consumed the line
+ *      - ESP_ERR_NOT_FOUND if no handler consumed the line
+ */
+esp_err_t esp_modem_urc_registry_dispatch(esp_modem_urc_registry_t *registry, modem_dte_t *dte, const char *line);
+
+/**
+ * @brief Get an integer argument of a URC
+ *
+ * @param urc URC
+ * @param index zero based index of the comma separated argument
+ * @param value parsed value
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the argument does not exist
+ *      - ESP_ERR_INVALID_RESPONSE if the argument is not an integer
+ */
+esp_err_t esp_modem_urc_get_int(const esp_modem_urc_t *urc, uint32_t index, int *value);
+
+/**
+ * @brief Get a string argument of a URC without copying it
+ *
+ * Surrounding double quotes are stripped. The result is not NUL-terminated.
+ *
+ * @param urc URC
+ * @param index zero based index of the comma separated argument
+ * @param str start of the argument inside the line buffer
+ * @param len length of the argument
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the argument does not exist
+ */
+esp_err_t esp_modem_urc_get_str(const esp_modem_urc_t *urc, uint32_t index, const char **str, size_t *len);
+
+/**
+ * @brief Get the rest of a URC from an argument on, without copying it
+ *
+ * Commas and quotes after the start of the argument are kept, e.g. for a payload which is the last argument.
+ * Surrounding double quotes are stripped. The result is not NUL-terminated.
+ *
+ * @param urc URC
+ * @param index zero based index of the first comma separated argument
+ * @param str start of the argument inside the line buffer
+ * @param len length up to the end of the line
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the argument does not exist
+ */
+esp_err_t esp_modem_urc_get_tail(const esp_modem_urc_t *urc, uint32_t index, const char **str, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,8 +13,10 @@
 // limitations under the License.
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "bg96.h"
+#include "esp_modem_dce_cache.h"
 
 #define MODEM_RESULT_CODE_POWERDOWN "POWERED DOWN"
 
@@ -177,6 +179,27 @@ static esp_err_t bg96_handle_cimi(modem_dce_t *dce, const char *line)
     return err;
 }
 
+/**
+ * @brief Handle response from AT+QCCID
+ */
+static esp_err_t bg96_handle_qccid(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QCCID", strlen("+QCCID"))) {
+        /* +QCCID: <iccid> */
+        const char *iccid = line + strlen("+QCCID");
+        iccid += strspn(iccid, ": ");
+        if (esp_modem_dce_parse_iccid(dce, iccid)) {
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
 /**
  * @brief Handle response from AT+COPS?
  */
@@ -229,6 +252,30 @@ static esp_err_t bg96_handle_power_down(modem_dce_t *dce, const char *line)
     return err;
 }
 
+/**
+ * @brief Handle APP RDY URC, printed once the modem firmware has booted
+ */
+static esp_err_t bg96_handle_app_ready(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    return esp_modem_post_event(dte, ESP_MODEM_EVENT_READY, urc->line, strlen(urc->line) + 1);
+}
+
+/**
+ * @brief Handle +QIURC URC
+ */
+static esp_err_t bg96_handle_qiurc(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    const char *type = NULL;
+    size_t len = 0;
+    /* +QIURC: "pdpdeact",<contextID> */
+    if (esp_modem_urc_get_str(urc, 0, &type, &len) == ESP_OK &&
+            len == strlen("pdpdeact") && !strncmp(type, "pdpdeact", len)) {
+        esp_modem_link_lost_reason_t reason = ESP_MODEM_LINK_LOST_PDP_DEACT;
+        return esp_modem_post_event(dte, ESP_MODEM_EVENT_LINK_LOST, &reason, sizeof(reason));
+    }
+    return ESP_FAIL;
+}
+
 /**
  * @brief Get signal quality
  *
@@ -398,25 +445,98 @@ err:
 }
 
 /**
- * @brief Get Operator's name
+ * @brief Get ICCID of the SIM card
  *
  * @param bg96_dce bg96 object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t bg96_get_operator_name(bg96_modem_dce_t *bg96_dce)
+static esp_err_t bg96_get_iccid(bg96_modem_dce_t *bg96_dce)
 {
     modem_dte_t *dte = bg96_dce->parent.dte;
-    bg96_dce->parent.handle_line = bg96_handle_cops;
-    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
-    DCE_CHECK(bg96_dce->parent.state == MODEM_STATE_SUCCESS, "get network operator failed", err);
+    bg96_dce->parent.handle_line = bg96_handle_qccid;
+    DCE_CHECK(dte->send_cmd(dte, "AT+QCCID\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(bg96_dce->parent.state == MODEM_STATE_SUCCESS, "get iccid failed", err);
+    ESP_LOGD(DCE_TAG, "get iccid ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get module name, IMEI and IMSI
+ *
+ * The module name belongs to the module, it is only queried if the IMEI is new.
+ * Refreshing a known identity takes two commands.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_get_identity(modem_dce_t *dce)
+{
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    char imei[MODEM_IMEI_LENGTH + 1];
+    strcpy(imei, dce->imei);
+    /* Get IMEI number */
+    DCE_CHECK(bg96_get_imei_number(bg96_dce) == ESP_OK, "get imei failed", err);
+    /* Get Module name */
+    if (!dce->name[0] || strcmp(imei, dce->imei)) {
+        DCE_CHECK(bg96_get_module_name(bg96_dce) == ESP_OK, "get module name failed", err);
+    }
+    /* Get IMSI number */
+    DCE_CHECK(bg96_get_imsi_number(bg96_dce) == ESP_OK, "get imsi failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get Operator's name
+ *
+ * Answered right away once the modem is registered. While it is still searching the modem may hold
+ * the answer for up to MODEM_COMMAND_TIMEOUT_OPERATOR, the read gives up after
+ * MODEM_COMMAND_TIMEOUT_OPERATOR_READ instead.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_get_operator_name(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    dce->handle_line = bg96_handle_cops;
+    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR_READ) == ESP_OK,
+              "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "get network operator failed", err);
     ESP_LOGD(DCE_TAG, "get network operator ok");
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Enable or disable +CEREG and +CGREG URCs
+ *
+ * @param dce Modem DCE object
+ * @param on true to enable URCs
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_set_network_reg_report(modem_dce_t *dce, bool on)
+{
+    DCE_CHECK(esp_modem_dce_set_reg_report(dce, "CEREG", on) == ESP_OK, "set CEREG report failed", err);
+    DCE_CHECK(esp_modem_dce_set_reg_report(dce, "CGREG", on) == ESP_OK, "set CGREG report failed", err);
+    ESP_LOGD(DCE_TAG, "set network registration report ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 /**
  * @brief Deinitialize BG96 object
  *
@@ -429,6 +549,8 @@ static esp_err_t bg96_deinit(modem_dce_t *dce)
 {
     bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     if (dce->dte) {
+        esp_modem_remove_urc_handler(dce->dte, "APP RDY", bg96_handle_app_ready);
+        esp_modem_remove_urc_handler(dce->dte, "+QIURC", bg96_handle_qiurc);
         dce->dte->dce = NULL;
     }
     free(bg96_dce);
@@ -450,27 +572,39 @@ modem_dce_t *bg96_init(modem_dte_t *dte)
     bg96_dce->parent.echo_mode = esp_modem_dce_echo;
     bg96_dce->parent.store_profile = esp_modem_dce_store_profile;
     bg96_dce->parent.set_flow_ctrl = esp_modem_dce_set_flow_ctrl;
+    bg96_dce->parent.set_baud_rate = esp_modem_dce_set_baud_rate;
     bg96_dce->parent.define_pdp_context = esp_modem_dce_define_pdp_context;
     bg96_dce->parent.hang_up = esp_modem_dce_hang_up;
     bg96_dce->parent.get_signal_quality = bg96_get_signal_quality;
     bg96_dce->parent.get_battery_status = bg96_get_battery_status;
     bg96_dce->parent.set_working_mode = bg96_set_working_mode;
+    bg96_dce->parent.resume_data_mode = esp_modem_dce_resume_data_mode;
+    bg96_dce->parent.get_operator_name = bg96_get_operator_name;
+    bg96_dce->parent.get_identity = bg96_get_identity;
+    bg96_dce->parent.set_psm = esp_modem_dce_set_psm;
+    bg96_dce->parent.set_edrx = esp_modem_dce_set_edrx;
+    bg96_dce->parent.set_network_reg_report = bg96_set_network_reg_report;
+    bg96_dce->parent.reset = esp_modem_dce_reset;
     bg96_dce->parent.power_down = bg96_power_down;
     bg96_dce->parent.deinit = bg96_deinit;
+    /* Register vendor specific URCs */
+    DCE_CHECK(esp_modem_add_urc_handler(dte, "APP RDY", bg96_handle_app_ready, NULL) == ESP_OK &&
+              esp_modem_add_urc_handler(dte, "+QIURC", bg96_handle_qiurc, NULL) == ESP_OK,
+              "register urc handlers failed", err_io);
     /* Sync between DTE and DCE */
     DCE_CHECK(esp_modem_dce_sync(&(bg96_dce->parent)) == ESP_OK, "sync failed", err_io);
     /* Close echo */
     DCE_CHECK(esp_modem_dce_echo(&(bg96_dce->parent), false) == ESP_OK, "close echo mode failed", err_io);
-    /* Get Module name */
-    DCE_CHECK(bg96_get_module_name(bg96_dce) == ESP_OK, "get module name failed", err_io);
-    /* Get IMEI number */
-    DCE_CHECK(bg96_get_imei_number(bg96_dce) == ESP_OK, "get imei failed", err_io);
-    /* Get IMSI number */
-    DCE_CHECK(bg96_get_imsi_number(bg96_dce) == ESP_OK, "get imsi failed", err_io);
-    /* Get operator name */
-    DCE_CHECK(bg96_get_operator_name(bg96_dce) == ESP_OK, "get operator name failed", err_io);
+    /* The ICCID identifies the SIM, the rest of the identity is cached for it */
+    DCE_CHECK(bg96_get_iccid(bg96_dce) == ESP_OK, "get iccid failed", err_io);
+    if (esp_modem_dce_cache_load(&(bg96_dce->parent)) != ESP_OK) {
+        DCE_CHECK(bg96_get_identity(&(bg96_dce->parent)) == ESP_OK, "get identity failed", err_io);
+        esp_modem_dce_cache_store(&(bg96_dce->parent));
+    }
     return &(bg96_dce->parent);
 err_io:
+    esp_modem_remove_urc_handler(dte, "APP RDY", bg96_handle_app_ready);
+    esp_modem_remove_urc_handler(dte, "+QIURC", bg96_handle_qiurc);
     free(bg96_dce);
 err:
     return NULL;
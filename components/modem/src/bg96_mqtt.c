@@ -0,0 +1,468 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "bg96_mqtt.h"
+
+#define BG96_MQTT_CLIENT_INDEX (0)
+#define BG96_MQTT_SSL_CONTEXT (0)
+#define BG96_MQTT_PROMPT "\r\n> "
+#define BG96_MQTT_UPLOAD_PROMPT "\r\nCONNECT\r\n"
+#define BG96_MQTT_TIMEOUT_PROMPT (1000)       /*!< Timeout value for the prompt of AT+QMTPUBEX and AT+QFUPL */
+#define BG96_MQTT_TIMEOUT_UPLOAD (10000)      /*!< Timeout value for uploading a file */
+#define BG96_MQTT_TIMEOUT_PDP_DEACTIVATE (40000)
+#define BG96_MQTT_TIMEOUT_DISCONNECT (30000)
+#define BG96_MQTT_TIMEOUT_MARGIN (5000)       /*!< Added to the retransmission time of the modem */
+
+#define BG96_MQTT_OPEN_BIT BIT0
+#define BG96_MQTT_CONN_BIT BIT1
+#define BG96_MQTT_PUB_BIT BIT2
+#define BG96_MQTT_SUB_BIT BIT3
+#define BG96_MQTT_DISC_BIT BIT4
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *DCE_TAG = "bg96_mqtt";
+#define DCE_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                \
+    {                                                                                 \
+        if (!(a))                                                                     \
+        {                                                                             \
+            ESP_LOGE(DCE_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                            \
+        }                                                                             \
+    } while (0)
+
+/**
+ * @brief State of the modem MQTT client
+ *
+ * Commands are serialized by the AT engine, so one result slot is enough. It is written by the URC
+ * handlers in the DTE task before the matching event bit is set.
+ *
+ */
+typedef struct {
+    EventGroupHandle_t events;         /*!< Completion of asynchronous operations */
+    bool connected;                    /*!< Broker connection is up */
+    uint32_t ack_timeout;              /*!< Time the modem may take to report an acknowledgement */
+    uint16_t msg_id;                   /*!< Last used message identifier */
+    volatile uint16_t wait_msg_id;     /*!< Message identifier of the operation in progress */
+    volatile int result;               /*!< Result of the last completed operation, 0 on success */
+    bg96_mqtt_receive_cb_t receive_cb; /*!< Callback for received messages */
+    void *receive_ctx;                 /*!< Context of receive_cb */
+} bg96_mqtt_client_t;
+
+static bg96_mqtt_client_t s_client;
+
+/**
+ * @brief Handle +QMTOPEN, +QMTCONN and +QMTDISC
+ */
+static esp_err_t bg96_mqtt_handle_result(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    int index = 0, result = 0, code = 0;
+    /* <client_idx>,<result>[,<ret_code>] */
+    if (esp_modem_urc_get_int(urc, 0, &index) != ESP_OK || index != BG96_MQTT_CLIENT_INDEX ||
+            esp_modem_urc_get_int(urc, 1, &result) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    /* The return code of CONNACK, only present for +QMTCONN */
+    if (esp_modem_urc_get_int(urc, 2, &code) == ESP_OK && result == 0) {
+        result = code;
+    }
+    s_client.result = result;
+    xEventGroupSetBits(s_client.events, (EventBits_t)(uintptr_t)context);
+    return ESP_OK;
+}
+
+/**
+ * @brief Handle +QMTPUB and +QMTSUB
+ */
+static esp_err_t bg96_mqtt_handle_ack(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    int index = 0, msg_id = 0, result = 0;
+    /* <client_idx>,<msgID>,<result>[,<value>] */
+    if (esp_modem_urc_get_int(urc, 0, &index) != ESP_OK || index != BG96_MQTT_CLIENT_INDEX ||
+            esp_modem_urc_get_int(urc, 1, &msg_id) != ESP_OK ||
+            esp_modem_urc_get_int(urc, 2, &result) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (result == 1) {
+        /* The modem retransmits, the final result follows */
+        ESP_LOGD(DCE_TAG, "message %d is retransmitted", msg_id);
+    } else if (msg_id == s_client.wait_msg_id) {
+        s_client.result = result;
+        xEventGroupSetBits(s_client.events, (EventBits_t)(uintptr_t)context);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Handle +QMTSTAT, the connection was closed by the modem
+ */
+static esp_err_t bg96_mqtt_handle_qmtstat(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    int index = 0, error = 0;
+    /* <client_idx>,<err_code> */
+    if (esp_modem_urc_get_int(urc, 0, &index) != ESP_OK || index != BG96_MQTT_CLIENT_INDEX ||
+            esp_modem_urc_get_int(urc, 1, &error) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    ESP_LOGW(DCE_TAG, "connection closed, error: %d", error);
+    s_client.connected = false;
+    /* Nothing will be acknowledged anymore */
+    s_client.result = -1;
+    xEventGroupSetBits(s_client.events, BG96_MQTT_PUB_BIT | BG96_MQTT_SUB_BIT);
+    return ESP_OK;
+}
+
+/**
+ * @brief Handle +QMTRECV
+ *
+ * The payload is printed as is, without escaping, so it runs from the first argument behind the topic to the
+ * end of the line whatever commas or quotes it contains.
+ */
+static esp_err_t bg96_mqtt_handle_qmtrecv(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    int index = 0, length = -1;
+    const char *topic = NULL, *payload = NULL;
+    size_t topic_len = 0, payload_len = 0;
+    /* <client_idx>,<msgID>,"<topic>"[,<payload_len>],"<payload>" */
+    if (esp_modem_urc_get_int(urc, 0, &index) != ESP_OK || index != BG96_MQTT_CLIENT_INDEX ||
+            esp_modem_urc_get_str(urc, 2, &topic, &topic_len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    /* the length is only reported with AT+QMTCFG="recv/mode" and is never quoted, a payload always is */
+    uint32_t payload_index = 3;
+    if (esp_modem_urc_get_int(urc, 3, &length) == ESP_OK && length >= 0) {
+        payload_index = 4;
+    }
+    if (esp_modem_urc_get_tail(urc, payload_index, &payload, &payload_len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (length >= 0) {
+        if (payload_len < (size_t)length) {
+            /* a line break in the payload ends the URC line */
+            ESP_LOGW(DCE_TAG, "message on %.*s cut at %d of %d bytes", (int)topic_len, topic, (int)payload_len,
+                     length);
+        } else {
+            payload_len = length;
+        }
+    }
+    if (!s_client.receive_cb) {
+        return ESP_OK;
+    }
+    char *buffer = malloc(topic_len + payload_len + 2);
+    if (!buffer) {
+        ESP_LOGE(DCE_TAG, "no memory for message on %.*s", (int)topic_len, topic);
+        return ESP_OK;
+    }
+    memcpy(buffer, topic, topic_len);
+    buffer[topic_len] = '\0';
+    memcpy(buffer + topic_len + 1, payload, payload_len);
+    buffer[topic_len + 1 + payload_len] = '\0';
+    s_client.receive_cb(buffer, buffer + topic_len + 1, payload_len, s_client.receive_ctx);
+    free(buffer);
+    return ESP_OK;
+}
+
+/**
+ * @brief URCs of the MQTT service
+ *
+ */
+static const struct {
+    const char *prefix;
+    esp_modem_urc_handler_t handler;
+    EventBits_t bit;
+} s_urcs[] = {
+    { "+QMTOPEN", bg96_mqtt_handle_result, BG96_MQTT_OPEN_BIT },
+    { "+QMTCONN", bg96_mqtt_handle_result, BG96_MQTT_CONN_BIT },
+    { "+QMTDISC", bg96_mqtt_handle_result, BG96_MQTT_DISC_BIT },
+    { "+QMTPUB", bg96_mqtt_handle_ack, BG96_MQTT_PUB_BIT },
+    { "+QMTSUB", bg96_mqtt_handle_ack, BG96_MQTT_SUB_BIT },
+    { "+QMTSTAT", bg96_mqtt_handle_qmtstat, 0 },
+    { "+QMTRECV", bg96_mqtt_handle_qmtrecv, 0 },
+};
+
+static void bg96_mqtt_remove_urcs(modem_dte_t *dte)
+{
+    for (int i = 0; i < sizeof(s_urcs) / sizeof(s_urcs[0]); i++) {
+        esp_modem_remove_urc_handler(dte, s_urcs[i].prefix, s_urcs[i].handler);
+    }
+}
+
+static esp_err_t bg96_mqtt_add_urcs(modem_dte_t *dte)
+{
+    for (int i = 0; i < sizeof(s_urcs) / sizeof(s_urcs[0]); i++) {
+        if (esp_modem_add_urc_handler(dte, s_urcs[i].prefix, s_urcs[i].handler, (void *)(uintptr_t)s_urcs[i].bit) != ESP_OK) {
+            bg96_mqtt_remove_urcs(dte);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Format and send a command which is answered with OK or ERROR
+ */
+static esp_err_t bg96_mqtt_command(modem_dce_t *dce, uint32_t timeout, const char *format, ...)
+{
+    modem_dte_t *dte = dce->dte;
+    char *command = NULL;
+    va_list args;
+    va_start(args, format);
+    int len = vasprintf(&command, format, args);
+    va_end(args);
+    DCE_CHECK(len > 0, "no memory for command", err);
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, command, timeout) == ESP_OK, "send command failed", err_send);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "command failed: %.*s", err_send, len - 1, command);
+    free(command);
+    return ESP_OK;
+err_send:
+    free(command);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Wait for the URC which completes an operation
+ */
+static esp_err_t bg96_mqtt_wait(EventBits_t bit, uint32_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(s_client.events, bit, pdTRUE, pdTRUE, pdMS_TO_TICKS(timeout));
+    if (!(bits & bit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return s_client.result == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static uint16_t bg96_mqtt_next_msg_id(void)
+{
+    /* 0 is reserved for QoS 0 */
+    if (++s_client.msg_id == 0) {
+        s_client.msg_id = 1;
+    }
+    return s_client.msg_id;
+}
+
+/**
+ * @brief Handle response from AT+QFUPL
+ */
+static esp_err_t bg96_handle_qfupl(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QFUPL", strlen("+QFUPL"))) {
+        /* +QFUPL: <upload_size>,<checksum> */
+        err = ESP_OK;
+    }
+    return err;
+}
+
+esp_err_t bg96_activate_pdp(modem_dce_t *dce, uint32_t context_id, const char *apn)
+{
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QICSGP=%d,1,\"%s\",\"\",\"\",1\r",
+                                context_id, apn) == ESP_OK, "configure context failed", err);
+    DCE_CHECK(bg96_mqtt_command(dce, BG96_MQTT_TIMEOUT_PDP_ACTIVATE, "AT+QIACT=%d\r", context_id) == ESP_OK,
+              "activate context failed", err);
+    ESP_LOGD(DCE_TAG, "activate context ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t bg96_deactivate_pdp(modem_dce_t *dce, uint32_t context_id)
+{
+    DCE_CHECK(bg96_mqtt_command(dce, BG96_MQTT_TIMEOUT_PDP_DEACTIVATE, "AT+QIDEACT=%d\r", context_id) == ESP_OK,
+              "deactivate context failed", err);
+    ESP_LOGD(DCE_TAG, "deactivate context ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t bg96_upload_file(modem_dce_t *dce, const char *name, const uint8_t *data, size_t length)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[64];
+    /* The file may not exist yet */
+    bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QFDEL=\"%s\"\r", name);
+    int len = snprintf(command, sizeof(command), "AT+QFUPL=\"%s\",%d,%d\r", name, (int)length, BG96_MQTT_TIMEOUT_UPLOAD / 1000);
+    DCE_CHECK(len < sizeof(command), "file name too long: %s", err, name);
+    DCE_CHECK(dte->send_wait(dte, command, len, BG96_MQTT_UPLOAD_PROMPT, BG96_MQTT_TIMEOUT_PROMPT) == ESP_OK,
+              "wait for upload failed", err);
+    dce->handle_line = bg96_handle_qfupl;
+    DCE_CHECK(dte->send_payload(dte, (const char *)data, length, BG96_MQTT_TIMEOUT_UPLOAD) == ESP_OK,
+              "send file failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "upload file failed", err);
+    ESP_LOGD(DCE_TAG, "upload %s ok", name);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t bg96_mqtt_connect(modem_dce_t *dce, const bg96_mqtt_config_t *config)
+{
+    esp_err_t ret = ESP_FAIL;
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(!s_client.connected, "already connected", err_state);
+    if (!s_client.events) {
+        s_client.events = xEventGroupCreate();
+        DCE_CHECK(s_client.events, "create event group failed", err);
+    }
+    DCE_CHECK(bg96_mqtt_add_urcs(dte) == ESP_OK, "register urc handlers failed", err);
+    s_client.ack_timeout = config->packet_timeout_s * 1000 * (config->retries + 1) + BG96_MQTT_TIMEOUT_MARGIN;
+    /* MQTT 3.1.1 on the given PDP context */
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCFG=\"version\",%d,4\r",
+                                BG96_MQTT_CLIENT_INDEX) == ESP_OK, "set version failed", err_cfg);
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCFG=\"pdpcid\",%d,%d\r",
+                                BG96_MQTT_CLIENT_INDEX, config->context_id) == ESP_OK, "set context failed", err_cfg);
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCFG=\"keepalive\",%d,%d\r",
+                                BG96_MQTT_CLIENT_INDEX, config->keepalive_s) == ESP_OK, "set keepalive failed", err_cfg);
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCFG=\"timeout\",%d,%d,%d,0\r",
+                                BG96_MQTT_CLIENT_INDEX, config->packet_timeout_s, config->retries) == ESP_OK,
+              "set timeout failed", err_cfg);
+    /* TLS 1.2 with server verification */
+    if (config->ca_file) {
+        DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCFG=\"ssl\",%d,1,%d\r",
+                                    BG96_MQTT_CLIENT_INDEX, BG96_MQTT_SSL_CONTEXT) == ESP_OK, "enable ssl failed", err_cfg);
+        DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QSSLCFG=\"sslversion\",%d,3\r",
+                                    BG96_MQTT_SSL_CONTEXT) == ESP_OK, "set ssl version failed", err_cfg);
+        DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QSSLCFG=\"ciphersuite\",%d,0xFFFF\r",
+                                    BG96_MQTT_SSL_CONTEXT) == ESP_OK, "set cipher suite failed", err_cfg);
+        DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QSSLCFG=\"seclevel\",%d,1\r",
+                                    BG96_MQTT_SSL_CONTEXT) == ESP_OK, "set security level failed", err_cfg);
+        DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QSSLCFG=\"cacert\",%d,\"%s\"\r",
+                                    BG96_MQTT_SSL_CONTEXT, config->ca_file) == ESP_OK, "set ca file failed", err_cfg);
+    } else {
+        DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCFG=\"ssl\",%d,0\r",
+                                    BG96_MQTT_CLIENT_INDEX) == ESP_OK, "disable ssl failed", err_cfg);
+    }
+    /* Network connection, the result is reported by +QMTOPEN */
+    xEventGroupClearBits(s_client.events, BG96_MQTT_OPEN_BIT);
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTOPEN=%d,\"%s\",%d\r",
+                                BG96_MQTT_CLIENT_INDEX, config->host, config->port) == ESP_OK, "open failed", err_cfg);
+    ret = bg96_mqtt_wait(BG96_MQTT_OPEN_BIT, BG96_MQTT_TIMEOUT_OPEN);
+    DCE_CHECK(ret == ESP_OK, "open %s:%d failed: %d", err_cfg, config->host, config->port, s_client.result);
+    /* MQTT session, the result is reported by +QMTCONN */
+    xEventGroupClearBits(s_client.events, BG96_MQTT_CONN_BIT);
+    if (config->username) {
+        ret = bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCONN=%d,\"%s\",\"%s\",\"%s\"\r",
+                                BG96_MQTT_CLIENT_INDEX, config->client_id, config->username,
+                                config->password ? config->password : "");
+    } else {
+        ret = bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCONN=%d,\"%s\"\r",
+                                BG96_MQTT_CLIENT_INDEX, config->client_id);
+    }
+    DCE_CHECK(ret == ESP_OK, "connect failed", err_open);
+    ret = bg96_mqtt_wait(BG96_MQTT_CONN_BIT, s_client.ack_timeout);
+    DCE_CHECK(ret == ESP_OK, "connect failed: %d", err_open, s_client.result);
+    s_client.connected = true;
+    ESP_LOGD(DCE_TAG, "connect ok");
+    return ESP_OK;
+err_open:
+    bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTCLOSE=%d\r", BG96_MQTT_CLIENT_INDEX);
+err_cfg:
+    bg96_mqtt_remove_urcs(dte);
+err:
+    return ret == ESP_ERR_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t bg96_mqtt_publish(modem_dce_t *dce, const char *topic, const uint8_t *payload, size_t length, int qos)
+{
+    esp_err_t ret = ESP_FAIL;
+    modem_dte_t *dte = dce->dte;
+    char *command = NULL;
+    DCE_CHECK(s_client.connected, "not connected", err_state);
+    DCE_CHECK(qos >= 0 && qos <= 2, "invalid qos: %d", err, qos);
+    s_client.wait_msg_id = qos ? bg96_mqtt_next_msg_id() : 0;
+    xEventGroupClearBits(s_client.events, BG96_MQTT_PUB_BIT);
+    int len = asprintf(&command, "AT+QMTPUBEX=%d,%d,%d,0,\"%s\",%d\r", BG96_MQTT_CLIENT_INDEX,
+                       s_client.wait_msg_id, qos, topic, (int)length);
+    DCE_CHECK(len > 0, "no memory for command", err);
+    DCE_CHECK(dte->send_wait(dte, command, len, BG96_MQTT_PROMPT, BG96_MQTT_TIMEOUT_PROMPT) == ESP_OK,
+              "wait for prompt failed", err_send);
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_payload(dte, (const char *)payload, length, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK,
+              "send payload failed", err_send);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "publish rejected", err_send);
+    ret = bg96_mqtt_wait(BG96_MQTT_PUB_BIT, s_client.ack_timeout);
+    DCE_CHECK(ret == ESP_OK, "publish %d failed: %d", err_send, s_client.wait_msg_id, s_client.result);
+    free(command);
+    return ESP_OK;
+err_send:
+    free(command);
+err:
+    return ret == ESP_ERR_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t bg96_mqtt_subscribe(modem_dce_t *dce, const char *topic, int qos, bg96_mqtt_receive_cb_t callback,
+                              void *context)
+{
+    esp_err_t ret = ESP_FAIL;
+    DCE_CHECK(s_client.connected, "not connected", err_state);
+    DCE_CHECK(qos >= 0 && qos <= 2, "invalid qos: %d", err, qos);
+    s_client.receive_cb = callback;
+    s_client.receive_ctx = context;
+    s_client.wait_msg_id = bg96_mqtt_next_msg_id();
+    xEventGroupClearBits(s_client.events, BG96_MQTT_SUB_BIT);
+    DCE_CHECK(bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTSUB=%d,%d,\"%s\",%d\r",
+                                BG96_MQTT_CLIENT_INDEX, s_client.wait_msg_id, topic, qos) == ESP_OK,
+              "subscribe failed", err);
+    ret = bg96_mqtt_wait(BG96_MQTT_SUB_BIT, s_client.ack_timeout);
+    DCE_CHECK(ret == ESP_OK, "subscribe %s failed: %d", err, topic, s_client.result);
+    ESP_LOGD(DCE_TAG, "subscribe %s ok", topic);
+    return ESP_OK;
+err:
+    return ret == ESP_ERR_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+}
+
+bool bg96_mqtt_is_connected(void)
+{
+    return s_client.connected;
+}
+
+esp_err_t bg96_mqtt_disconnect(modem_dce_t *dce)
+{
+    esp_err_t ret = ESP_OK;
+    if (s_client.connected) {
+        /* Closes the network connection as well */
+        xEventGroupClearBits(s_client.events, BG96_MQTT_DISC_BIT);
+        ret = bg96_mqtt_command(dce, MODEM_COMMAND_TIMEOUT_DEFAULT, "AT+QMTDISC=%d\r", BG96_MQTT_CLIENT_INDEX);
+        if (ret == ESP_OK) {
+            ret = bg96_mqtt_wait(BG96_MQTT_DISC_BIT, BG96_MQTT_TIMEOUT_DISCONNECT);
+        }
+        s_client.connected = false;
+    }
+    bg96_mqtt_remove_urcs(dce->dte);
+    s_client.receive_cb = NULL;
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
+}
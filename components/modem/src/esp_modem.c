@@ -19,15 +19,39 @@
 #include "freertos/semphr.h"
 #include "esp_modem.h"
 #include "esp_log.h"
+#include "nvs.h"
 #include "sdkconfig.h"
 
 #define ESP_MODEM_LINE_BUFFER_SIZE (CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE / 2)
+/* Receive ring holds everything arriving at the fastest baud rate while the UART task is not scheduled, with 2x margin.
+   8N1 framing, 10 bits per byte. Rounded up to a multiple of the hardware FIFO length, as the driver requires. */
+#define ESP_MODEM_RX_RING_MIN_SIZE(baud) (2 * ((baud) / 10) * CONFIG_EXAMPLE_UART_RX_LATENCY_MS / 1000)
+#define ESP_MODEM_RX_RING_SIZE(baud) \
+    ((MAX(CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE, ESP_MODEM_RX_RING_MIN_SIZE(baud)) + UART_FIFO_LEN - 1) / UART_FIFO_LEN * UART_FIFO_LEN)
 #define ESP_MODEM_EVENT_QUEUE_SIZE (16)
+/* Counts posted events not yet dispatched, never lower than the number of events in the loop queue */
+#define ESP_MODEM_EVENT_SEM_MAX (ESP_MODEM_EVENT_QUEUE_SIZE * 2)
 
 #define MIN_PATTERN_INTERVAL (9)
 #define MIN_POST_IDLE (0)
 #define MIN_PRE_IDLE (0)
 
+#define ESP_MODEM_BAUD_PROBE_TIMEOUT_MS (100) /*!< Time to wait for "OK" after "AT" while probing the baud rate */
+#define ESP_MODEM_BAUD_PROBE_ATTEMPTS (2)     /*!< "AT" attempts per baud rate while probing */
+#define ESP_MODEM_BAUD_VERIFY_ATTEMPTS (3)    /*!< Consecutive "AT" which must succeed at a new baud rate */
+#define ESP_MODEM_READY_BACKOFF_MIN_MS (50)   /*!< First interval between "AT" while waiting for the modem to boot */
+#define ESP_MODEM_READY_BACKOFF_MAX_MS (1000) /*!< Upper limit of the interval, doubled after each attempt */
+#define ESP_MODEM_PROMPT_MAX_LENGTH (16)      /*!< Max length of a prompt send_wait can wait for */
+#define PPP_FLAG_SEQUENCE (0x7e)              /*!< Delimits PPP frames */
+#define ESP_MODEM_NVS_NAMESPACE "esp_modem"
+#define ESP_MODEM_NVS_KEY_BAUD_RATE "baud"
+
+/**
+ * @brief Baud rates tried by negotiation and probing, fastest first
+ *
+ */
+static const uint32_t esp_modem_baud_rates[] = {3000000, 921600, 460800, 230400, 115200};
+
 /**
  * @brief Macro defined for error checking
  *
@@ -56,9 +80,29 @@ typedef struct {
     esp_event_loop_handle_t event_loop_hdl; /*!< Event loop handle */
     TaskHandle_t uart_event_task_hdl;       /*!< UART event task handle */
     SemaphoreHandle_t process_sem;          /*!< Semaphore used for indicating processing status */
+    SemaphoreHandle_t event_sem;            /*!< Given for each event posted to the event loop */
+    SemaphoreHandle_t ready_sem;            /*!< Given when the modem reports that it has booted */
+    QueueSetHandle_t queue_set;             /*!< UART event queue and event_sem, the UART event task blocks on it */
     modem_dte_t parent;                     /*!< DTE interface that should extend */
     esp_modem_on_receive         receive_cb;      /*!< ptr to data reception */
     void                            *receive_cb_ctx; /*!< ptr to rx fn context data */
+    esp_modem_urc_registry_t urc_registry;  /*!< Handlers for unsolicited result codes */
+    uint8_t carrier_match;                  /*!< Matched length of "NO CARRIER" in PPP mode */
+    bool carrier_after_flag;                /*!< The last PPP byte was a frame delimiter */
+    uint32_t baud_rate;                     /*!< Current UART baud rate */
+    bool probing;                           /*!< Lines are consumed by the baud rate probe */
+    size_t line_len;                        /*!< Length of the partial line kept in buffer, UART event task only */
+    bool line_reset;                        /*!< Drop the partial line before the next read, set by other tasks */
+    esp_err_t (*handle_line)(modem_dce_t *dce, const char *line); /*!< Handler of the command in progress */
+    esp_modem_dte_stats_t stats;            /*!< Receive path statistics */
+    esp_modem_cmd_stats_table_t cmd_stats;  /*!< Latency of the commands sent */
+    portMUX_TYPE cmd_stats_lock;            /*!< Protects cmd_stats */
+    char prompt[ESP_MODEM_PROMPT_MAX_LENGTH];             /*!< Prompt send_wait is waiting for */
+    uint8_t prompt_next[ESP_MODEM_PROMPT_MAX_LENGTH];     /*!< KMP failure function of prompt */
+    uint8_t prompt_len;                     /*!< Length of prompt, 0 if send_wait is not waiting */
+    uint8_t prompt_match;                   /*!< Length of the prompt prefix matched so far */
+    bool prompt_error;                      /*!< The command was answered with an error instead of the prompt */
+    portMUX_TYPE prompt_lock;               /*!< Protects the prompt matcher */
 } esp_modem_dte_t;
 
 
@@ -71,33 +115,261 @@ esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb,
 }
 
 
+/**
+ * @brief Post an event to the DTE event loop and wake the UART event task to dispatch it
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param event_id event id
+ * @param event_data event data, copied into the event loop
+ * @param event_data_size size of event data
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the event queue is full
+ */
+static esp_err_t esp_dte_post_event(esp_modem_dte_t *esp_dte, int32_t event_id, const void *event_data, size_t event_data_size)
+{
+    esp_err_t err = esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, event_id, (void *)event_data,
+                                      event_data_size, 0);
+    if (err == ESP_ERR_TIMEOUT && xTaskGetCurrentTaskHandle() == esp_dte->uart_event_task_hdl) {
+        /* The UART event task is the only consumer and would wait for itself, dispatch the oldest event to make room */
+        esp_event_loop_run(esp_dte->event_loop_hdl, 0);
+        err = esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, event_id, (void *)event_data,
+                                event_data_size, 0);
+    }
+    if (err == ESP_OK) {
+        xSemaphoreGive(esp_dte->event_sem);
+    }
+    return err;
+}
+
 /**
  * @brief Handle one line in DTE
  *
+ * The line is offered to the handler of the command in progress first, then to the URC registry.
+ *
  * @param esp_dte ESP modem DTE object
+ * @param line NUL-terminated line inside the line buffer
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
+static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte, const char *line)
 {
     modem_dce_t *dce = esp_dte->parent.dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    const char *line = (const char *)(esp_dte->buffer);
     /* Skip pure "\r\n" lines */
-    if (strlen(line) > 2) {
-        MODEM_CHECK(dce->handle_line, "no handler for line", err_handle);
-        MODEM_CHECK(dce->handle_line(dce, line) == ESP_OK, "handle line failed", err_handle);
+    if (strlen(line) <= 2) {
+        return ESP_OK;
+    }
+    /* A command answered with an error instead of a prompt ends send_wait early, the line is handled as usual */
+    if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        portENTER_CRITICAL(&esp_dte->prompt_lock);
+        bool waiting = esp_dte->prompt_len != 0;
+        esp_dte->prompt_len = 0;
+        esp_dte->prompt_error = waiting;
+        portEXIT_CRITICAL(&esp_dte->prompt_lock);
+        if (waiting) {
+            xSemaphoreGive(esp_dte->process_sem);
+        }
+    }
+    /* While probing the baud rate, the only interesting answer is "OK" */
+    if (__atomic_load_n(&esp_dte->probing, __ATOMIC_ACQUIRE)) {
+        if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+            xSemaphoreGive(esp_dte->process_sem);
+        }
+        return ESP_OK;
+    }
+    /* published by send_payload, dce->handle_line belongs to the command task */
+    esp_err_t (*handle_line)(modem_dce_t *, const char *) = __atomic_load_n(&esp_dte->handle_line, __ATOMIC_ACQUIRE);
+    if (dce && handle_line && handle_line(dce, line) == ESP_OK) {
+        return ESP_OK;
+    }
+    if (esp_modem_urc_registry_dispatch(&esp_dte->urc_registry, &esp_dte->parent, line) == ESP_OK) {
+        return ESP_OK;
     }
-    return ESP_OK;
-err_handle:
     /* Send ESP_MODEM_EVENT_UNKNOWN signal to event loop */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
-                      (void *)line, strlen(line) + 1, pdMS_TO_TICKS(100));
+    esp_dte_post_event(esp_dte, ESP_MODEM_EVENT_UNKNOWN, line, strlen(line) + 1);
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Handle network registration URCs (+CREG, +CGREG, +CEREG)
+ */
+static esp_err_t esp_modem_handle_network_reg(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    esp_modem_network_reg_t reg = {
+        .domain = (esp_modem_network_domain_t)context
+    };
+    int stat = 0;
+    int value = 0;
+    MODEM_CHECK(esp_modem_urc_get_int(urc, 0, &stat) == ESP_OK, "invalid registration status: %s", err, urc->line);
+    /* "+CEREG: <stat>[,...]" is the URC, "+CEREG: <n>,<stat>[,...]" is a late answer to a query */
+    if (esp_modem_urc_get_int(urc, 1, &value) == ESP_OK) {
+        stat = value;
+    }
+    reg.stat = (esp_modem_network_reg_stat_t)stat;
+    return esp_modem_post_event(dte, ESP_MODEM_EVENT_NETWORK_REG, &reg, sizeof(reg));
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Handle NO CARRIER outside of a command
+ */
+static esp_err_t esp_modem_handle_no_carrier(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    esp_modem_link_lost_reason_t reason = ESP_MODEM_LINK_LOST_NO_CARRIER;
+    return esp_modem_post_event(dte, ESP_MODEM_EVENT_LINK_LOST, &reason, sizeof(reason));
+}
+
+/**
+ * @brief Handle RDY, which the modem prints once it has booted
+ */
+static esp_err_t esp_modem_handle_ready(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    xSemaphoreGive(esp_dte->ready_sem);
+    return esp_modem_post_event(dte, ESP_MODEM_EVENT_READY, urc->line, strlen(urc->line) + 1);
+}
+
+/**
+ * @brief Watch PPP data for NO CARRIER, which the modem prints when it drops the data call
+ *
+ * The modem prints it between frames, so only a match right behind a frame delimiter counts.
+ * Payload bytes inside a frame never match, whatever the peer sends.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data received data
+ * @param length length of received data
+ */
+static void esp_dte_scan_carrier_lost(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+    static const char no_carrier[] = "\r\n" MODEM_RESULT_CODE_NO_CARRIER "\r\n";
+    for (size_t i = 0; i < length; i++) {
+        if ((esp_dte->carrier_match || esp_dte->carrier_after_flag) &&
+                data[i] == no_carrier[esp_dte->carrier_match]) {
+            if (++esp_dte->carrier_match == sizeof(no_carrier) - 1) {
+                esp_dte->carrier_match = 0;
+                esp_modem_handle_no_carrier(&esp_dte->parent, NULL, NULL);
+            }
+        } else {
+            esp_dte->carrier_match = 0;
+        }
+        esp_dte->carrier_after_flag = data[i] == PPP_FLAG_SEQUENCE;
+    }
+}
+
+/**
+ * @brief Search received bytes for the prompt send_wait is waiting for
+ *
+ * KMP over the byte stream: a match may span reads and bytes already seen are never looked at again.
+ * Wakes send_wait on a match.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data received bytes
+ * @param length length of data
+ * @return size_t offset behind the end of the prompt in data, 0 if there was no match
+ */
+static size_t esp_dte_scan_prompt(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+    size_t end = 0;
+    portENTER_CRITICAL(&esp_dte->prompt_lock);
+    if (esp_dte->prompt_len) {
+        const uint8_t *prompt = (const uint8_t *)esp_dte->prompt;
+        uint8_t match = esp_dte->prompt_match;
+        for (size_t i = 0; i < length; i++) {
+            while (match && prompt[match] != data[i]) {
+                match = esp_dte->prompt_next[match - 1];
+            }
+            if (prompt[match] == data[i] && ++match == esp_dte->prompt_len) {
+                end = i + 1;
+                break;
+            }
+        }
+        esp_dte->prompt_match = match;
+        if (end) {
+            esp_dte->prompt_len = 0;
+        }
+    }
+    portEXIT_CRITICAL(&esp_dte->prompt_lock);
+    if (end) {
+        xSemaphoreGive(esp_dte->process_sem);
+    }
+    return end;
+}
+
+/**
+ * @brief Hand complete lines in the line buffer to esp_dte_handle_line
+ *
+ * A trailing partial line is kept at the start of the buffer and completed by the next read.
+ * A line that does not fit into the buffer is handed over truncated.
+ * A prompt send_wait is waiting for is not a line, it is dropped together with what precedes it on its line.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes just appended to the line buffer
+ */
+static void esp_dte_split_lines(esp_modem_dte_t *esp_dte, size_t length)
+{
+    uint8_t *buffer = esp_dte->buffer;
+    size_t end = esp_dte->line_len + length;
+    size_t start = 0;
+    size_t prompt_end = esp_dte_scan_prompt(esp_dte, buffer + esp_dte->line_len, length);
+    if (prompt_end) {
+        prompt_end += esp_dte->line_len;
+    }
+    for (size_t i = esp_dte->line_len; i < end; i++) {
+        if (i + 1 == prompt_end) {
+            start = prompt_end;
+            continue;
+        }
+        if (buffer[i] != '\n') {
+            continue;
+        }
+        /* make sure the line is a standard string, the buffer always has room for the terminator */
+        uint8_t next = buffer[i + 1];
+        buffer[i + 1] = '\0';
+        esp_dte_handle_line(esp_dte, (const char *)buffer + start);
+        buffer[i + 1] = next;
+        start = i + 1;
+    }
+    if (start) {
+        memmove(buffer, buffer + start, end - start);
+    }
+    esp_dte->line_len = end - start;
+    if (esp_dte->line_len == ESP_MODEM_LINE_BUFFER_SIZE - 1) {
+        ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
+        buffer[esp_dte->line_len] = '\0';
+        esp_dte_handle_line(esp_dte, (const char *)buffer);
+        esp_dte->line_len = 0;
+    }
+}
+
+/**
+ * @brief Read bytes from UART and hand complete lines over
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes to read
+ * @return size_t number of bytes read
+ */
+static size_t esp_dte_read_lines(esp_modem_dte_t *esp_dte, size_t length)
+{
+    size_t total = 0;
+    while (total < length) {
+        if (__atomic_exchange_n(&esp_dte->line_reset, false, __ATOMIC_ACQUIRE)) {
+            esp_dte->line_len = 0;
+        }
+        size_t room = ESP_MODEM_LINE_BUFFER_SIZE - 1 - esp_dte->line_len;
+        int read_len = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer + esp_dte->line_len,
+                                       MIN(room, length - total), pdMS_TO_TICKS(100));
+        if (read_len <= 0) {
+            ESP_LOGE(MODEM_TAG, "uart read bytes failed");
+            break;
+        }
+        esp_dte_split_lines(esp_dte, read_len);
+        total += read_len;
+    }
+    return total;
+}
+
 /**
  * @brief Handle when a pattern has been detected by UART
  *
@@ -106,27 +378,25 @@ err:
 static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte)
 {
     int pos = uart_pattern_pop_pos(esp_dte->uart_port);
-    int read_len = 0;
     if (pos != -1) {
-        if (pos < ESP_MODEM_LINE_BUFFER_SIZE - 1) {
-            /* read one line(include '\n') */
-            read_len = pos + 1;
-        } else {
-            ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
-            read_len = ESP_MODEM_LINE_BUFFER_SIZE - 1;
+        /* read up to and including the '\n', the read also completes a partial line kept from before */
+        do {
+            esp_dte_read_lines(esp_dte, pos + 1);
+        } while ((pos = uart_pattern_pop_pos(esp_dte->uart_port)) != -1);
+    } else {
+        /* Either the lines of this event were read with an earlier one, or the pattern queue overflowed.
+           Split whatever is buffered in software instead of dropping it, unless the DTE switched to data
+           mode in the meantime: then the buffer holds PPP data, which the UART_DATA event delivers */
+        modem_dce_t *dce = esp_dte->parent.dce;
+        if (dce && dce->mode == MODEM_PPP_MODE) {
+            return;
         }
-        read_len = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, read_len, pdMS_TO_TICKS(100));
-        if (read_len) {
-            /* make sure the line is a standard string */
-            esp_dte->buffer[read_len] = '\0';
-            /* Send new line to handle */
-            esp_dte_handle_line(esp_dte);
-        } else {
-            ESP_LOGE(MODEM_TAG, "uart read bytes failed");
+        size_t length = 0;
+        uart_get_buffered_data_len(esp_dte->uart_port, &length);
+        if (length) {
+            esp_dte->stats.pattern_overflows++;
+            esp_dte_read_lines(esp_dte, length);
         }
-    } else {
-        ESP_LOGW(MODEM_TAG, "Pattern Queue Size too small");
-        uart_flush(esp_dte->uart_port);
     }
 }
 
@@ -134,16 +404,57 @@ static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte)
  * @brief Handle when new data received by UART
  *
  * @param esp_dte ESP32 Modem DTE object
+ * @return size_t number of bytes read
  */
-static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
+static size_t esp_handle_uart_data(esp_modem_dte_t *esp_dte)
 {
+    modem_dce_t *dce = esp_dte->parent.dce;
     size_t length = 0;
     uart_get_buffered_data_len(esp_dte->uart_port, &length);
+    if (!dce || dce->mode != MODEM_PPP_MODE) {
+        /* Data events in command mode are enabled by send_wait, for a prompt without a line end */
+        return esp_dte_read_lines(esp_dte, length);
+    }
     length = MIN(ESP_MODEM_LINE_BUFFER_SIZE, length);
+    if (!length) {
+        return 0;
+    }
     length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
     /* pass the input data to configured callback */
     if (length) {
-        esp_dte->receive_cb(esp_dte->buffer, length, esp_dte->receive_cb_ctx);
+        esp_dte_scan_carrier_lost(esp_dte, esp_dte->buffer, length);
+        if (esp_dte->receive_cb) {
+            esp_dte->receive_cb(esp_dte->buffer, length, esp_dte->receive_cb_ctx);
+        } else {
+            esp_dte->stats.bytes_lost += length;
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Empty the UART ring buffer after an overflow
+ *
+ * Everything buffered is still valid, so it is handed over like regular input instead of being flushed.
+ * Bytes the driver could not store wait in the driver and follow once there is room again.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_handle_uart_overflow(esp_modem_dte_t *esp_dte)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    size_t length = 0;
+    if (dce && dce->mode == MODEM_PPP_MODE) {
+        while (esp_handle_uart_data(esp_dte)) {
+        }
+    } else {
+        /* Lines with a recorded pattern position first, then the rest */
+        int pos;
+        while ((pos = uart_pattern_pop_pos(esp_dte->uart_port)) != -1) {
+            esp_dte_read_lines(esp_dte, pos + 1);
+        }
+        uart_get_buffered_data_len(esp_dte->uart_port, &length);
+        esp_dte_read_lines(esp_dte, length);
     }
 }
 
@@ -157,20 +468,27 @@ static void uart_event_task_entry(void *param)
     esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
     uart_event_t event;
     while (1) {
-        if (xQueueReceive(esp_dte->event_queue, &event, pdMS_TO_TICKS(100))) {
+        QueueSetMemberHandle_t active = xQueueSelectFromSet(esp_dte->queue_set, portMAX_DELAY);
+        if (active == esp_dte->event_sem) {
+            /* Dispatch one posted event, the loop might be empty if the event was dispatched by esp_dte_post_event */
+            xSemaphoreTake(esp_dte->event_sem, 0);
+            esp_event_loop_run(esp_dte->event_loop_hdl, 0);
+        } else if (xQueueReceive(esp_dte->event_queue, &event, 0)) {
             switch (event.type) {
             case UART_DATA:
                 esp_handle_uart_data(esp_dte);
                 break;
             case UART_FIFO_OVF:
+                /* The driver had to reset the hardware FIFO, its content is gone */
                 ESP_LOGW(MODEM_TAG, "HW FIFO Overflow");
-                uart_flush_input(esp_dte->uart_port);
-                xQueueReset(esp_dte->event_queue);
+                esp_dte->stats.fifo_overflows++;
+                esp_dte->stats.bytes_lost += UART_FIFO_LEN;
+                esp_handle_uart_overflow(esp_dte);
                 break;
             case UART_BUFFER_FULL:
                 ESP_LOGW(MODEM_TAG, "Ring Buffer Full");
-                uart_flush_input(esp_dte->uart_port);
-                xQueueReset(esp_dte->event_queue);
+                esp_dte->stats.buffer_full++;
+                esp_handle_uart_overflow(esp_dte);
                 break;
             case UART_BREAK:
                 ESP_LOGW(MODEM_TAG, "Rx Break");
@@ -189,8 +507,6 @@ static void uart_event_task_entry(void *param)
                 break;
             }
         }
-        /* Drive the event loop */
-        esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(50));
     }
     vTaskDelete(NULL);
 }
@@ -198,6 +514,9 @@ static void uart_event_task_entry(void *param)
 /**
  * @brief Send command to DCE
  *
+ * With CONFIG_EXAMPLE_MODEM_ADAPTIVE_TIMEOUT the timeout is only the nominal one, the one applied follows the
+ * latency seen for the command so far, see esp_modem_cmd_stats.h.
+ *
  * @param dte Modem DTE object
  * @param command command string
  * @param timeout timeout value, unit: ms
@@ -206,19 +525,60 @@ static void uart_event_task_entry(void *param)
  *      - ESP_FAIL on error
  */
 static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+{
+    MODEM_CHECK(command, "command is NULL", err);
+    return dte->send_payload(dte, command, strlen(command), timeout);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Send binary payload to DCE and wait for the response
+ *
+ * Works like send_cmd, but the payload may contain any byte. Used for data announced by a preceding
+ * command, e.g. after the prompt of AT+QMTPUBEX.
+ *
+ * @param dte Modem DTE object
+ * @param data payload
+ * @param length length of payload
+ * @param timeout timeout value in millisecond
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_send_payload(modem_dte_t *dte, const char *data, uint32_t length, uint32_t timeout)
 {
     esp_err_t ret = ESP_FAIL;
     modem_dce_t *dce = dte->dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    MODEM_CHECK(command, "command is NULL", err);
+    MODEM_CHECK(data, "data is NULL", err);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Calculate timeout clock tick */
+    char name[ESP_MODEM_CMD_STATS_MAX_NAME_LENGTH + 1];
+    esp_modem_cmd_stats_name(data, length, name);
+    uint32_t nominal = timeout;
+#if CONFIG_EXAMPLE_MODEM_ADAPTIVE_TIMEOUT
+    /* Learned from the latency of earlier commands, so a busy modem does not fail and a hung one fails early */
+    portENTER_CRITICAL(&esp_dte->cmd_stats_lock);
+    timeout = esp_modem_cmd_stats_timeout(&esp_dte->cmd_stats, name, nominal);
+    portEXIT_CRITICAL(&esp_dte->cmd_stats_lock);
+#endif
     /* Reset runtime information */
     dce->state = MODEM_STATE_PROCESSING;
+    __atomic_store_n(&esp_dte->handle_line, dce->handle_line, __ATOMIC_RELEASE);
     /* Send command via UART */
-    uart_write_bytes(esp_dte->uart_port, command, strlen(command));
+    TickType_t start = xTaskGetTickCount();
+    uart_write_bytes(esp_dte->uart_port, data, length);
     /* Check timeout */
-    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
+    bool answered = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    uint32_t elapsed = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    __atomic_store_n(&esp_dte->handle_line, NULL, __ATOMIC_RELEASE);
+    portENTER_CRITICAL(&esp_dte->cmd_stats_lock);
+    esp_modem_cmd_stats_record(&esp_dte->cmd_stats, name, nominal, timeout, elapsed, !answered);
+    portEXIT_CRITICAL(&esp_dte->cmd_stats_lock);
+    MODEM_CHECK(answered, "process command timeout: %s after %d ms", err, name, timeout);
+    if (elapsed > nominal) {
+        ESP_LOGW(MODEM_TAG, "%s answered after %d ms, nominal timeout %d ms", name, elapsed, nominal);
+    }
     ret = ESP_OK;
 err:
     dce->handle_line = NULL;
@@ -247,6 +607,9 @@ err:
 /**
  * @brief Send data and wait for prompt from DCE
  *
+ * The prompt is matched in the received stream by the UART event task, lines and URCs arriving before it are
+ * handled as usual. An error result code ends the wait early.
+ *
  * @param dte Modem DTE object
  * @param data data buffer
  * @param length length of data to send
@@ -254,34 +617,68 @@ err:
  * @param timeout timeout value (unit: ms)
  * @return esp_err_t
  *      ESP_OK on success
- *      ESP_FAIL on error
+ *      ESP_FAIL on error or timeout
  */
 static esp_err_t esp_modem_dte_send_wait(modem_dte_t *dte, const char *data, uint32_t length,
         const char *prompt, uint32_t timeout)
 {
-    MODEM_CHECK(data, "data is NULL", err_param);
-    MODEM_CHECK(prompt, "prompt is NULL", err_param);
+    MODEM_CHECK(data, "data is NULL", err);
+    MODEM_CHECK(prompt, "prompt is NULL", err);
+    size_t len = strlen(prompt);
+    MODEM_CHECK(len && len <= ESP_MODEM_PROMPT_MAX_LENGTH, "invalid prompt length: %d", err, (int)len);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    // We'd better disable pattern detection here for a moment in case prompt string contains the pattern character
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
-    // uart_disable_rx_intr(esp_dte->uart_port);
-    MODEM_CHECK(uart_write_bytes(esp_dte->uart_port, data, length) >= 0, "uart write bytes failed", err_write);
-    uint32_t len = strlen(prompt);
-    uint8_t *buffer = calloc(len + 1, sizeof(uint8_t));
-    int res = uart_read_bytes(esp_dte->uart_port, buffer, len, pdMS_TO_TICKS(timeout));
-    MODEM_CHECK(res >= len, "wait prompt [%s] timeout", err, prompt);
-    MODEM_CHECK(!strncmp(prompt, (const char *)buffer, len), "get wrong prompt: %s", err, buffer);
-    free(buffer);
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    /* Arm the matcher of the RX path, line handling stays active meanwhile */
+    portENTER_CRITICAL(&esp_dte->prompt_lock);
+    memcpy(esp_dte->prompt, prompt, len);
+    esp_dte->prompt_next[0] = 0;
+    for (size_t i = 1, k = 0; i < len; i++) {
+        while (k && prompt[i] != prompt[k]) {
+            k = esp_dte->prompt_next[k - 1];
+        }
+        if (prompt[i] == prompt[k]) {
+            k++;
+        }
+        esp_dte->prompt_next[i] = k;
+    }
+    esp_dte->prompt_match = 0;
+    esp_dte->prompt_error = false;
+    esp_dte->prompt_len = len;
+    portEXIT_CRITICAL(&esp_dte->prompt_lock);
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    /* A prompt does not have to end with the pattern character, its bytes come with data events */
+    uart_enable_rx_intr(esp_dte->uart_port);
+    bool sent = uart_write_bytes(esp_dte->uart_port, data, length) >= 0;
+    bool woken = sent && xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    uart_disable_rx_intr(esp_dte->uart_port);
+    portENTER_CRITICAL(&esp_dte->prompt_lock);
+    bool error = esp_dte->prompt_error;
+    bool matched = !error && esp_dte->prompt_len == 0;
+    esp_dte->prompt_len = 0;
+    portEXIT_CRITICAL(&esp_dte->prompt_lock);
+    MODEM_CHECK(sent, "uart write bytes failed", err);
+    MODEM_CHECK(!error, "error instead of prompt", err);
+    MODEM_CHECK(matched, "wait prompt timeout", err);
+    if (!woken) {
+        /* Matched just after the timeout, the semaphore was given meanwhile */
+        xSemaphoreTake(esp_dte->process_sem, 0);
+    }
     return ESP_OK;
 err:
-    free(buffer);
-err_write:
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-err_param:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Switch the UART from line parsing to raw PPP data
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_enter_data_mode(esp_modem_dte_t *esp_dte)
+{
+    uart_disable_pattern_det_intr(esp_dte->uart_port);
+    __atomic_store_n(&esp_dte->line_reset, true, __ATOMIC_RELEASE);
+    uart_enable_rx_intr(esp_dte->uart_port);
+}
+
 /**
  * @brief Change Modem's working mode
  *
@@ -300,12 +697,12 @@ static esp_err_t esp_modem_dte_change_mode(modem_dte_t *dte, modem_mode_t new_mo
     switch (new_mode) {
     case MODEM_PPP_MODE:
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
-        uart_disable_pattern_det_intr(esp_dte->uart_port);
-        uart_enable_rx_intr(esp_dte->uart_port);
+        esp_dte_enter_data_mode(esp_dte);
         break;
     case MODEM_COMMAND_MODE:
         uart_disable_rx_intr(esp_dte->uart_port);
         uart_flush(esp_dte->uart_port);
+        __atomic_store_n(&esp_dte->line_reset, true, __ATOMIC_RELEASE);
         uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
         uart_pattern_queue_reset(esp_dte->uart_port, CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE);
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
@@ -318,6 +715,64 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Change UART baud rate of DTE
+ *
+ * @param dte Modem DTE object
+ * @param baud_rate new baud rate
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_change_baud(modem_dte_t *dte, uint32_t baud_rate)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* Let pending output leave at the old rate */
+    MODEM_CHECK(uart_wait_tx_done(esp_dte->uart_port, pdMS_TO_TICKS(100)) == ESP_OK, "wait tx done failed", err);
+    MODEM_CHECK(uart_set_baudrate(esp_dte->uart_port, baud_rate) == ESP_OK, "set baud rate failed", err);
+    /* Anything received during the switch is garbage */
+    uart_flush_input(esp_dte->uart_port);
+    __atomic_store_n(&esp_dte->line_reset, true, __ATOMIC_RELEASE);
+    if (!dte->dce || dte->dce->mode == MODEM_COMMAND_MODE) {
+        uart_pattern_queue_reset(esp_dte->uart_port, CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE);
+    }
+    esp_dte->baud_rate = baud_rate;
+    ESP_LOGD(MODEM_TAG, "baud rate changed to %d", baud_rate);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Check if the DCE answers "AT" at the current baud rate
+ *
+ * Works without a DCE object, the answer is picked up by esp_dte_handle_line.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param attempts number of "AT" to send
+ * @param required number of consecutive "OK" required
+ * @return esp_err_t
+ *      - ESP_OK if the DCE answered
+ *      - ESP_FAIL otherwise
+ */
+static esp_err_t esp_modem_dte_probe(esp_modem_dte_t *esp_dte, uint32_t attempts, uint32_t required)
+{
+    uint32_t answered = 0;
+    for (uint32_t i = 0; i < attempts && answered < required; i++) {
+        /* Drop a late answer to a previous attempt */
+        xSemaphoreTake(esp_dte->process_sem, 0);
+        __atomic_store_n(&esp_dte->probing, true, __ATOMIC_RELEASE);
+        uart_write_bytes(esp_dte->uart_port, "AT\r", strlen("AT\r"));
+        if (xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(ESP_MODEM_BAUD_PROBE_TIMEOUT_MS)) == pdTRUE) {
+            answered++;
+        } else {
+            answered = 0;
+        }
+        __atomic_store_n(&esp_dte->probing, false, __ATOMIC_RELEASE);
+    }
+    return answered >= required ? ESP_OK : ESP_FAIL;
+}
+
 static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
@@ -343,6 +798,10 @@ static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
     esp_event_loop_delete(esp_dte->event_loop_hdl);
     /* Uninstall UART Driver */
     uart_driver_delete(esp_dte->uart_port);
+    /* Delete queue set, after the UART event queue is gone */
+    vQueueDelete(esp_dte->queue_set);
+    vSemaphoreDelete(esp_dte->event_sem);
+    vSemaphoreDelete(esp_dte->ready_sem);
     /* Free memory */
     free(esp_dte->buffer);
     if (dte->dce) {
@@ -365,14 +824,30 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     MODEM_CHECK(esp_dte->buffer, "calloc line memory failed", err_line_mem);
     /* Set attributes */
     esp_dte->uart_port = config->port_num;
+    esp_dte->baud_rate = config->baud_rate;
     esp_dte->parent.flow_ctrl = config->flow_control;
     /* Bind methods */
     esp_dte->parent.send_cmd = esp_modem_dte_send_cmd;
     esp_dte->parent.send_data = esp_modem_dte_send_data;
     esp_dte->parent.send_wait = esp_modem_dte_send_wait;
+    esp_dte->parent.send_payload = esp_modem_dte_send_payload;
     esp_dte->parent.change_mode = esp_modem_dte_change_mode;
+    esp_dte->parent.change_baud = esp_modem_dte_change_baud;
     esp_dte->parent.process_cmd_done = esp_modem_dte_process_cmd_done;
     esp_dte->parent.deinit = esp_modem_dte_deinit;
+    esp_dte->cmd_stats_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    esp_modem_cmd_stats_init(&esp_dte->cmd_stats);
+    esp_dte->prompt_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    /* Register handlers for common unsolicited result codes */
+    esp_modem_urc_registry_init(&esp_dte->urc_registry);
+    esp_modem_urc_registry_add(&esp_dte->urc_registry, "+CREG", esp_modem_handle_network_reg,
+                               (void *)ESP_MODEM_NETWORK_DOMAIN_CS);
+    esp_modem_urc_registry_add(&esp_dte->urc_registry, "+CGREG", esp_modem_handle_network_reg,
+                               (void *)ESP_MODEM_NETWORK_DOMAIN_GPRS);
+    esp_modem_urc_registry_add(&esp_dte->urc_registry, "+CEREG", esp_modem_handle_network_reg,
+                               (void *)ESP_MODEM_NETWORK_DOMAIN_EPS);
+    esp_modem_urc_registry_add(&esp_dte->urc_registry, MODEM_RESULT_CODE_NO_CARRIER, esp_modem_handle_no_carrier, NULL);
+    esp_modem_urc_registry_add(&esp_dte->urc_registry, "RDY", esp_modem_handle_ready, NULL);
 
     /* Config UART */
     uart_config_t uart_config = {
@@ -384,18 +859,27 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
         .flow_ctrl = (config->flow_control == MODEM_FLOW_CONTROL_HW) ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE
     };
     /* Install UART driver and get event queue used inside driver */
-    res = uart_driver_install(esp_dte->uart_port, CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE, CONFIG_EXAMPLE_UART_TX_BUFFER_SIZE,
+    /* Size the ring for the fastest rate the link may be switched to later */
+    uint32_t rx_ring_size = ESP_MODEM_RX_RING_SIZE(MAX(config->baud_rate, CONFIG_EXAMPLE_UART_MODEM_MAX_BAUD_RATE));
+    ESP_LOGD(MODEM_TAG, "rx ring size: %d", rx_ring_size);
+    res = uart_driver_install(esp_dte->uart_port, rx_ring_size, CONFIG_EXAMPLE_UART_TX_BUFFER_SIZE,
                               CONFIG_EXAMPLE_UART_EVENT_QUEUE_SIZE, &(esp_dte->event_queue), 0);
     MODEM_CHECK(res == ESP_OK, "install uart driver failed", err_uart_config);
 
     MODEM_CHECK(uart_param_config(esp_dte->uart_port, &uart_config) == ESP_OK, "config uart parameter failed", err_uart_config);
+    int rts_pin = UART_PIN_NO_CHANGE;
+    int cts_pin = UART_PIN_NO_CHANGE;
+#if CONFIG_EXAMPLE_UART_MODEM_FLOW_CONTROL_HW
     if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
-        res = uart_set_pin(esp_dte->uart_port, CONFIG_EXAMPLE_UART_MODEM_TX_PIN, CONFIG_EXAMPLE_UART_MODEM_RX_PIN,
-                           CONFIG_EXAMPLE_UART_MODEM_RTS_PIN, CONFIG_EXAMPLE_UART_MODEM_CTS_PIN);
-    } else {
-        res = uart_set_pin(esp_dte->uart_port, CONFIG_EXAMPLE_UART_MODEM_TX_PIN, CONFIG_EXAMPLE_UART_MODEM_RX_PIN,
-                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        rts_pin = CONFIG_EXAMPLE_UART_MODEM_RTS_PIN;
+        cts_pin = CONFIG_EXAMPLE_UART_MODEM_CTS_PIN;
     }
+#else
+    MODEM_CHECK(config->flow_control != MODEM_FLOW_CONTROL_HW,
+                "hardware flow control requires RTS and CTS pins", err_uart_config);
+#endif
+    res = uart_set_pin(esp_dte->uart_port, CONFIG_EXAMPLE_UART_MODEM_TX_PIN, CONFIG_EXAMPLE_UART_MODEM_RX_PIN,
+                       rts_pin, cts_pin);
     MODEM_CHECK(res == ESP_OK, "config uart gpio failed", err_uart_config);
     /* Set flow control threshold */
     if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
@@ -408,6 +892,8 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     res = uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
     /* Set pattern queue size */
     res |= uart_pattern_queue_reset(esp_dte->uart_port, CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE);
+    /* Command mode reads lines on pattern events only, see esp_modem_dte_change_mode */
+    res |= uart_disable_rx_intr(esp_dte->uart_port);
     MODEM_CHECK(res == ESP_OK, "config uart pattern failed", err_uart_pattern);
     /* Create Event loop */
     esp_event_loop_args_t loop_args = {
@@ -418,6 +904,17 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     /* Create semaphore */
     esp_dte->process_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->process_sem, "create process semaphore failed", err_sem);
+    esp_dte->ready_sem = xSemaphoreCreateBinary();
+    MODEM_CHECK(esp_dte->ready_sem, "create ready semaphore failed", err_ready_sem);
+    /* Create queue set, the UART event task waits for UART events and posted modem events at once */
+    esp_dte->event_sem = xSemaphoreCreateCounting(ESP_MODEM_EVENT_SEM_MAX, 0);
+    MODEM_CHECK(esp_dte->event_sem, "create event semaphore failed", err_event_sem);
+    esp_dte->queue_set = xQueueCreateSet(CONFIG_EXAMPLE_UART_EVENT_QUEUE_SIZE + ESP_MODEM_EVENT_SEM_MAX);
+    MODEM_CHECK(esp_dte->queue_set, "create queue set failed", err_queue_set);
+    /* Only empty queues can be added, lines behind dropped events are picked up with the next pattern */
+    xQueueReset(esp_dte->event_queue);
+    MODEM_CHECK(xQueueAddToSet(esp_dte->event_queue, esp_dte->queue_set) == pdPASS &&
+                xQueueAddToSet(esp_dte->event_sem, esp_dte->queue_set) == pdPASS, "add to queue set failed", err_queue_set_add);
     /* Create UART Event task */
     BaseType_t ret = xTaskCreate(uart_event_task_entry,             //Task Entry
                                  "uart_event",                      //Task Name
@@ -430,6 +927,15 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     return &(esp_dte->parent);
     /* Error handling */
 err_tsk_create:
+    xQueueRemoveFromSet(esp_dte->event_sem, esp_dte->queue_set);
+    xQueueRemoveFromSet(esp_dte->event_queue, esp_dte->queue_set);
+err_queue_set_add:
+    vQueueDelete(esp_dte->queue_set);
+err_queue_set:
+    vSemaphoreDelete(esp_dte->event_sem);
+err_event_sem:
+    vSemaphoreDelete(esp_dte->ready_sem);
+err_ready_sem:
     vSemaphoreDelete(esp_dte->process_sem);
 err_sem:
     esp_event_loop_delete(esp_dte->event_loop_hdl);
@@ -457,6 +963,195 @@ esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t h
     return esp_event_handler_unregister_with(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_EVENT_ANY_ID, handler);
 }
 
+esp_err_t esp_modem_add_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_handler_t handler, void *context)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_modem_urc_registry_add(&esp_dte->urc_registry, prefix, handler, context);
+}
+
+esp_err_t esp_modem_remove_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_handler_t handler)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_modem_urc_registry_remove(&esp_dte->urc_registry, prefix, handler);
+}
+
+esp_err_t esp_modem_post_event(modem_dte_t *dte, int32_t event_id, const void *event_data, size_t event_data_size)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_dte_post_event(esp_dte, event_id, event_data, event_data_size);
+}
+
+esp_err_t esp_modem_get_dte_stats(modem_dte_t *dte, esp_modem_dte_stats_t *stats)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    *stats = esp_dte->stats;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_get_cmd_stats(modem_dte_t *dte, esp_modem_cmd_stats_t *stats, uint32_t max, uint32_t *count)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    portENTER_CRITICAL(&esp_dte->cmd_stats_lock);
+    uint32_t copied = MIN(esp_dte->cmd_stats.count, max);
+    memcpy(stats, esp_dte->cmd_stats.entries, copied * sizeof(esp_modem_cmd_stats_t));
+    portEXIT_CRITICAL(&esp_dte->cmd_stats_lock);
+    *count = copied;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_reset_cmd_stats(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    portENTER_CRITICAL(&esp_dte->cmd_stats_lock);
+    esp_modem_cmd_stats_init(&esp_dte->cmd_stats);
+    portEXIT_CRITICAL(&esp_dte->cmd_stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_load_baud_rate(uint32_t *baud_rate)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint32_t value = 0;
+    err = nvs_get_u32(handle, ESP_MODEM_NVS_KEY_BAUD_RATE, &value);
+    nvs_close(handle);
+    if (err == ESP_OK) {
+        *baud_rate = value;
+    }
+    return err;
+}
+
+/**
+ * @brief Remember the negotiated baud rate, so that the next boot starts at it
+ *
+ * @param baud_rate baud rate to store
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - others on NVS error
+ */
+static esp_err_t esp_modem_store_baud_rate(uint32_t baud_rate)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_u32(handle, ESP_MODEM_NVS_KEY_BAUD_RATE, baud_rate);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t esp_modem_probe_baud_rate(modem_dte_t *dte, uint32_t *baud_rate)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    uint32_t initial = esp_dte->baud_rate;
+    /* Most likely the DCE is still where we left it */
+    if (esp_modem_dte_probe(esp_dte, ESP_MODEM_BAUD_PROBE_ATTEMPTS, 1) == ESP_OK) {
+        *baud_rate = initial;
+        return ESP_OK;
+    }
+    for (int i = 0; i < sizeof(esp_modem_baud_rates) / sizeof(esp_modem_baud_rates[0]); i++) {
+        if (esp_modem_baud_rates[i] == initial) {
+            continue;
+        }
+        MODEM_CHECK(dte->change_baud(dte, esp_modem_baud_rates[i]) == ESP_OK, "change baud rate failed", err);
+        if (esp_modem_dte_probe(esp_dte, ESP_MODEM_BAUD_PROBE_ATTEMPTS, 1) == ESP_OK) {
+            ESP_LOGI(MODEM_TAG, "modem found at %d baud", esp_modem_baud_rates[i]);
+            *baud_rate = esp_modem_baud_rates[i];
+            return ESP_OK;
+        }
+    }
+err:
+    dte->change_baud(dte, initial);
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_negotiate_baud_rate(modem_dte_t *dte, uint32_t max_baud_rate, uint32_t *baud_rate)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->set_baud_rate, "DCE can not change baud rate", err);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE, "baud rate can only be changed in command mode", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    uint32_t initial = esp_dte->baud_rate;
+    uint32_t current = initial;
+    for (int i = 0; i < sizeof(esp_modem_baud_rates) / sizeof(esp_modem_baud_rates[0]); i++) {
+        uint32_t candidate = esp_modem_baud_rates[i];
+        if (candidate > max_baud_rate) {
+            continue;
+        }
+        if (candidate <= current) {
+            break;
+        }
+        /* The DCE refuses rates it does not support, try the next one */
+        if (dce->set_baud_rate(dce, candidate) != ESP_OK) {
+            continue;
+        }
+        MODEM_CHECK(dte->change_baud(dte, candidate) == ESP_OK, "change baud rate failed", err_lost);
+        if (esp_modem_dte_probe(esp_dte, ESP_MODEM_BAUD_VERIFY_ATTEMPTS, ESP_MODEM_BAUD_VERIFY_ATTEMPTS) == ESP_OK) {
+            current = candidate;
+            break;
+        }
+        ESP_LOGW(MODEM_TAG, "link unreliable at %d baud, falling back", candidate);
+        /* Ask the DCE to go back blindly, then check that both ends agree again */
+        char command[24];
+        snprintf(command, sizeof(command), "AT+IPR=%d\r", current);
+        dte->send_data(dte, command, strlen(command));
+        MODEM_CHECK(dte->change_baud(dte, current) == ESP_OK, "change baud rate failed", err_lost);
+        if (esp_modem_dte_probe(esp_dte, ESP_MODEM_BAUD_PROBE_ATTEMPTS, 1) != ESP_OK) {
+            MODEM_CHECK(esp_modem_probe_baud_rate(dte, &current) == ESP_OK, "modem lost after baud rate change", err_lost);
+        }
+    }
+    /* Persist on both ends, the DCE keeps AT+IPR with AT&W */
+    if (current != initial && dce->store_profile(dce) != ESP_OK) {
+        ESP_LOGW(MODEM_TAG, "store baud rate in modem profile failed");
+    }
+    uint32_t stored = 0;
+    if (esp_modem_load_baud_rate(&stored) != ESP_OK || stored != current) {
+        if (esp_modem_store_baud_rate(current) != ESP_OK) {
+            ESP_LOGW(MODEM_TAG, "store baud rate in nvs failed");
+        }
+    }
+    ESP_LOGI(MODEM_TAG, "baud rate: %d", current);
+    *baud_rate = current;
+    return ESP_OK;
+err_lost:
+    *baud_rate = esp_dte->baud_rate;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_wait_ready(modem_dte_t *dte, uint32_t timeout_ms)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    uint32_t backoff_ms = ESP_MODEM_READY_BACKOFF_MIN_MS;
+    /* A RDY seen before is stale, the probe decides */
+    xSemaphoreTake(esp_dte->ready_sem, 0);
+    while (esp_modem_dte_probe(esp_dte, 1, 1) != ESP_OK) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            ESP_LOGW(MODEM_TAG, "modem not ready after %d ms", timeout_ms);
+            return ESP_ERR_TIMEOUT;
+        }
+        /* RDY ends the wait early, the next "AT" is answered right away */
+        if (xSemaphoreTake(esp_dte->ready_sem, MIN(pdMS_TO_TICKS(backoff_ms), timeout - elapsed)) == pdTRUE) {
+            backoff_ms = ESP_MODEM_READY_BACKOFF_MIN_MS;
+        } else {
+            backoff_ms = MIN(backoff_ms * 2, ESP_MODEM_READY_BACKOFF_MAX_MS);
+        }
+    }
+    ESP_LOGD(MODEM_TAG, "modem ready after %d ms", (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+    return ESP_OK;
+}
+
 esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
 {
     modem_dce_t *dce = dte->dce;
@@ -468,7 +1163,7 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
     MODEM_CHECK(dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK, "enter ppp mode failed", err);
 
     /* post PPP mode started event */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_START, NULL, 0, 0);
+    esp_dte_post_event(esp_dte, ESP_MODEM_EVENT_PPP_START, NULL, 0);
     return ESP_OK;
 err:
     return ESP_FAIL;
@@ -481,7 +1176,7 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
 
     /* post PPP mode stopped event */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
+    esp_dte_post_event(esp_dte, ESP_MODEM_EVENT_PPP_STOP, NULL, 0);
     /* Enter command mode */
     MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err);
     /* Hang up */
@@ -490,3 +1185,28 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
 err:
     return ESP_FAIL;
 }
+
+esp_err_t esp_modem_pause_ppp(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->mode == MODEM_PPP_MODE, "not in ppp mode", err);
+    /* +++ leaves the data call up, the netif drops outgoing frames meanwhile */
+    MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_resume_ppp(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE, "not in command mode", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(dce->resume_data_mode(dce) == ESP_OK, "resume data mode failed", err);
+    esp_dte_enter_data_mode(esp_dte);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
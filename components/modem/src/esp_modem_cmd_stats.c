@@ -0,0 +1,132 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <sys/param.h>
+#include "esp_modem_cmd_stats.h"
+
+#define CMD_STATS_NAME_DATA "<data>"
+#define CMD_STATS_NAME_OTHER "<other>"
+
+/* Upper bounds of the histogram buckets, the last bucket has none */
+static const uint32_t s_bucket_bounds_ms[ESP_MODEM_CMD_STATS_BUCKETS - 1] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000
+};
+
+void esp_modem_cmd_stats_init(esp_modem_cmd_stats_table_t *table)
+{
+    memset(table, 0, sizeof(esp_modem_cmd_stats_table_t));
+}
+
+void esp_modem_cmd_stats_name(const char *data, uint32_t length, char *name)
+{
+    bool is_command = (length >= 2 && (data[0] == 'A' || data[0] == 'a') && (data[1] == 'T' || data[1] == 't')) ||
+                      (length >= 3 && !strncmp(data, "+++", 3));
+    if (!is_command) {
+        strcpy(name, CMD_STATS_NAME_DATA);
+        return;
+    }
+    uint32_t len = 0;
+    while (len < length && len < ESP_MODEM_CMD_STATS_MAX_NAME_LENGTH) {
+        char c = data[len];
+        if (c == '\r' || c == '\n') {
+            break;
+        }
+        name[len++] = c;
+        if (c == '=' || c == '?') {
+            break;
+        }
+    }
+    name[len] = '\0';
+}
+
+static esp_modem_cmd_stats_t *cmd_stats_find(const esp_modem_cmd_stats_table_t *table, const char *name)
+{
+    for (uint32_t i = 0; i < table->count; i++) {
+        if (!strcmp(table->entries[i].command, name)) {
+            return (esp_modem_cmd_stats_t *)&table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_modem_cmd_stats_t *cmd_stats_add(esp_modem_cmd_stats_table_t *table, const char *name)
+{
+    esp_modem_cmd_stats_t *stats = cmd_stats_find(table, name);
+    if (stats) {
+        return stats;
+    }
+    /* The last entry collects the commands which do not fit */
+    if (table->count >= ESP_MODEM_CMD_STATS_MAX_COMMANDS - 1) {
+        stats = &table->entries[ESP_MODEM_CMD_STATS_MAX_COMMANDS - 1];
+        if (table->count < ESP_MODEM_CMD_STATS_MAX_COMMANDS) {
+            strcpy(stats->command, CMD_STATS_NAME_OTHER);
+            table->count++;
+        }
+        return stats;
+    }
+    stats = &table->entries[table->count++];
+    strncpy(stats->command, name, ESP_MODEM_CMD_STATS_MAX_NAME_LENGTH);
+    return stats;
+}
+
+uint32_t esp_modem_cmd_stats_timeout(const esp_modem_cmd_stats_table_t *table, const char *name, uint32_t nominal_ms)
+{
+    const esp_modem_cmd_stats_t *stats = cmd_stats_find(table, name);
+    if (!stats || stats->count < ESP_MODEM_CMD_TIMEOUT_MIN_SAMPLES) {
+        return nominal_ms;
+    }
+    uint32_t timeout_ms = esp_modem_cmd_stats_percentile(stats, ESP_MODEM_CMD_TIMEOUT_PERCENTILE) *
+                          ESP_MODEM_CMD_TIMEOUT_MARGIN;
+    uint32_t floor_ms = MIN(nominal_ms, ESP_MODEM_CMD_TIMEOUT_FLOOR_MS);
+    uint32_t ceiling_ms = MAX(nominal_ms, MIN(nominal_ms * ESP_MODEM_CMD_TIMEOUT_STRETCH,
+                                              ESP_MODEM_CMD_TIMEOUT_CEILING_MS));
+    return MIN(MAX(timeout_ms, floor_ms), ceiling_ms);
+}
+
+void esp_modem_cmd_stats_record(esp_modem_cmd_stats_table_t *table, const char *name, uint32_t nominal_ms,
+                                uint32_t timeout_ms, uint32_t elapsed_ms, bool timed_out)
+{
+    esp_modem_cmd_stats_t *stats = cmd_stats_add(table, name);
+    uint32_t bucket = 0;
+    while (bucket < ESP_MODEM_CMD_STATS_BUCKETS - 1 && elapsed_ms > s_bucket_bounds_ms[bucket]) {
+        bucket++;
+    }
+    stats->histogram[bucket]++;
+    stats->count++;
+    stats->total_ms += elapsed_ms;
+    stats->max_ms = MAX(stats->max_ms, elapsed_ms);
+    stats->nominal_ms = nominal_ms;
+    stats->timeout_ms = timeout_ms;
+    if (timed_out) {
+        stats->timeouts++;
+    } else if (elapsed_ms > nominal_ms) {
+        stats->slow++;
+    }
+}
+
+uint32_t esp_modem_cmd_stats_percentile(const esp_modem_cmd_stats_t *stats, uint32_t percentile)
+{
+    if (stats->count == 0) {
+        return 0;
+    }
+    uint32_t rank = MAX(((uint64_t)stats->count * percentile + 99) / 100, 1);
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < ESP_MODEM_CMD_STATS_BUCKETS - 1; i++) {
+        seen += stats->histogram[i];
+        if (seen >= rank) {
+            return MIN(s_bucket_bounds_ms[i], stats->max_ms);
+        }
+    }
+    return stats->max_ms;
+}
@@ -0,0 +1,163 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "esp_modem_dce_cache.h"
+
+#define ESP_MODEM_NVS_NAMESPACE "esp_modem"
+#define ESP_MODEM_NVS_KEY_DCE_CACHE "dce_cache"
+#define ESP_MODEM_DCE_CACHE_VERSION (1)   /*!< Bump when the layout of esp_modem_dce_cache_t changes */
+#define ESP_MODEM_DCE_CACHE_NO_PROFILE (-1)
+
+static const char *DCE_TAG = "dce_cache";
+
+/**
+ * @brief Layout of the cache in NVS
+ *
+ */
+typedef struct {
+    uint8_t version;                      /*!< ESP_MODEM_DCE_CACHE_VERSION */
+    int8_t profile_flow_ctrl;             /*!< Flow control saved in the modem profile, -1 if unknown */
+    char iccid[MODEM_ICCID_LENGTH + 1];   /*!< SIM the cache belongs to */
+    char name[MODEM_MAX_NAME_LENGTH];     /*!< Module name */
+    char imei[MODEM_IMEI_LENGTH + 1];     /*!< IMEI number */
+    char imsi[MODEM_IMSI_LENGTH + 1];     /*!< IMSI number */
+    char oper[MODEM_MAX_OPERATOR_LENGTH]; /*!< Operator name, empty until it has been looked up */
+} esp_modem_dce_cache_t;
+
+/**
+ * @brief Read the cache from NVS, a cache of another layout counts as missing
+ */
+static esp_err_t dce_cache_read(esp_modem_dce_cache_t *cache)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        size_t size = sizeof(esp_modem_dce_cache_t);
+        err = nvs_get_blob(handle, ESP_MODEM_NVS_KEY_DCE_CACHE, cache, &size);
+        nvs_close(handle);
+        if (err == ESP_OK && (size != sizeof(esp_modem_dce_cache_t) || cache->version != ESP_MODEM_DCE_CACHE_VERSION)) {
+            err = ESP_ERR_NOT_FOUND;
+        }
+    }
+    /* Missing, or a blob too large for the current layout */
+    if (err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_NVS_INVALID_LENGTH) {
+        err = ESP_ERR_NOT_FOUND;
+    }
+    return err;
+}
+
+/**
+ * @brief Write the cache to NVS, unless it is unchanged
+ */
+static esp_err_t dce_cache_write(const esp_modem_dce_cache_t *cache)
+{
+    esp_modem_dce_cache_t stored;
+    if (dce_cache_read(&stored) == ESP_OK && !memcmp(&stored, cache, sizeof(esp_modem_dce_cache_t))) {
+        return ESP_OK;
+    }
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, ESP_MODEM_NVS_KEY_DCE_CACHE, cache, sizeof(esp_modem_dce_cache_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "store cache failed: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGD(DCE_TAG, "cache stored for %s", cache->iccid);
+    }
+    return err;
+}
+
+/**
+ * @brief Read the cache of the SIM in the DCE, or start an empty one
+ */
+static void dce_cache_read_for(modem_dce_t *dce, esp_modem_dce_cache_t *cache)
+{
+    if (dce_cache_read(cache) != ESP_OK || strcmp(cache->iccid, dce->iccid)) {
+        memset(cache, 0, sizeof(esp_modem_dce_cache_t));
+        cache->version = ESP_MODEM_DCE_CACHE_VERSION;
+        cache->profile_flow_ctrl = ESP_MODEM_DCE_CACHE_NO_PROFILE;
+        snprintf(cache->iccid, sizeof(cache->iccid), "%s", dce->iccid);
+    }
+}
+
+esp_err_t esp_modem_dce_cache_load(modem_dce_t *dce)
+{
+    esp_modem_dce_cache_t cache;
+    esp_err_t err = dce_cache_read(&cache);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!dce->iccid[0] || strcmp(cache.iccid, dce->iccid)) {
+        ESP_LOGI(DCE_TAG, "SIM changed, cache is stale");
+        return ESP_ERR_NOT_FOUND;
+    }
+    snprintf(dce->name, sizeof(dce->name), "%s", cache.name);
+    snprintf(dce->imei, sizeof(dce->imei), "%s", cache.imei);
+    snprintf(dce->imsi, sizeof(dce->imsi), "%s", cache.imsi);
+    snprintf(dce->oper, sizeof(dce->oper), "%s", cache.oper);
+    ESP_LOGD(DCE_TAG, "cache loaded for %s", dce->iccid);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_dce_cache_store(modem_dce_t *dce)
+{
+    esp_modem_dce_cache_t cache;
+    dce_cache_read_for(dce, &cache);
+    snprintf(cache.name, sizeof(cache.name), "%s", dce->name);
+    snprintf(cache.imei, sizeof(cache.imei), "%s", dce->imei);
+    snprintf(cache.imsi, sizeof(cache.imsi), "%s", dce->imsi);
+    snprintf(cache.oper, sizeof(cache.oper), "%s", dce->oper);
+    return dce_cache_write(&cache);
+}
+
+bool esp_modem_dce_cache_profile_stored(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl)
+{
+    esp_modem_dce_cache_t cache;
+    return dce_cache_read(&cache) == ESP_OK && !strcmp(cache.iccid, dce->iccid) &&
+           cache.profile_flow_ctrl == flow_ctrl;
+}
+
+esp_err_t esp_modem_dce_cache_set_profile(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl)
+{
+    esp_modem_dce_cache_t cache;
+    dce_cache_read_for(dce, &cache);
+    cache.profile_flow_ctrl = flow_ctrl;
+    return dce_cache_write(&cache);
+}
+
+esp_err_t esp_modem_dce_cache_erase(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, ESP_MODEM_NVS_KEY_DCE_CACHE);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    nvs_close(handle);
+    return err;
+}
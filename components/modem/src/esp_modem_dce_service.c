@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_modem_dce_service.h"
 
@@ -30,6 +31,18 @@ static const char *DCE_TAG = "dce_service";
         }                                                                             \
     } while (0)
 
+bool esp_modem_dce_parse_iccid(modem_dce_t *dce, const char *text)
+{
+    size_t digits = strspn(text, "0123456789");
+    if (digits < MODEM_ICCID_MIN_DIGITS) {
+        return false;
+    }
+    size_t len = MIN(digits + strspn(text + digits, "Ff"), MODEM_ICCID_LENGTH);
+    memcpy(dce->iccid, text, len);
+    dce->iccid[len] = '\0';
+    return true;
+}
+
 esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
@@ -98,6 +111,21 @@ err:
     return ESP_FAIL;
 }
 
+esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baud_rate)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[24];
+    int len = snprintf(command, sizeof(command), "AT+IPR=%d\r", baud_rate);
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set baud rate failed", err);
+    ESP_LOGD(DCE_TAG, "set baud rate ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const char *type, const char *apn)
 {
     modem_dte_t *dte = dce->dte;
@@ -113,6 +141,163 @@ err:
     return ESP_FAIL;
 }
 
+esp_err_t esp_modem_dce_set_reg_report(modem_dce_t *dce, const char *reg, bool on)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[16];
+    int len = snprintf(command, sizeof(command), "AT+%s=%d\r", reg, on ? 1 : 0);
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set registration report failed", err);
+    if (on) {
+        /* The answer is not consumed by the default handler, it reaches the URC handlers */
+        snprintf(command, sizeof(command), "AT+%s?\r", reg);
+        dce->handle_line = esp_modem_dce_handle_response_default;
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "query registration failed", err);
+    }
+    ESP_LOGD(DCE_TAG, "set registration report ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Handle response from ATO
+ */
+static esp_err_t esp_modem_dce_handle_ato(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_CONNECT)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_NO_CARRIER) || strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+esp_err_t esp_modem_dce_resume_data_mode(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    dce->handle_line = esp_modem_dce_handle_ato;
+    DCE_CHECK(dte->send_cmd(dte, "ATO\r", MODEM_COMMAND_TIMEOUT_RESUME) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "resume data mode failed", err);
+    dce->mode = MODEM_PPP_MODE;
+    ESP_LOGD(DCE_TAG, "resume data mode ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Encode a timer as GPRS Timer 3 (T3412 extended), unit in bits 8-6, value in bits 5-1
+ */
+static uint8_t esp_modem_encode_t3412(uint32_t seconds)
+{
+    /* Units in ascending order with their code */
+    static const uint32_t units[][2] = {
+        {2, 0x3}, {30, 0x4}, {60, 0x5}, {600, 0x0}, {3600, 0x1}, {36000, 0x2}, {1152000, 0x6}
+    };
+    for (int i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        uint32_t value = (seconds + units[i][0] - 1) / units[i][0];
+        if (value <= 0x1F) {
+            return units[i][1] << 5 | value;
+        }
+    }
+    return 0x6 << 5 | 0x1F;
+}
+
+/**
+ * @brief Encode a timer as GPRS Timer 2 (T3324), unit in bits 8-6, value in bits 5-1
+ */
+static uint8_t esp_modem_encode_t3324(uint32_t seconds)
+{
+    static const uint32_t units[][2] = {
+        {2, 0x0}, {60, 0x1}, {360, 0x2}
+    };
+    for (int i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        uint32_t value = (seconds + units[i][0] - 1) / units[i][0];
+        if (value <= 0x1F) {
+            return units[i][1] << 5 | value;
+        }
+    }
+    return 0x2 << 5 | 0x1F;
+}
+
+/**
+ * @brief Encode an eDRX cycle for WB-S1 mode
+ */
+static uint8_t esp_modem_encode_edrx(uint32_t cycle_ms)
+{
+    /* Cycle lengths in units of 10 ms, indexed by their code */
+    static const uint32_t cycles[] = {
+        512, 1024, 2048, 4096, 6144, 8192, 10240, 12288,
+        14336, 16384, 32768, 65536, 131072, 262144, 524288, 1048576
+    };
+    uint8_t code = 0;
+    for (int i = 0; i < sizeof(cycles) / sizeof(cycles[0]); i++) {
+        if (cycles[i] * 10 <= cycle_ms) {
+            code = i;
+        }
+    }
+    return code;
+}
+
+/**
+ * @brief Write the lowest bits of value as a string of '0' and '1', most significant first
+ */
+static void esp_modem_format_bits(char *str, uint8_t value, int bits)
+{
+    for (int i = 0; i < bits; i++) {
+        str[i] = (value & (1 << (bits - 1 - i))) ? '1' : '0';
+    }
+    str[bits] = '\0';
+}
+
+esp_err_t esp_modem_dce_set_psm(modem_dce_t *dce, bool on, uint32_t periodic_tau_s, uint32_t active_time_s)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[48];
+    if (on) {
+        char tau[9];
+        char active_time[9];
+        esp_modem_format_bits(tau, esp_modem_encode_t3412(periodic_tau_s), 8);
+        esp_modem_format_bits(active_time, esp_modem_encode_t3324(active_time_s), 8);
+        snprintf(command, sizeof(command), "AT+CPSMS=1,,,\"%s\",\"%s\"\r", tau, active_time);
+    } else {
+        snprintf(command, sizeof(command), "AT+CPSMS=0\r");
+    }
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set psm failed", err);
+    ESP_LOGD(DCE_TAG, "set psm ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_set_edrx(modem_dce_t *dce, bool on, uint32_t cycle_ms)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    if (on) {
+        char cycle[5];
+        esp_modem_format_bits(cycle, esp_modem_encode_edrx(cycle_ms), 4);
+        /* AcT type 4: E-UTRAN (WB-S1), i.e. LTE-M */
+        snprintf(command, sizeof(command), "AT+CEDRXS=1,4,\"%s\"\r", cycle);
+    } else {
+        snprintf(command, sizeof(command), "AT+CEDRXS=0\r");
+    }
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set edrx failed", err);
+    ESP_LOGD(DCE_TAG, "set edrx ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 esp_err_t esp_modem_dce_hang_up(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
@@ -124,3 +309,15 @@ esp_err_t esp_modem_dce_hang_up(modem_dce_t *dce)
 err:
     return ESP_FAIL;
 }
+
+esp_err_t esp_modem_dce_reset(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CFUN=1,1\r", MODEM_COMMAND_TIMEOUT_RESET) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "reset failed", err);
+    ESP_LOGD(DCE_TAG, "reset ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
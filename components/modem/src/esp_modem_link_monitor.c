@@ -0,0 +1,458 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_link_monitor.h"
+
+static const char *TAG = "esp-modem-link";
+
+#define PPP_FLAG (0x7e)
+#define PPP_ESCAPE (0x7d)
+#define PPP_TRANS (0x20)
+#define PPP_INITFCS (0xffff)
+#define PPP_GOODFCS (0xf0b8)
+#define PPP_PROTOCOL_LCP (0xc021)
+
+#define LCP_CONFIGURE_ACK (2)
+#define LCP_ECHO_REQUEST (9)
+#define LCP_ECHO_REPLY (10)
+#define LCP_OPTION_MAGIC (5)
+#define LCP_HEADER_LENGTH (4)
+/* code, id, length, magic number and tag */
+#define LCP_ECHO_LENGTH (LCP_HEADER_LENGTH + 4 + 4)
+
+/* the data of our echoes, tells their replies apart from those to the echoes of the network stack */
+static const uint8_t LINK_MONITOR_TAG[4] = { 'L', 'M', 'O', 'N' };
+
+#define LINK_MONITOR_FRAME_MAX (64)  /*!< Longest LCP frame looked at, enough for a Configure-Ack */
+#define LINK_MONITOR_ECHO_MAX (2 + 2 * (4 + LCP_ECHO_LENGTH + 2))
+#define LINK_MONITOR_RETRY_MS (10)   /*!< Wait for the network stack to finish its frame */
+
+struct esp_modem_link_monitor {
+    modem_dte_t *dte;
+    esp_modem_link_monitor_send_t send;
+    void *context;
+    esp_modem_link_monitor_config_t config;
+    portMUX_TYPE lock;                   /*!< Protects everything below, except the deframer */
+    SemaphoreHandle_t wakeup;            /*!< Wakes the task for a reply, a suspicion or stop */
+    SemaphoreHandle_t stopped;           /*!< Given by the task when it ends */
+    bool running;
+    bool pending;                        /*!< An echo is waiting for its reply */
+    bool restored;                       /*!< A reply came in while the link was down, to be posted */
+    uint8_t id;                          /*!< Identifier of the last echo */
+    uint32_t magic;                      /*!< Our magic number, from the Configure-Ack of the peer */
+    int64_t sent_us;                     /*!< Time the last echo was sent */
+    int64_t next_us;                     /*!< Time the next echo is due */
+    int64_t last_rx_us;                  /*!< Time anything was received */
+    int64_t tx_since_rx_us;              /*!< Time of the first output since the last input, 0 for none */
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t timeout_us;
+    uint32_t failures;                   /*!< Echoes lost in a row */
+    uint32_t history;                    /*!< One bit per echo, set if lost, newest in bit 0 */
+    uint32_t history_len;
+    esp_modem_link_stats_t stats;
+    /* HDLC deframer, used by esp_modem_link_monitor_input() only */
+    uint8_t frame[LINK_MONITOR_FRAME_MAX];
+    size_t frame_len;
+    bool escaped;
+};
+
+static uint16_t link_fcs(uint16_t fcs, const uint8_t *data, size_t length)
+{
+    while (length--) {
+        fcs ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            fcs = fcs & 1 ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+        }
+    }
+    return fcs;
+}
+
+/**
+ * @brief Frame an LCP Echo-Request, escaping all control characters as the default ACCM asks
+ */
+static size_t link_build_echo(uint8_t *out, uint8_t id, uint32_t magic)
+{
+    uint8_t frame[4 + LCP_ECHO_LENGTH + 2] = {
+        0xff, 0x03, PPP_PROTOCOL_LCP >> 8, PPP_PROTOCOL_LCP & 0xff,
+        LCP_ECHO_REQUEST, id, 0, LCP_ECHO_LENGTH,
+        magic >> 24, magic >> 16, magic >> 8, magic
+    };
+    memcpy(frame + 12, LINK_MONITOR_TAG, sizeof(LINK_MONITOR_TAG));
+    uint16_t fcs = link_fcs(PPP_INITFCS, frame, sizeof(frame) - 2) ^ 0xffff;
+    frame[sizeof(frame) - 2] = fcs & 0xff;
+    frame[sizeof(frame) - 1] = fcs >> 8;
+    size_t length = 0;
+    out[length++] = PPP_FLAG;
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        if (frame[i] < 0x20 || frame[i] == PPP_FLAG || frame[i] == PPP_ESCAPE) {
+            out[length++] = PPP_ESCAPE;
+            out[length++] = frame[i] ^ PPP_TRANS;
+        } else {
+            out[length++] = frame[i];
+        }
+    }
+    out[length++] = PPP_FLAG;
+    return length;
+}
+
+static uint32_t link_timeout_us(const esp_modem_link_monitor_t *monitor)
+{
+    uint32_t max_us = monitor->config.max_timeout_ms * 1000;
+    if (monitor->srtt_us == 0) {
+        return max_us;
+    }
+    uint32_t timeout_us = monitor->srtt_us + 4 * monitor->rttvar_us;
+    if (timeout_us < ESP_MODEM_LINK_MONITOR_MIN_TIMEOUT_MS * 1000) {
+        timeout_us = ESP_MODEM_LINK_MONITOR_MIN_TIMEOUT_MS * 1000;
+    }
+    return timeout_us < max_us ? timeout_us : max_us;
+}
+
+static void link_record(esp_modem_link_monitor_t *monitor, bool lost)
+{
+    monitor->history = (monitor->history << 1) | lost;
+    if (monitor->history_len < ESP_MODEM_LINK_MONITOR_HISTORY) {
+        monitor->history_len++;
+    }
+    uint32_t mask = monitor->history_len < 32 ? (1u << monitor->history_len) - 1 : 0xffffffff;
+    monitor->stats.loss_permille = __builtin_popcount(monitor->history & mask) * 1000 / monitor->history_len;
+}
+
+/**
+ * @brief Account a reply to the pending echo, called with the lock held
+ */
+static void link_handle_reply(esp_modem_link_monitor_t *monitor, int64_t now)
+{
+    uint32_t rtt_us = now - monitor->sent_us;
+    /* RFC 6298 estimator, the first sample sets the deviation to half of it */
+    if (monitor->srtt_us == 0) {
+        monitor->srtt_us = rtt_us ? rtt_us : 1;
+        monitor->rttvar_us = rtt_us / 2;
+    } else {
+        uint32_t delta = rtt_us > monitor->srtt_us ? rtt_us - monitor->srtt_us : monitor->srtt_us - rtt_us;
+        monitor->rttvar_us = (3 * monitor->rttvar_us + delta) / 4;
+        monitor->srtt_us = (7 * monitor->srtt_us + rtt_us) / 8;
+    }
+    monitor->timeout_us = link_timeout_us(monitor);
+    monitor->pending = false;
+    monitor->failures = 0;
+    link_record(monitor, false);
+
+    esp_modem_link_stats_t *stats = &monitor->stats;
+    stats->replies++;
+    stats->rtt_ms = rtt_us / 1000;
+    stats->srtt_ms = monitor->srtt_us / 1000;
+    stats->jitter_ms = monitor->rttvar_us / 1000;
+    if (stats->replies == 1 || stats->rtt_ms < stats->rtt_min_ms) {
+        stats->rtt_min_ms = stats->rtt_ms;
+    }
+    if (stats->rtt_ms > stats->rtt_max_ms) {
+        stats->rtt_max_ms = stats->rtt_ms;
+    }
+    stats->timeout_ms = monitor->timeout_us / 1000;
+    /* a healthy link is probed less and less often */
+    stats->interval_ms = stats->interval_ms * 2 < monitor->config.max_interval_ms ?
+                         stats->interval_ms * 2 : monitor->config.max_interval_ms;
+    monitor->next_us = monitor->sent_us + (int64_t)stats->interval_ms * 1000;
+    if (!stats->up) {
+        stats->up = true;
+        monitor->restored = true;
+    }
+}
+
+/**
+ * @brief Look at a complete LCP frame for the reply to our echo or our magic number
+ */
+static void link_handle_frame(esp_modem_link_monitor_t *monitor, const uint8_t *frame, size_t length, int64_t now)
+{
+    if (length < 4 + LCP_HEADER_LENGTH + 2 || link_fcs(PPP_INITFCS, frame, length) != PPP_GOODFCS) {
+        return;
+    }
+    if (frame[0] != 0xff || frame[1] != 0x03 || ((frame[2] << 8) | frame[3]) != PPP_PROTOCOL_LCP) {
+        return;
+    }
+    const uint8_t *lcp = frame + 4;
+    size_t lcp_len = (lcp[2] << 8) | lcp[3];
+    if (lcp_len < LCP_HEADER_LENGTH || lcp_len > length - 4 - 2) {
+        return;
+    }
+    bool wake = false;
+    portENTER_CRITICAL(&monitor->lock);
+    if (lcp[0] == LCP_ECHO_REPLY && lcp_len == LCP_ECHO_LENGTH) {
+        if (monitor->running && monitor->pending && lcp[1] == monitor->id &&
+                !memcmp(lcp + 8, LINK_MONITOR_TAG, sizeof(LINK_MONITOR_TAG))) {
+            link_handle_reply(monitor, now);
+            wake = true;
+        }
+    } else if (lcp[0] == LCP_CONFIGURE_ACK) {
+        /* the peer acknowledges our options, the magic number among them */
+        for (size_t i = LCP_HEADER_LENGTH; i + 2 <= lcp_len && lcp[i + 1] >= 2; i += lcp[i + 1]) {
+            if (lcp[i] == LCP_OPTION_MAGIC && lcp[i + 1] == 6 && i + 6 <= lcp_len) {
+                monitor->magic = ((uint32_t)lcp[i + 2] << 24) | (lcp[i + 3] << 16) | (lcp[i + 4] << 8) | lcp[i + 5];
+            }
+        }
+    }
+    portEXIT_CRITICAL(&monitor->lock);
+    if (wake) {
+        xSemaphoreGive(monitor->wakeup);
+    }
+}
+
+void esp_modem_link_monitor_input(esp_modem_link_monitor_t *monitor, const uint8_t *data, size_t length)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&monitor->lock);
+    monitor->last_rx_us = now;
+    monitor->tx_since_rx_us = 0;
+    portEXIT_CRITICAL(&monitor->lock);
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = data[i];
+        if (c == PPP_FLAG) {
+            if (monitor->frame_len <= LINK_MONITOR_FRAME_MAX) {
+                link_handle_frame(monitor, monitor->frame, monitor->frame_len, now);
+            }
+            monitor->frame_len = 0;
+            monitor->escaped = false;
+        } else if (c == PPP_ESCAPE) {
+            monitor->escaped = true;
+        } else {
+            if (monitor->frame_len < LINK_MONITOR_FRAME_MAX) {
+                monitor->frame[monitor->frame_len] = monitor->escaped ? c ^ PPP_TRANS : c;
+            }
+            /* counts on past the buffer, so a long frame is not taken for a short one */
+            if (monitor->frame_len <= LINK_MONITOR_FRAME_MAX) {
+                monitor->frame_len++;
+            }
+            monitor->escaped = false;
+        }
+    }
+}
+
+void esp_modem_link_monitor_output(esp_modem_link_monitor_t *monitor)
+{
+    bool wake = false;
+    portENTER_CRITICAL(&monitor->lock);
+    if (monitor->tx_since_rx_us == 0) {
+        monitor->tx_since_rx_us = esp_timer_get_time();
+        wake = monitor->running;
+    }
+    portEXIT_CRITICAL(&monitor->lock);
+    if (wake) {
+        xSemaphoreGive(monitor->wakeup);
+    }
+}
+
+/**
+ * @brief Send the next echo
+ *
+ * The echo is pending before it is sent, its reply may come in before the send returns.
+ */
+static esp_err_t link_send_echo(esp_modem_link_monitor_t *monitor)
+{
+    uint8_t echo[LINK_MONITOR_ECHO_MAX];
+    portENTER_CRITICAL(&monitor->lock);
+    uint8_t id = ++monitor->id;
+    uint32_t magic = monitor->magic;
+    monitor->pending = true;
+    monitor->sent_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&monitor->lock);
+    size_t length = link_build_echo(echo, id, magic);
+    esp_err_t err = monitor->send(echo, length, monitor->context);
+    portENTER_CRITICAL(&monitor->lock);
+    if (err == ESP_OK) {
+        monitor->stats.sent++;
+    } else if (monitor->id == id) {
+        monitor->pending = false;
+        if (err != ESP_ERR_TIMEOUT) {
+            /* no session right now, try again later */
+            monitor->next_us = esp_timer_get_time() + (int64_t)monitor->config.min_interval_ms * 1000;
+        }
+    }
+    portEXIT_CRITICAL(&monitor->lock);
+    return err;
+}
+
+static void link_monitor_task(void *arg)
+{
+    esp_modem_link_monitor_t *monitor = arg;
+    while (true) {
+        bool restored = false;
+        bool down = false;
+        uint32_t detect_ms = 0;
+        int64_t wait_us = 0;
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL(&monitor->lock);
+        if (!monitor->running) {
+            portEXIT_CRITICAL(&monitor->lock);
+            break;
+        }
+        restored = monitor->restored;
+        monitor->restored = false;
+        esp_modem_link_stats_t *stats = &monitor->stats;
+        if (monitor->pending && now - monitor->sent_us >= monitor->timeout_us) {
+            monitor->pending = false;
+            monitor->failures++;
+            link_record(monitor, true);
+            stats->lost++;
+            stats->interval_ms = monitor->config.min_interval_ms;
+            monitor->next_us = monitor->sent_us + (int64_t)stats->interval_ms * 1000;
+            if (monitor->failures >= monitor->config.max_failures && stats->up) {
+                stats->up = false;
+                stats->link_down++;
+                stats->detect_ms = (now - monitor->last_rx_us) / 1000;
+                detect_ms = stats->detect_ms;
+                down = true;
+            }
+        }
+        if (monitor->pending) {
+            wait_us = monitor->sent_us + monitor->timeout_us - now;
+        } else {
+            int64_t due = monitor->next_us;
+            /* the network stack is talking to a peer that does not answer, find out early */
+            if (monitor->tx_since_rx_us) {
+                int64_t suspect = monitor->tx_since_rx_us + monitor->timeout_us;
+                int64_t earliest = monitor->sent_us + (int64_t)monitor->config.min_interval_ms * 1000;
+                suspect = suspect > earliest ? suspect : earliest;
+                due = suspect < due ? suspect : due;
+            }
+            wait_us = due - now;
+        }
+        portEXIT_CRITICAL(&monitor->lock);
+        if (restored) {
+            ESP_LOGI(TAG, "link restored");
+            esp_modem_post_event(monitor->dte, ESP_MODEM_EVENT_LINK_RESTORED, NULL, 0);
+        }
+        if (down) {
+            ESP_LOGW(TAG, "link down, no echo reply, last data %d ms ago", detect_ms);
+            esp_modem_link_lost_reason_t reason = ESP_MODEM_LINK_LOST_ECHO_TIMEOUT;
+            esp_modem_post_event(monitor->dte, ESP_MODEM_EVENT_LINK_LOST, &reason, sizeof(reason));
+        }
+        if (wait_us <= 0) {
+            esp_err_t err = link_send_echo(monitor);
+            if (err == ESP_OK) {
+                continue;
+            }
+            wait_us = err == ESP_ERR_TIMEOUT ? LINK_MONITOR_RETRY_MS * 1000 :
+                      (int64_t)monitor->config.min_interval_ms * 1000;
+        }
+        xSemaphoreTake(monitor->wakeup, pdMS_TO_TICKS((wait_us + 999) / 1000));
+    }
+    xSemaphoreGive(monitor->stopped);
+    vTaskDelete(NULL);
+}
+
+esp_modem_link_monitor_t *esp_modem_link_monitor_create(modem_dte_t *dte, esp_modem_link_monitor_send_t send,
+                                                        void *context)
+{
+    esp_modem_link_monitor_t *monitor = calloc(1, sizeof(esp_modem_link_monitor_t));
+    if (monitor == NULL) {
+        ESP_LOGE(TAG, "Cannot allocate esp_modem_link_monitor_t");
+        return NULL;
+    }
+    monitor->wakeup = xSemaphoreCreateBinary();
+    monitor->stopped = xSemaphoreCreateBinary();
+    if (monitor->wakeup == NULL || monitor->stopped == NULL) {
+        ESP_LOGE(TAG, "Cannot create link monitor semaphores");
+        esp_modem_link_monitor_delete(monitor);
+        return NULL;
+    }
+    monitor->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    monitor->dte = dte;
+    monitor->send = send;
+    monitor->context = context;
+    return monitor;
+}
+
+void esp_modem_link_monitor_delete(esp_modem_link_monitor_t *monitor)
+{
+    esp_modem_link_monitor_stop(monitor);
+    if (monitor->wakeup) {
+        vSemaphoreDelete(monitor->wakeup);
+    }
+    if (monitor->stopped) {
+        vSemaphoreDelete(monitor->stopped);
+    }
+    free(monitor);
+}
+
+esp_err_t esp_modem_link_monitor_start(esp_modem_link_monitor_t *monitor, const esp_modem_link_monitor_config_t *config)
+{
+    if (config->min_interval_ms == 0 || config->max_interval_ms < config->min_interval_ms ||
+            config->max_timeout_ms < ESP_MODEM_LINK_MONITOR_MIN_TIMEOUT_MS || config->max_failures == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&monitor->lock);
+    if (monitor->running) {
+        portEXIT_CRITICAL(&monitor->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    monitor->config = *config;
+    monitor->running = true;
+    monitor->pending = false;
+    monitor->restored = false;
+    monitor->next_us = now;
+    monitor->sent_us = now;
+    monitor->last_rx_us = now;
+    monitor->tx_since_rx_us = 0;
+    monitor->srtt_us = 0;
+    monitor->rttvar_us = 0;
+    monitor->failures = 0;
+    monitor->history = 0;
+    monitor->history_len = 0;
+    monitor->timeout_us = link_timeout_us(monitor);
+    monitor->stats.up = true;
+    monitor->stats.loss_permille = 0;
+    monitor->stats.interval_ms = config->min_interval_ms;
+    monitor->stats.timeout_ms = monitor->timeout_us / 1000;
+    portEXIT_CRITICAL(&monitor->lock);
+    /* a stop before this start may have left a wakeup behind */
+    xSemaphoreTake(monitor->wakeup, 0);
+    if (xTaskCreate(link_monitor_task, "link_monitor", ESP_MODEM_LINK_MONITOR_TASK_STACK_SIZE, monitor,
+                    ESP_MODEM_LINK_MONITOR_TASK_PRIORITY, NULL) != pdTRUE) {
+        ESP_LOGE(TAG, "create link monitor task failed");
+        portENTER_CRITICAL(&monitor->lock);
+        monitor->running = false;
+        portEXIT_CRITICAL(&monitor->lock);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void esp_modem_link_monitor_stop(esp_modem_link_monitor_t *monitor)
+{
+    portENTER_CRITICAL(&monitor->lock);
+    bool running = monitor->running;
+    monitor->running = false;
+    portEXIT_CRITICAL(&monitor->lock);
+    if (running) {
+        xSemaphoreGive(monitor->wakeup);
+        xSemaphoreTake(monitor->stopped, portMAX_DELAY);
+    }
+}
+
+void esp_modem_link_monitor_get_stats(esp_modem_link_monitor_t *monitor, esp_modem_link_stats_t *stats)
+{
+    portENTER_CRITICAL(&monitor->lock);
+    *stats = monitor->stats;
+    portEXIT_CRITICAL(&monitor->lock);
+}
@@ -11,8 +11,11 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_netif.h"
 #include "esp_modem.h"
+#include "esp_modem_netif.h"
 #include "esp_log.h"
 
 static const char *TAG = "esp-modem-netif";
@@ -23,6 +26,10 @@ static const char *TAG = "esp-modem-netif";
 typedef struct esp_modem_netif_driver_s {
     esp_netif_driver_base_t base;           /*!< base structure reserved as esp-netif driver */
     modem_dte_t            *dte;        /*!< ptr to the esp_modem objects (DTE) */
+    SemaphoreHandle_t       tx_lock;    /*!< serializes the network stack and link monitor output */
+    bool                    tx_mid_frame; /*!< the network stack stopped in the middle of a frame */
+    esp_modem_link_monitor_t *monitor;  /*!< link monitor, created with the driver to see the LCP negotiation */
+    bool                    monitor_started; /*!< the link monitor was started at least once */
 } esp_modem_netif_driver_t;
 
 /**
@@ -30,7 +37,7 @@ typedef struct esp_modem_netif_driver_s {
  *
  * Note: This API has to conform to esp-netif transmit prototype
  *
- * @param h Opaque pointer representing esp-netif driver, esp_dte in this case of esp_modem
+ * @param h Opaque pointer representing esp-netif driver, esp_modem_netif_driver_t in this case of esp_modem
  * @param data data buffer
  * @param length length of data to send
  *
@@ -38,11 +45,45 @@ typedef struct esp_modem_netif_driver_s {
  */
 static esp_err_t esp_modem_dte_transmit(void *h, void *buffer, size_t len)
 {
-    modem_dte_t *dte = h;
+    esp_modem_netif_driver_t *driver = h;
+    modem_dte_t *dte = driver->dte;
+    /* While the data call is paused the modem would take the frame for a command */
+    if (!dte->dce || dte->dce->mode != MODEM_PPP_MODE) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = ESP_FAIL;
+    xSemaphoreTake(driver->tx_lock, portMAX_DELAY);
     if (dte->send_data(dte, (const char *)buffer, len) > 0) {
-        return ESP_OK;
+        /* frames may be handed over in pieces, every frame ends with a flag */
+        driver->tx_mid_frame = len > 0 && ((const uint8_t *)buffer)[len - 1] != 0x7e;
+        ret = ESP_OK;
     }
-    return ESP_FAIL;
+    xSemaphoreGive(driver->tx_lock);
+    if (ret == ESP_OK) {
+        esp_modem_link_monitor_output(driver->monitor);
+    }
+    return ret;
+}
+
+/**
+ * @brief Send an echo of the link monitor between two frames of the network stack
+ */
+static esp_err_t esp_modem_netif_send_echo(const uint8_t *frame, size_t length, void *context)
+{
+    esp_modem_netif_driver_t *driver = context;
+    modem_dte_t *dte = driver->dte;
+    if (!dte->dce || dte->dce->mode != MODEM_PPP_MODE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(driver->tx_lock, 0) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    if (!driver->tx_mid_frame) {
+        ret = dte->send_data(dte, (const char *)frame, length) > 0 ? ESP_OK : ESP_FAIL;
+    }
+    xSemaphoreGive(driver->tx_lock);
+    return ret;
 }
 
 /**
@@ -62,7 +103,7 @@ static esp_err_t esp_modem_post_attach_start(esp_netif_t * esp_netif, void * arg
     const esp_netif_driver_ifconfig_t driver_ifconfig = {
             .driver_free_rx_buffer = NULL,
             .transmit = esp_modem_dte_transmit,
-            .handle = dte
+            .handle = driver
     };
     driver->base.netif = esp_netif;
     ESP_ERROR_CHECK(esp_netif_set_driver_config(esp_netif, &driver_ifconfig));
@@ -82,6 +123,7 @@ static esp_err_t esp_modem_post_attach_start(esp_netif_t * esp_netif, void * arg
 static esp_err_t modem_netif_receive_cb(void *buffer, size_t len, void *context)
 {
     esp_modem_netif_driver_t *driver = context;
+    esp_modem_link_monitor_input(driver->monitor, buffer, len);
     esp_netif_receive(driver->base.netif, buffer, len, NULL);
     return ESP_OK;
 }
@@ -93,16 +135,32 @@ void *esp_modem_netif_setup(modem_dte_t *dte)
         ESP_LOGE(TAG, "Cannot allocate esp_modem_netif_driver_t");
         goto drv_create_failed;
     }
+    driver->tx_lock = xSemaphoreCreateMutex();
+    if (driver->tx_lock == NULL) {
+        ESP_LOGE(TAG, "Cannot create tx lock");
+        goto drv_lock_failed;
+    }
+    /* before the first session, the magic number is only seen in the Configure-Ack of the peer */
+    driver->monitor = esp_modem_link_monitor_create(dte, esp_modem_netif_send_echo, driver);
+    if (driver->monitor == NULL) {
+        goto drv_monitor_failed;
+    }
     esp_err_t err = esp_modem_set_rx_cb(dte, modem_netif_receive_cb, driver);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_modem_set_rx_cb failed with: %d", err);
-        goto drv_create_failed;
+        goto drv_rx_cb_failed;
     }
 
     driver->base.post_attach = esp_modem_post_attach_start;
     driver->dte = dte;
     return driver;
 
+drv_rx_cb_failed:
+    esp_modem_link_monitor_delete(driver->monitor);
+drv_monitor_failed:
+    vSemaphoreDelete(driver->tx_lock);
+drv_lock_failed:
+    free(driver);
 drv_create_failed:
     return NULL;
 }
@@ -110,10 +168,38 @@ drv_create_failed:
 void esp_modem_netif_teardown(void *h)
 {
     esp_modem_netif_driver_t *driver = h;
+    esp_modem_link_monitor_delete(driver->monitor);
     esp_netif_destroy(driver->base.netif);
+    vSemaphoreDelete(driver->tx_lock);
     free(driver);
 }
 
+esp_err_t esp_modem_netif_start_link_monitor(void *h, const esp_modem_link_monitor_config_t *config)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_err_t err = esp_modem_link_monitor_start(driver->monitor, config);
+    if (err == ESP_OK) {
+        driver->monitor_started = true;
+    }
+    return err;
+}
+
+void esp_modem_netif_stop_link_monitor(void *h)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_modem_link_monitor_stop(driver->monitor);
+}
+
+esp_err_t esp_modem_netif_get_link_stats(void *h, esp_modem_link_stats_t *stats)
+{
+    esp_modem_netif_driver_t *driver = h;
+    if (!driver->monitor_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_modem_link_monitor_get_stats(driver->monitor, stats);
+    return ESP_OK;
+}
+
 esp_err_t esp_modem_netif_clear_default_handlers(void *h)
 {
     esp_modem_netif_driver_t *driver = h;
@@ -0,0 +1,221 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "esp_modem_urc.h"
+
+#define URC_BUCKET(c) ((uint8_t)(c) % ESP_MODEM_URC_BUCKETS)
+
+void esp_modem_urc_registry_init(esp_modem_urc_registry_t *registry)
+{
+    memset(registry, 0, sizeof(esp_modem_urc_registry_t));
+    registry->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    for (int i = 0; i < ESP_MODEM_URC_BUCKETS; i++) {
+        registry->buckets[i] = -1;
+    }
+    for (int i = 0; i < ESP_MODEM_URC_MAX_HANDLERS; i++) {
+        registry->entries[i].next = -1;
+    }
+}
+
+esp_err_t esp_modem_urc_registry_add(esp_modem_urc_registry_t *registry, const char *prefix,
+                                     esp_modem_urc_handler_t handler, void *context)
+{
+    if (!prefix || !handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(prefix);
+    if (len == 0 || len > ESP_MODEM_URC_MAX_PREFIX_LENGTH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&registry->lock);
+    for (int i = 0; i < ESP_MODEM_URC_MAX_HANDLERS; i++) {
+        esp_modem_urc_entry_t *entry = &registry->entries[i];
+        if (entry->handler) {
+            continue;
+        }
+        memcpy(entry->prefix, prefix, len + 1);
+        entry->prefix_len = len;
+        entry->context = context;
+        entry->handler = handler;
+        uint8_t bucket = URC_BUCKET(prefix[0]);
+        entry->next = registry->buckets[bucket];
+        registry->buckets[bucket] = i;
+        ret = ESP_OK;
+        break;
+    }
+    portEXIT_CRITICAL(&registry->lock);
+    return ret;
+}
+
+esp_err_t esp_modem_urc_registry_remove(esp_modem_urc_registry_t *registry, const char *prefix,
+                                        esp_modem_urc_handler_t handler)
+{
+    if (!prefix || !prefix[0]) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&registry->lock);
+    int8_t *link = &registry->buckets[URC_BUCKET(prefix[0])];
+    while (*link >= 0) {
+        esp_modem_urc_entry_t *entry = &registry->entries[*link];
+        if (entry->handler == handler && !strcmp(entry->prefix, prefix)) {
+            *link = entry->next;
+            entry->next = -1;
+            entry->handler = NULL;
+            ret = ESP_OK;
+            break;
+        }
+        link = &entry->next;
+    }
+    /* A dispatch on another task may have copied the handler before it was unlinked, wait until it is over.
+     * Dispatches started later cannot see the entry. */
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint32_t seq = registry->dispatch_seq;
+    while (ret == ESP_OK && registry->dispatcher && registry->dispatcher != self && registry->dispatch_seq == seq) {
+        portEXIT_CRITICAL(&registry->lock);
+        vTaskDelay(1);
+        portENTER_CRITICAL(&registry->lock);
+    }
+    portEXIT_CRITICAL(&registry->lock);
+    return ret;
+}
+
+/**
+ * @brief Check if the character terminates a URC prefix
+ */
+static inline bool urc_prefix_boundary(char c)
+{
+    return c == '\0' || c == ':' || c == ' ' || c == '\r' || c == '\n';
+}
+
+esp_err_t esp_modem_urc_registry_dispatch(esp_modem_urc_registry_t *registry, modem_dte_t *dte, const char *line)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&registry->lock);
+    registry->dispatcher = xTaskGetCurrentTaskHandle();
+    registry->dispatch_seq++;
+    int8_t index = registry->buckets[URC_BUCKET(line[0])];
+    while (index >= 0) {
+        esp_modem_urc_entry_t *entry = &registry->entries[index];
+        /* Copy what the call needs under the lock, the handler might unregister itself */
+        index = entry->next;
+        esp_modem_urc_handler_t handler = entry->handler;
+        void *context = entry->context;
+        uint8_t prefix_len = entry->prefix_len;
+        if (!handler || strncmp(line, entry->prefix, prefix_len) || !urc_prefix_boundary(line[prefix_len])) {
+            continue;
+        }
+        portEXIT_CRITICAL(&registry->lock);
+        esp_modem_urc_t urc = {
+            .line = line,
+            .args = line + prefix_len,
+        };
+        if (*urc.args == ':') {
+            urc.args++;
+        }
+        while (*urc.args == ' ') {
+            urc.args++;
+        }
+        urc.args_len = strcspn(urc.args, "\r\n");
+        if (handler(dte, &urc, context) == ESP_OK) {
+            ret = ESP_OK;
+        }
+        portENTER_CRITICAL(&registry->lock);
+    }
+    registry->dispatcher = NULL;
+    portEXIT_CRITICAL(&registry->lock);
+    return ret;
+}
+
+/**
+ * @brief Locate the comma separated argument at index, commas inside quotes are skipped
+ */
+static esp_err_t urc_find_arg(const esp_modem_urc_t *urc, uint32_t index, const char **start, size_t *len)
+{
+    const char *p = urc->args;
+    const char *end = urc->args + urc->args_len;
+    bool quoted = false;
+    while (index) {
+        if (p >= end) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (*p == '"') {
+            quoted = !quoted;
+        } else if (*p == ',' && !quoted) {
+            index--;
+        }
+        p++;
+    }
+    const char *q = p;
+    quoted = false;
+    while (q < end && (quoted || *q != ',')) {
+        if (*q == '"') {
+            quoted = !quoted;
+        }
+        q++;
+    }
+    *start = p;
+    *len = q - p;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_urc_get_int(const esp_modem_urc_t *urc, uint32_t index, int *value)
+{
+    const char *str = NULL;
+    size_t len = 0;
+    esp_err_t err = urc_find_arg(urc, index, &str, &len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (len == 0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    char *end = NULL;
+    long v = strtol(str, &end, 10);
+    /* the argument must be numeric up to the next separator */
+    if (end == str || end < str + len) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    *value = (int)v;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_urc_get_str(const esp_modem_urc_t *urc, uint32_t index, const char **str, size_t *len)
+{
+    esp_err_t err = urc_find_arg(urc, index, str, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (*len >= 2 && (*str)[0] == '"' && (*str)[*len - 1] == '"') {
+        (*str)++;
+        *len -= 2;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_urc_get_tail(const esp_modem_urc_t *urc, uint32_t index, const char **str, size_t *len)
+{
+    esp_err_t err = urc_find_arg(urc, index, str, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *len = urc->args + urc->args_len - *str;
+    if (*len >= 2 && (*str)[0] == '"' && (*str)[*len - 1] == '"') {
+        (*str)++;
+        *len -= 2;
+    }
+    return ESP_OK;
+}
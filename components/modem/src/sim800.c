@@ -13,9 +13,11 @@
 // limitations under the License.
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_modem_dce_service.h"
 #include "sim800.h"
+#include "esp_modem_dce_cache.h"
 
 #define MODEM_RESULT_CODE_POWERDOWN "POWER DOWN"
 
@@ -178,6 +180,23 @@ static esp_err_t sim800_handle_cimi(modem_dce_t *dce, const char *line)
     return err;
 }
 
+/**
+ * @brief Handle response from AT+CCID
+ */
+static esp_err_t sim800_handle_ccid(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (esp_modem_dce_parse_iccid(dce, line)) {
+        /* <iccid> */
+        err = ESP_OK;
+    }
+    return err;
+}
+
 /**
  * @brief Handle response from AT+COPS?
  */
@@ -228,6 +247,15 @@ static esp_err_t sim800_handle_power_down(modem_dce_t *dce, const char *line)
     return err;
 }
 
+/**
+ * @brief Handle +PDP: DEACT URC, printed when the network deactivates the PDP context
+ */
+static esp_err_t sim800_handle_pdp_deact(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    esp_modem_link_lost_reason_t reason = ESP_MODEM_LINK_LOST_PDP_DEACT;
+    return esp_modem_post_event(dte, ESP_MODEM_EVENT_LINK_LOST, &reason, sizeof(reason));
+}
+
 /**
  * @brief Get signal quality
  *
@@ -397,25 +425,128 @@ err:
 }
 
 /**
- * @brief Get Operator's name
+ * @brief Get ICCID of the SIM card
  *
  * @param sim800_dce sim800 object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t sim800_get_operator_name(sim800_modem_dce_t *sim800_dce)
+static esp_err_t sim800_get_iccid(sim800_modem_dce_t *sim800_dce)
 {
     modem_dte_t *dte = sim800_dce->parent.dte;
-    sim800_dce->parent.handle_line = sim800_handle_cops;
-    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
-    DCE_CHECK(sim800_dce->parent.state == MODEM_STATE_SUCCESS, "get network operator failed", err);
+    sim800_dce->parent.handle_line = sim800_handle_ccid;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CCID\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(sim800_dce->parent.state == MODEM_STATE_SUCCESS, "get iccid failed", err);
+    ESP_LOGD(DCE_TAG, "get iccid ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get module name, IMEI and IMSI
+ *
+ * The module name belongs to the module, it is only queried if the IMEI is new.
+ * Refreshing a known identity takes two commands.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim800_get_identity(modem_dce_t *dce)
+{
+    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
+    char imei[MODEM_IMEI_LENGTH + 1];
+    strcpy(imei, dce->imei);
+    /* Get IMEI number */
+    DCE_CHECK(sim800_get_imei_number(sim800_dce) == ESP_OK, "get imei failed", err);
+    /* Get Module name */
+    if (!dce->name[0] || strcmp(imei, dce->imei)) {
+        DCE_CHECK(sim800_get_module_name(sim800_dce) == ESP_OK, "get module name failed", err);
+    }
+    /* Get IMSI number */
+    DCE_CHECK(sim800_get_imsi_number(sim800_dce) == ESP_OK, "get imsi failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get Operator's name
+ *
+ * Answered right away once the modem is registered. While it is still searching the modem may hold
+ * the answer for up to MODEM_COMMAND_TIMEOUT_OPERATOR, the read gives up after
+ * MODEM_COMMAND_TIMEOUT_OPERATOR_READ instead.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim800_get_operator_name(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    dce->handle_line = sim800_handle_cops;
+    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR_READ) == ESP_OK,
+              "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "get network operator failed", err);
     ESP_LOGD(DCE_TAG, "get network operator ok");
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Enable or disable +CGREG URCs
+ *
+ * @param dce Modem DCE object
+ * @param on true to enable URCs
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim800_set_network_reg_report(modem_dce_t *dce, bool on)
+{
+    DCE_CHECK(esp_modem_dce_set_reg_report(dce, "CGREG", on) == ESP_OK, "set CGREG report failed", err);
+    ESP_LOGD(DCE_TAG, "set network registration report ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Power saving mode, not available on the GSM/GPRS only SIM800
+ *
+ * @param dce Modem DCE object
+ * @param on true to request PSM
+ * @param periodic_tau_s requested periodic TAU interval
+ * @param active_time_s requested active time
+ * @return esp_err_t
+ *      - ESP_OK if PSM is switched off
+ *      - ESP_ERR_NOT_SUPPORTED otherwise
+ */
+static esp_err_t sim800_set_psm(modem_dce_t *dce, bool on, uint32_t periodic_tau_s, uint32_t active_time_s)
+{
+    return on ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+}
+
+/**
+ * @brief Extended DRX, not available on the GSM/GPRS only SIM800
+ *
+ * @param dce Modem DCE object
+ * @param on true to request eDRX
+ * @param cycle_ms requested eDRX cycle
+ * @return esp_err_t
+ *      - ESP_OK if eDRX is switched off
+ *      - ESP_ERR_NOT_SUPPORTED otherwise
+ */
+static esp_err_t sim800_set_edrx(modem_dce_t *dce, bool on, uint32_t cycle_ms)
+{
+    return on ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+}
+
 /**
  * @brief Deinitialize SIM800 object
  *
@@ -428,6 +559,7 @@ static esp_err_t sim800_deinit(modem_dce_t *dce)
 {
     sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
     if (dce->dte) {
+        esp_modem_remove_urc_handler(dce->dte, "+PDP", sim800_handle_pdp_deact);
         dce->dte->dce = NULL;
     }
     free(sim800_dce);
@@ -449,27 +581,37 @@ modem_dce_t *sim800_init(modem_dte_t *dte)
     sim800_dce->parent.echo_mode = esp_modem_dce_echo;
     sim800_dce->parent.store_profile = esp_modem_dce_store_profile;
     sim800_dce->parent.set_flow_ctrl = esp_modem_dce_set_flow_ctrl;
+    sim800_dce->parent.set_baud_rate = esp_modem_dce_set_baud_rate;
     sim800_dce->parent.define_pdp_context = esp_modem_dce_define_pdp_context;
     sim800_dce->parent.hang_up = esp_modem_dce_hang_up;
     sim800_dce->parent.get_signal_quality = sim800_get_signal_quality;
     sim800_dce->parent.get_battery_status = sim800_get_battery_status;
     sim800_dce->parent.set_working_mode = sim800_set_working_mode;
+    sim800_dce->parent.resume_data_mode = esp_modem_dce_resume_data_mode;
+    sim800_dce->parent.get_operator_name = sim800_get_operator_name;
+    sim800_dce->parent.get_identity = sim800_get_identity;
+    sim800_dce->parent.set_psm = sim800_set_psm;
+    sim800_dce->parent.set_edrx = sim800_set_edrx;
+    sim800_dce->parent.set_network_reg_report = sim800_set_network_reg_report;
+    sim800_dce->parent.reset = esp_modem_dce_reset;
     sim800_dce->parent.power_down = sim800_power_down;
     sim800_dce->parent.deinit = sim800_deinit;
+    /* Register vendor specific URCs */
+    DCE_CHECK(esp_modem_add_urc_handler(dte, "+PDP", sim800_handle_pdp_deact, NULL) == ESP_OK,
+              "register urc handlers failed", err_io);
     /* Sync between DTE and DCE */
     DCE_CHECK(esp_modem_dce_sync(&(sim800_dce->parent)) == ESP_OK, "sync failed", err_io);
     /* Close echo */
     DCE_CHECK(esp_modem_dce_echo(&(sim800_dce->parent), false) == ESP_OK, "close echo mode failed", err_io);
-    /* Get Module name */
-    DCE_CHECK(sim800_get_module_name(sim800_dce) == ESP_OK, "get module name failed", err_io);
-    /* Get IMEI number */
-    DCE_CHECK(sim800_get_imei_number(sim800_dce) == ESP_OK, "get imei failed", err_io);
-    /* Get IMSI number */
-    DCE_CHECK(sim800_get_imsi_number(sim800_dce) == ESP_OK, "get imsi failed", err_io);
-    /* Get operator name */
-    DCE_CHECK(sim800_get_operator_name(sim800_dce) == ESP_OK, "get operator name failed", err_io);
+    /* The ICCID identifies the SIM, the rest of the identity is cached for it */
+    DCE_CHECK(sim800_get_iccid(sim800_dce) == ESP_OK, "get iccid failed", err_io);
+    if (esp_modem_dce_cache_load(&(sim800_dce->parent)) != ESP_OK) {
+        DCE_CHECK(sim800_get_identity(&(sim800_dce->parent)) == ESP_OK, "get identity failed", err_io);
+        esp_modem_dce_cache_store(&(sim800_dce->parent));
+    }
     return &(sim800_dce->parent);
 err_io:
+    esp_modem_remove_urc_handler(dte, "+PDP", sim800_handle_pdp_deact);
     free(sim800_dce);
 err:
     return NULL;
@@ -0,0 +1,172 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "unity.h"
+#include "esp_modem.h"
+#include "sdkconfig.h"
+
+/* The DTE talks to itself through the internal UART loopback, at the fastest rate it is configured for */
+#define TEST_BAUD_RATE CONFIG_EXAMPLE_UART_MODEM_MAX_BAUD_RATE
+#define TEST_PPP_BYTES (256 * 1024)
+#define TEST_URC_LINES (200)
+#define TEST_HOG_TIME_MS (CONFIG_EXAMPLE_UART_RX_LATENCY_MS)
+#define TEST_HOG_PRIORITY (CONFIG_EXAMPLE_UART_EVENT_TASK_PRIORITY + 1)
+
+typedef struct {
+    volatile uint32_t received;
+    volatile uint32_t errors;
+} test_rx_ctx_t;
+
+static volatile bool s_hog_run;
+
+static esp_err_t test_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
+{
+    dce->mode = mode;
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep the UART event task from running for the configured worst-case latency, over and over
+ */
+static void test_hog_task(void *param)
+{
+    while (s_hog_run) {
+        int64_t until = esp_timer_get_time() + TEST_HOG_TIME_MS * 1000;
+        while (esp_timer_get_time() < until) {
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    vTaskDelete(NULL);
+}
+
+static void test_start_hogs(void)
+{
+    s_hog_run = true;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(test_hog_task, "hog", 2048, NULL, TEST_HOG_PRIORITY, NULL, core));
+    }
+}
+
+static void test_stop_hogs(void)
+{
+    s_hog_run = false;
+    vTaskDelay(pdMS_TO_TICKS(2 * TEST_HOG_TIME_MS));
+}
+
+static modem_dte_t *test_dte_init(modem_dce_t *dce)
+{
+    esp_modem_dte_config_t config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    config.baud_rate = TEST_BAUD_RATE;
+    config.flow_control = MODEM_FLOW_CONTROL_NONE;
+    modem_dte_t *dte = esp_modem_dte_init(&config);
+    TEST_ASSERT_NOT_NULL(dte);
+    TEST_ASSERT_EQUAL(ESP_OK, uart_set_loop_back(config.port_num, true));
+    memset(dce, 0, sizeof(modem_dce_t));
+    dce->mode = MODEM_COMMAND_MODE;
+    dce->set_working_mode = test_set_working_mode;
+    dce->dte = dte;
+    dte->dce = dce;
+    return dte;
+}
+
+static esp_err_t test_ppp_receive(void *buffer, size_t len, void *context)
+{
+    test_rx_ctx_t *ctx = (test_rx_ctx_t *)context;
+    const uint8_t *data = (const uint8_t *)buffer;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != (uint8_t)(ctx->received + i)) {
+            ctx->errors++;
+        }
+    }
+    ctx->received += len;
+    return ESP_OK;
+}
+
+TEST_CASE("modem dte receives ppp data at line rate without loss", "[modem][stress]")
+{
+    modem_dce_t dce;
+    test_rx_ctx_t ctx = {0};
+    modem_dte_t *dte = test_dte_init(&dce);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_modem_set_rx_cb(dte, test_ppp_receive, &ctx));
+    TEST_ASSERT_EQUAL(ESP_OK, dte->change_mode(dte, MODEM_PPP_MODE));
+
+    static uint8_t chunk[1024];
+    test_start_hogs();
+    for (uint32_t sent = 0; sent < TEST_PPP_BYTES; sent += sizeof(chunk)) {
+        for (size_t i = 0; i < sizeof(chunk); i++) {
+            chunk[i] = (uint8_t)(sent + i);
+        }
+        TEST_ASSERT_EQUAL(sizeof(chunk), dte->send_data(dte, (const char *)chunk, sizeof(chunk)));
+    }
+    test_stop_hogs();
+    for (int i = 0; i < 100 && ctx.received < TEST_PPP_BYTES; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    esp_modem_dte_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_modem_get_dte_stats(dte, &stats));
+    printf("ppp: received %u/%u, fifo overflows %u, buffer full %u, lost %u\n", ctx.received, TEST_PPP_BYTES,
+           stats.fifo_overflows, stats.buffer_full, stats.bytes_lost);
+    dte->dce = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, dte->deinit(dte));
+    TEST_ASSERT_EQUAL(0, stats.bytes_lost);
+    TEST_ASSERT_EQUAL(TEST_PPP_BYTES, ctx.received);
+    TEST_ASSERT_EQUAL(0, ctx.errors);
+}
+
+static esp_err_t test_handle_urc(modem_dte_t *dte, const esp_modem_urc_t *urc, void *context)
+{
+    test_rx_ctx_t *ctx = (test_rx_ctx_t *)context;
+    int index = -1;
+    if (esp_modem_urc_get_int(urc, 0, &index) != ESP_OK || index != ctx->received) {
+        ctx->errors++;
+    }
+    ctx->received++;
+    return ESP_OK;
+}
+
+TEST_CASE("modem dte splits urc bursts beyond the pattern queue without loss", "[modem][stress]")
+{
+    modem_dce_t dce;
+    test_rx_ctx_t ctx = {0};
+    modem_dte_t *dte = test_dte_init(&dce);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_modem_add_urc_handler(dte, "+TEST", test_handle_urc, &ctx));
+
+    /* Many more lines than the pattern queue holds, arriving while the UART event task is starved */
+    static char burst[TEST_URC_LINES * 16];
+    int length = 0;
+    for (int i = 0; i < TEST_URC_LINES; i++) {
+        length += snprintf(burst + length, sizeof(burst) - length, "+TEST: %d\r\n", i);
+    }
+    test_start_hogs();
+    TEST_ASSERT_EQUAL(length, dte->send_data(dte, burst, length));
+    test_stop_hogs();
+    for (int i = 0; i < 100 && ctx.received < TEST_URC_LINES; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    esp_modem_dte_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_modem_get_dte_stats(dte, &stats));
+    printf("urc: received %u/%u, pattern overflows %u, buffer full %u, lost %u\n", ctx.received, TEST_URC_LINES,
+           stats.pattern_overflows, stats.buffer_full, stats.bytes_lost);
+    dte->dce = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, dte->deinit(dte));
+    TEST_ASSERT_EQUAL(0, stats.bytes_lost);
+    TEST_ASSERT_EQUAL(TEST_URC_LINES, ctx.received);
+    TEST_ASSERT_EQUAL(0, ctx.errors);
+}
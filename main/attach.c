@@ -0,0 +1,209 @@
+//
+//  Copyright © 2020 Stack Care Inc. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "iotc.h"
+
+#include "lte_poc.h"
+
+#define ATTACH_TOPIC "/devices/%s/attach"
+#define ATTACH_TOPIC_MAX (sizeof("/devices//attach") + ID_MAX)
+#define ATTACH_RETRY_MIN_S 1
+#define ATTACH_RETRY_MAX_S 60
+#define ATTACH_CACHE_TIME_S CONFIG_EXAMPLE_MQTT_ATTACH_CACHE_TIME
+
+typedef enum {
+    ATTACH_IDLE,
+    ATTACH_SENT,        // waiting for the PUBACK
+    ATTACH_WAITING,     // failed, a retry is scheduled
+    ATTACH_DONE,
+} attach_state_t;
+
+typedef struct {
+    char topic[ATTACH_TOPIC_MAX];
+    attach_state_t state;
+    uint8_t failures;
+    iotc_timed_task_handle_t retry;
+} attach_device_t;
+
+static const char *TAG = "Attach";
+
+// everything but attach_get_stats() runs in the MQTT task, from the iotc callbacks
+static attach_device_t s_devices[MAX_NUM_SENSORS];
+static int s_count = 0;
+static iotc_context_handle_t s_context = IOTC_INVALID_CONTEXT_HANDLE;
+// a PUBACK or retry carries the generation it was made in, those of an earlier connection are ignored
+static uint8_t s_generation = 0;
+static int s_pending = 0;
+static int64_t s_round_start_us;
+static bool s_was_attached = false;
+static int64_t s_closed_us;
+static attach_stats_t s_stats;
+
+static void *attach_tag(int index)
+{
+    return (void *)(intptr_t)((s_generation << 8) | index);
+}
+
+// the device of a tag, -1 if it is from an earlier generation
+static int attach_index(void *tag)
+{
+    intptr_t value = (intptr_t)tag;
+    if (((value >> 8) & 0xff) != s_generation || (value & 0xff) >= s_count) {
+        return -1;
+    }
+    return value & 0xff;
+}
+
+static void attach_send(int index);
+
+static void on_retry(const iotc_context_handle_t context_handle, const iotc_timed_task_handle_t timed_task_handle,
+                     void *user_data)
+{
+    int index = attach_index(user_data);
+    if (index < 0 || s_devices[index].state != ATTACH_WAITING) {
+        return;
+    }
+    s_devices[index].retry = IOTC_INVALID_TIMED_TASK_HANDLE;
+    attach_send(index);
+}
+
+static void attach_retry(int index, iotc_state_t state)
+{
+    attach_device_t *device = &s_devices[index];
+    if (device->failures < 8) {
+        device->failures++;
+    }
+    // doubled with each failure and spread by up to half, so a hub full of devices does not retry in lockstep
+    uint32_t delay_s = ATTACH_RETRY_MIN_S << (device->failures - 1);
+    if (delay_s > ATTACH_RETRY_MAX_S) {
+        delay_s = ATTACH_RETRY_MAX_S;
+    }
+    delay_s += esp_random() % (delay_s / 2 + 1);
+    device->state = ATTACH_WAITING;
+    device->retry = iotc_schedule_timed_task(s_context, on_retry, delay_s, 0, attach_tag(index));
+    s_stats.retries++;
+    ESP_LOGW(TAG, "%s failed: %d, retrying in %d s", device->topic, state, delay_s);
+    if (device->retry < 0) {
+        // stays pending until the next connection
+        ESP_LOGE(TAG, "failed to schedule the retry: %d", device->retry);
+    }
+}
+
+static void on_attach_ack(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state)
+{
+    int index = attach_index(data);
+    if (index < 0 || s_devices[index].state != ATTACH_SENT) {
+        return;
+    }
+    if (state != IOTC_STATE_OK) {
+        attach_retry(index, state);
+        return;
+    }
+    s_devices[index].state = ATTACH_DONE;
+    s_devices[index].failures = 0;
+    s_stats.attached++;
+    if (--s_pending == 0) {
+        uint32_t all_ms = (esp_timer_get_time() - s_round_start_us) / 1000;
+        s_stats.last_all_attached_ms = all_ms;
+        if (all_ms > s_stats.max_all_attached_ms) {
+            s_stats.max_all_attached_ms = all_ms;
+        }
+        boot_mark("devices attached");
+        ESP_LOGI(TAG, "all %d devices attached in %u ms", s_count, all_ms);
+    }
+    s_stats.pending = s_pending;
+}
+
+static void attach_send(int index)
+{
+    attach_device_t *device = &s_devices[index];
+    // the SDK copies topic and payload, the publish window keeps a full hub from flooding the link
+    iotc_state_t state = iotc_publish(s_context, device->topic, "{}", IOTC_MQTT_QOS_AT_LEAST_ONCE, on_attach_ack,
+                                      attach_tag(index));
+    if (state != IOTC_STATE_OK) {
+        attach_retry(index, state);
+        return;
+    }
+    device->state = ATTACH_SENT;
+}
+
+esp_err_t attach_set_devices(const char *const *device_ids, int count)
+{
+    if (count > MAX_NUM_SENSORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        int len = snprintf(s_devices[i].topic, sizeof(s_devices[i].topic), ATTACH_TOPIC, device_ids[i]);
+        if (len < 0 || len >= sizeof(s_devices[i].topic)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        s_devices[i].state = ATTACH_IDLE;
+        s_devices[i].failures = 0;
+        s_devices[i].retry = IOTC_INVALID_TIMED_TASK_HANDLE;
+    }
+    s_count = count;
+    s_was_attached = false;
+    s_stats.devices = count;
+    return ESP_OK;
+}
+
+void attach_start(iotc_context_handle_t context, bool session_present)
+{
+    s_context = context;
+    s_generation++;
+    int64_t now = esp_timer_get_time();
+    // the attachments of a resumed session, or of a connection lost only moments ago, are still in place
+    bool keep = s_was_attached &&
+                (session_present || now - s_closed_us < (int64_t)ATTACH_CACHE_TIME_S * 1000000);
+    s_pending = 0;
+    for (int i = 0; i < s_count; i++) {
+        if (!keep || s_devices[i].state != ATTACH_DONE) {
+            s_devices[i].state = ATTACH_IDLE;
+            s_pending++;
+        }
+    }
+    s_round_start_us = now;
+    s_stats.rounds++;
+    s_stats.cached += s_count - s_pending;
+    s_stats.pending = s_pending;
+    if (s_pending == 0) {
+        ESP_LOGI(TAG, "all %d devices still attached", s_count);
+        return;
+    }
+    ESP_LOGI(TAG, "attaching %d of %d devices", s_pending, s_count);
+    // all attaches go out together, the PUBACKs come back in one round trip
+    for (int i = 0; i < s_count; i++) {
+        if (s_devices[i].state == ATTACH_IDLE) {
+            attach_send(i);
+        }
+    }
+}
+
+void attach_stop()
+{
+    s_generation++;
+    for (int i = 0; i < s_count; i++) {
+        if (s_devices[i].retry >= 0) {
+            iotc_cancel_timed_task(s_devices[i].retry);
+            s_devices[i].retry = IOTC_INVALID_TIMED_TASK_HANDLE;
+        }
+        if (s_devices[i].state != ATTACH_DONE) {
+            s_devices[i].state = ATTACH_IDLE;
+        }
+    }
+    s_was_attached = true;
+    s_closed_us = esp_timer_get_time();
+}
+
+void attach_get_stats(attach_stats_t *stats)
+{
+    // written by the MQTT task, a counter read in the middle of an update is off by one at most
+    *stats = s_stats;
+}
@@ -0,0 +1,62 @@
+//
+//  Copyright © 2020 Stack Care Inc. All rights reserved.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "lte_poc.h"
+
+#define BOOT_MAX_MARKS 16
+
+typedef struct {
+    const char *name;
+    int64_t time_us;
+} boot_mark_t;
+
+static const char *TAG = "Boot";
+
+static boot_mark_t s_marks[BOOT_MAX_MARKS];
+static int s_mark_count = 0;
+static bool s_dumped = false;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// esp_timer starts with the application, the ROM and 2nd stage bootloader are not included
+void boot_mark(const char *name)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_mark_count < BOOT_MAX_MARKS) {
+        s_marks[s_mark_count].name = name;
+        s_marks[s_mark_count].time_us = now;
+        s_mark_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGD(TAG, "%s at %lld ms", name, now / 1000);
+}
+
+// prints the timeline once, later calls are ignored
+void boot_timeline_dump()
+{
+    portENTER_CRITICAL(&s_lock);
+    bool dumped = s_dumped;
+    s_dumped = true;
+    int count = s_mark_count;
+    portEXIT_CRITICAL(&s_lock);
+    if (dumped) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "~~~~ boot timeline ~~~~");
+    int64_t previous = 0;
+    for (int i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "%8lld ms  +%6lld ms  %s", s_marks[i].time_us / 1000,
+                 (s_marks[i].time_us - previous) / 1000, s_marks[i].name);
+        previous = s_marks[i].time_us;
+    }
+    ESP_LOGI(TAG, "~~~~~~~~~~~~~~~~~~~~~~~");
+}
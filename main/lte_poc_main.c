@@ -6,32 +6,63 @@
    software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
    CONDITIONS OF ANY KIND, either express or implied.
 */
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
 #include "mqtt_client.h"
 #include "esp_modem.h"
 #include "esp_modem_netif.h"
+#include "esp_modem_dce_cache.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+#include "esp_wifi.h"
+#endif
 #include "nvs_flash.h"
 #include "sim800.h"
 #include "bg96.h"
 
+#include "iotc_mqtt.h"
 #include "lte_poc.h"
 #include "stackcare_protobuf.pb-c.h"
 
 #define BROKER_URL "mqtt://mqtt.eclipse.org"
 #define TOPIC_MQTT_ZONE_STATUS "/devices/%s/events/zone-status"
+#define CONNECTION_WAIT_MS 60000
+/* Time each recovery stage gets to bring MQTT back before the next one is tried */
+#define RECOVERY_RECONNECT_BUDGET_MS 90000
+#define RECOVERY_TRANSPORT_BUDGET_MS 90000
+#define RECOVERY_REDIAL_BUDGET_MS 120000
+#define RECOVERY_MODEM_RESET_BUDGET_MS 240000
+#define PPP_STOP_WAIT_MS 5000
 
 static const char *TAG = "LTE_POC";
 static EventGroupHandle_t event_group = NULL;
 #if !CONFIG_EXAMPLE_USE_WIFI
 static const int CONNECT_BIT = BIT0;
 static const int STOP_BIT = BIT1;
+static const int REGISTERED_BIT = BIT3;
+static const int READY_BIT = BIT4;
+/* Packet domains the modem is registered in, one bit per esp_modem_network_domain_t */
+static uint32_t s_registered_domains = 0;
+/* For the recovery stages, which run in their own task */
+static modem_dte_t *s_dte = NULL;
+static modem_dce_t *s_dce = NULL;
+static void *s_modem_netif_adapter = NULL;
+/* Command mode is shared by app_main and the recovery stages, one of them at a time */
+static SemaphoreHandle_t s_command_lock = NULL;
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+static bool s_ppp_up = false;
+#endif
 #endif
+#if CONFIG_EXAMPLE_INCLUDE_ESP_MQTT_TEST
 static const int GOT_DATA_BIT = BIT2;
+#endif
 
 #if !CONFIG_EXAMPLE_USE_WIFI
 #if CONFIG_EXAMPLE_SEND_MSG
@@ -116,6 +147,27 @@ err:
 }
 #endif
 
+/* With Wi-Fi as a second transport, the selector decides which link the MQTT client uses */
+static void set_lte_link_state(bool up)
+{
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+    /* registered is not enough to carry traffic, that takes an address */
+    transport_set_link_state(TRANSPORT_LTE, up && s_ppp_up);
+#else
+    mqtt_set_link_state(up);
+#endif
+}
+
+/* Only a loss of the link MQTT runs on is an incident */
+static bool lte_carries_mqtt()
+{
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+    return transport_get_active() == TRANSPORT_LTE;
+#else
+    return true;
+#endif
+}
+
 static void modem_event_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
     switch (event_id) {
@@ -129,12 +181,160 @@ static void modem_event_handler(void *event_handler_arg, esp_event_base_t event_
     case ESP_MODEM_EVENT_UNKNOWN:
         ESP_LOGW(TAG, "Unknow line received: %s", (char *)event_data);
         break;
+    case ESP_MODEM_EVENT_NETWORK_REG: {
+        esp_modem_network_reg_t *reg = (esp_modem_network_reg_t *)event_data;
+        ESP_LOGI(TAG, "Network registration changed, domain: %d, stat: %d", reg->domain, reg->stat);
+        if (reg->domain != ESP_MODEM_NETWORK_DOMAIN_CS) {
+            /* An LTE-only modem may report +CGREG as not registered, either packet domain will do */
+            if (reg->stat == ESP_MODEM_NETWORK_REG_HOME || reg->stat == ESP_MODEM_NETWORK_REG_ROAMING) {
+                s_registered_domains |= BIT(reg->domain);
+            } else {
+                s_registered_domains &= ~BIT(reg->domain);
+            }
+            if (s_registered_domains) {
+                xEventGroupSetBits(event_group, REGISTERED_BIT);
+            } else {
+                xEventGroupClearBits(event_group, REGISTERED_BIT);
+            }
+            set_lte_link_state(s_registered_domains != 0);
+        }
+        break;
+    }
+    case ESP_MODEM_EVENT_LINK_LOST:
+        ESP_LOGW(TAG, "Modem link lost, reason: %d", *(esp_modem_link_lost_reason_t *)event_data);
+        set_lte_link_state(false);
+        if (lte_carries_mqtt()) {
+            recovery_report_down(RECOVERY_STAGE_LINK_REDIAL, "link lost");
+        }
+        break;
+    case ESP_MODEM_EVENT_LINK_RESTORED:
+        ESP_LOGI(TAG, "Modem link restored");
+        set_lte_link_state(s_registered_domains != 0);
+        if (lte_carries_mqtt() && mqtt_wait_connected(0) == ESP_OK) {
+            /* the outage was shorter than the MQTT keepalive */
+            recovery_report_up();
+        }
+        break;
+    case ESP_MODEM_EVENT_READY:
+        ESP_LOGI(TAG, "Modem ready: %s", (char *)event_data);
+        xEventGroupSetBits(event_group, READY_BIT);
+        break;
     default:
         break;
     }
 }
+
+/**
+ * @brief Refresh the cached modem identity while waiting for registration
+ *
+ * The AT channel is idle until the modem registers and PPP is not up yet,
+ * so the refresh neither delays the dial nor holds back PPP frames. The boot
+ * used the cached values, a change is picked up by the next boot.
+ */
+static void refresh_identity(modem_dce_t *dce)
+{
+    xSemaphoreTake(s_command_lock, portMAX_DELAY);
+    if (dce->get_identity(dce) == ESP_OK) {
+        esp_modem_dce_cache_store(dce);
+    }
+    xSemaphoreGive(s_command_lock);
+}
+
+static void start_link_monitor()
+{
+#if CONFIG_EXAMPLE_MODEM_LINK_MONITOR
+    /* a dead bearer shows within seconds instead of at the next MQTT keepalive */
+    esp_modem_link_monitor_config_t link_monitor_config = ESP_MODEM_LINK_MONITOR_DEFAULT_CONFIG();
+    link_monitor_config.max_interval_ms = CONFIG_EXAMPLE_MODEM_LINK_MONITOR_MAX_INTERVAL_MS;
+    if (esp_modem_netif_start_link_monitor(s_modem_netif_adapter, &link_monitor_config) != ESP_OK) {
+        ESP_LOGW(TAG, "link monitor not started");
+    }
 #endif
+}
 
+/* Take the PPP session down, the modem is left in command mode if it still answers */
+static esp_err_t stop_link()
+{
+    esp_modem_netif_stop_link_monitor(s_modem_netif_adapter);
+    xEventGroupClearBits(event_group, CONNECT_BIT | STOP_BIT);
+    esp_err_t err = esp_modem_stop_ppp(s_dte);
+    xEventGroupWaitBits(event_group, STOP_BIT, pdTRUE, pdTRUE, PPP_STOP_WAIT_MS / portTICK_PERIOD_MS);
+    return err;
+}
+
+static esp_err_t start_link()
+{
+    if (esp_modem_start_ppp(s_dte) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    EventBits_t bits = xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE,
+                                           CONNECTION_WAIT_MS / portTICK_PERIOD_MS);
+    if (!(bits & CONNECT_BIT)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    start_link_monitor();
+    return ESP_OK;
+}
+
+/**
+ * @brief Recovery stage: dial the data call again
+ *
+ * Clears a PDP context or PPP session the network dropped without telling.
+ */
+static esp_err_t recover_link_redial()
+{
+    xSemaphoreTake(s_command_lock, portMAX_DELAY);
+    esp_err_t err = stop_link();
+    if (err == ESP_OK || s_dce->mode == MODEM_COMMAND_MODE) {
+        err = start_link();
+    }
+    /* otherwise the modem does not leave data mode, only a restart helps */
+    xSemaphoreGive(s_command_lock);
+    return err;
+}
+
+/**
+ * @brief Recovery stage: restart the modem and dial again once it is registered
+ *
+ * AT+CFUN=1,1 restarts the module firmware, a hung baseband or a stuck attach is cleared by it.
+ */
+static esp_err_t recover_modem_reset_locked()
+{
+    stop_link();
+    if (s_dce->mode != MODEM_COMMAND_MODE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xEventGroupClearBits(event_group, READY_BIT | REGISTERED_BIT);
+    if (s_dce->reset(s_dce) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    xEventGroupWaitBits(event_group, READY_BIT, pdTRUE, pdTRUE,
+                        CONFIG_EXAMPLE_MODEM_READY_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (esp_modem_wait_ready(s_dte, CONFIG_EXAMPLE_MODEM_READY_TIMEOUT_MS) != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    /* echo and registration reports are not part of the stored profile */
+    if (s_dce->echo_mode(s_dce, false) != ESP_OK || s_dce->set_network_reg_report(s_dce, true) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    EventBits_t bits = xEventGroupWaitBits(event_group, REGISTERED_BIT, pdFALSE, pdTRUE,
+                                           CONFIG_EXAMPLE_MODEM_REGISTRATION_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (!(bits & REGISTERED_BIT)) {
+        ESP_LOGW(TAG, "not registered after modem reset, dialing anyway");
+    }
+    return start_link();
+}
+
+static esp_err_t recover_modem_reset()
+{
+    xSemaphoreTake(s_command_lock, portMAX_DELAY);
+    esp_err_t err = recover_modem_reset_locked();
+    xSemaphoreGive(s_command_lock);
+    return err;
+}
+#endif
+
+#if CONFIG_EXAMPLE_INCLUDE_ESP_MQTT_TEST
 static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 {
     esp_mqtt_client_handle_t client = event->client;
@@ -174,6 +374,7 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
     }
     return ESP_OK;
 }
+#endif
 
 #if !CONFIG_EXAMPLE_USE_WIFI
 static void on_ppp_changed(void *arg, esp_event_base_t event_base,
@@ -208,10 +409,26 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "Name Server2: " IPSTR, IP2STR(&dns_info.ip.u_addr.ip4));
         ESP_LOGI(TAG, "~~~~~~~~~~~~~~");
         xEventGroupSetBits(event_group, CONNECT_BIT);
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+        s_ppp_up = true;
+#endif
+        set_lte_link_state(true);
 
         ESP_LOGI(TAG, "GOT ip event!!!");
     } else if (event_id == IP_EVENT_PPP_LOST_IP) {
         ESP_LOGI(TAG, "Modem Disconnect from PPP Server");
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+        s_ppp_up = false;
+#endif
+        set_lte_link_state(false);
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+    } else if (event_id == IP_EVENT_STA_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        ESP_LOGI(TAG, "Wi-Fi IP    : " IPSTR, IP2STR(&event->ip_info.ip));
+        transport_set_link_state(TRANSPORT_WIFI, true);
+    } else if (event_id == IP_EVENT_STA_LOST_IP) {
+        transport_set_link_state(TRANSPORT_WIFI, false);
+#endif
     } else if (event_id == IP_EVENT_GOT_IP6) {
         ESP_LOGI(TAG, "GOT IPv6 event!");
 
@@ -219,6 +436,17 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "Got IPv6 address " IPV6STR, IPV62STR(event->ip6_info.ip));
     }
 }
+
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+static void on_wifi_event(void *arg, esp_event_base_t event_base,
+                          int32_t event_id, void *event_data)
+{
+    /* the address outlives the association for a while, traffic does not */
+    if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        transport_set_link_state(TRANSPORT_WIFI, false);
+    }
+}
+#endif
 #endif
 
 static uint64_t get_epoch_milli()
@@ -233,7 +461,7 @@ static uint64_t get_epoch_milli()
     return result;
 }
 
-static void publish_zone_status()
+static void publish_zone_status(uplink_class_t class)
 {
     char *publish_topic = NULL;
     asprintf(&publish_topic, TOPIC_MQTT_ZONE_STATUS, DEVICE_ID);
@@ -248,14 +476,124 @@ static void publish_zone_status()
     msg_len = zone_status__get_packed_size(&event);
     msg_buf = (uint8_t *) malloc(msg_len);
     zone_status__pack(&event, msg_buf);
-    mqtt_publish_data(publish_topic, msg_buf, msg_len);
+    uplink_publish(publish_topic, msg_buf, msg_len, class);
     free(msg_buf);
     free(publish_topic);
-    ESP_LOGI(TAG, "MQTT published a zone status event");
+    ESP_LOGI(TAG, "MQTT queued a zone status event");
+}
+
+#if !CONFIG_EXAMPLE_USE_WIFI
+static void log_modem_cmd_stats(modem_dte_t *dte)
+{
+    esp_modem_cmd_stats_t *stats = calloc(ESP_MODEM_CMD_STATS_MAX_COMMANDS, sizeof(esp_modem_cmd_stats_t));
+    if (stats == NULL) {
+        return;
+    }
+    uint32_t count = 0;
+    esp_modem_get_cmd_stats(dte, stats, ESP_MODEM_CMD_STATS_MAX_COMMANDS, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "%-15s: %d sent, %d timeouts, %d slow, avg %d p50 %d p99 %d max %d ms, timeout %d/%d ms",
+                 stats[i].command, stats[i].count, stats[i].timeouts, stats[i].slow,
+                 (uint32_t)(stats[i].total_ms / stats[i].count), esp_modem_cmd_stats_percentile(&stats[i], 50),
+                 esp_modem_cmd_stats_percentile(&stats[i], 99), stats[i].max_ms, stats[i].timeout_ms,
+                 stats[i].nominal_ms);
+    }
+    free(stats);
+}
+
+static void log_link_stats(void *modem_netif_adapter)
+{
+    esp_modem_link_stats_t stats;
+    if (esp_modem_netif_get_link_stats(modem_netif_adapter, &stats) != ESP_OK) {
+        return;
+    }
+    ESP_LOGI(TAG, "link: %s, rtt %d ms (min %d, max %d, jitter %d), loss %d.%d %%, %d echoes, %d down",
+             stats.up ? "up" : "down", stats.srtt_ms, stats.rtt_min_ms, stats.rtt_max_ms, stats.jitter_ms,
+             stats.loss_permille / 10, stats.loss_permille % 10, stats.sent, stats.link_down);
+}
+#endif
+
+static void log_recovery_stats()
+{
+    recovery_stats_t stats;
+    recovery_get_stats(&stats);
+    ESP_LOGI(TAG, "recovery: %d incidents, mttr last %d avg %d max %d ms, last by %s%s", stats.incidents,
+             stats.mttr_last_ms, stats.mttr_avg_ms, stats.mttr_max_ms, recovery_stage_name(stats.last_stage),
+             stats.active ? ", recovering" : "");
+    for (int i = 0; i < RECOVERY_STAGE_MAX; i++) {
+        if (stats.recovered[i]) {
+            ESP_LOGI(TAG, "recovery: %d by %s", stats.recovered[i], recovery_stage_name(i));
+        }
+    }
+}
+
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+static void log_transport_stats()
+{
+    transport_stats_t stats;
+    transport_get_stats(&stats);
+    ESP_LOGI(TAG, "transport: on %s, %d failovers, %d failbacks, failover last %d max %d ms",
+             transport_name(stats.active), stats.failovers, stats.failbacks, stats.failover_last_ms,
+             stats.failover_max_ms);
+    for (int i = 0; i < TRANSPORT_MAX; i++) {
+        ESP_LOGI(TAG, "transport: %s %s%s, mqtt %d/%d bytes, %d probes (%d failed, %d bytes), handshake %d ms",
+                 transport_name(i), stats.up[i] ? "up" : "down", stats.healthy[i] ? " healthy" : "",
+                 (uint32_t)stats.sent[i], (uint32_t)stats.received[i], stats.probes[i], stats.probe_failures[i],
+                 (uint32_t)stats.probe_bytes[i], stats.handshake_ms[i]);
+    }
+}
+#endif
+
+static void log_publish_stats()
+{
+    iotc_mqtt_publish_stats_t stats;
+    if (mqtt_get_publish_stats(&stats) != ESP_OK) {
+        return;
+    }
+    ESP_LOGI(TAG, "publish: %d acked, srtt %d var %d rto %d ms, rtt min %d max %d ms, %d timeouts, %d resent",
+             stats.acked, stats.srtt_ms, stats.rttvar_ms, stats.rto_ms, stats.min_rtt_ms, stats.max_rtt_ms,
+             stats.timeouts, stats.resent);
+    ESP_LOGI(TAG, "publish window: %d in flight, %d queued, %d refused", stats.in_flight, stats.queued,
+             stats.refused);
+    static const char *class_names[IOTC_MQTT_PRIORITY_COUNT] = { "urgent", "normal", "bulk" };
+    for (int i = 0; i < IOTC_MQTT_PRIORITY_COUNT; i++) {
+        // bucket b holds the delays below 16 << 2b ms
+        const uint32_t *delay = stats.queue_delay[i];
+        ESP_LOGI(TAG, "queue delay %s: <16 %d, <64 %d, <256 %d, <1k %d, <4k %d, <16k %d, <64k %d, more %d, max %d ms",
+                 class_names[i], delay[0], delay[1], delay[2], delay[3], delay[4], delay[5], delay[6], delay[7],
+                 stats.max_queue_delay_ms[i]);
+    }
+}
+
+static void log_connect_stats()
+{
+    mqtt_connect_stats_t stats;
+    mqtt_get_connect_stats(&stats);
+    ESP_LOGI(TAG, "mqtt ready: %d connects, %d resumed, last %d avg %d max %d ms", stats.connects, stats.resumed,
+             stats.last_ready_ms, stats.avg_ready_ms, stats.max_ready_ms);
+}
+
+static void log_attach_stats()
+{
+    attach_stats_t stats;
+    attach_get_stats(&stats);
+    ESP_LOGI(TAG, "attach: %d devices, %d pending, %d acked, %d retries, %d cached, all attached last %d max %d ms",
+             stats.devices, stats.pending, stats.attached, stats.retries, stats.cached, stats.last_all_attached_ms,
+             stats.max_all_attached_ms);
+}
+
+static void log_uplink_stats()
+{
+    uplink_stats_t stats;
+    uplink_get_stats(&stats);
+    ESP_LOGI(TAG, "uplink: %d wakes (%.1f/h), radio on %d s, sent %d alarm %d normal, dropped %d, max hold %d ms",
+             stats.wakes, stats.wakes_per_hour, (uint32_t)(stats.radio_on_ms / 1000),
+             stats.sent[UPLINK_CLASS_ALARM], stats.sent[UPLINK_CLASS_NORMAL], stats.dropped, stats.max_hold_ms);
 }
 
 void app_main(void)
 {
+    boot_mark("app_main");
     //Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -266,9 +604,6 @@ void app_main(void)
 
 #if !CONFIG_EXAMPLE_USE_WIFI
 
-    ESP_LOGI(TAG, "wait for 30 seconds as a work-around for crashes in LTE mode");
-    vTaskDelay(30000 / portTICK_PERIOD_MS);
-
 #if CONFIG_LWIP_PPP_PAP_SUPPORT
     esp_netif_auth_type_t auth_type = NETIF_PPP_AUTHTYPE_PAP;
 #elif CONFIG_LWIP_PPP_CHAP_SUPPORT
@@ -281,6 +616,9 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &on_ip_event, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, &on_ppp_changed, NULL));
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_event, NULL));
+#endif
 
 #endif
 
@@ -291,12 +629,36 @@ void app_main(void)
     esp_netif_config_t cfg = ESP_NETIF_DEFAULT_PPP();
     esp_netif_t *esp_netif = esp_netif_new(&cfg);
     assert(esp_netif);
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+    /* Wi-Fi associates while the modem boots, whichever link is up first carries the connection */
+    esp_netif_t *wifi_netif = wifi_start_sta();
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT_PREFER_LTE
+    transport_t preferred = TRANSPORT_LTE;
+#else
+    transport_t preferred = TRANSPORT_WIFI;
+#endif
+    ESP_ERROR_CHECK(transport_init(preferred, wifi_netif, esp_netif, CONFIG_EXAMPLE_DUAL_TRANSPORT_PROBE_INTERVAL_MS));
+#endif
 
     /* create dte object */
     esp_modem_dte_config_t config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    /* Start at the baud rate negotiated last time, the modem keeps it in its profile */
+    esp_modem_load_baud_rate(&config.baud_rate);
     modem_dte_t *dte = esp_modem_dte_init(&config);
+    s_dte = dte;
+    s_command_lock = xSemaphoreCreateMutex();
+    assert(s_command_lock);
     /* Register event handler */
     ESP_ERROR_CHECK(esp_modem_set_event_handler(dte, modem_event_handler, ESP_EVENT_ANY_ID, NULL));
+    /* Wait for the modem to boot instead of sleeping for the worst case */
+    uint32_t baud_rate = config.baud_rate;
+    if (esp_modem_wait_ready(dte, CONFIG_EXAMPLE_MODEM_READY_TIMEOUT_MS) != ESP_OK) {
+        /* Follow the modem if NVS and modem profile disagree */
+        if (esp_modem_probe_baud_rate(dte, &baud_rate) != ESP_OK) {
+            ESP_LOGW(TAG, "modem does not answer at any baud rate");
+        }
+    }
+    boot_mark("modem ready");
     /* create dce object */
 #if CONFIG_EXAMPLE_MODEM_DEVICE_SIM800
     modem_dce_t *dce = sim800_init(dte);
@@ -305,11 +667,35 @@ void app_main(void)
 #else
 #error "Unsupported DCE"
 #endif
-    ESP_ERROR_CHECK(dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE));
-    ESP_ERROR_CHECK(dce->store_profile(dce));
-    /* Print Module ID, Operator, IMEI, IMSI */
+    assert(dce);
+    s_dce = dce;
+    boot_mark("modem identified");
+    /* AT&W writes the modem flash, skip it if the profile is known to be up to date */
+    if (!esp_modem_dce_cache_profile_stored(dce, config.flow_control)) {
+        ESP_ERROR_CHECK(dce->set_flow_ctrl(dce, config.flow_control));
+        ESP_ERROR_CHECK(dce->store_profile(dce));
+        esp_modem_dce_cache_set_profile(dce, config.flow_control);
+    }
+    /* Upgrade the link, the modem profile is stored again once the rate is settled */
+    if (esp_modem_negotiate_baud_rate(dte, CONFIG_EXAMPLE_UART_MODEM_MAX_BAUD_RATE, &baud_rate) != ESP_OK) {
+        ESP_LOGW(TAG, "baud rate negotiation failed");
+    }
+    ESP_LOGI(TAG, "Baud rate: %d", baud_rate);
+    /* Registration is reported as ESP_MODEM_EVENT_NETWORK_REG, including the current state */
+    ESP_ERROR_CHECK(dce->set_network_reg_report(dce, true));
+#if CONFIG_EXAMPLE_MODEM_PSM
+    if (dce->set_psm(dce, true, CONFIG_EXAMPLE_MODEM_PSM_TAU_S, CONFIG_EXAMPLE_MODEM_PSM_ACTIVE_TIME_S) != ESP_OK) {
+        ESP_LOGW(TAG, "PSM is not available");
+    }
+#endif
+#if CONFIG_EXAMPLE_MODEM_EDRX
+    if (dce->set_edrx(dce, true, CONFIG_EXAMPLE_MODEM_EDRX_CYCLE_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "eDRX is not available");
+    }
+#endif
+    /* Print Module ID, IMEI, IMSI. The operator is looked up once registered */
+    ESP_LOGI(TAG, "ICCID: %s", dce->iccid);
     ESP_LOGI(TAG, "Module: %s", dce->name);
-    ESP_LOGI(TAG, "Operator: %s", dce->oper);
     ESP_LOGI(TAG, "IMEI: %s", dce->imei);
     ESP_LOGI(TAG, "IMSI: %s", dce->imsi);
     /* Get signal quality */
@@ -320,21 +706,65 @@ void app_main(void)
     uint32_t voltage = 0, bcs = 0, bcl = 0;
     ESP_ERROR_CHECK(dce->get_battery_status(dce, &bcs, &bcl, &voltage));
     ESP_LOGI(TAG, "Battery voltage: %d mV", voltage);
+    /* Dial once the packet domain is registered, ATD fails before that */
+    if (!(xEventGroupGetBits(event_group) & REGISTERED_BIT)) {
+        refresh_identity(dce);
+    }
+    EventBits_t bits = xEventGroupWaitBits(event_group, REGISTERED_BIT, pdFALSE, pdTRUE,
+                                           CONFIG_EXAMPLE_MODEM_REGISTRATION_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (bits & REGISTERED_BIT) {
+        boot_mark("registered");
+        /* answered right away now, and PPP is not up yet to be held back by it */
+        xSemaphoreTake(s_command_lock, portMAX_DELAY);
+        if (dce->get_operator_name(dce) == ESP_OK) {
+            ESP_LOGI(TAG, "Operator: %s", dce->oper);
+        }
+        xSemaphoreGive(s_command_lock);
+    } else {
+        ESP_LOGW(TAG, "not registered after %d ms, dialing anyway", CONFIG_EXAMPLE_MODEM_REGISTRATION_TIMEOUT_MS);
+    }
     /* setup PPPoS network parameters */
     esp_netif_ppp_set_auth(esp_netif, auth_type, CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME, CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD);
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+    /* Everything PPP, lwIP, mbedTLS and the IoT Core SDK need is allocated after this point */
+    uint32_t heap_before_ppp = esp_get_free_heap_size();
+    int64_t ppp_start_us = esp_timer_get_time();
+#endif
     void *modem_netif_adapter = esp_modem_netif_setup(dte);
+    s_modem_netif_adapter = modem_netif_adapter;
     esp_modem_netif_set_default_handlers(modem_netif_adapter, esp_netif);
     /* attach the modem to the network interface */
     esp_netif_attach(esp_netif, modem_netif_adapter);
     /* Wait for IP address */
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+    /* go on over Wi-Fi if the modem takes long, the selector moves to LTE once it is up */
+    bits = xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE, CONNECTION_WAIT_MS / portTICK_PERIOD_MS);
+    if (bits & CONNECT_BIT) {
+        boot_mark("ppp up");
+        start_link_monitor();
+    } else {
+        /* no address to watch yet, the monitor starts with the next start_link() */
+        ESP_LOGW(TAG, "no PPP address after %d ms, going on over %s", CONNECTION_WAIT_MS,
+                 transport_name(transport_get_active()));
+        boot_mark("ppp pending");
+    }
+#else
     xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    boot_mark("ppp up");
+    start_link_monitor();
+#endif
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+    uint32_t ppp_up_ms = (esp_timer_get_time() - ppp_start_us) / 1000;
+#endif
 #else
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
     wifi_init_sta();
 #endif
 
     obtain_time();
+    boot_mark("time set");
 
+#if CONFIG_EXAMPLE_INCLUDE_ESP_MQTT_TEST
     // ESP MQTT tests
     /* Config MQTT */
     esp_mqtt_client_config_t mqtt_config = {
@@ -346,6 +776,7 @@ void app_main(void)
     xEventGroupWaitBits(event_group, GOT_DATA_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
     esp_mqtt_client_destroy(mqtt_client);
     ESP_LOGI(TAG, "ESP-IDF native MQTT test is done");
+#endif
 
     ESP_LOGI(TAG, "starting Google IoT core MQTT and other tests...");
 
@@ -353,17 +784,59 @@ void app_main(void)
     bool do_mqtt_test = true;
 
     int test_count = 0;
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+    bench_result_t ppp_bench = { .name = "PPP + IoT Core SDK", .cpu_permille = -1 };
+#endif
 
     if (do_mqtt_test) {
+        /* the cheapest stage goes first, each gets its budget before the next one is tried */
+        recovery_set_action(RECOVERY_STAGE_MQTT_RECONNECT, NULL, RECOVERY_RECONNECT_BUDGET_MS);
+        recovery_set_action(RECOVERY_STAGE_TRANSPORT_RESET, mqtt_reconnect, RECOVERY_TRANSPORT_BUDGET_MS);
+#if !CONFIG_EXAMPLE_USE_WIFI
+        recovery_set_action(RECOVERY_STAGE_LINK_REDIAL, recover_link_redial, RECOVERY_REDIAL_BUDGET_MS);
+        recovery_set_action(RECOVERY_STAGE_MODEM_RESET, recover_modem_reset, RECOVERY_MODEM_RESET_BUDGET_MS);
+#endif
+        ESP_ERROR_CHECK(recovery_init());
         mqtt_init_iotc();
+        int64_t mqtt_start_us = esp_timer_get_time();
         mqtt_start();
         ESP_LOGI(TAG, "IoT Core MQTT is started");
+        if (mqtt_wait_connected(CONNECTION_WAIT_MS) != ESP_OK) {
+            ESP_LOGW(TAG, "IoT Core MQTT is not connected yet");
+        }
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+        uint32_t connect_ms = ppp_up_ms + (esp_timer_get_time() - mqtt_start_us) / 1000;
+        bench_run(ppp_bench.name, mqtt_publish_data_wait, CONFIG_EXAMPLE_TRANSPORT_BENCH_COUNT,
+                  CONFIG_EXAMPLE_TRANSPORT_BENCH_PAYLOAD_SIZE, heap_before_ppp, &ppp_bench);
+        ppp_bench.connect_ms = connect_ms;
+        bench_log(&ppp_bench);
+#else
+        (void)mqtt_start_us;
+#endif
+        ESP_ERROR_CHECK(uplink_init(CONFIG_EXAMPLE_UPLINK_BATCH_INTERVAL_MS, CONFIG_EXAMPLE_UPLINK_ACTIVE_TAIL_MS));
     }
 
     while (test_count < CONFIG_EXAMPLE_NUM_TEST_MESSAGES) {
         if (do_mqtt_test) {
+            // the status after boot is reported right away, the rest are batched
+            publish_zone_status(test_count == 0 ? UPLINK_CLASS_ALARM : UPLINK_CLASS_NORMAL);
+            if (test_count % 10 == 9) {
+                log_uplink_stats();
+                log_publish_stats();
+                log_connect_stats();
+                log_attach_stats();
+                log_recovery_stats();
+#if !CONFIG_EXAMPLE_USE_WIFI
+                log_link_stats(modem_netif_adapter);
+#endif
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+                log_transport_stats();
+#endif
+            }
+            if (test_count == 0) {
+                boot_mark("first publish");
+            }
             vTaskDelay(10000 / portTICK_PERIOD_MS);
-            publish_zone_status();
         }
 
 #if CONFIG_EXAMPLE_INCLUDE_HTTP_TEST
@@ -377,17 +850,44 @@ void app_main(void)
     }
 
     if (do_mqtt_test) {
+        // send what is still held back before the connection goes down
+        uplink_drain(CONNECTION_WAIT_MS);
+        log_uplink_stats();
+        log_publish_stats();
+        /* the shutdown below is not an incident */
+        recovery_stop();
+        log_recovery_stats();
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+        /* no failover while the connection is taken down */
+        transport_stop();
+        log_transport_stats();
+#endif
         mqtt_stop();
     }
 
 #if !CONFIG_EXAMPLE_USE_WIFI
+    log_modem_cmd_stats(dte);
+    log_link_stats(modem_netif_adapter);
     ESP_LOGI(TAG, "taking LTE down...");
+    /* recovery is stopped, the modem is ours until it is powered down */
+    xSemaphoreTake(s_command_lock, portMAX_DELAY);
+    /* the echoes stop before the session does */
+    esp_modem_netif_stop_link_monitor(modem_netif_adapter);
     /* Exit PPP mode */
     ESP_ERROR_CHECK(esp_modem_stop_ppp(dte));
     /* Destroy the netif adapter withe events, which internally frees also the esp-netif instance */
     esp_modem_netif_clear_default_handlers(modem_netif_adapter);
     esp_modem_netif_teardown(modem_netif_adapter);
     xEventGroupWaitBits(event_group, STOP_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+    /* The modem stack needs command mode, so it runs once PPP is down */
+    bench_result_t modem_bench;
+    if (bench_run_modem_mqtt(dce, CONFIG_EXAMPLE_TRANSPORT_BENCH_COUNT,
+                             CONFIG_EXAMPLE_TRANSPORT_BENCH_PAYLOAD_SIZE, &modem_bench) == ESP_OK) {
+        bench_log(&ppp_bench);
+        bench_log(&modem_bench);
+    }
+#endif
 #if CONFIG_EXAMPLE_SEND_MSG
     const char *message = "Welcome to ESP32!";
     ESP_ERROR_CHECK(example_send_message_text(dce, CONFIG_EXAMPLE_SEND_MSG_PEER_PHONE_NUMBER, message));
@@ -397,6 +897,7 @@ void app_main(void)
     ESP_ERROR_CHECK(dce->power_down(dce));
     ESP_LOGI(TAG, "Power down");
     ESP_ERROR_CHECK(dce->deinit(dce));
+    xSemaphoreGive(s_command_lock);
     ESP_ERROR_CHECK(dte->deinit(dte));
     ESP_LOGI(TAG, "LTE is taken down now");
 #endif
@@ -7,11 +7,13 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "iotc.h"
 #include "iotc_jwt.h"
 #include "esp_system.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
@@ -22,9 +24,7 @@
 #define JWT_EXPIRATION_PERIOD 86400 // 24 hours. This is the maximum allowed according to doc
 
 #define IOTC_UNUSED(x) (void)(x)
-#define DEVICE_PATH "projects/%s/locations/%s/registries/%s/devices/%s"
 #define SUBSCRIBE_TOPIC_COMMAND "/devices/%s/commands/#"
-#define SUBSCRIBE_TOPIC_COMMAND_NO_SUFFIX "/devices/%s/commands"
 #define SUBSCRIBE_TOPIC_CONFIG "/devices/%s/config"
 #define TOPIC_MQTT_MOTION "/devices/%s/events/mqtt-motion"
 #define TOPIC_MQTT_HEARTBEAT "/devices/%s/events/mqtt-heartbeat"
@@ -34,7 +34,9 @@
 #define KEEPALIVE_TIMEOUT 180 //seconds
 
 #define OFFLINE_THRESHOLD 10
-#define OFFLINE_REBOOT_WAIT (30 * 60) // 30 minutes
+#define CALLBACK_QUEUE_LEN 8
+#define PUBLISH_WINDOW CONFIG_EXAMPLE_MQTT_PUBLISH_WINDOW
+#define PUBLISH_QUEUE CONFIG_EXAMPLE_MQTT_PUBLISH_QUEUE
 
 typedef enum {
     SS_MQTT_UNKNOWN,
@@ -45,31 +47,63 @@ typedef enum {
     SS_MQTT_CONNECTED
 } ss_mqtt_state_t;
 
+// the user_data of each subscription, the SDK hands a message to the subscription it matched
+typedef enum {
+    SUB_COMMAND = 1,
+    SUB_CONFIG,
+} mqtt_subscription_t;
+
 static const char *TAG = "Mqtt";
 
 static ss_mqtt_state_t s_mqtt_state = SS_MQTT_NOT_ACTIVATED;
 
+static const int CONNECTED_BIT = BIT0;
+static const int PUBACK_BIT = BIT1;
+static const int WRITABLE_BIT = BIT2;
+static const int SUBMITTABLE_BIT = BIT3;
+
 static TaskHandle_t s_control_task = NULL;
+static TaskHandle_t s_drain_task = NULL;
+static QueueHandle_t s_callback_jobs = NULL;
+static EventGroupHandle_t s_state_events = NULL;
 static bool s_mqtt_running = false;
 static bool s_is_connected = false;
 static bool s_is_offline = false;
+static bool s_window_full = false;
+static bool s_link_up = true;
+static bool s_reconnect = false;
 static time_t s_offline_time;
-static char *s_dev_id_list[MAX_NUM_SENSORS];
-static int s_dev_num;
+// guards s_is_offline and s_offline_time, check_offline() runs on the publishing tasks too
+static portMUX_TYPE s_offline_lock = portMUX_INITIALIZER_UNLOCKED;
 
 static HubInfo s_hub_info;
 static char *s_priv_key = NULL;
 static char *s_jwt_token = NULL;
 static int s_publish_count = 0;
 static int s_publish_confirmed = 0;
+static bool s_got_puback = false;
+static volatile int s_wait_pid = -1;
+static volatile iotc_state_t s_wait_state;
 static char *s_topic_command;
-static char *s_topic_command_no_suffix;
 static char *s_topic_config;
 
+// connect to ready: from the connect request until the subscriptions are acknowledged
+static int64_t s_connect_start_us = 0;
+static int s_subacks_pending = 0;
+static bool s_subscribed = false;   // granted on this context, kept by the broker with a persistent session
+static mqtt_connect_stats_t s_connect_stats;
+static uint64_t s_ready_total_ms = 0;
+
 static iotc_context_handle_t s_iotc_context = IOTC_INVALID_CONTEXT_HANDLE;
 static iotc_mqtt_qos_t s_iotc_qos = IOTC_MQTT_QOS_AT_LEAST_ONCE;
 
 static void mqtt_task();
+static void check_offline();
+static void on_writable(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state);
+static void on_submittable(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state);
+static void callback_task(void *param);
+static void mqtt_callback_executor(iotc_callback_job_t *job, iotc_sub_call_type_t call_type, void *executor_data);
+static uint8_t mqtt_callback_executor_takes(iotc_sub_call_type_t call_type, void *executor_data);
 static void iotc_mqttlogic_subscribe_callback(iotc_context_handle_t in_context_handle, iotc_sub_call_type_t call_type, const iotc_sub_call_params_t * const params, iotc_state_t state, void *user_data);
 //static void on_connection_state_changed(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state);
 
@@ -105,7 +139,18 @@ static void ss_set_mqtt_state(ss_mqtt_state_t value)
 {
     ss_mqtt_state_t old = s_mqtt_state;
     s_mqtt_state = value;
+    if (value == SS_MQTT_CONNECTED) {
+        xEventGroupSetBits(s_state_events, CONNECTED_BIT);
+    } else {
+        xEventGroupClearBits(s_state_events, CONNECTED_BIT);
+    }
     ESP_LOGI(TAG, "mqtt state changed. %s --> %s", mqtt_state_name(old), mqtt_state_name(value));
+    if (value == SS_MQTT_CONNECTED) {
+        recovery_report_up();
+    } else if (value == SS_MQTT_DISCONNECTED_RETRYING) {
+        recovery_report_down(RECOVERY_STAGE_MQTT_RECONNECT, "mqtt disconnected");
+    }
+    transport_report_mqtt(value == SS_MQTT_CONNECTED);
 }
 
 static esp_err_t s_create_jwt()
@@ -155,6 +200,13 @@ esp_err_t mqtt_init_iotc()
         return ESP_OK;
     }
 
+    s_state_events = xEventGroupCreate();
+    if (s_state_events == NULL) {
+        ESP_LOGE(TAG, "failed to create state events");
+        return ESP_FAIL;
+    }
+    xEventGroupSetBits(s_state_events, WRITABLE_BIT | SUBMITTABLE_BIT);
+
     strcpy(s_hub_info.hubId, HUB_ID);
     strcpy(s_hub_info.projectId, PROJECT_ID);
     strcpy(s_hub_info.locale, IOTC_LOCALE);
@@ -170,6 +222,17 @@ esp_err_t mqtt_init_iotc()
         return ESP_FAIL;
     }
 
+    // message handlers run on their own task, a slow one no longer holds up keepalives, acks and reads
+    if (s_callback_jobs == NULL) {
+        s_callback_jobs = xQueueCreate(CALLBACK_QUEUE_LEN, sizeof(iotc_callback_job_t *));
+        if (s_callback_jobs == NULL ||
+            xTaskCreate(&callback_task, "mqtt_callbacks", BUF_SIZE * 4, NULL, DEFAULT_PRIORITY - 1, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "failed to create the callback task");
+            return ESP_FAIL;
+        }
+    }
+    iotc_set_callback_executor(&mqtt_callback_executor, &mqtt_callback_executor_takes, NULL);
+
     /*  Create a connection context. A context represents a Connection
      on a single socket, and can be used to publish and subscribe
      to numerous topics. */
@@ -179,6 +242,15 @@ esp_err_t mqtt_init_iotc()
         return ESP_FAIL;
     }
 
+    // publishes beyond the window wait in the SDK instead of piling up in the TLS and UART buffers
+    iotc_set_publish_window(s_iotc_context, PUBLISH_WINDOW, PUBLISH_QUEUE, on_writable, NULL);
+    // publishes refused before they reach the MQTT task wait for their own signal
+    iotc_set_submit_writable_callback(s_iotc_context, on_submittable, NULL);
+#if CONFIG_EXAMPLE_MQTT_PERSISTENT_SESSION
+    // the broker keeps the subscriptions, a reconnect with the session present needs no SUBSCRIBE
+    iotc_set_session_type(s_iotc_context, IOTC_SESSION_CONTINUE);
+#endif
+
     return s_create_jwt();
 }
 
@@ -189,26 +261,60 @@ const char *mqtt_current_jwt()
 
 static void check_offline()
 {
+    time_t now;
+    time(&now);
+    // inputs and flip are read and made in one go, a stale read must not undo a newer flip
+    portENTER_CRITICAL(&s_offline_lock);
     int diff = s_publish_count - s_publish_confirmed;
-    ESP_LOGD(TAG, "acknowledgement pending: %d", diff - 1);
-    bool seems_offline = diff > OFFLINE_THRESHOLD;
-    if (s_is_offline != seems_offline) {
+    // with a window the SDK holds the backlog and refuses publishes once window and queue are full
+    bool seems_offline = PUBLISH_WINDOW > 0 ? s_window_full : diff > OFFLINE_THRESHOLD;
+    bool changed = s_is_offline != seems_offline;
+    if (changed) {
         s_is_offline = seems_offline;
-        if (s_is_offline) {
-            time(&s_offline_time);
-            //zb_set_led(YELLOW, ON);
-            ESP_LOGW(TAG, "Too many messages pending. MQTT seems offline");
-        } else {
-            //zb_set_led(YELLOW, OFF);
-            ESP_LOGI(TAG, "MQTT is back online");
+        if (seems_offline) {
+            s_offline_time = now;
+        }
+    }
+    portEXIT_CRITICAL(&s_offline_lock);
+
+    ESP_LOGD(TAG, "acknowledgement pending: %d", diff - 1);
+    if (!changed) {
+        return;
+    }
+    if (seems_offline) {
+        //zb_set_led(YELLOW, ON);
+        ESP_LOGW(TAG, "Too many messages pending. MQTT seems offline");
+        // the connection looks alive but nothing gets through, a keepalive would take minutes to notice
+        recovery_report_down(RECOVERY_STAGE_TRANSPORT_RESET, "no PUBACK");
+    } else {
+        //zb_set_led(YELLOW, OFF);
+        ESP_LOGI(TAG, "MQTT is back online");
+        if (s_mqtt_state == SS_MQTT_CONNECTED) {
+            recovery_report_up();
         }
     }
 }
 
-static void on_publish(iotc_context_handle_t in_context_handle, void* data, iotc_state_t state)
+static void publish_finished(int pid, iotc_state_t state)
 {
-    int pid = (int) data;
+    if (pid == s_wait_pid) {
+        s_wait_state = state;
+        xEventGroupSetBits(s_state_events, PUBACK_BIT);
+    }
+    if (state == IOTC_PUBLISH_WINDOW_FULL) {
+        // submitted publishes are refused here in the MQTT task, not to the publishing task
+        ESP_LOGW(TAG, "publish window and queue are full, publish %d refused", pid);
+        s_window_full = true;
+        xEventGroupClearBits(s_state_events, WRITABLE_BIT);
+        check_offline();
+        return;
+    }
     ESP_LOGI(TAG, "publishing completed for id: %d, state: %d", pid, state);
+    if (!s_got_puback) {
+        s_got_puback = true;
+        boot_mark("first PUBACK");
+        boot_timeline_dump();
+    }
     if (s_publish_confirmed < pid) {
         s_publish_confirmed = pid;
     }
@@ -218,46 +324,220 @@ static void on_publish(iotc_context_handle_t in_context_handle, void* data, iotc
     //turn_red_led_off_if_on();
 }
 
-static esp_err_t s_mqtt_publish(const char *topic, const uint8_t *msg, size_t len)
+static void on_publish(iotc_context_handle_t in_context_handle, void* data, iotc_state_t state)
+{
+    publish_finished((int) data, state);
+}
+
+typedef struct {
+    int pid;
+    mqtt_publish_done_t done;
+    void *arg;
+} tracked_publish_t;
+
+static void on_tracked_publish(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state)
+{
+    tracked_publish_t *tracked = data;
+    publish_finished(tracked->pid, state);
+    esp_err_t err = ESP_OK;
+    if (state == IOTC_PUBLISH_WINDOW_FULL) {
+        err = ESP_ERR_NO_MEM;
+    } else if (state != IOTC_STATE_OK) {
+        err = ESP_FAIL;
+    }
+    tracked->done(tracked->arg, err);
+    free(tracked);
+}
+
+// the SDK queue has drained after a publish was refused
+static void on_writable(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state)
+{
+    ESP_LOGI(TAG, "publish window has room again");
+    s_window_full = false;
+    xEventGroupSetBits(s_state_events, WRITABLE_BIT);
+    check_offline();
+}
+
+// the MQTT task has taken submitted publishes after one was refused
+static void on_submittable(iotc_context_handle_t in_context_handle, void *data, iotc_state_t state)
+{
+    xEventGroupSetBits(s_state_events, SUBMITTABLE_BIT);
+}
+
+// publishes come from several tasks, each takes an id of its own
+static int next_publish_id()
+{
+    return __atomic_fetch_add(&s_publish_count, 1, __ATOMIC_RELAXED);
+}
+
+static esp_err_t s_mqtt_publish(const char *topic, const uint8_t *msg, size_t len, mqtt_priority_t priority, int pid,
+                                iotc_user_callback_t *callback, void *user_data)
 {
     if (s_is_connected == false) {
         ESP_LOGI(TAG, "s_is_connected : FALSE");
         return ESP_FAIL;
     }
 
-    int result;
+    if (s_link_up == false) {
+        ESP_LOGW(TAG, "data link is down, dropping publish");
+        return ESP_FAIL;
+    }
+
+    if (s_window_full) {
+        // the SDK refused a publish in the MQTT task, hold back until on_writable()
+        return ESP_ERR_NO_MEM;
+    }
+
+    iotc_mqtt_priority_t iotc_priority;
+    switch (priority) {
+    case MQTT_PRIORITY_URGENT:
+        iotc_priority = IOTC_MQTT_PRIORITY_URGENT;
+        break;
+    case MQTT_PRIORITY_BULK:
+        iotc_priority = IOTC_MQTT_PRIORITY_BULK;
+        break;
+    default:
+        iotc_priority = IOTC_MQTT_PRIORITY_NORMAL;
+        break;
+    }
+
     if (len <= 0) {
-        result = iotc_publish(s_iotc_context,
-                              topic,
-                              (const char *)msg,
-                              s_iotc_qos,
-                              on_publish,
-                              (void*) s_publish_count);
-    } else {
-        result = iotc_publish_data(s_iotc_context,
-                                   topic,
-                                   msg,
-                                   len,
-                                   s_iotc_qos,
-                                   on_publish,
-                                   (void*) s_publish_count);
+        // string messages are control messages like the attach, they go as normal
+        len = strlen((const char *)msg);
+        iotc_priority = IOTC_MQTT_PRIORITY_NORMAL;
     }
-    ESP_LOGI(TAG, "publish request id: %d, state: %d", s_publish_count, result);
-    s_publish_count += 1;
 
-    check_offline();
+    // safe from any task: the SDK copies the publish and hands it to the MQTT task without a lock
+    xEventGroupClearBits(s_state_events, SUBMITTABLE_BIT);
+    iotc_state_t result = iotc_submit_publish_data(s_iotc_context,
+                                                   topic,
+                                                   msg,
+                                                   len,
+                                                   s_iotc_qos,
+                                                   iotc_priority,
+                                                   callback,
+                                                   user_data);
+    if (result == IOTC_SUBMIT_QUEUE_FULL) {
+        // on_submittable() follows once the MQTT task has taken the publishes ahead of it
+        ESP_LOGW(TAG, "MQTT task is behind, publish %d refused", pid);
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(s_state_events, SUBMITTABLE_BIT);
+    ESP_LOGI(TAG, "publish request id: %d, state: %d", pid, result);
 
-    return ESP_OK;
+    // with a window its input only changes on the iotc task, which runs the check itself
+    if (PUBLISH_WINDOW == 0) {
+        check_offline();
+    }
+
+    return result == IOTC_STATE_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t mqtt_publish(const char *topic, const char* msg)
 {
-    return s_mqtt_publish(topic, (const uint8_t *)msg, 0);
+    int pid = next_publish_id();
+    return s_mqtt_publish(topic, (const uint8_t *)msg, 0, MQTT_PRIORITY_NORMAL, pid, on_publish, (void *) pid);
 }
 
 esp_err_t mqtt_publish_data(const char* topic, const uint8_t* msg, size_t len)
 {
-    return s_mqtt_publish(topic, msg, len);
+    int pid = next_publish_id();
+    return s_mqtt_publish(topic, msg, len, MQTT_PRIORITY_NORMAL, pid, on_publish, (void *) pid);
+}
+
+esp_err_t mqtt_publish_data_priority(const char *topic, const uint8_t *msg, size_t len, mqtt_priority_t priority)
+{
+    int pid = next_publish_id();
+    return s_mqtt_publish(topic, msg, len, priority, pid, on_publish, (void *) pid);
+}
+
+esp_err_t mqtt_publish_tracked(const char *topic, const uint8_t *msg, size_t len, mqtt_priority_t priority,
+                               mqtt_publish_done_t done, void *arg)
+{
+    tracked_publish_t *tracked = malloc(sizeof(tracked_publish_t));
+    if (tracked == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    tracked->pid = next_publish_id();
+    tracked->done = done;
+    tracked->arg = arg;
+    esp_err_t err = s_mqtt_publish(topic, msg, len, priority, tracked->pid, on_tracked_publish, tracked);
+    if (err != ESP_OK) {
+        // never reached the SDK, done is not called
+        free(tracked);
+    }
+    return err;
+}
+
+// publishes and waits for the PUBACK, for measurements only
+esp_err_t mqtt_publish_data_wait(const char *topic, const uint8_t *msg, size_t len, uint32_t timeout_ms)
+{
+    if (s_state_events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xEventGroupClearBits(s_state_events, PUBACK_BIT);
+    int pid = next_publish_id();
+    s_wait_pid = pid;
+    esp_err_t err = s_mqtt_publish(topic, msg, len, MQTT_PRIORITY_NORMAL, pid, on_publish, (void *) pid);
+    if (err == ESP_OK) {
+        EventBits_t bits = xEventGroupWaitBits(s_state_events, PUBACK_BIT, pdTRUE, pdTRUE,
+                                               timeout_ms / portTICK_PERIOD_MS);
+        if (!(bits & PUBACK_BIT)) {
+            err = ESP_ERR_TIMEOUT;
+        } else if (s_wait_state == IOTC_PUBLISH_WINDOW_FULL) {
+            err = ESP_ERR_NO_MEM;
+        } else if (s_wait_state != IOTC_STATE_OK) {
+            err = ESP_FAIL;
+        }
+    }
+    s_wait_pid = -1;
+    return err;
+}
+
+static void callback_task(void *param)
+{
+    iotc_callback_job_t *job;
+    for (;;) {
+        if (xQueueReceive(s_callback_jobs, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (job == NULL) {
+            // every job queued before the marker has run
+            xTaskNotifyGive(s_drain_task);
+            continue;
+        }
+        iotc_run_callback_job(job);
+    }
+}
+
+// the other callbacks call back into the SDK, which only the iotc task may do. The SDK runs
+// them right away, without a job for every PUBACK and SUBACK.
+static uint8_t mqtt_callback_executor_takes(iotc_sub_call_type_t call_type, void *executor_data)
+{
+    IOTC_UNUSED(executor_data);
+    return call_type == IOTC_SUB_CALL_MESSAGE;
+}
+
+// runs on the iotc task for every message callback
+static void mqtt_callback_executor(iotc_callback_job_t *job, iotc_sub_call_type_t call_type, void *executor_data)
+{
+    IOTC_UNUSED(executor_data);
+    IOTC_UNUSED(call_type);
+    // with the queue full the message is handled here rather than dropped
+    if (xQueueSend(s_callback_jobs, &job, 0) != pdTRUE) {
+        iotc_run_callback_job(job);
+    }
+}
+
+// the SDK frees what the jobs hold on to when it shuts down, so they must have run by then
+static void drain_callback_jobs()
+{
+    iotc_callback_job_t *marker = NULL;
+    iotc_set_callback_executor(NULL, NULL, NULL);
+    s_drain_task = xTaskGetCurrentTaskHandle();
+    xQueueSend(s_callback_jobs, &marker, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    s_drain_task = NULL;
 }
 
 static void run_task(void* param)
@@ -273,8 +553,8 @@ void mqtt_start() {
         return;
     }
 
-    s_dev_id_list[0] = DEVICE_ID;
-    s_dev_num = 1;
+    static const char *device_ids[] = { DEVICE_ID };
+    attach_set_devices(device_ids, sizeof(device_ids) / sizeof(device_ids[0]));
 
     s_control_task = xTaskGetCurrentTaskHandle();
     xTaskCreate(&run_task, "mqtt_task", BUF_SIZE * 8, NULL, DEFAULT_PRIORITY, NULL);
@@ -298,13 +578,121 @@ void mqtt_stop()
     s_control_task = NULL;
 }
 
-void mqtt_attach_device(const char* device_id)
+esp_err_t mqtt_wait_writable(uint32_t timeout_ms)
+{
+    if (s_state_events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const EventBits_t writable = WRITABLE_BIT | SUBMITTABLE_BIT;
+    EventBits_t bits = xEventGroupWaitBits(s_state_events, writable, pdFALSE, pdTRUE,
+                                           timeout_ms / portTICK_PERIOD_MS);
+    return (bits & writable) == writable ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t mqtt_wait_connected(uint32_t timeout_ms)
 {
-    char* attach_topic = NULL;
-    asprintf(&attach_topic, "/devices/%s/attach", device_id);
-    ESP_LOGI(TAG, "publishing device attachment to %s", attach_topic);
-    mqtt_publish(attach_topic, "{}");
-    free(attach_topic);
+    if (s_state_events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_state_events, CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           timeout_ms / portTICK_PERIOD_MS);
+    return (bits & CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void mqtt_set_link_state(bool link_up)
+{
+    if (s_link_up == link_up) {
+        return;
+    }
+    s_link_up = link_up;
+    if (link_up) {
+        ESP_LOGI(TAG, "data link is up");
+    } else {
+        // report right away instead of waiting for the keepalive to expire
+        time_t now;
+        time(&now);
+        portENTER_CRITICAL(&s_offline_lock);
+        s_offline_time = now;
+        portEXIT_CRITICAL(&s_offline_lock);
+        ESP_LOGW(TAG, "data link is down, MQTT is offline");
+    }
+}
+
+// set by the recovery task, taken by the iotc task once the connection is closed
+static bool take_reconnect_request()
+{
+    return __atomic_exchange_n(&s_reconnect, false, __ATOMIC_ACQ_REL);
+}
+
+esp_err_t mqtt_reconnect()
+{
+    if (!s_mqtt_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // while retrying, every attempt already starts with a new socket, TLS session and name lookup
+    if (__atomic_load_n(&s_reconnect, __ATOMIC_ACQUIRE) || s_mqtt_state == SS_MQTT_DISCONNECTED_RETRYING) {
+        return ESP_OK;
+    }
+    if (s_mqtt_state != SS_MQTT_CONNECTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGW(TAG, "dropping the connection to reconnect");
+    __atomic_store_n(&s_reconnect, true, __ATOMIC_RELEASE);
+    if (iotc_shutdown_connection(s_iotc_context) != IOTC_STATE_OK) {
+        __atomic_store_n(&s_reconnect, false, __ATOMIC_RELEASE);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_get_publish_stats(iotc_mqtt_publish_stats_t *stats)
+{
+    // written by the iotc task, a counter read in the middle of an update is off by one at most
+    if (iotc_get_mqtt_publish_stats(s_iotc_context, stats) != IOTC_STATE_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+void mqtt_get_connect_stats(mqtt_connect_stats_t *stats)
+{
+    // written by the iotc task, like the publish stats
+    *stats = s_connect_stats;
+}
+
+static void mqtt_ready(bool resumed)
+{
+    uint32_t ready_ms = (esp_timer_get_time() - s_connect_start_us) / 1000;
+    s_connect_stats.connects++;
+    if (resumed) {
+        s_connect_stats.resumed++;
+    }
+    s_connect_stats.last_ready_ms = ready_ms;
+    s_ready_total_ms += ready_ms;
+    s_connect_stats.avg_ready_ms = s_ready_total_ms / s_connect_stats.connects;
+    if (ready_ms > s_connect_stats.max_ready_ms) {
+        s_connect_stats.max_ready_ms = ready_ms;
+    }
+    boot_mark("mqtt ready");
+    ESP_LOGI(TAG, "ready %u ms after the connect request%s", ready_ms, resumed ? ", session resumed" : "");
+}
+
+static void mqtt_subscribe_all(iotc_context_handle_t context_handle)
+{
+    // one SUBSCRIBE and one SUBACK for all topics instead of a round trip each.
+    // The config can be larger than the free heap, it is streamed in chunks.
+    const char *topics[] = { s_topic_command, s_topic_config };
+    const iotc_mqtt_qos_t qos[] = { IOTC_MQTT_QOS_AT_LEAST_ONCE, IOTC_MQTT_QOS_AT_LEAST_ONCE };
+    void *const subscriptions[] = { (void *)SUB_COMMAND, (void *)SUB_CONFIG };
+    const uint8_t stream[] = { 0, 1 };
+    s_subscribed = false;
+    s_subacks_pending = sizeof(topics) / sizeof(topics[0]);
+    iotc_state_t state = iotc_subscribe_multiple(context_handle, topics, qos, s_subacks_pending,
+                                                 &iotc_mqttlogic_subscribe_callback, subscriptions, stream);
+    if (state != IOTC_STATE_OK) {
+        ESP_LOGE(TAG, "subscribe failed: %d", state);
+        s_subacks_pending = 0;
+    }
 }
 
 // TODO: delegate some tasks to Control Center for better thread safety
@@ -319,17 +707,17 @@ static void on_connection_state_changed(iotc_context_handle_t in_context_handle,
     case IOTC_CONNECTION_STATE_OPENED:
         ESP_LOGI(TAG, "IOTC_CONNECTION_STATE_OPENED");
         ESP_LOGI(TAG, "Connected!");
+        boot_mark("mqtt connected");
         ss_set_mqtt_state(SS_MQTT_CONNECTED);
          
-        for (int i = 0; i < s_dev_num; i++) {
-            mqtt_attach_device(s_dev_id_list[i]);
-        }
-
-        iotc_subscribe(in_context_handle, s_topic_command, IOTC_MQTT_QOS_AT_LEAST_ONCE,
-                &iotc_mqttlogic_subscribe_callback, /*user_data=*/NULL);
+        attach_start(in_context_handle, conn_data->session_present);
 
-        iotc_subscribe(in_context_handle, s_topic_config, IOTC_MQTT_QOS_AT_LEAST_ONCE,
-                &iotc_mqttlogic_subscribe_callback, /*user_data=*/NULL);
+        if (conn_data->session_present && s_subscribed) {
+            // the broker still has the subscriptions and the SDK their callbacks
+            mqtt_ready(true);
+        } else {
+            mqtt_subscribe_all(in_context_handle);
+        }
 
 
         //event_post(MQTT_EVENTS, EVENT_MQTT_CONNECTED, NULL, 0);
@@ -357,8 +745,13 @@ static void on_connection_state_changed(iotc_context_handle_t in_context_handle,
         IOTC_STATE_OK then the connection has been closed from one side. */
     case IOTC_CONNECTION_STATE_CLOSED:
         ESP_LOGW(TAG, "IOTC_CONNECTION_STATE_CLOSED. reason: %d", state);
+        attach_stop();
 
-        if (state == IOTC_STATE_OK) {
+        // taken whichever way the connection closed, a stale request would hide the next one
+        if (take_reconnect_request() && state == IOTC_STATE_OK) {
+            try_reconnect = true;
+            ss_set_mqtt_state(SS_MQTT_DISCONNECTED_RETRYING);
+        } else if (state == IOTC_STATE_OK) {
             iotc_events_stop();
             ss_set_mqtt_state(SS_MQTT_DISCONNECTED);
         } else {
@@ -377,6 +770,7 @@ static void on_connection_state_changed(iotc_context_handle_t in_context_handle,
         // renew the JWT token first in case the cause of disconnect is JWT expiration
         if (s_create_jwt() == ESP_OK) {
             //event_post(MQTT_EVENTS, EVENT_MQTT_JWT_RENEWED, s_jwt_token, strlen(s_jwt_token) + 1);
+            s_connect_start_us = esp_timer_get_time();
             iotc_connect(in_context_handle, conn_data->username, s_jwt_token,
                          conn_data->client_id, conn_data->connection_timeout,
                          conn_data->keepalive_timeout, &on_connection_state_changed);
@@ -387,36 +781,58 @@ static void on_connection_state_changed(iotc_context_handle_t in_context_handle,
 static void iotc_mqttlogic_subscribe_callback(iotc_context_handle_t in_context_handle, iotc_sub_call_type_t call_type,
         const iotc_sub_call_params_t * const params, iotc_state_t state, void *user_data) {
     IOTC_UNUSED(in_context_handle);
-    IOTC_UNUSED(call_type);
-    IOTC_UNUSED(state);
-    IOTC_UNUSED(user_data);
-    if (params != NULL && params->message.topic != NULL) {
-        ESP_LOGI(TAG, "Subscription Topic: %s", params->message.topic);
-        char *sub_message = (char *) malloc(params->message.temporary_payload_data_length + 1);
-        if (sub_message == NULL) {
-            ESP_LOGE(TAG, "Failed to allocate memory.");
-            return;
+    // subacks and the streamed config come on the iotc task, commands on the callback task
+    if (call_type == IOTC_SUB_CALL_SUBACK) {
+        if (state != IOTC_MQTT_SUBSCRIPTION_SUCCESSFULL) {
+            ESP_LOGE(TAG, "subscription to %s refused", params != NULL ? params->suback.topic : "?");
+            // never ready on this connection, s_subscribed is still false so a reconnect subscribes again.
+            // Once per SUBSCRIBE, the SUBACK may refuse more than one topic
+            if (s_subacks_pending > 0) {
+                s_subacks_pending = 0;
+                recovery_report_down(RECOVERY_STAGE_MQTT_RECONNECT, "SUBACK refused");
+            }
+        } else if (s_subacks_pending > 0 && --s_subacks_pending == 0) {
+            s_subscribed = true;
+            mqtt_ready(false);
         }
-        memcpy(sub_message, params->message.temporary_payload_data, params->message.temporary_payload_data_length);
-        sub_message[params->message.temporary_payload_data_length] = '\0';
-        ESP_LOGI(TAG, "Message Payload: %s ", sub_message);
-
-        if (strcmp(s_topic_command, params->message.topic) == 0) {
-            //event_post(MQTT_EVENTS, EVENT_MQTT_COMMAND_RECEIVED, sub_message, strlen(sub_message) + 1);
-            ESP_LOGI(TAG, "MQTT command received");
-        } else if (strcmp(s_topic_command_no_suffix, params->message.topic) == 0) {
-            // Note: library incompatibility found.
-            // With the google-iotc library upgraded to 1.0.2,
-            // it's noticed that params->message.topic value
-            // doesn't have "/#" suffix at the end.
-            // Have to handle the issue here.
-            //event_post(MQTT_EVENTS, EVENT_MQTT_COMMAND_RECEIVED, sub_message, strlen(sub_message) + 1);
+        return;
+    }
+    if (params == NULL) {
+        return;
+    }
+    switch (call_type) {
+    case IOTC_SUB_CALL_MESSAGE_BEGIN:
+        ESP_LOGI(TAG, "Subscription Topic: %s, %u bytes", params->stream.topic, params->stream.total_length);
+        break;
+    case IOTC_SUB_CALL_MESSAGE_CHUNK:
+        // straight from the SDK's read buffer, the config is never held whole
+        ESP_LOGI(TAG, "Message Payload [%u]: %.*s", params->stream.offset,
+                 (int)params->stream.temporary_chunk_data_length, params->stream.temporary_chunk_data);
+        //event_post(MQTT_EVENTS, EVENT_MQTT_CONFIG_CHUNK, params->stream.temporary_chunk_data, params->stream.temporary_chunk_data_length);
+        break;
+    case IOTC_SUB_CALL_MESSAGE_END:
+        if (state != IOTC_STATE_OK) {
+            ESP_LOGW(TAG, "config cut off after %u of %u bytes: %d", params->stream.offset,
+                     params->stream.total_length, state);
+            break;
+        }
+        //event_post(MQTT_EVENTS, EVENT_MQTT_CONFIG_RECEIVED, NULL, 0);
+        ESP_LOGI(TAG, "MQTT config received");
+        break;
+    case IOTC_SUB_CALL_MESSAGE:
+        if (params->message.topic == NULL) {
+            break;
+        }
+        ESP_LOGI(TAG, "Subscription Topic: %s", params->message.topic);
+        ESP_LOGI(TAG, "Message Payload: %.*s ", (int)params->message.temporary_payload_data_length,
+                 params->message.temporary_payload_data);
+        if ((mqtt_subscription_t)(intptr_t)user_data == SUB_COMMAND) {
+            //event_post(MQTT_EVENTS, EVENT_MQTT_COMMAND_RECEIVED, params->message.temporary_payload_data, params->message.temporary_payload_data_length);
             ESP_LOGI(TAG, "MQTT command received");
-        } else if (strcmp(s_topic_config, params->message.topic) == 0) {
-            //event_post(MQTT_EVENTS, EVENT_MQTT_CONFIG_RECEIVED, sub_message, strlen(sub_message) + 1);
-            ESP_LOGI(TAG, "MQTT config received");
-		}
-		free(sub_message);
+        }
+        break;
+    default:
+        break;
     }
 }
 
@@ -435,8 +851,6 @@ static void mqtt_task() {
 
     asprintf(&s_topic_command, SUBSCRIBE_TOPIC_COMMAND, s_hub_info.hubId);
     ESP_LOGI(TAG, "command topic constructed: %s", s_topic_command);
-    asprintf(&s_topic_command_no_suffix, SUBSCRIBE_TOPIC_COMMAND_NO_SUFFIX, s_hub_info.hubId);
-    ESP_LOGD(TAG, "command topic name without suffix also created");
 
     asprintf(&s_topic_config, SUBSCRIBE_TOPIC_CONFIG, s_hub_info.hubId);
     ESP_LOGI(TAG, "config topic constructed: %s", s_topic_config);
@@ -450,6 +864,7 @@ static void mqtt_task() {
     }
     ESP_LOGI(TAG, "device_path: %s", device_path);
     ESP_LOGI(TAG, "JWT token: %s", s_jwt_token);
+    s_connect_start_us = esp_timer_get_time();
     int res = iotc_connect(s_iotc_context, NULL, s_jwt_token, device_path, connection_timeout, keepalive_timeout,
             &on_connection_state_changed);
     free(device_path);
@@ -476,6 +891,7 @@ static void mqtt_task() {
      handler by calling iotc_events_stop(); */
     iotc_events_process_blocking();
 
+    drain_callback_jobs();
     iotc_delete_context(s_iotc_context);
     s_iotc_context = IOTC_INVALID_CONTEXT_HANDLE;
     s_is_connected = false;
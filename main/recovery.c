@@ -0,0 +1,284 @@
+//
+//  Copyright © 2020 Stack Care Inc. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "lte_poc.h"
+
+#define RECOVERY_TASK_STACK_SIZE 4096
+#define RECOVERY_RTC_MAGIC 0x52435652 // "RCVR"
+// an incident carried over a reboot is only trusted if the clock says it started less than this ago
+#define RECOVERY_RTC_MAX_AGE (24 * 60 * 60)
+
+typedef struct {
+    recovery_action_t action;
+    uint32_t budget_ms;
+} recovery_step_t;
+
+// an open incident, kept across esp_restart() so the reboot counts into its repair time
+typedef struct {
+    uint32_t magic;
+    time_t started;
+} recovery_rtc_t;
+
+static const char *TAG = "Recovery";
+
+static const char *s_stage_names[RECOVERY_STAGE_MAX] = {
+    "mqtt reconnect", "transport reset", "link re-dial", "modem reset", "reboot"
+};
+
+static RTC_NOINIT_ATTR recovery_rtc_t s_rtc;
+
+static TaskHandle_t s_task = NULL;
+static SemaphoreHandle_t s_stopped = NULL;
+static recovery_step_t s_steps[RECOVERY_STAGE_MAX];
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+// reported by the connection, guarded by s_lock
+static bool s_up = true;
+static int s_requested = -1;         // cheapest stage able to repair the last reported failure
+static const char *s_cause = NULL;
+static bool s_stopping = false;
+// the open incident and the statistics, written by the task, guarded by s_lock
+static bool s_active = false;
+static recovery_stage_t s_stage;
+static recovery_stage_t s_reached;   // highest stage of the incident
+static int64_t s_started_us;
+static int64_t s_stage_started_us;
+static recovery_stats_t s_stats;
+static uint64_t s_mttr_total_ms = 0;
+
+static const char *stage_name(recovery_stage_t stage)
+{
+    return stage < RECOVERY_STAGE_MAX ? s_stage_names[stage] : "?";
+}
+
+// the first stage at or above stage that can be run, waiting for the connection needs no action
+static recovery_stage_t next_stage(recovery_stage_t stage)
+{
+    while (stage != RECOVERY_STAGE_MQTT_RECONNECT && stage < RECOVERY_STAGE_REBOOT && s_steps[stage].action == NULL) {
+        stage++;
+    }
+    return stage;
+}
+
+static void enter_stage(recovery_stage_t stage, const char *cause)
+{
+    stage = next_stage(stage);
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_stage = stage;
+    if (stage > s_reached) {
+        s_reached = stage;
+    }
+    s_stage_started_us = now;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGW(TAG, "%s after %d ms (%s)", stage_name(stage), (int)((now - s_started_us) / 1000),
+             cause ? cause : "timeout");
+
+    if (stage == RECOVERY_STAGE_REBOOT) {
+        if (s_steps[stage].action != NULL) {
+            s_steps[stage].action();
+        }
+        s_rtc.magic = RECOVERY_RTC_MAGIC;
+        s_rtc.started = time(NULL) - (time_t)((now - s_started_us) / 1000000);
+        esp_restart();
+    }
+    if (s_steps[stage].action != NULL) {
+        esp_err_t err = s_steps[stage].action();
+        if (err != ESP_OK) {
+            // no use waiting for the budget, go on with the next stage right away
+            ESP_LOGW(TAG, "%s failed: %s", stage_name(stage), esp_err_to_name(err));
+            portENTER_CRITICAL(&s_lock);
+            s_stage_started_us = 0;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+}
+
+static void open_incident(recovery_stage_t stage, const char *cause)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_active = true;
+    s_started_us = now;
+    s_reached = RECOVERY_STAGE_MQTT_RECONNECT;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGW(TAG, "connection lost (%s)", cause ? cause : "unknown");
+    enter_stage(stage, NULL);
+}
+
+static void close_incident()
+{
+    uint32_t mttr_ms = (esp_timer_get_time() - s_started_us) / 1000;
+    portENTER_CRITICAL(&s_lock);
+    s_active = false;
+    s_stats.incidents++;
+    s_stats.recovered[s_reached]++;
+    s_stats.last_stage = s_reached;
+    s_stats.mttr_last_ms = mttr_ms;
+    s_mttr_total_ms += mttr_ms;
+    s_stats.mttr_avg_ms = s_mttr_total_ms / s_stats.incidents;
+    if (mttr_ms > s_stats.mttr_max_ms) {
+        s_stats.mttr_max_ms = mttr_ms;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    s_rtc.magic = 0;
+    ESP_LOGI(TAG, "connection restored in %u ms, reached %s", mttr_ms, stage_name(s_reached));
+}
+
+static void recovery_task(void *param)
+{
+    while (true) {
+        TickType_t wait = portMAX_DELAY;
+        if (s_active) {
+            int64_t deadline = s_stage_started_us + (int64_t)s_steps[s_stage].budget_ms * 1000;
+            int64_t left = deadline - esp_timer_get_time();
+            wait = left > 0 ? pdMS_TO_TICKS(left / 1000) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        portENTER_CRITICAL(&s_lock);
+        bool stopping = s_stopping;
+        bool up = s_up;
+        int requested = s_requested;
+        const char *cause = s_cause;
+        s_requested = -1;
+        portEXIT_CRITICAL(&s_lock);
+        if (stopping) {
+            break;
+        }
+
+        if (!s_active) {
+            if (!up && requested >= 0) {
+                open_incident(requested, cause);
+            }
+        } else if (up) {
+            close_incident();
+        } else if (requested > (int)s_stage) {
+            // the failure turned out to be further down, skip the stages which cannot repair it
+            enter_stage(requested, cause);
+        } else if (s_stage < RECOVERY_STAGE_REBOOT &&
+                   esp_timer_get_time() >= s_stage_started_us + (int64_t)s_steps[s_stage].budget_ms * 1000) {
+            enter_stage(s_stage + 1, NULL);
+        }
+    }
+    xSemaphoreGive(s_stopped);
+    vTaskDelete(NULL);
+}
+
+esp_err_t recovery_init()
+{
+    if (s_task != NULL) {
+        ESP_LOGW(TAG, "recovery is already initialized");
+        return ESP_OK;
+    }
+    s_stopped = xSemaphoreCreateBinary();
+    if (s_stopped == NULL) {
+        ESP_LOGE(TAG, "failed to create recovery semaphore");
+        return ESP_FAIL;
+    }
+    s_stopping = false;
+    s_active = false;
+    if (s_rtc.magic == RECOVERY_RTC_MAGIC && esp_reset_reason() == ESP_RST_SW) {
+        // the last incident ended in a reboot, it is closed once the connection is back
+        time_t age = time(NULL) - s_rtc.started;
+        if (age < 0 || age > RECOVERY_RTC_MAX_AGE) {
+            age = 0;
+        }
+        s_up = false;
+        s_active = true;
+        s_stage = RECOVERY_STAGE_MQTT_RECONNECT;
+        s_reached = RECOVERY_STAGE_REBOOT;
+        s_started_us = -(int64_t)age * 1000000;
+        s_stage_started_us = esp_timer_get_time();
+        ESP_LOGW(TAG, "resuming incident from %d s ago after reboot", (int)age);
+    }
+    s_rtc.magic = 0;
+    if (xTaskCreate(&recovery_task, "recovery_task", RECOVERY_TASK_STACK_SIZE, NULL, DEFAULT_PRIORITY,
+                    &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "failed to create recovery task");
+        vSemaphoreDelete(s_stopped);
+        s_stopped = NULL;
+        s_task = NULL;
+        return ESP_FAIL;
+    }
+    // pick up what was reported before the task ran
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void recovery_set_action(recovery_stage_t stage, recovery_action_t action, uint32_t budget_ms)
+{
+    if (stage >= RECOVERY_STAGE_MAX) {
+        return;
+    }
+    s_steps[stage].action = action;
+    s_steps[stage].budget_ms = budget_ms;
+}
+
+void recovery_report_down(recovery_stage_t first_stage, const char *cause)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_up = false;
+    if ((int)first_stage > s_requested) {
+        s_requested = first_stage;
+        s_cause = cause;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void recovery_report_up()
+{
+    portENTER_CRITICAL(&s_lock);
+    s_up = true;
+    s_requested = -1;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void recovery_get_stats(recovery_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    stats->active = s_active;
+    stats->stage = s_reached;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const char *recovery_stage_name(recovery_stage_t stage)
+{
+    return stage_name(stage);
+}
+
+void recovery_stop()
+{
+    if (s_task == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stopping = true;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+    // a running stage is finished first
+    xSemaphoreTake(s_stopped, portMAX_DELAY);
+    vSemaphoreDelete(s_stopped);
+    s_stopped = NULL;
+    s_task = NULL;
+}
@@ -0,0 +1,515 @@
+//
+//  Copyright © 2020 Stack Care Inc. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "iotc_config.h"
+#include "iotc_RootCA_list.h"
+#include "iotc_bsp_io_net_route.h"
+#include "iotc_bsp_tls_session.h"
+
+#include "lte_poc.h"
+
+#define TRANSPORT_TASK_STACK_SIZE 6144
+#define TRANSPORT_PROBE_TIMEOUT_MS 15000
+// MQTT down for this long on the active transport moves it to a healthy standby
+#define TRANSPORT_MQTT_GRACE_MS 30000
+// how often to look again whether the clock is set, until it is
+#define TRANSPORT_CLOCK_WAIT_MS 1000
+
+typedef struct {
+    const char *name;
+    uint16_t port;
+} transport_broker_t;
+
+typedef struct {
+    int fd;
+    uint32_t bytes;
+} transport_probe_t;
+
+static const char *TAG = "Transport";
+
+static const char *s_transport_names[TRANSPORT_MAX] = { "wifi", "lte" };
+static const transport_broker_t s_broker = IOTC_MQTT_HOST;
+
+static TaskHandle_t s_task = NULL;
+static SemaphoreHandle_t s_stopped = NULL;
+static esp_netif_t *s_netif[TRANSPORT_MAX];
+static transport_t s_preferred;
+static uint32_t s_probe_interval_ms;
+// last address the broker resolved to, probes go on with it when the lookup fails
+static struct in_addr s_broker_addr;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+// reported by the event handlers and the MQTT client, guarded by s_lock
+static bool s_up[TRANSPORT_MAX];
+static bool s_probe_due[TRANSPORT_MAX];     // came up and has not been probed since
+static esp_netif_dns_info_t s_dns[TRANSPORT_MAX];
+static bool s_mqtt_connected = false;
+static int64_t s_mqtt_down_us = 0;
+static int64_t s_switch_us = 0;         // start of the switch MQTT has not come back from yet
+static bool s_stopping = false;
+// written by the task, guarded by s_lock
+static transport_t s_active;
+static transport_stats_t s_stats;
+static uint64_t s_sent_mark = 0;        // library byte counters when the active transport took over
+static uint64_t s_received_mark = 0;
+
+const char *transport_name(transport_t transport)
+{
+    return transport < TRANSPORT_MAX ? s_transport_names[transport] : "?";
+}
+
+// certificates cannot be checked before SNTP set the clock
+static bool clock_set()
+{
+    time_t now = time(NULL);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    return timeinfo.tm_year >= (2016 - 1900);
+}
+
+static transport_t other(transport_t transport)
+{
+    return transport == TRANSPORT_WIFI ? TRANSPORT_LTE : TRANSPORT_WIFI;
+}
+
+static void set_default_netif(void *ctx)
+{
+    netif_set_default((struct netif *)ctx);
+}
+
+// new connections, DNS and the default route go through transport
+static esp_err_t apply_route(transport_t transport)
+{
+    esp_netif_ip_info_t ip_info;
+    if (esp_netif_get_ip_info(s_netif[transport], &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    struct in_addr source = { .s_addr = ip_info.ip.addr };
+    iotc_bsp_io_net_set_source(&source);
+    // esp-netif picks the default interface by priority whenever one goes up or down
+    tcpip_callback(set_default_netif, esp_netif_get_netif_impl(s_netif[transport]));
+    portENTER_CRITICAL(&s_lock);
+    esp_netif_dns_info_t dns = s_dns[transport];
+    portEXIT_CRITICAL(&s_lock);
+    if (dns.ip.u_addr.ip4.addr != 0) {
+        esp_netif_set_dns_info(s_netif[transport], ESP_NETIF_DNS_MAIN, &dns);
+    }
+    return ESP_OK;
+}
+
+// MQTT traffic since the last call is accounted to the active transport
+static void account_bytes()
+{
+    uint64_t sent, received;
+    iotc_bsp_io_net_get_counters(&sent, &received);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.sent[s_active] += sent - s_sent_mark;
+    s_stats.received[s_active] += received - s_received_mark;
+    s_sent_mark = sent;
+    s_received_mark = received;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static int probe_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    transport_probe_t *probe = ctx;
+    int ret = send(probe->fd, buf, len, 0);
+    if (ret < 0) {
+        return errno == EAGAIN ? MBEDTLS_ERR_SSL_TIMEOUT : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    probe->bytes += ret;
+    return ret;
+}
+
+static int probe_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    transport_probe_t *probe = ctx;
+    int ret = recv(probe->fd, buf, len, 0);
+    if (ret < 0) {
+        return errno == EAGAIN ? MBEDTLS_ERR_SSL_TIMEOUT : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    if (ret == 0) {
+        return MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    probe->bytes += ret;
+    return ret;
+}
+
+static esp_err_t probe_connect(transport_probe_t *probe, const struct in_addr *source)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(s_broker.name, NULL, &hints, &result) == 0 && result != NULL) {
+        s_broker_addr = ((struct sockaddr_in *)result->ai_addr)->sin_addr;
+        freeaddrinfo(result);
+    }
+    if (s_broker_addr.s_addr == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_addr = *source };
+    struct sockaddr_in remote = { .sin_family = AF_INET, .sin_addr = s_broker_addr, .sin_port = htons(s_broker.port) };
+    struct timeval timeout = {
+        .tv_sec = TRANSPORT_PROBE_TIMEOUT_MS / 1000,
+        .tv_usec = (TRANSPORT_PROBE_TIMEOUT_MS % 1000) * 1000,
+    };
+    probe->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (probe->fd < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    // connect() has no timeout of its own, wait for it with select()
+    fcntl(probe->fd, F_SETFL, fcntl(probe->fd, F_GETFL) | O_NONBLOCK);
+    if (bind(probe->fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+        (connect(probe->fd, (struct sockaddr *)&remote, sizeof(remote)) != 0 && errno != EINPROGRESS)) {
+        return ESP_FAIL;
+    }
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(probe->fd, &fds);
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (select(probe->fd + 1, NULL, &fds, NULL, &timeout) <= 0 ||
+        getsockopt(probe->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    fcntl(probe->fd, F_SETFL, fcntl(probe->fd, F_GETFL) & ~O_NONBLOCK);
+    setsockopt(probe->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(probe->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return ESP_OK;
+}
+
+/**
+ * @brief Connect to the broker through transport and run a TLS handshake
+ *
+ * Shows that the broker can be reached that way, and leaves a fresh TLS session for the MQTT connection to
+ * resume. The cached session is offered, so a warm-up costs a few hundred bytes unless the server forgot it.
+ */
+static esp_err_t probe(transport_t transport)
+{
+    esp_netif_ip_info_t ip_info;
+    if (esp_netif_get_ip_info(s_netif[transport], &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    struct in_addr source = { .s_addr = ip_info.ip.addr };
+    transport_probe_t probe = { .fd = -1 };
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_x509_crt cacert;
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    mbedtls_x509_crt_init(&cacert);
+
+    int64_t start = esp_timer_get_time();
+    // mbedtls wants the PEM list null terminated
+    unsigned char *ca = calloc(1, IOTC_ROOTCA_LIST_BYTE_LENGTH + 1);
+    esp_err_t err = ca == NULL ? ESP_ERR_NO_MEM : probe_connect(&probe, &source);
+    if (err == ESP_OK) {
+        memcpy(ca, iotc_RootCA_list, IOTC_ROOTCA_LIST_BYTE_LENGTH);
+        if (mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, NULL, 0) != 0 ||
+            mbedtls_x509_crt_parse(&cacert, ca, IOTC_ROOTCA_LIST_BYTE_LENGTH + 1) < 0 ||
+            mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+            err = ESP_FAIL;
+        }
+    }
+    if (err == ESP_OK) {
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&conf, &cacert, NULL);
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+        if (mbedtls_ssl_setup(&ssl, &conf) != 0 || mbedtls_ssl_set_hostname(&ssl, s_broker.name) != 0) {
+            err = ESP_FAIL;
+        }
+    }
+    if (err == ESP_OK) {
+        mbedtls_ssl_set_bio(&ssl, &probe, probe_send, probe_recv, NULL);
+        iotc_bsp_tls_session_load(&ssl);
+        int ret = mbedtls_ssl_handshake(&ssl);
+        if (ret == 0) {
+            iotc_bsp_tls_session_save(&ssl);
+            mbedtls_ssl_close_notify(&ssl);
+        } else {
+            ESP_LOGD(TAG, "probe handshake failed: -0x%x", -ret);
+            err = ret == MBEDTLS_ERR_SSL_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        }
+    }
+    uint32_t handshake_ms = (esp_timer_get_time() - start) / 1000;
+    if (probe.fd >= 0) {
+        close(probe.fd);
+    }
+    free(ca);
+    mbedtls_x509_crt_free(&cacert);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.probes[transport]++;
+    s_stats.probe_bytes[transport] += probe.bytes;
+    s_stats.healthy[transport] = err == ESP_OK;
+    if (err == ESP_OK) {
+        s_stats.handshake_ms[transport] = handshake_ms;
+    } else {
+        s_stats.probe_failures[transport]++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s probe: %s in %u ms, %u bytes", transport_name(transport),
+             err == ESP_OK ? "ok" : esp_err_to_name(err), handshake_ms, probe.bytes);
+    return err;
+}
+
+// the MQTT client is told about the link it actually uses
+static void report_link()
+{
+    portENTER_CRITICAL(&s_lock);
+    bool up = s_up[s_active];
+    portEXIT_CRITICAL(&s_lock);
+    mqtt_set_link_state(up);
+}
+
+/**
+ * @brief Move the MQTT connection to transport
+ *
+ * The new path has been shown to reach the broker before the old connection is dropped. IoT Core takes a single
+ * connection per device, so MQTT itself cannot overlap, but the reconnect resumes the TLS session.
+ */
+static void switch_to(transport_t transport, bool failback)
+{
+    if (apply_route(transport) != ESP_OK) {
+        return;
+    }
+    account_bytes();
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    transport_t from = s_active;
+    s_active = transport;
+    s_stats.active = transport;
+    // whatever made us leave, only a probe after the switch may bring us back
+    s_stats.healthy[from] = false;
+    if (failback) {
+        s_stats.failbacks++;
+    } else {
+        s_stats.failovers++;
+    }
+    // a failover is timed from the moment MQTT was lost, if it was
+    s_switch_us = !failback && !s_mqtt_connected && s_mqtt_down_us ? s_mqtt_down_us : now;
+    if (!s_mqtt_connected) {
+        // the new path gets its own grace period before moving on again
+        s_mqtt_down_us = now;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGW(TAG, "%s from %s to %s", failback ? "failback" : "failover", transport_name(from),
+             transport_name(transport));
+    report_link();
+    // while MQTT is retrying, the next attempt takes the new route anyway
+    mqtt_reconnect();
+}
+
+static void transport_task(void *param)
+{
+    int64_t next_probe_us = esp_timer_get_time();
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        TickType_t wait = now < next_probe_us ? pdMS_TO_TICKS((next_probe_us - now) / 1000) + 1 : 0;
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        portENTER_CRITICAL(&s_lock);
+        bool stopping = s_stopping;
+        transport_t active = s_active;
+        transport_t standby = other(active);
+        bool active_up = s_up[active];
+        bool standby_up = s_up[standby];
+        bool standby_healthy = s_stats.healthy[standby];
+        bool probe_due = s_probe_due[standby];
+        bool mqtt_stuck = !s_mqtt_connected && s_mqtt_down_us &&
+                          esp_timer_get_time() - s_mqtt_down_us > TRANSPORT_MQTT_GRACE_MS * 1000LL;
+        portEXIT_CRITICAL(&s_lock);
+        if (stopping) {
+            break;
+        }
+        account_bytes();
+
+        now = esp_timer_get_time();
+        if (standby_up && (probe_due || now >= next_probe_us)) {
+            if (clock_set()) {
+                // keeps the standby path and its TLS session warm
+                portENTER_CRITICAL(&s_lock);
+                s_probe_due[standby] = false;
+                portEXIT_CRITICAL(&s_lock);
+                standby_healthy = probe(standby) == ESP_OK;
+                next_probe_us = esp_timer_get_time() + (int64_t)s_probe_interval_ms * 1000;
+            } else {
+                next_probe_us = now + TRANSPORT_CLOCK_WAIT_MS * 1000LL;
+            }
+        } else if (now >= next_probe_us) {
+            next_probe_us = now + (int64_t)s_probe_interval_ms * 1000;
+        }
+
+        if (!active_up && standby_up) {
+            // nothing left to lose on the active link, no need to wait for a probe
+            switch_to(standby, false);
+        } else if (mqtt_stuck && standby_up && standby_healthy) {
+            switch_to(standby, false);
+        } else if (standby == s_preferred && standby_up && standby_healthy) {
+            switch_to(standby, true);
+        } else {
+            // esp-netif may have moved the default route while an interface came or went
+            apply_route(active);
+        }
+    }
+    xSemaphoreGive(s_stopped);
+    vTaskDelete(NULL);
+}
+
+esp_err_t transport_init(transport_t preferred, esp_netif_t *wifi, esp_netif_t *lte, uint32_t probe_interval_ms)
+{
+    if (s_task != NULL) {
+        ESP_LOGW(TAG, "transport is already initialized");
+        return ESP_OK;
+    }
+    s_netif[TRANSPORT_WIFI] = wifi;
+    s_netif[TRANSPORT_LTE] = lte;
+    s_preferred = preferred;
+    s_probe_interval_ms = probe_interval_ms;
+    s_stopping = false;
+    // start on whatever is up, the preferred transport takes over once a probe got through
+    s_active = s_up[preferred] || !s_up[other(preferred)] ? preferred : other(preferred);
+    s_stats.active = s_active;
+    iotc_bsp_io_net_get_counters(&s_sent_mark, &s_received_mark);
+    apply_route(s_active);
+    report_link();
+    ESP_LOGI(TAG, "starting on %s, preferred %s", transport_name(s_active), transport_name(preferred));
+    s_stopped = xSemaphoreCreateBinary();
+    if (s_stopped == NULL) {
+        ESP_LOGE(TAG, "failed to create transport semaphore");
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(&transport_task, "transport_task", TRANSPORT_TASK_STACK_SIZE, NULL, DEFAULT_PRIORITY,
+                    &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "failed to create transport task");
+        vSemaphoreDelete(s_stopped);
+        s_stopped = NULL;
+        s_task = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void transport_set_link_state(transport_t transport, bool up)
+{
+    if (transport >= TRANSPORT_MAX) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    bool changed = s_up[transport] != up;
+    s_up[transport] = up;
+    s_stats.up[transport] = up;
+    if (up && changed) {
+        s_probe_due[transport] = true;
+    }
+    if (!up) {
+        s_stats.healthy[transport] = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (up && s_netif[transport] != NULL) {
+        // right after the address, the name servers are still the ones this interface brought
+        esp_netif_dns_info_t dns;
+        if (esp_netif_get_dns_info(s_netif[transport], ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+            portENTER_CRITICAL(&s_lock);
+            s_dns[transport] = dns;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    ESP_LOGI(TAG, "%s is %s", transport_name(transport), up ? "up" : "down");
+    if (s_task != NULL) {
+        report_link();
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void transport_report_mqtt(bool connected)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool was_connected = s_mqtt_connected;
+    s_mqtt_connected = connected;
+    if (!connected && was_connected) {
+        s_mqtt_down_us = now;
+    } else if (connected) {
+        s_mqtt_down_us = 0;
+        if (s_switch_us) {
+            uint32_t failover_ms = (now - s_switch_us) / 1000;
+            s_stats.failover_last_ms = failover_ms;
+            if (failover_ms > s_stats.failover_max_ms) {
+                s_stats.failover_max_ms = failover_ms;
+            }
+            s_switch_us = 0;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (s_task != NULL && connected != was_connected) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+transport_t transport_get_active()
+{
+    portENTER_CRITICAL(&s_lock);
+    transport_t active = s_active;
+    portEXIT_CRITICAL(&s_lock);
+    return active;
+}
+
+void transport_get_stats(transport_stats_t *stats)
+{
+    if (s_task != NULL) {
+        account_bytes();
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void transport_stop()
+{
+    if (s_task == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stopping = true;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+    // a running probe is finished first
+    xSemaphoreTake(s_stopped, portMAX_DELAY);
+    vSemaphoreDelete(s_stopped);
+    s_stopped = NULL;
+    s_task = NULL;
+    account_bytes();
+}
@@ -0,0 +1,200 @@
+//
+//  Copyright © 2020 Stack Care Inc. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "lte_poc.h"
+
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+#include "bg96_mqtt.h"
+#include "iotc_RootCA_list.h"
+#endif
+
+#define BENCH_TOPIC "/devices/%s/events/bench"
+#define BENCH_PUBLISH_TIMEOUT_MS 30000
+
+// modem side of the comparison, same endpoint as the SDK uses (iotc_config.h)
+#define BENCH_MODEM_HOST "mqtt.2030.ltsapis.goog"
+#define BENCH_MODEM_PORT 8883
+#define BENCH_MODEM_CA_FILE "iotc_roots.pem"
+#define BENCH_MODEM_PDP_CONTEXT 1
+#define BENCH_MODEM_KEEPALIVE_S 180
+#define BENCH_MODEM_PACKET_TIMEOUT_S 5
+#define BENCH_MODEM_RETRIES 3
+
+static const char *TAG = "Bench";
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+// run time of the idle tasks of all cores and the run time counter
+static bool cpu_sample(uint32_t *idle, uint32_t *total)
+{
+    UBaseType_t count = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *tasks = malloc(count * sizeof(TaskStatus_t));
+    if (tasks == NULL) {
+        return false;
+    }
+    count = uxTaskGetSystemState(tasks, count, total);
+    *idle = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        if (!strncmp(tasks[i].pcTaskName, "IDLE", strlen("IDLE"))) {
+            *idle += tasks[i].ulRunTimeCounter;
+        }
+    }
+    free(tasks);
+    return count > 0;
+}
+#endif
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void bench_run(const char *name, bench_publish_t publish, int count, size_t payload_len, uint32_t heap_baseline,
+               bench_result_t *result)
+{
+    memset(result, 0, sizeof(bench_result_t));
+    result->name = name;
+    result->cpu_permille = -1;
+
+    char *topic = NULL;
+    asprintf(&topic, BENCH_TOPIC, HUB_ID);
+    uint8_t *payload = malloc(payload_len);
+    uint32_t *latency = calloc(count, sizeof(uint32_t));
+    if (topic == NULL || payload == NULL || latency == NULL) {
+        ESP_LOGE(TAG, "no memory for %s benchmark", name);
+        goto end;
+    }
+    esp_fill_random(payload, payload_len);
+
+    uint32_t min_free = esp_get_free_heap_size();
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+    uint32_t idle_start = 0, total_start = 0;
+    bool cpu_valid = cpu_sample(&idle_start, &total_start);
+#endif
+    // stop and wait, every publish is acknowledged before the next one is sent
+    for (int i = 0; i < count; i++) {
+        int64_t start = esp_timer_get_time();
+        if (publish(topic, payload, payload_len, BENCH_PUBLISH_TIMEOUT_MS) != ESP_OK) {
+            result->failed++;
+            continue;
+        }
+        latency[result->published++] = (esp_timer_get_time() - start) / 1000;
+        uint32_t free_heap = esp_get_free_heap_size();
+        if (free_heap < min_free) {
+            min_free = free_heap;
+        }
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+    uint32_t idle_end = 0, total_end = 0;
+    if (cpu_valid && cpu_sample(&idle_end, &total_end) && total_end != total_start) {
+        // the counters are per core, the run time counter is wall time
+        uint64_t capacity = (uint64_t)(total_end - total_start) * portNUM_PROCESSORS;
+        result->cpu_permille = 1000 - (uint64_t)(idle_end - idle_start) * 1000 / capacity;
+    }
+#endif
+    uint32_t free_heap = esp_get_free_heap_size();
+    result->heap_used = heap_baseline > free_heap ? heap_baseline - free_heap : 0;
+    result->heap_peak = heap_baseline > min_free ? heap_baseline - min_free : 0;
+
+    if (result->published > 0) {
+        qsort(latency, result->published, sizeof(uint32_t), compare_u32);
+        uint64_t sum = 0;
+        for (int i = 0; i < result->published; i++) {
+            sum += latency[i];
+        }
+        result->latency_min_ms = latency[0];
+        result->latency_avg_ms = sum / result->published;
+        result->latency_p95_ms = latency[(result->published * 95 - 1) / 100];
+        result->latency_max_ms = latency[result->published - 1];
+    }
+
+end:
+    free(latency);
+    free(payload);
+    free(topic);
+}
+
+void bench_log(const bench_result_t *result)
+{
+    ESP_LOGI(TAG, "~~~~ %s ~~~~", result->name);
+    ESP_LOGI(TAG, "connect     : %d ms", result->connect_ms);
+    ESP_LOGI(TAG, "published   : %d, failed %d", result->published, result->failed);
+    ESP_LOGI(TAG, "latency     : min %d, avg %d, p95 %d, max %d ms", result->latency_min_ms,
+             result->latency_avg_ms, result->latency_p95_ms, result->latency_max_ms);
+    ESP_LOGI(TAG, "heap        : %d bytes connected, %d bytes peak", result->heap_used, result->heap_peak);
+    if (result->cpu_permille >= 0) {
+        ESP_LOGI(TAG, "cpu         : %d.%d %%", result->cpu_permille / 10, result->cpu_permille % 10);
+    } else {
+        ESP_LOGI(TAG, "cpu         : n/a, enable FREERTOS_GENERATE_RUN_TIME_STATS");
+    }
+}
+
+#if CONFIG_EXAMPLE_TRANSPORT_BENCH
+static struct modem_dce *s_dce = NULL;
+
+static esp_err_t modem_mqtt_publish(const char *topic, const uint8_t *msg, size_t len, uint32_t timeout_ms)
+{
+    // the modem retransmits on its own, see BENCH_MODEM_PACKET_TIMEOUT_S
+    return bg96_mqtt_publish(s_dce, topic, msg, len, 1);
+}
+
+esp_err_t bench_run_modem_mqtt(struct modem_dce *dce, int count, size_t payload_len, bench_result_t *result)
+{
+    esp_err_t err = ESP_FAIL;
+    char *device_path = NULL;
+    s_dce = dce;
+    // everything the modem stack needs on our side is allocated after this point
+    uint32_t heap_baseline = esp_get_free_heap_size();
+    int64_t start = esp_timer_get_time();
+    if (bg96_activate_pdp(dce, BENCH_MODEM_PDP_CONTEXT, CONFIG_EXAMPLE_MODEM_APN) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to activate PDP context");
+        return ESP_FAIL;
+    }
+    // the modem verifies the server against the same roots as the SDK
+    if (bg96_upload_file(dce, BENCH_MODEM_CA_FILE, iotc_RootCA_list, IOTC_ROOTCA_LIST_BYTE_LENGTH) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to upload CA certificates");
+        goto deactivate;
+    }
+    asprintf(&device_path, DEVICE_PATH, PROJECT_ID, IOTC_LOCALE, IOTC_REGISTRY_ID, HUB_ID);
+    if (device_path == NULL) {
+        ESP_LOGE(TAG, "failed to create device_path");
+        goto deactivate;
+    }
+    bg96_mqtt_config_t config = {
+        .host = BENCH_MODEM_HOST,
+        .port = BENCH_MODEM_PORT,
+        .client_id = device_path,
+        .username = "unused",
+        .password = mqtt_current_jwt(),
+        .ca_file = BENCH_MODEM_CA_FILE,
+        .context_id = BENCH_MODEM_PDP_CONTEXT,
+        .keepalive_s = BENCH_MODEM_KEEPALIVE_S,
+        .packet_timeout_s = BENCH_MODEM_PACKET_TIMEOUT_S,
+        .retries = BENCH_MODEM_RETRIES,
+    };
+    err = bg96_mqtt_connect(dce, &config);
+    free(device_path);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "modem MQTT connect failed: %s", esp_err_to_name(err));
+        goto deactivate;
+    }
+    uint32_t connect_ms = (esp_timer_get_time() - start) / 1000;
+    bench_run("modem MQTT", modem_mqtt_publish, count, payload_len, heap_baseline, result);
+    result->connect_ms = connect_ms;
+    bg96_mqtt_disconnect(dce);
+deactivate:
+    bg96_deactivate_pdp(dce, BENCH_MODEM_PDP_CONTEXT);
+    return err;
+}
+#endif
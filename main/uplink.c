@@ -0,0 +1,268 @@
+//
+//  Copyright © 2020 Stack Care Inc. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "lte_poc.h"
+
+#define UPLINK_QUEUE_SIZE 16
+#define UPLINK_MAX_PENDING 32
+#define UPLINK_TASK_STACK_SIZE 4096
+#define UPLINK_WRITABLE_WAIT_MS 5000
+
+// a full batch fits into the SDK submission ring, see components/esp-google-iot/CMakeLists.txt
+#if defined(IOTC_EVTD_SUBMISSION_RING_SIZE) && IOTC_EVTD_SUBMISSION_RING_SIZE < UPLINK_MAX_PENDING
+#error "IOTC_EVTD_SUBMISSION_RING_SIZE is smaller than UPLINK_MAX_PENDING"
+#endif
+
+typedef struct {
+    uplink_class_t class;
+    char *topic;
+    uint8_t *msg;
+    size_t len;
+    int64_t queued_us;
+    bool refused;           // refused by the MQTT task, goes out again first
+} uplink_msg_t;
+
+static const char *TAG = "Uplink";
+
+static QueueHandle_t s_queue = NULL;
+static SemaphoreHandle_t s_drained = NULL;
+static uplink_msg_t *s_pending[UPLINK_MAX_PENDING];
+static int s_pending_count = 0;
+static uint32_t s_batch_interval_ms;
+static uint32_t s_active_tail_ms;
+
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static uplink_stats_t s_stats;
+// the radio is assumed to stay on until this time after the last uplink
+static int64_t s_radio_off_us = 0;
+static int64_t s_start_us = 0;
+
+static void uplink_free(uplink_msg_t *item)
+{
+    free(item->topic);
+    free(item->msg);
+    free(item);
+}
+
+static bool radio_is_on()
+{
+    return esp_timer_get_time() < s_radio_off_us;
+}
+
+// account the radio as on from now until the active tail has passed
+static void radio_touch()
+{
+    int64_t now = esp_timer_get_time();
+    int64_t off = now + (int64_t)s_active_tail_ms * 1000;
+    portENTER_CRITICAL(&s_stats_lock);
+    if (now >= s_radio_off_us) {
+        s_stats.wakes++;
+        s_stats.radio_on_ms += s_active_tail_ms;
+    } else {
+        s_stats.radio_on_ms += (off - s_radio_off_us) / 1000;
+    }
+    s_radio_off_us = off;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void uplink_dropped(uplink_msg_t *item)
+{
+    ESP_LOGW(TAG, "dropped uplink to %s", item->topic);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.dropped++;
+    portEXIT_CRITICAL(&s_stats_lock);
+    uplink_free(item);
+}
+
+// runs in the MQTT task, the item is ours again
+static void uplink_done(void *arg, esp_err_t err)
+{
+    uplink_msg_t *item = arg;
+    if (err == ESP_ERR_NO_MEM) {
+        // the publish window and queue were full by the time the MQTT task got to it
+        item->refused = true;
+        if (xQueueSendToFront(s_queue, &item, 0) == pdTRUE) {
+            return;
+        }
+    }
+    if (err != ESP_OK) {
+        uplink_dropped(item);
+        return;
+    }
+    uint32_t held_ms = (esp_timer_get_time() - item->queued_us) / 1000;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.sent[item->class]++;
+    if (held_ms > s_stats.max_hold_ms) {
+        s_stats.max_hold_ms = held_ms;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    uplink_free(item);
+}
+
+static void uplink_send(uplink_msg_t *item)
+{
+    // a flushed batch reaches the SDK in one go, there the alarm still goes out first
+    mqtt_priority_t priority = item->class == UPLINK_CLASS_ALARM ? MQTT_PRIORITY_URGENT : MQTT_PRIORITY_NORMAL;
+    radio_touch();
+    esp_err_t err = mqtt_publish_tracked(item->topic, item->msg, item->len, priority, uplink_done, item);
+    if (err == ESP_ERR_NO_MEM && mqtt_wait_writable(UPLINK_WRITABLE_WAIT_MS) == ESP_OK) {
+        // the SDK publish queue was full, back off until it has drained instead of dropping
+        err = mqtt_publish_tracked(item->topic, item->msg, item->len, priority, uplink_done, item);
+    }
+    if (err != ESP_OK) {
+        uplink_dropped(item);
+    }
+}
+
+static void uplink_flush()
+{
+    if (s_pending_count == 0) {
+        return;
+    }
+    ESP_LOGD(TAG, "flushing %d uplinks", s_pending_count);
+    for (int i = 0; i < s_pending_count; i++) {
+        uplink_send(s_pending[i]);
+        s_pending[i] = NULL;
+    }
+    s_pending_count = 0;
+}
+
+static void uplink_task(void *param)
+{
+    int64_t next_flush_us = esp_timer_get_time() + (int64_t)s_batch_interval_ms * 1000;
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        TickType_t wait = portMAX_DELAY;
+        if (s_pending_count > 0) {
+            wait = now < next_flush_us ? (next_flush_us - now) / 1000 / portTICK_PERIOD_MS : 0;
+        }
+        uplink_msg_t *item = NULL;
+        if (xQueueReceive(s_queue, &item, wait) == pdTRUE) {
+            if (item == NULL) {
+                // drain request
+                uplink_flush();
+                xSemaphoreGive(s_drained);
+            } else if (item->refused) {
+                // was due already, uplink_send() waits until the SDK takes it
+                uplink_send(item);
+            } else if (item->class == UPLINK_CLASS_ALARM) {
+                // the radio wakes for the alarm anyway, take the batch along
+                uplink_send(item);
+                uplink_flush();
+            } else if (radio_is_on()) {
+                // still inside the active window of the last wake, no extra wake
+                uplink_send(item);
+            } else {
+                if (s_pending_count == 0) {
+                    next_flush_us = esp_timer_get_time() + (int64_t)s_batch_interval_ms * 1000;
+                }
+                s_pending[s_pending_count++] = item;
+                if (s_pending_count == UPLINK_MAX_PENDING) {
+                    uplink_flush();
+                }
+            }
+        } else {
+            uplink_flush();
+        }
+    }
+}
+
+esp_err_t uplink_init(uint32_t batch_interval_ms, uint32_t active_tail_ms)
+{
+    if (s_queue != NULL) {
+        ESP_LOGW(TAG, "uplink is already initialized");
+        return ESP_OK;
+    }
+    s_batch_interval_ms = batch_interval_ms;
+    s_active_tail_ms = active_tail_ms;
+    s_start_us = esp_timer_get_time();
+    s_queue = xQueueCreate(UPLINK_QUEUE_SIZE, sizeof(uplink_msg_t *));
+    s_drained = xSemaphoreCreateBinary();
+    if (s_queue == NULL || s_drained == NULL) {
+        ESP_LOGE(TAG, "failed to create uplink queue");
+        if (s_queue != NULL) {
+            vQueueDelete(s_queue);
+            s_queue = NULL;
+        }
+        if (s_drained != NULL) {
+            vSemaphoreDelete(s_drained);
+            s_drained = NULL;
+        }
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(&uplink_task, "uplink_task", UPLINK_TASK_STACK_SIZE, NULL, DEFAULT_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "failed to create uplink task");
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        vSemaphoreDelete(s_drained);
+        s_drained = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uplink_publish(const char *topic, const uint8_t *msg, size_t len, uplink_class_t class)
+{
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uplink_msg_t *item = calloc(1, sizeof(uplink_msg_t));
+    if (item == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    item->class = class;
+    item->topic = strdup(topic);
+    item->msg = malloc(len);
+    item->len = len;
+    item->queued_us = esp_timer_get_time();
+    if (item->topic == NULL || item->msg == NULL) {
+        uplink_free(item);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(item->msg, msg, len);
+    if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "uplink queue is full");
+        uplink_free(item);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uplink_drain(uint32_t timeout_ms)
+{
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uplink_msg_t *marker = NULL;
+    xSemaphoreTake(s_drained, 0);
+    if (xQueueSend(s_queue, &marker, timeout_ms / portTICK_PERIOD_MS) != pdTRUE ||
+            xSemaphoreTake(s_drained, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+void uplink_get_stats(uplink_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    // the tail of the current wake has not passed yet
+    if (now < s_radio_off_us) {
+        stats->radio_on_ms -= (s_radio_off_us - now) / 1000;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    uint64_t uptime_ms = (now - s_start_us) / 1000;
+    stats->wakes_per_hour = uptime_ms ? (float)stats->wakes * 3600000 / uptime_ms : 0;
+}
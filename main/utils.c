@@ -33,14 +33,16 @@ static bool _obtain_time()
     time_t now = 0;
     struct tm timeinfo;
     int retry = 0;
-    const int retry_count = 20;
+    // poll often, the time is usually set within a few hundred milliseconds
+    const int retry_interval_ms = 100;
+    const int retry_count = 40000 / retry_interval_ms;
     char strftime_buf[64];
     timeinfo.tm_year = 0;
 
     //zb_set_led(YELLOW, ON);
     while (timeinfo.tm_year < (2016 - 1900) && ++retry < retry_count) {
         ESP_LOGD(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
+        vTaskDelay(retry_interval_ms / portTICK_PERIOD_MS);
         time(&now);
         localtime_r(&now, &timeinfo);
     }
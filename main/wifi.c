@@ -14,12 +14,13 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
-#if CONFIG_EXAMPLE_USE_WIFI
+#if CONFIG_EXAMPLE_USE_WIFI || CONFIG_EXAMPLE_DUAL_TRANSPORT
 
 /* The examples use WiFi configuration that you can set via project configuration menu
 
@@ -29,6 +30,8 @@
 #define EXAMPLE_ESP_WIFI_SSID      CONFIG_ESP_WIFI_SSID
 #define EXAMPLE_ESP_WIFI_PASS      CONFIG_ESP_WIFI_PASSWORD
 #define EXAMPLE_ESP_MAXIMUM_RETRY  CONFIG_ESP_MAXIMUM_RETRY
+/* A standby station keeps trying at this interval once the quick retries are used up */
+#define WIFI_STANDBY_RETRY_MS 10000
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -42,6 +45,9 @@ static EventGroupHandle_t s_wifi_event_group;
 static const char *TAG = "wifi station";
 
 static int s_retry_num = 0;
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+static esp_timer_handle_t s_retry_timer = NULL;
+#endif
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
@@ -65,20 +71,39 @@ static void event_handler(void* arg, esp_event_base_t event_base,
     }
 }
 
-void wifi_init_sta(void)
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+static void standby_retry(void *arg)
 {
-    s_wifi_event_group = xEventGroupCreate();
+    esp_wifi_connect();
+}
 
-    ESP_ERROR_CHECK(esp_netif_init());
+static void standby_event_handler(void* arg, esp_event_base_t event_base,
+                                  int32_t event_id, void* event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY) {
+            esp_wifi_connect();
+            s_retry_num++;
+        } else {
+            esp_timer_start_once(s_retry_timer, WIFI_STANDBY_RETRY_MS * 1000);
+        }
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        s_retry_num = 0;
+    }
+}
+#endif
 
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+static esp_netif_t *wifi_start(esp_event_handler_t handler)
+{
+    esp_netif_t *netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, handler, NULL));
 
     wifi_config_t wifi_config = {
         .sta = {
@@ -98,6 +123,17 @@ void wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
+    return netif;
+}
+
+void wifi_init_sta(void)
+{
+    s_wifi_event_group = xEventGroupCreate();
+
+    ESP_ERROR_CHECK(esp_netif_init());
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    wifi_start(&event_handler);
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -126,4 +162,19 @@ void wifi_init_sta(void)
     vEventGroupDelete(s_wifi_event_group);
 }
 
+#if CONFIG_EXAMPLE_DUAL_TRANSPORT
+esp_netif_t *wifi_start_sta(void)
+{
+    /* netif and event loop are up already, the station reconnects for as long as it runs */
+    const esp_timer_create_args_t timer_args = {
+        .callback = &standby_retry,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_retry_timer));
+    esp_netif_t *netif = wifi_start(&standby_event_handler);
+    ESP_LOGI(TAG, "wifi_start_sta finished.");
+    return netif;
+}
+#endif
+
 #endif